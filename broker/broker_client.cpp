@@ -0,0 +1,371 @@
+// broker_client.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "broker_client.h"
+#include "broker_protocol.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+
+namespace
+{
+    std::atomic<uint32_t> gSharedRegions(0);
+
+    BrokerMessage brokerMessage(uint32_t op, uint32_t result = 0, uint32_t value0 = 0, uint32_t value1 = 0, uint32_t value2 = 0, uint64_t length = 0)
+    {
+        BrokerMessage message;
+        memset(&message, 0, sizeof(message));
+        message.magic = SDM_BROKER_MAGIC;
+        message.op = op;
+        message.result = result;
+        message.value0 = value0;
+        message.value1 = value1;
+        message.value2 = value2;
+        message.length = length;
+        return message;
+    }
+
+    // the broker runs in another working directory
+    const char* absolutePath(const char* path, std::string& storage)
+    {
+        if (path == NULL || path[0] == '\0' || path[0] == '/')
+        {
+            return path;
+        }
+
+        char resolved[PATH_MAX];
+        if (realpath(path, resolved) == NULL)
+        {
+            return path;
+        }
+        storage = resolved;
+        return storage.c_str();
+    }
+
+    // anonymous POSIX shared memory, only reachable through the returned descriptor
+    int createSharedRegion()
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "/sdm_broker.%ld.%u", (long)getpid(), (unsigned)gSharedRegions++);
+
+        int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+        {
+            return -1;
+        }
+        shm_unlink(name);
+
+        if (ftruncate(fd, SDM_BROKER_SHARED_SIZE) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+BrokerClient::BrokerClient() :
+    mSocket(-1),
+    mShared(NULL),
+    mRefcon(NULL)
+{
+    memset(&mCallbacks, 0, sizeof(mCallbacks));
+}
+
+BrokerClient::~BrokerClient()
+{
+    Disconnect();
+}
+
+SDMReturnCode BrokerClient::Connect(const char* socketPath)
+{
+    Disconnect();
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socketPath == NULL || strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+    strcpy(address.sun_path, socketPath);
+
+    mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mSocket < 0 || connect(mSocket, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        Disconnect();
+        return SDMReturnCode_IOError;
+    }
+
+    int fd = createSharedRegion();
+    if (fd < 0)
+    {
+        Disconnect();
+        return SDMReturnCode_InternalError;
+    }
+
+    void* shared = mmap(NULL, SDM_BROKER_SHARED_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shared == MAP_FAILED)
+    {
+        close(fd);
+        Disconnect();
+        return SDMReturnCode_InternalError;
+    }
+    mShared = (uint8_t*)shared;
+
+    BrokerMessage reply;
+    bool sent = BrokerSend(mSocket, brokerMessage(BROKER_OP_HELLO, 0, SDM_BROKER_VERSION), fd);
+    close(fd);
+    if (!sent || !BrokerRecv(mSocket, reply) || reply.op != BROKER_OP_REPLY)
+    {
+        Disconnect();
+        return SDMReturnCode_IOError;
+    }
+
+    if (reply.result != SDMReturnCode_Success)
+    {
+        Disconnect();
+        return (SDMReturnCode)reply.result;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+void BrokerClient::Disconnect()
+{
+    if (mSocket >= 0)
+    {
+        close(mSocket);
+        mSocket = -1;
+    }
+
+    if (mShared != NULL)
+    {
+        munmap(mShared, SDM_BROKER_SHARED_SIZE);
+        mShared = NULL;
+    }
+}
+
+SDMReturnCode BrokerClient::Open(const SDMOpenParameters* params)
+{
+    if (params == NULL || params->callbacks == NULL)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    mCallbacks = *params->callbacks;
+    mRefcon = params->refcon;
+
+    if (mShared == NULL)
+    {
+        return SDMReturnCode_RequestFailed;
+    }
+
+    std::string resourcesDirectoryPath;
+    std::string manifestFilePath;
+
+    BrokerOpenRecord record;
+    memset(&record, 0, sizeof(record));
+    record.versionMajor = params->version.major;
+    record.versionMinor = params->version.minor;
+    memcpy(mShared, &record, sizeof(record));
+
+    size_t length = sizeof(record);
+    if (!BrokerPutString(mShared, SDM_BROKER_SHARED_SIZE, length, absolutePath(params->resourcesDirectoryPath, resourcesDirectoryPath)) ||
+        !BrokerPutString(mShared, SDM_BROKER_SHARED_SIZE, length, absolutePath(params->manifestFilePath, manifestFilePath)) ||
+        !BrokerPutString(mShared, SDM_BROKER_SHARED_SIZE, length, params->locales))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    return call(brokerMessage(BROKER_OP_OPEN, 0, params->debugArchitecture, params->flags, params->connectMode, length));
+}
+
+SDMReturnCode BrokerClient::Authenticate(const SDMAuthenticateParameters* params)
+{
+    if (params == NULL)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    return call(brokerMessage(BROKER_OP_AUTHENTICATE, 0, params->flags));
+}
+
+SDMReturnCode BrokerClient::ResumeBoot()
+{
+    return call(brokerMessage(BROKER_OP_RESUME_BOOT));
+}
+
+SDMReturnCode BrokerClient::Close()
+{
+    return call(brokerMessage(BROKER_OP_CLOSE));
+}
+
+SDMReturnCode BrokerClient::call(const BrokerMessage& request)
+{
+    if (mSocket < 0)
+    {
+        return SDMReturnCode_RequestFailed;
+    }
+
+    if (!BrokerSend(mSocket, request))
+    {
+        Disconnect();
+        return SDMReturnCode_IOError;
+    }
+
+    for (;;)
+    {
+        BrokerMessage message;
+        if (!BrokerRecv(mSocket, message))
+        {
+            Disconnect();
+            return SDMReturnCode_IOError;
+        }
+
+        if (message.op == BROKER_OP_REPLY)
+        {
+            return (SDMReturnCode)message.result;
+        }
+
+        if (!serveCallback(message))
+        {
+            Disconnect();
+            return SDMReturnCode_IOError;
+        }
+    }
+}
+
+bool BrokerClient::serveCallback(const BrokerMessage& request)
+{
+    SDMReturnCode res = SDMReturnCode_UnsupportedOperation;
+    size_t accessesCompleted = 0;
+
+    switch (request.op)
+    {
+    case BROKER_OP_REGISTER_ACCESS:
+        res = registerAccess(request, &accessesCompleted);
+        break;
+
+    case BROKER_OP_RESET_START:
+        if (mCallbacks.resetStart != NULL)
+        {
+            res = mCallbacks.resetStart(request.value0, mRefcon);
+        }
+        break;
+
+    case BROKER_OP_RESET_FINISH:
+        if (mCallbacks.resetFinish != NULL)
+        {
+            res = mCallbacks.resetFinish(request.value0, mRefcon);
+        }
+        break;
+
+    case BROKER_OP_UPDATE_PROGRESS:
+    {
+        std::string message;
+        bool present = false;
+        size_t offset = 0;
+        if (BrokerGetString(mShared, request.length, offset, message, present) && present && mCallbacks.updateProgress != NULL)
+        {
+            mCallbacks.updateProgress(message.c_str(), (uint8_t)request.value0, mRefcon);
+        }
+        res = SDMReturnCode_Success;
+        break;
+    }
+
+    default:
+        return false;
+    }
+
+    return BrokerSend(mSocket, brokerMessage(BROKER_OP_RESULT, res, (uint32_t)accessesCompleted));
+}
+
+SDMReturnCode BrokerClient::registerAccess(const BrokerMessage& request, size_t* accessesCompleted)
+{
+    size_t count = request.value1;
+    if (mCallbacks.registerAccess == NULL)
+    {
+        return SDMReturnCode_UnsupportedOperation;
+    }
+    if (count > SDM_BROKER_MAX_ACCESSES || request.length < sizeof(BrokerDeviceRecord) + count * sizeof(BrokerAccessRecord))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    BrokerDeviceRecord deviceRecord;
+    memcpy(&deviceRecord, mShared, sizeof(deviceRecord));
+
+    SDMDeviceDescriptor memAp;
+    SDMDeviceDescriptor device;
+    memset(&memAp, 0, sizeof(memAp));
+    memset(&device, 0, sizeof(device));
+    device.deviceType = deviceRecord.deviceType;
+    if (device.deviceType == SDMDeviceType_ArmADI_AP)
+    {
+        device.armAP.dpIndex = (uint8_t)deviceRecord.dpIndex;
+        device.armAP.address = deviceRecord.address;
+    }
+    else
+    {
+        device.armCoreSightComponent.dpIndex = (uint8_t)deviceRecord.dpIndex;
+        device.armCoreSightComponent.baseAddress = deviceRecord.address;
+        if (deviceRecord.hasMemAp)
+        {
+            memAp.deviceType = SDMDeviceType_ArmADI_AP;
+            memAp.armAP.dpIndex = (uint8_t)deviceRecord.memApDpIndex;
+            memAp.armAP.address = deviceRecord.memApAddress;
+            device.armCoreSightComponent.memAp = &memAp;
+        }
+    }
+
+    try
+    {
+        mAccesses.resize(count);
+        mValues.resize(count);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    BrokerAccessRecord* records = (BrokerAccessRecord*)(mShared + sizeof(deviceRecord));
+    for (size_t i = 0; i < count; i++)
+    {
+        BrokerAccessRecord record;
+        memcpy(&record, &records[i], sizeof(record));
+        mValues[i] = record.value;
+        mAccesses[i].address = record.address;
+        mAccesses[i].op = record.op;
+        mAccesses[i].value = &mValues[i];
+        mAccesses[i].pollMask = record.pollMask;
+        mAccesses[i].retries = record.retries;
+    }
+
+    SDMReturnCode res = mCallbacks.registerAccess(&device, request.value0, mAccesses.data(), count, accessesCompleted, mRefcon);
+    if (*accessesCompleted > count)
+    {
+        *accessesCompleted = count;
+    }
+
+    // values go back in place
+    for (size_t i = 0; i < *accessesCompleted; i++)
+    {
+        memcpy((uint8_t*)&records[i] + offsetof(BrokerAccessRecord, value), &mValues[i], sizeof(uint32_t));
+    }
+
+    return res;
+}
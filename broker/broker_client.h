@@ -0,0 +1,79 @@
+// broker_client.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief One Secure Debug Manager session run by an SdmBroker on behalf of this process.
+ *
+ * The session's callbacks are called on the thread making the SDM call, while the
+ * broker waits for them, as if the library were loaded in this process.
+ */
+
+#ifndef BROKER_CLIENT_H
+#define BROKER_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "broker_protocol.h"
+
+class BrokerClient
+{
+public:
+    BrokerClient();
+
+    /**
+     * Disconnects, the broker closes a session still open.
+     */
+    ~BrokerClient();
+
+    /**
+     * \brief Connect to a broker and hand it a shared memory region.
+     *
+     * @param[in] socketPath Broker socket.
+     * @return SDMReturnCode_IOError if the broker is not running.
+     */
+    SDMReturnCode Connect(const char* socketPath);
+
+    void Disconnect();
+
+    /**
+     * \brief SDMOpen in the broker. Relative paths are resolved in this process first.
+     *
+     * presentForm is not forwarded, so credentials must resolve non-interactively in
+     * the broker.
+     */
+    SDMReturnCode Open(const SDMOpenParameters* params);
+
+    SDMReturnCode Authenticate(const SDMAuthenticateParameters* params);
+    SDMReturnCode ResumeBoot();
+    SDMReturnCode Close();
+
+private:
+    // sends an SDM call and serves the session's callbacks until the broker replies
+    SDMReturnCode call(const BrokerMessage& request);
+
+    // performs one callback, false if the connection failed
+    bool serveCallback(const BrokerMessage& request);
+
+    SDMReturnCode registerAccess(const BrokerMessage& request, size_t* accessesCompleted);
+
+    int mSocket;
+    uint8_t* mShared;
+
+    SDMCallbacks mCallbacks;
+    void* mRefcon;
+
+    // reused across register access callbacks
+    std::vector<SDMRegisterAccess> mAccesses;
+    std::vector<uint32_t> mValues;
+};
+
+#endif // BROKER_CLIENT_H
@@ -0,0 +1,273 @@
+// broker_protocol.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Wire format between BrokerClient and SdmBroker.
+ *
+ * A client connects to the broker's Unix domain socket and sends BROKER_OP_HELLO with
+ * the file descriptor of a shared memory region of SDM_BROKER_SHARED_SIZE bytes
+ * attached. Every other message is a BrokerMessage on the socket, with any variable
+ * length payload placed at the start of the shared region.
+ *
+ * Calls are strictly nested. The client sends an SDM call, then serves callbacks from
+ * the broker until the broker sends BROKER_OP_REPLY:
+ *
+ *   client -> broker: BROKER_OP_OPEN | AUTHENTICATE | RESUME_BOOT | CLOSE
+ *   broker -> client: BROKER_OP_REGISTER_ACCESS | RESET_* | UPDATE_PROGRESS, answered
+ *                     by the client with BROKER_OP_RESULT, any number of times
+ *   broker -> client: BROKER_OP_REPLY
+ *
+ * The broker opens its sessions with SDMOpenExtensions::callerThreadCallbacks, so the
+ * library makes no callback outside a call: rx_pump and SDMLazyOpen_Background are off.
+ *
+ * A party only writes the shared region while the other one is waiting for its message,
+ * so it needs no locking. Fields are in host byte order, both ends run on one machine.
+ * One connection carries one session.
+ */
+
+#ifndef BROKER_PROTOCOL_H
+#define BROKER_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define SDM_BROKER_MAGIC          0x4B524253 /* "SBRK" */
+#define SDM_BROKER_VERSION        1
+#define SDM_BROKER_SHARED_SIZE    (1024 * 1024)
+#define SDM_BROKER_SOCKET_ENV     "SDM_BROKER_SOCKET"
+#define SDM_BROKER_DEFAULT_SOCKET "/tmp/sdm_broker.sock"
+
+typedef enum BrokerOp {
+    BROKER_OP_HELLO = 1,        /*!< value0: SDM_BROKER_VERSION, shared region attached */
+    BROKER_OP_OPEN,             /*!< value0: debugArchitecture, value1: flags, value2: connectMode, payload: BrokerOpenRecord and strings */
+    BROKER_OP_AUTHENTICATE,     /*!< value0: flags */
+    BROKER_OP_RESUME_BOOT,
+    BROKER_OP_CLOSE,
+    BROKER_OP_REPLY,            /*!< result of the call */
+
+    BROKER_OP_REGISTER_ACCESS = 0x100, /*!< value0: transferSize, value1: access count, payload: BrokerDeviceRecord, BrokerAccessRecord[count] */
+    BROKER_OP_RESET_START,      /*!< value0: resetType */
+    BROKER_OP_RESET_FINISH,     /*!< value0: resetType */
+    BROKER_OP_UPDATE_PROGRESS,  /*!< value0: percent complete, payload: message string */
+    BROKER_OP_RESULT            /*!< result of the callback, value0: accesses completed. Register values updated in place */
+} BrokerOp;
+
+typedef struct BrokerMessage {
+    uint32_t magic;             /*!< SDM_BROKER_MAGIC */
+    uint32_t op;                /*!< BrokerOp */
+    uint32_t result;            /*!< SDMReturnCode, BROKER_OP_REPLY and BROKER_OP_RESULT */
+    uint32_t value0;
+    uint32_t value1;
+    uint32_t value2;
+    uint64_t length;            /*!< Payload bytes in the shared region */
+} BrokerMessage;
+
+typedef struct BrokerOpenRecord {
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    uint32_t reserved;
+    /* followed by resourcesDirectoryPath, manifestFilePath and locales, see BrokerPutString */
+} BrokerOpenRecord;
+
+/** An SDMDeviceDescriptor with its parent MEM-AP, if any, inlined */
+typedef struct BrokerDeviceRecord {
+    uint32_t deviceType;
+    uint32_t dpIndex;
+    uint64_t address;           /*!< AP address, or CoreSight component base address */
+    uint32_t hasMemAp;
+    uint32_t memApDpIndex;
+    uint64_t memApAddress;
+} BrokerDeviceRecord;
+
+typedef struct BrokerAccessRecord {
+    uint64_t address;
+    uint32_t op;                /*!< SDMRegisterAccessOp */
+    uint32_t value;             /*!< Write data or poll value, then the value after the access */
+    uint32_t pollMask;
+    uint32_t retries;
+} BrokerAccessRecord;
+
+static_assert(sizeof(BrokerMessage) == 32, "BrokerMessage must not be padded");
+static_assert(sizeof(BrokerDeviceRecord) == 32, "BrokerDeviceRecord must not be padded");
+static_assert(sizeof(BrokerAccessRecord) == 24, "BrokerAccessRecord must not be padded");
+
+/** Register accesses that fit in the shared region in one callback */
+#define SDM_BROKER_MAX_ACCESSES ((SDM_BROKER_SHARED_SIZE - sizeof(BrokerDeviceRecord)) / sizeof(BrokerAccessRecord))
+
+/**
+ * \brief Send a message, with a file descriptor attached if fd is not negative.
+ *
+ * @return false if the connection closed or failed first.
+ */
+inline bool BrokerSend(int socket, const BrokerMessage& message, int fd = -1)
+{
+    iovec data = { (void*)&message, sizeof(message) };
+    msghdr header;
+    memset(&header, 0, sizeof(header));
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+
+    union
+    {
+        cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    if (fd >= 0)
+    {
+        memset(&control, 0, sizeof(control));
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+        cmsghdr* rights = CMSG_FIRSTHDR(&header);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(rights), &fd, sizeof(int));
+    }
+
+    // the descriptor goes with the first byte, the rest is plain data
+    const uint8_t* bytes = (const uint8_t*)&message;
+    size_t remaining = sizeof(message);
+    while (remaining > 0)
+    {
+        data.iov_base = (void*)bytes;
+        data.iov_len = remaining;
+        ssize_t sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        bytes += sent;
+        remaining -= (size_t)sent;
+        header.msg_control = NULL;
+        header.msg_controllen = 0;
+    }
+    return true;
+}
+
+/**
+ * \brief Receive a message and check its magic. A file descriptor attached to it is
+ * stored in fd if given, otherwise closed.
+ *
+ * @return false if the connection closed or failed first, or the message is malformed.
+ */
+inline bool BrokerRecv(int socket, BrokerMessage& message, int* fd = NULL)
+{
+    if (fd != NULL)
+    {
+        *fd = -1;
+    }
+
+    union
+    {
+        cmsghdr align;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    uint8_t* bytes = (uint8_t*)&message;
+    size_t remaining = sizeof(message);
+    while (remaining > 0)
+    {
+        iovec data = { bytes, remaining };
+        msghdr header;
+        memset(&header, 0, sizeof(header));
+        header.msg_iov = &data;
+        header.msg_iovlen = 1;
+        header.msg_control = control.buffer;
+        header.msg_controllen = sizeof(control.buffer);
+
+        ssize_t received = recvmsg(socket, &header, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+
+        for (cmsghdr* rights = CMSG_FIRSTHDR(&header); rights != NULL; rights = CMSG_NXTHDR(&header, rights))
+        {
+            if (rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS)
+            {
+                int receivedFd = -1;
+                memcpy(&receivedFd, CMSG_DATA(rights), sizeof(int));
+                if (fd != NULL && *fd < 0)
+                {
+                    *fd = receivedFd;
+                }
+                else
+                {
+                    close(receivedFd);
+                }
+            }
+        }
+
+        bytes += received;
+        remaining -= (size_t)received;
+    }
+
+    return message.magic == SDM_BROKER_MAGIC && message.length <= SDM_BROKER_SHARED_SIZE;
+}
+
+/**
+ * \brief Append a string, or NULL, to a payload as a uint32_t length and the characters.
+ *
+ * @return false if it does not fit.
+ */
+inline bool BrokerPutString(uint8_t* payload, size_t size, size_t& offset, const char* text)
+{
+    uint32_t length = text != NULL ? (uint32_t)strlen(text) : UINT32_MAX;
+    size_t needed = sizeof(length) + (text != NULL ? length : 0);
+    if (offset > size || needed > size - offset)
+    {
+        return false;
+    }
+
+    memcpy(payload + offset, &length, sizeof(length));
+    if (text != NULL)
+    {
+        memcpy(payload + offset + sizeof(length), text, length);
+    }
+    offset += needed;
+    return true;
+}
+
+/**
+ * \brief Read a string appended by BrokerPutString.
+ *
+ * @param[out] present Whether the string was not NULL.
+ * @return false if the payload is truncated.
+ */
+template <typename String>
+bool BrokerGetString(const uint8_t* payload, size_t size, size_t& offset, String& text, bool& present)
+{
+    uint32_t length = 0;
+    if (offset > size || sizeof(length) > size - offset)
+    {
+        return false;
+    }
+    memcpy(&length, payload + offset, sizeof(length));
+    offset += sizeof(length);
+
+    present = length != UINT32_MAX;
+    if (!present)
+    {
+        text.clear();
+        return true;
+    }
+    if (length > size - offset)
+    {
+        return false;
+    }
+
+    text.assign((const char*)payload + offset, length);
+    offset += length;
+    return true;
+}
+
+#endif // BROKER_PROTOCOL_H
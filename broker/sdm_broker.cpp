@@ -0,0 +1,77 @@
+// sdm_broker.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Runs an SdmBroker on the secure_debug_manager library until interrupted.
+ *
+ * Debuggers load secure_debug_manager_broker in place of secure_debug_manager to run
+ * their sessions here, sharing the crypto context and caches of this process.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdm_broker_server.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--socket PATH]\n", binname);
+        fprintf(stderr, "\t--socket PATH : Unix domain socket to listen on. Default: $%s, or %s.\n", SDM_BROKER_SOCKET_ENV, SDM_BROKER_DEFAULT_SOCKET);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    SdmBrokerOptions options;
+    const char* socketPath = getenv(SDM_BROKER_SOCKET_ENV);
+    options.socketPath = socketPath != NULL && socketPath[0] != '\0' ? socketPath : SDM_BROKER_DEFAULT_SOCKET;
+    options.api.open = SDMOpenEx;
+    options.api.authenticate = SDMAuthenticate;
+    options.api.resumeBoot = SDMResumeBoot;
+    options.api.close = SDMClose;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--socket") == 0 && arg + 1 < argc)
+        {
+            options.socketPath = argv[++arg];
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    SdmBroker broker(options);
+    if (broker.Start() != SDMReturnCode_Success)
+    {
+        fprintf(stderr, "Error: failed to listen on %s\n", options.socketPath.c_str());
+        return EXIT_FAILURE;
+    }
+
+    printf("Listening on %s\n", options.socketPath.c_str());
+    fflush(stdout);
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+
+    broker.Stop();
+    printf("%llu sessions served\n", (unsigned long long)broker.SessionCount());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,449 @@
+// sdm_broker_server.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "sdm_broker_server.h"
+#include "broker_protocol.h"
+
+#include <string.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <system_error>
+
+// per client state, the refcon of the session callbacks
+struct SdmBroker::Connection
+{
+    int socket;
+    uint8_t* shared;
+
+    // set once the client is gone, callbacks then fail without touching the socket
+    bool failed;
+
+    SDMCallbacks callbacks;
+    SDMHandle handle;
+    bool open;
+
+    // referenced by the session until it is closed
+    std::string resourcesDirectoryPath;
+    std::string manifestFilePath;
+    std::string locales;
+};
+
+namespace
+{
+    BrokerMessage brokerMessage(uint32_t op, uint32_t result = 0, uint32_t value0 = 0, uint32_t value1 = 0, uint64_t length = 0)
+    {
+        BrokerMessage message;
+        memset(&message, 0, sizeof(message));
+        message.magic = SDM_BROKER_MAGIC;
+        message.op = op;
+        message.result = result;
+        message.value0 = value0;
+        message.value1 = value1;
+        message.length = length;
+        return message;
+    }
+
+    // sends a callback to the client and waits for its result
+    SDMReturnCode callClient(int socket, bool& failed, const BrokerMessage& request, BrokerMessage& result)
+    {
+        if (failed)
+        {
+            return SDMReturnCode_IOError;
+        }
+
+        if (!BrokerSend(socket, request) || !BrokerRecv(socket, result) || result.op != BROKER_OP_RESULT)
+        {
+            failed = true;
+            return SDMReturnCode_IOError;
+        }
+
+        return (SDMReturnCode)result.result;
+    }
+
+    void toDeviceRecord(const SDMDeviceDescriptor* device, BrokerDeviceRecord& record)
+    {
+        memset(&record, 0, sizeof(record));
+        if (device == NULL)
+        {
+            return;
+        }
+
+        record.deviceType = device->deviceType;
+        if (device->deviceType == SDMDeviceType_ArmADI_AP)
+        {
+            record.dpIndex = device->armAP.dpIndex;
+            record.address = device->armAP.address;
+        }
+        else if (device->deviceType == SDMDeviceType_ArmADI_CoreSightComponent)
+        {
+            record.dpIndex = device->armCoreSightComponent.dpIndex;
+            record.address = device->armCoreSightComponent.baseAddress;
+            if (device->armCoreSightComponent.memAp != NULL)
+            {
+                record.hasMemAp = 1;
+                record.memApDpIndex = device->armCoreSightComponent.memAp->armAP.dpIndex;
+                record.memApAddress = device->armCoreSightComponent.memAp->armAP.address;
+            }
+        }
+    }
+}
+
+SdmBroker::SdmBroker(const SdmBrokerOptions& options) :
+    mOptions(options),
+    mListenSocket(-1),
+    mStopping(false),
+    mSessions(0),
+    mOpenSessions(0)
+{
+}
+
+SdmBroker::~SdmBroker()
+{
+    Stop();
+}
+
+SDMReturnCode SdmBroker::Start()
+{
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (mOptions.socketPath.empty() || mOptions.socketPath.size() >= sizeof(address.sun_path) ||
+        mOptions.api.open == NULL || mOptions.api.authenticate == NULL || mOptions.api.resumeBoot == NULL || mOptions.api.close == NULL)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+    memcpy(address.sun_path, mOptions.socketPath.c_str(), mOptions.socketPath.size());
+
+    mListenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (mListenSocket < 0)
+    {
+        return SDMReturnCode_IOError;
+    }
+
+    // sessions use the broker's credentials, keep other users out
+    unlink(mOptions.socketPath.c_str());
+    mode_t mask = umask(0177);
+    int bound = bind(mListenSocket, (sockaddr*)&address, sizeof(address));
+    umask(mask);
+
+    if (bound != 0 || listen(mListenSocket, 16) != 0)
+    {
+        close(mListenSocket);
+        mListenSocket = -1;
+        return SDMReturnCode_IOError;
+    }
+
+    mStopping = false;
+    mAcceptThread = std::thread(&SdmBroker::acceptLoop, this);
+
+    return SDMReturnCode_Success;
+}
+
+void SdmBroker::Stop()
+{
+    if (mListenSocket < 0)
+    {
+        return;
+    }
+
+    // unblocks accept and every connection waiting in recv
+    mStopping = true;
+    shutdown(mListenSocket, SHUT_RDWR);
+    mAcceptThread.join();
+    close(mListenSocket);
+    mListenSocket = -1;
+    unlink(mOptions.socketPath.c_str());
+
+    {
+        std::lock_guard<std::mutex> lock(mConnectionsMutex);
+        for (int connection : mConnections)
+        {
+            shutdown(connection, SHUT_RDWR);
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mConnectionsMutex);
+    mConnectionsDone.wait(lock, [this]() { return mConnections.empty(); });
+}
+
+size_t SdmBroker::ConnectionCount()
+{
+    std::lock_guard<std::mutex> lock(mConnectionsMutex);
+    return mConnections.size();
+}
+
+void SdmBroker::acceptLoop()
+{
+    while (!mStopping)
+    {
+        int connection = accept(mListenSocket, NULL, NULL);
+        if (connection < 0)
+        {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mConnectionsMutex);
+        if (mStopping)
+        {
+            close(connection);
+            break;
+        }
+
+        // detached, so a long running broker does not keep the threads of clients that are gone
+        try
+        {
+            mConnections.push_back(connection);
+            std::thread(&SdmBroker::serve, this, connection).detach();
+        }
+        catch (const std::exception&)
+        {
+            mConnections.erase(std::remove(mConnections.begin(), mConnections.end(), connection), mConnections.end());
+            close(connection);
+        }
+    }
+}
+
+void SdmBroker::serve(int socket)
+{
+    serveSession(socket);
+
+    // last access to the broker, Stop waits for every connection to get here
+    std::lock_guard<std::mutex> lock(mConnectionsMutex);
+    mConnections.erase(std::remove(mConnections.begin(), mConnections.end(), socket), mConnections.end());
+    close(socket);
+    mConnectionsDone.notify_all();
+}
+
+void SdmBroker::serveSession(int socket)
+{
+    Connection connection;
+    connection.socket = socket;
+    connection.shared = NULL;
+    connection.failed = false;
+    memset(&connection.callbacks, 0, sizeof(connection.callbacks));
+    connection.callbacks.registerAccess = registerAccess;
+    connection.callbacks.resetStart = resetStart;
+    connection.callbacks.resetFinish = resetFinish;
+    connection.callbacks.updateProgress = updateProgress;
+    connection.handle = NULL;
+    connection.open = false;
+
+    // the client's shared region comes with its first message
+    BrokerMessage hello;
+    int fd = -1;
+    struct stat info;
+    if (BrokerRecv(socket, hello, &fd) && hello.op == BROKER_OP_HELLO && hello.value0 == SDM_BROKER_VERSION &&
+        fd >= 0 && fstat(fd, &info) == 0 && info.st_size >= SDM_BROKER_SHARED_SIZE)
+    {
+        void* shared = mmap(NULL, SDM_BROKER_SHARED_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        connection.shared = shared != MAP_FAILED ? (uint8_t*)shared : NULL;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+
+    bool ok = BrokerSend(socket, brokerMessage(BROKER_OP_REPLY, connection.shared != NULL ? SDMReturnCode_Success : SDMReturnCode_InvalidArgument));
+
+    while (ok && connection.shared != NULL)
+    {
+        BrokerMessage request;
+        if (!BrokerRecv(socket, request))
+        {
+            break;
+        }
+
+        SDMReturnCode res = SDMReturnCode_InternalError;
+        if (request.op == BROKER_OP_OPEN)
+        {
+            res = serveOpen(connection, request);
+        }
+        else if (!connection.open)
+        {
+            // as the library does for calls before SDMOpen
+            res = SDMReturnCode_InternalError;
+        }
+        else if (request.op == BROKER_OP_AUTHENTICATE)
+        {
+            SDMAuthenticateParameters params;
+            memset(&params, 0, sizeof(params));
+            params.flags = request.value0;
+            res = mOptions.api.authenticate(connection.handle, &params);
+        }
+        else if (request.op == BROKER_OP_RESUME_BOOT)
+        {
+            res = mOptions.api.resumeBoot(connection.handle);
+        }
+        else if (request.op == BROKER_OP_CLOSE)
+        {
+            res = mOptions.api.close(connection.handle);
+            connection.open = false;
+            mOpenSessions--;
+        }
+        else
+        {
+            break;
+        }
+
+        // a callback found the client gone
+        if (connection.failed)
+        {
+            break;
+        }
+
+        ok = BrokerSend(socket, brokerMessage(BROKER_OP_REPLY, res));
+    }
+
+    // a client that exits without SDMClose leaves its session to the broker
+    connection.failed = true;
+    if (connection.open)
+    {
+        mOptions.api.close(connection.handle);
+        mOpenSessions--;
+    }
+
+    if (connection.shared != NULL)
+    {
+        munmap(connection.shared, SDM_BROKER_SHARED_SIZE);
+    }
+}
+
+SDMReturnCode SdmBroker::serveOpen(Connection& connection, const BrokerMessage& request)
+{
+    if (connection.open)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    // copied out, callbacks reuse the shared region
+    BrokerOpenRecord record;
+    size_t offset = sizeof(record);
+    bool hasResources = false;
+    bool hasManifest = false;
+    bool hasLocales = false;
+    if (request.length < sizeof(record) ||
+        !BrokerGetString(connection.shared, request.length, offset, connection.resourcesDirectoryPath, hasResources) ||
+        !BrokerGetString(connection.shared, request.length, offset, connection.manifestFilePath, hasManifest) ||
+        !BrokerGetString(connection.shared, request.length, offset, connection.locales, hasLocales))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+    memcpy(&record, connection.shared, sizeof(record));
+
+    SDMOpenParameters params;
+    memset(&params, 0, sizeof(params));
+    params.version.major = record.versionMajor;
+    params.version.minor = record.versionMinor;
+    params.debugArchitecture = request.value0;
+    params.flags = request.value1;
+    params.connectMode = request.value2;
+    params.callbacks = &connection.callbacks;
+    params.refcon = &connection;
+    params.resourcesDirectoryPath = hasResources ? connection.resourcesDirectoryPath.c_str() : NULL;
+    params.manifestFilePath = hasManifest ? connection.manifestFilePath.c_str() : NULL;
+    params.locales = hasLocales ? connection.locales.c_str() : NULL;
+
+    // callbacks are only forwarded while the client waits for a reply, so none may come
+    // from a library thread, see broker_protocol.h
+    SDMOpenExtensions extensions;
+    memset(&extensions, 0, sizeof(extensions));
+    extensions.size = sizeof(extensions);
+    extensions.callerThreadCallbacks = 1;
+
+    SDMReturnCode res = mOptions.api.open(&connection.handle, &params, &extensions);
+    if (res == SDMReturnCode_Success)
+    {
+        connection.open = true;
+        mSessions++;
+        mOpenSessions++;
+    }
+
+    return res;
+}
+
+SDMReturnCode SdmBroker::registerAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+{
+    Connection& connection = *(Connection*)refcon;
+    *accessesCompleted = 0;
+
+    BrokerDeviceRecord deviceRecord;
+    toDeviceRecord(device, deviceRecord);
+
+    // lists longer than the shared region are forwarded in parts
+    do
+    {
+        size_t count = std::min(accessCount - *accessesCompleted, (size_t)SDM_BROKER_MAX_ACCESSES);
+        const SDMRegisterAccess* part = accesses + *accessesCompleted;
+
+        memcpy(connection.shared, &deviceRecord, sizeof(deviceRecord));
+        BrokerAccessRecord* records = (BrokerAccessRecord*)(connection.shared + sizeof(deviceRecord));
+        for (size_t i = 0; i < count; i++)
+        {
+            BrokerAccessRecord record = { part[i].address, part[i].op, part[i].value != NULL ? *part[i].value : 0, part[i].pollMask, part[i].retries };
+            memcpy(&records[i], &record, sizeof(record));
+        }
+
+        BrokerMessage result;
+        SDMReturnCode res = callClient(connection.socket, connection.failed,
+            brokerMessage(BROKER_OP_REGISTER_ACCESS, 0, transferSize, (uint32_t)count, sizeof(deviceRecord) + count * sizeof(BrokerAccessRecord)), result);
+        if (connection.failed)
+        {
+            return res;
+        }
+
+        size_t completed = std::min((size_t)result.value0, count);
+        for (size_t i = 0; i < completed; i++)
+        {
+            if (part[i].value != NULL)
+            {
+                BrokerAccessRecord record;
+                memcpy(&record, &records[i], sizeof(record));
+                *part[i].value = record.value;
+            }
+        }
+        *accessesCompleted += completed;
+
+        if (res != SDMReturnCode_Success || completed != count)
+        {
+            return res;
+        }
+    }
+    while (*accessesCompleted < accessCount);
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SdmBroker::resetStart(SDMResetType resetType, void* refcon)
+{
+    Connection& connection = *(Connection*)refcon;
+    BrokerMessage result;
+    return callClient(connection.socket, connection.failed, brokerMessage(BROKER_OP_RESET_START, 0, resetType), result);
+}
+
+SDMReturnCode SdmBroker::resetFinish(SDMResetType resetType, void* refcon)
+{
+    Connection& connection = *(Connection*)refcon;
+    BrokerMessage result;
+    return callClient(connection.socket, connection.failed, brokerMessage(BROKER_OP_RESET_FINISH, 0, resetType), result);
+}
+
+void SdmBroker::updateProgress(const char* progressMessage, uint8_t percentComplete, void* refcon)
+{
+    Connection& connection = *(Connection*)refcon;
+    size_t length = 0;
+    if (!BrokerPutString(connection.shared, SDM_BROKER_SHARED_SIZE, length, progressMessage))
+    {
+        return;
+    }
+
+    BrokerMessage result;
+    callClient(connection.socket, connection.failed, brokerMessage(BROKER_OP_UPDATE_PROGRESS, 0, percentComplete, 0, length), result);
+}
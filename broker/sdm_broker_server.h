@@ -0,0 +1,112 @@
+// sdm_broker_server.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Serves Secure Debug Manager sessions to other processes over a Unix domain socket.
+ *
+ * Each connection is one session (see broker_protocol.h), run on its own thread. Sessions
+ * are opened in the broker process, so the PSA crypto context, the certificate frame
+ * cache and any memory mapped authentication bundle are initialized once and shared by
+ * every client. Register accesses, resets and progress updates are forwarded back to the
+ * client that opened the session.
+ */
+
+#ifndef SDM_BROKER_SERVER_H
+#define SDM_BROKER_SERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+#include "broker_protocol.h"
+
+/**
+ * \brief The SDM entry points sessions are served with. sdm_broker uses the library exports.
+ */
+struct SdmBrokerApi
+{
+    SDMReturnCode (*open)(SDMHandle* handle, const SDMOpenParameters* params, const SDMOpenExtensions* extensions);
+    SDMReturnCode (*authenticate)(SDMHandle handle, const SDMAuthenticateParameters* params);
+    SDMReturnCode (*resumeBoot)(SDMHandle handle);
+    SDMReturnCode (*close)(SDMHandle handle);
+};
+
+struct SdmBrokerOptions
+{
+    std::string socketPath;     /*!< Unix domain socket to listen on, replaced if it exists */
+    SdmBrokerApi api;
+};
+
+class SdmBroker
+{
+public:
+    explicit SdmBroker(const SdmBrokerOptions& options);
+
+    /**
+     * Stops the broker.
+     */
+    ~SdmBroker();
+
+    /**
+     * \brief Listen and start accepting clients on a background thread.
+     *
+     * The socket is only accessible to the user running the broker.
+     *
+     * @return SDMReturnCode_IOError if the socket could not be bound.
+     */
+    SDMReturnCode Start();
+
+    /**
+     * \brief Stop accepting, disconnect every client and wait for their threads.
+     *
+     * Sessions still open are closed, their callbacks fail with SDMReturnCode_IOError.
+     */
+    void Stop();
+
+    /** Sessions opened, over all clients */
+    uint64_t SessionCount() const { return mSessions; }
+
+    /** Sessions currently open */
+    uint64_t OpenSessionCount() const { return mOpenSessions; }
+
+    /** Clients connected, each served by a thread that exits when the client disconnects */
+    size_t ConnectionCount();
+
+private:
+    struct Connection;
+
+    void acceptLoop();
+    void serve(int socket);
+    void serveSession(int socket);
+    SDMReturnCode serveOpen(Connection& connection, const BrokerMessage& request);
+
+    // SDMCallbacks forwarding to the client, with the Connection as refcon
+    static SDMReturnCode registerAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon);
+    static SDMReturnCode resetStart(SDMResetType resetType, void* refcon);
+    static SDMReturnCode resetFinish(SDMResetType resetType, void* refcon);
+    static void updateProgress(const char* progressMessage, uint8_t percentComplete, void* refcon);
+
+    SdmBrokerOptions mOptions;
+    int mListenSocket;
+    std::atomic<bool> mStopping;
+    std::atomic<uint64_t> mSessions;
+    std::atomic<uint64_t> mOpenSessions;
+
+    std::thread mAcceptThread;
+    std::mutex mConnectionsMutex;
+    std::vector<int> mConnections;       // one detached thread each, see serve
+    std::condition_variable mConnectionsDone;
+};
+
+#endif // SDM_BROKER_SERVER_H
@@ -0,0 +1,138 @@
+// sdm_broker_shim.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Secure Debug Manager API exports that run every session in an sdm_broker daemon.
+ *
+ * Built as a drop-in replacement of the secure_debug_manager library. The broker socket
+ * is taken from the SDM_BROKER_SOCKET environment variable, or SDM_BROKER_DEFAULT_SOCKET.
+ */
+
+#include <stdlib.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "secure_debug_manager.h"
+#include "broker_client.h"
+#include "broker_protocol.h"
+
+namespace
+{
+    // one broker connection per open session
+    std::mutex gClientsMutex;
+    std::map<SDMHandle, std::unique_ptr<BrokerClient>> gClients;
+
+    SDMReturnCode findClient(SDMHandle handle, BrokerClient*& client)
+    {
+        std::lock_guard<std::mutex> lock(gClientsMutex);
+        if (gClients.empty())
+        {
+            // SDM not open
+            return SDMReturnCode_InternalError;
+        }
+
+        auto found = gClients.find(handle);
+        if (found == gClients.end())
+        {
+            // invalid handle
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        client = found->second.get();
+        return SDMReturnCode_Success;
+    }
+}
+
+SDMReturnCode SDMOpen(SDMHandle *handle, const SDMOpenParameters* params)
+{
+    if (params == 0 || handle == 0)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    std::unique_ptr<BrokerClient> client(new (std::nothrow) BrokerClient());
+    if (client == 0)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    const char* socketPath = getenv(SDM_BROKER_SOCKET_ENV);
+    SDMReturnCode ret = client->Connect(socketPath != NULL && socketPath[0] != '\0' ? socketPath : SDM_BROKER_DEFAULT_SOCKET);
+    if (ret != SDMReturnCode_Success)
+    {
+        return ret;
+    }
+
+    ret = client->Open(params);
+    if (ret != SDMReturnCode_Success)
+    {
+        return ret;
+    }
+
+    SDMHandle clientHandle = (SDMHandle)client.get();
+    try
+    {
+        std::lock_guard<std::mutex> lock(gClientsMutex);
+        gClients[clientHandle] = std::move(client);
+    }
+    catch (const std::bad_alloc&)
+    {
+        if (client)
+        {
+            client->Close();
+        }
+        return SDMReturnCode_InternalError;
+    }
+
+    *handle = clientHandle;
+
+    return ret;
+}
+
+SDMReturnCode SDMAuthenticate(SDMHandle handle, const SDMAuthenticateParameters *params)
+{
+    BrokerClient* client = 0;
+    SDMReturnCode found = findClient(handle, client);
+    if (found != SDMReturnCode_Success)
+    {
+        return found;
+    }
+
+    return client->Authenticate(params);
+}
+
+SDMReturnCode SDMResumeBoot(SDMHandle handle)
+{
+    BrokerClient* client = 0;
+    SDMReturnCode found = findClient(handle, client);
+    if (found != SDMReturnCode_Success)
+    {
+        return found;
+    }
+
+    return client->ResumeBoot();
+}
+
+SDMReturnCode SDMClose(SDMHandle handle)
+{
+    BrokerClient* client = 0;
+    SDMReturnCode found = findClient(handle, client);
+    if (found != SDMReturnCode_Success)
+    {
+        return found;
+    }
+
+    SDMReturnCode res = client->Close();
+
+    std::lock_guard<std::mutex> lock(gClientsMutex);
+    gClients.erase(handle);
+
+    return res;
+}
@@ -0,0 +1,574 @@
+// batch_runner.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Authenticates many targets concurrently, for board farms.
+ *
+ * Reads a manifest of targets, authenticates them on a bounded pool of worker
+ * threads and reports throughput and latency. Each target has its own debug probe
+ * connection and Secure Debug Manager session.
+ *
+ * The manifest has one [section] per target, named after the target, of key = value
+ * lines. Keys before the first section are defaults for every target. '#' and ';'
+ * start comments. Relative paths are resolved against the manifest directory.
+ *
+ *   address = TCP:dstream-01     debug probe address, prefixed with protocol (TCP:/USB:)
+ *   sdf = corstone1000.sdf       SDF file describing the target system
+ *   dap_index = 1                RDDI device index of the system DAP
+ *   com_index = 2                RDDI device index of the SDC-600 COM-AP or APBCOM
+ *   private_key_file = ...       credentials, or authentication_bundle_file
+ *   trust_chain_file = ...
+ *   authentication_bundle_file = ...
+ *   timeout = 60                 seconds allowed for the session
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+
+#include "rddi_adapter.h"
+
+#define DEFAULT_TIMEOUT_SECONDS 60
+
+namespace
+{
+    struct Target
+    {
+        std::string name;
+        std::string address;
+        std::string sdf;
+        int dapIndex;
+        int comIndex;
+        std::string privateKeyFile;
+        std::string trustChainFile;
+        std::string bundleFile;
+        unsigned timeoutSeconds;
+    };
+
+    struct Result
+    {
+        bool success;
+        bool timedOut;
+        const char* stage;   /*!< Stage that failed */
+        int code;            /*!< RDDI or SDM return code of the failed stage */
+        double seconds;
+        std::string error;   /*!< Last setErrorMessage */
+    };
+
+    struct Session
+    {
+        const Target* target;
+        RDDIAdapter rddi;
+        Result* result;
+    };
+
+    // bounded work stealing pool: each worker takes from the front of its own queue,
+    // and steals from the back of the others when it runs dry
+    class WorkQueue
+    {
+    public:
+        void Push(size_t item)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mItems.push_back(item);
+        }
+
+        bool PopFront(size_t& item)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mItems.empty())
+            {
+                return false;
+            }
+            item = mItems.front();
+            mItems.pop_front();
+            return true;
+        }
+
+        bool StealBack(size_t& item)
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if (mItems.empty())
+            {
+                return false;
+            }
+            item = mItems.back();
+            mItems.pop_back();
+            return true;
+        }
+
+    private:
+        std::mutex mMutex;
+        std::deque<size_t> mItems;
+    };
+
+    std::mutex gPrintMutex;
+    bool gVerbose = false;
+
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--jobs N] [--timeout SECONDS] [--csv FILE] [--verbose] MANIFEST\n", binname);
+        fprintf(stderr, "\t--jobs N : Targets authenticated concurrently. Default: the number of CPUs.\n");
+        fprintf(stderr, "\t--timeout SECONDS : Default session timeout for targets without a timeout key. Default %d.\n", DEFAULT_TIMEOUT_SECONDS);
+        fprintf(stderr, "\t--csv FILE : Write per-target results to FILE.\n");
+        fprintf(stderr, "\t--verbose : Print progress and RDDI errors of every target.\n");
+        fprintf(stderr, "\tMANIFEST : Targets to authenticate, see the batch_runner.cpp header for the format.\n");
+    }
+
+    std::string Trim(const std::string& text)
+    {
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos)
+        {
+            return std::string();
+        }
+        size_t last = text.find_last_not_of(" \t\r\n");
+        return text.substr(first, last - first + 1);
+    }
+
+    std::string ResolvePath(const std::string& directory, const std::string& path)
+    {
+        bool absolute = !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+        return absolute ? path : directory + path;
+    }
+
+    bool ApplyKey(Target& target, const std::string& key, const std::string& value, const std::string& directory)
+    {
+        char* end = NULL;
+        if (key == "address")
+        {
+            target.address = value;
+        }
+        else if (key == "sdf")
+        {
+            target.sdf = ResolvePath(directory, value);
+        }
+        else if (key == "dap_index" || key == "com_index")
+        {
+            long index = strtol(value.c_str(), &end, 0);
+            if (value.empty() || *end != '\0' || index < 0)
+            {
+                return false;
+            }
+            (key == "dap_index" ? target.dapIndex : target.comIndex) = (int)index;
+        }
+        else if (key == "private_key_file")
+        {
+            target.privateKeyFile = ResolvePath(directory, value);
+        }
+        else if (key == "trust_chain_file")
+        {
+            target.trustChainFile = ResolvePath(directory, value);
+        }
+        else if (key == "authentication_bundle_file")
+        {
+            target.bundleFile = ResolvePath(directory, value);
+        }
+        else if (key == "timeout")
+        {
+            unsigned long seconds = strtoul(value.c_str(), &end, 0);
+            if (value.empty() || *end != '\0' || seconds == 0)
+            {
+                return false;
+            }
+            target.timeoutSeconds = (unsigned)seconds;
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    bool LoadManifest(const char* path, unsigned defaultTimeout, std::vector<Target>& targets)
+    {
+        std::ifstream file(path);
+        if (!file.good())
+        {
+            fprintf(stderr, "Error: failed to open %s\n", path);
+            return false;
+        }
+
+        std::string manifestPath(path);
+        size_t separator = manifestPath.find_last_of("/\\");
+        std::string directory = separator == std::string::npos ? std::string() : manifestPath.substr(0, separator + 1);
+
+        Target defaults = { "", "", "", -1, -1, "", "", "", defaultTimeout };
+        Target* current = &defaults;
+
+        std::string line;
+        size_t lineNumber = 0;
+        while (std::getline(file, line))
+        {
+            lineNumber++;
+
+            size_t comment = line.find_first_of("#;");
+            if (comment != std::string::npos)
+            {
+                line.erase(comment);
+            }
+
+            line = Trim(line);
+            if (line.empty())
+            {
+                continue;
+            }
+
+            if (line[0] == '[')
+            {
+                if (line.back() != ']' || line.size() < 3)
+                {
+                    fprintf(stderr, "Error: %s:%zu: expected [target]\n", path, lineNumber);
+                    return false;
+                }
+
+                targets.push_back(defaults);
+                targets.back().name = Trim(line.substr(1, line.size() - 2));
+                current = &targets.back();
+                continue;
+            }
+
+            size_t equals = line.find('=');
+            if (equals == std::string::npos || !ApplyKey(*current, Trim(line.substr(0, equals)), Trim(line.substr(equals + 1)), directory))
+            {
+                fprintf(stderr, "Error: %s:%zu: invalid line\n", path, lineNumber);
+                return false;
+            }
+        }
+
+        for (const Target& target : targets)
+        {
+            if (target.address.empty() || target.sdf.empty() || target.dapIndex < 0 || target.comIndex < 0)
+            {
+                fprintf(stderr, "Error: target %s needs address, sdf, dap_index and com_index\n", target.name.c_str());
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void updateProgress(const char *progressMessage, uint8_t percentComplete, void *refcon)
+    {
+        if (gVerbose)
+        {
+            Session* session = (Session*)((RDDIAdapter*)refcon)->context;
+            std::lock_guard<std::mutex> lock(gPrintMutex);
+            printf("[%s] %s %u%%\n", session->target->name.c_str(), progressMessage, (unsigned)percentComplete);
+        }
+    }
+
+    void setErrorMessage(const char *errorMessage, const char *errorDetails, void *refcon)
+    {
+        Session* session = (Session*)((RDDIAdapter*)refcon)->context;
+        session->result->error = errorMessage != NULL ? errorMessage : "";
+        if (errorDetails != NULL && errorDetails[0] != '\0')
+        {
+            session->result->error += std::string(": ") + errorDetails;
+        }
+    }
+
+    // the manifest supplies the credentials, there is no one to answer a form
+    SDMReturnCode presentForm(const SDMForm *form, void *refcon)
+    {
+        return SDMReturnCode_UnsupportedOperation;
+    }
+
+    void Fail(Result& result, const char* stage, int code)
+    {
+        result.success = false;
+        result.stage = stage;
+        result.code = code;
+    }
+
+    void Authenticate(const Target& target, Result& result)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        Session session;
+        session.target = &target;
+        session.result = &result;
+        RDDIAdapter_Init(&session.rddi, target.dapIndex, target.comIndex);
+        session.rddi.verbose = gVerbose;
+        session.rddi.context = &session;
+
+        result.success = true;
+        result.timedOut = false;
+        result.stage = "";
+        result.code = 0;
+
+        SDMOpenExtensions extensions;
+        memset(&extensions, 0, sizeof(extensions));
+        extensions.size = sizeof(extensions);
+        extensions.privateKeyFile = target.privateKeyFile.empty() ? NULL : target.privateKeyFile.c_str();
+        extensions.trustChainFile = target.trustChainFile.empty() ? NULL : target.trustChainFile.c_str();
+        extensions.authenticationBundleFile = target.bundleFile.empty() ? NULL : target.bundleFile.c_str();
+
+        SDMCallbacks callbacks;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.updateProgress = updateProgress;
+        callbacks.setErrorMessage = setErrorMessage;
+        callbacks.presentForm = presentForm;
+        RDDIAdapter_SetCallbacks(&callbacks);
+
+        SDMOpenParameters params;
+        memset(&params, 0, sizeof(params));
+        params.version.major = SDMVersion_CurrentMajor;
+        params.version.minor = SDMVersion_CurrentMinor;
+        params.callbacks = &callbacks;
+        params.refcon = &session.rddi;
+
+        int rddiRes = RDDIAdapter_Connect(&session.rddi, target.sdf.c_str(), target.address.c_str());
+        if (rddiRes != RDDI_SUCCESS)
+        {
+            Fail(result, "connect", rddiRes);
+        }
+        else
+        {
+            rddiRes = RDDIAdapter_OpenComPort(&session.rddi, &params.debugArchitecture);
+            if (rddiRes != RDDI_SUCCESS)
+            {
+                Fail(result, "COM port", rddiRes);
+            }
+            else
+            {
+                // probe connection time counts against the timeout
+                session.rddi.hasDeadline = true;
+                session.rddi.deadline = start + std::chrono::seconds(target.timeoutSeconds);
+
+                SDMHandle handle;
+                SDMReturnCode sdmRes = SDMOpenEx(&handle, &params, &extensions);
+                if (sdmRes != SDMReturnCode_Success)
+                {
+                    Fail(result, "open", sdmRes);
+                }
+                else
+                {
+                    sdmRes = SDMAuthenticate(handle, NULL);
+                    if (sdmRes != SDMReturnCode_Success)
+                    {
+                        Fail(result, "authenticate", sdmRes);
+                    }
+                    else if ((sdmRes = SDMResumeBoot(handle)) != SDMReturnCode_Success)
+                    {
+                        Fail(result, "resume boot", sdmRes);
+                    }
+
+                    // close the link even when out of time
+                    session.rddi.hasDeadline = false;
+                    SDMReturnCode closeRes = SDMClose(handle);
+                    if (result.success && closeRes != SDMReturnCode_Success)
+                    {
+                        Fail(result, "close", closeRes);
+                    }
+                }
+
+                RDDIAdapter_CloseComPort(&session.rddi);
+            }
+
+            RDDIAdapter_Disconnect(&session.rddi);
+        }
+
+        result.timedOut = session.rddi.timedOut;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double Percentile(const std::vector<double>& sorted, double percentile)
+    {
+        if (sorted.empty())
+        {
+            return 0.0;
+        }
+        size_t rank = (size_t)(percentile / 100.0 * (double)(sorted.size() - 1) + 0.5);
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+    bool WriteCsv(const char* path, const std::vector<Target>& targets, const std::vector<Result>& results)
+    {
+        FILE* file = fopen(path, "w");
+        if (file == NULL)
+        {
+            return false;
+        }
+
+        fprintf(file, "target,status,stage,code,seconds,error\n");
+        for (size_t i = 0; i < targets.size(); i++)
+        {
+            const Result& result = results[i];
+            std::string error = result.error;
+            std::replace(error.begin(), error.end(), '"', '\'');
+            fprintf(file, "%s,%s,%s,0x%08x,%.3f,\"%s\"\n", targets[i].name.c_str(),
+                    result.success ? "ok" : result.timedOut ? "timeout" : "failed",
+                    result.stage, (unsigned)result.code, result.seconds, error.c_str());
+        }
+
+        return fclose(file) == 0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long jobs = std::max(1u, std::thread::hardware_concurrency());
+    unsigned long defaultTimeout = DEFAULT_TIMEOUT_SECONDS;
+    const char* csvPath = NULL;
+
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc)
+        {
+            jobs = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--timeout") == 0 && arg + 1 < argc)
+        {
+            defaultTimeout = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--csv") == 0 && arg + 1 < argc)
+        {
+            csvPath = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--verbose") == 0)
+        {
+            gVerbose = true;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - arg != 1 || jobs == 0 || defaultTimeout == 0)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Target> targets;
+    if (!LoadManifest(argv[arg], (unsigned)defaultTimeout, targets))
+    {
+        return EXIT_FAILURE;
+    }
+
+    if (targets.empty())
+    {
+        fprintf(stderr, "Error: no targets in %s\n", argv[arg]);
+        return EXIT_FAILURE;
+    }
+
+    size_t workerCount = std::min((size_t)jobs, targets.size());
+    std::vector<WorkQueue> queues(workerCount);
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        queues[i % workerCount].Push(i);
+    }
+
+    std::vector<Result> results(targets.size());
+    std::atomic<size_t> finished(0);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    auto worker = [&](size_t self)
+    {
+        for (;;)
+        {
+            size_t item = 0;
+            bool found = queues[self].PopFront(item);
+            for (size_t i = 1; !found && i < workerCount; i++)
+            {
+                found = queues[(self + i) % workerCount].StealBack(item);
+            }
+
+            // no work is added once started, so empty queues mean done
+            if (!found)
+            {
+                return;
+            }
+
+            Authenticate(targets[item], results[item]);
+
+            size_t done = ++finished;
+            const Result& result = results[item];
+            std::lock_guard<std::mutex> lock(gPrintMutex);
+            if (result.success)
+            {
+                printf("[%zu/%zu] %s: authenticated in %.3f s\n", done, targets.size(), targets[item].name.c_str(), result.seconds);
+            }
+            else
+            {
+                printf("[%zu/%zu] %s: %s %s failed with code 0x%08x after %.3f s %s\n", done, targets.size(), targets[item].name.c_str(),
+                       result.timedOut ? "timed out," : "", result.stage, (unsigned)result.code, result.seconds, result.error.c_str());
+            }
+            fflush(stdout);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.push_back(std::thread(worker, i));
+    }
+    for (std::thread& thread : workers)
+    {
+        thread.join();
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> latencies;
+    size_t timedOut = 0;
+    for (const Result& result : results)
+    {
+        if (result.success)
+        {
+            latencies.push_back(result.seconds);
+        }
+        else if (result.timedOut)
+        {
+            timedOut++;
+        }
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    double totalLatency = 0.0;
+    for (double latency : latencies)
+    {
+        totalLatency += latency;
+    }
+
+    size_t failed = targets.size() - latencies.size();
+    printf("\n%zu targets, %zu workers: %zu authenticated, %zu failed (%zu timed out)\n",
+           targets.size(), workerCount, latencies.size(), failed, timedOut);
+    printf("Wall time %.3f s, throughput %.2f targets/min\n", wallSeconds, wallSeconds > 0.0 ? (double)targets.size() * 60.0 / wallSeconds : 0.0);
+    if (!latencies.empty())
+    {
+        printf("Latency (s): min %.3f mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+               latencies.front(), totalLatency / (double)latencies.size(),
+               Percentile(latencies, 50), Percentile(latencies, 90), Percentile(latencies, 99), latencies.back());
+    }
+
+    if (csvPath != NULL && !WriteCsv(csvPath, targets, results))
+    {
+        fprintf(stderr, "Error: failed to write %s\n", csvPath);
+        return EXIT_FAILURE;
+    }
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
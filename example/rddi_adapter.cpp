@@ -0,0 +1,437 @@
+// rddi_adapter.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <new>
+#include <vector>
+
+#include "rddi_adapter.h"
+#include "rddi_configinfo.h"
+
+#define BUFFER_LENGTH 128
+
+// RDDI DP.CSW ID for system resets
+#define DP_CTRL_STAT_REG_ID 0x2081
+
+namespace
+{
+    bool WaitForACK(RDDIAdapter* adapter, unsigned int mask, unsigned int value, unsigned int ctrlStat)
+    {
+        int attempts = 0;
+        int result = RDDI_SUCCESS;
+        const int MaxDAPPWRACKPolls = 100;
+
+        while ( ((ctrlStat & mask) != value) &&
+                (result == RDDI_SUCCESS) &&
+                (attempts < MaxDAPPWRACKPolls))
+        {
+            result = Debug_RegReadBlock(adapter->handle, adapter->dapIndex, DP_CTRL_STAT_REG_ID, 1, &ctrlStat, 1);
+            attempts++;
+        }
+
+        return (attempts < MaxDAPPWRACKPolls) && (result == RDDI_SUCCESS);
+    }
+
+    int systemResetStart(RDDIAdapter* adapter)
+    {
+        if (adapter->dapIndex < 1)
+        {
+            return RDDI_WRONGDEV;
+        }
+
+        // Connect to DAP device
+        int deviceId = 0;
+        int version = 0;
+        char message[BUFFER_LENGTH];
+
+        int result = Debug_OpenConn(adapter->handle, adapter->dapIndex, &deviceId, &version, message, BUFFER_LENGTH);
+        if (result != RDDI_SUCCESS)
+        {
+            return result;
+        }
+
+        uint32 ctrlStat = 0x00000000;
+
+        // Read modify write the DAP CtrlStat bits
+        result = Debug_RegReadBlock(adapter->handle, adapter->dapIndex, DP_CTRL_STAT_REG_ID, 1, &ctrlStat, 1);
+        if (result != RDDI_SUCCESS)
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return result;
+        }
+
+        // Power down DBG & SYS
+        ctrlStat &= ~0x50000000;
+        result = Debug_RegWriteBlock(adapter->handle, adapter->dapIndex, DP_CTRL_STAT_REG_ID, 1, &ctrlStat);
+        if (result != RDDI_SUCCESS)
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return result;
+        }
+
+        // ACK should go low
+        if (!WaitForACK(adapter, 0xA0000000, 0x0, ctrlStat))
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return RDDI_INTERNAL_ERROR;
+        }
+
+        // Drive nSRST low
+        result = Debug_SystemReset(adapter->handle, 0, RDDI_RST_ASSERT);
+        if (result != RDDI_SUCCESS)
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return result;
+        }
+
+        // Power up DBG & SYS
+        ctrlStat = 0x50000000;
+        result = Debug_RegWriteBlock(adapter->handle, adapter->dapIndex, DP_CTRL_STAT_REG_ID, 1, &ctrlStat);
+        if (result != RDDI_SUCCESS)
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return result;
+        }
+
+        // ACK should go high
+        if (!WaitForACK(adapter, 0xA0000000, 0xA0000000, ctrlStat))
+        {
+            Debug_CloseConn(adapter->handle, adapter->dapIndex);
+            return RDDI_INTERNAL_ERROR;
+        }
+
+        // Disconnect DAP device
+        return Debug_CloseConn(adapter->handle, adapter->dapIndex);
+    }
+
+    int systemResetFinish(RDDIAdapter* adapter)
+    {
+        return Debug_SystemReset(adapter->handle, 0, RDDI_RST_DEASSERT);
+    }
+
+    bool pastDeadline(RDDIAdapter* adapter)
+    {
+        if (adapter->hasDeadline && std::chrono::steady_clock::now() >= adapter->deadline)
+        {
+            adapter->timedOut = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Reads and writes, no polls. Passed to the probe back to back in lists of up to maxListLength
+    SDMReturnCode runList(RDDIAdapter* adapter, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted)
+    {
+        size_t chunkLength = adapter->maxListLength > 0 ? adapter->maxListLength : accessCount;
+
+        for (size_t first = 0; first < accessCount; first += chunkLength)
+        {
+            size_t count = accessCount - first < chunkLength ? accessCount - first : chunkLength;
+
+            RDDI_REG_ACC_OP* ops = &adapter->ops[0];
+            for (size_t i = 0; i < count; i++)
+            {
+                const SDMRegisterAccess& access = accesses[first + i];
+                ops[i].registerID = (int)(access.address / 4);
+                ops[i].registerSize = 1;
+                ops[i].rwFlag = (access.op == SDMRegisterAccessOp_Read ? 0 : 1);
+                ops[i].pRegisterValue = access.value;
+                ops[i].errorCode = RDDI_SUCCESS;
+                ops[i].errorLength = 0;
+                ops[i].pErrorMsg = NULL;
+            }
+
+            int result = Debug_RegRWList(adapter->handle, adapter->comPortDeviceIndex, ops, (int)count);
+            if (result != RDDI_SUCCESS)
+            {
+                if (adapter->verbose)
+                {
+                    printf("registerAccess : Debug_RegRWList failed with error code %d\n", result);
+                }
+                return SDMReturnCode_TransferError;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                if (ops[i].errorCode != RDDI_SUCCESS)
+                {
+                    if (adapter->verbose)
+                    {
+                        printf("registerAccess : Debug_RegRWList failed for operation %zu with error code %d: %s\n", first + i, ops[i].errorCode, ops[i].pErrorMsg);
+                    }
+                    return SDMReturnCode_TransferError;
+                }
+                (*accessesCompleted)++;
+            }
+        }
+
+        return SDMReturnCode_Success;
+    }
+
+    // Read until (value & pollMask) matches the expected value, up to retries reads
+    SDMReturnCode runPoll(RDDIAdapter* adapter, const SDMRegisterAccess& access)
+    {
+        const uint32_t expected = *access.value & access.pollMask;
+        const int registerID = (int)(access.address / 4);
+
+        for (uint32_t attempt = 0; attempt < access.retries || attempt == 0; attempt++)
+        {
+            uint32 value = 0;
+            int result = Debug_RegReadBlock(adapter->handle, adapter->comPortDeviceIndex, registerID, 1, &value, 1);
+            if (result != RDDI_SUCCESS)
+            {
+                if (adapter->verbose)
+                {
+                    printf("registerAccess : poll read failed with error code %d\n", result);
+                }
+                return SDMReturnCode_TransferError;
+            }
+
+            if (((uint32_t)value & access.pollMask) == expected)
+            {
+                *access.value = (uint32_t)value;
+                return SDMReturnCode_Success;
+            }
+
+            if (pastDeadline(adapter))
+            {
+                return SDMReturnCode_TimeoutError;
+            }
+        }
+
+        return SDMReturnCode_TimeoutError;
+    }
+}
+
+void RDDIAdapter_Init(RDDIAdapter* adapter, int dapIndex, int comPortDeviceIndex)
+{
+    adapter->handle = 0;
+    adapter->dapIndex = dapIndex;
+    adapter->comPortDeviceIndex = comPortDeviceIndex;
+    adapter->verbose = true;
+    adapter->hasDeadline = false;
+    adapter->deadline = std::chrono::steady_clock::time_point();
+    adapter->timedOut = false;
+    adapter->context = NULL;
+    adapter->maxListLength = RDDI_ADAPTER_DEFAULT_MAX_LIST_LENGTH;
+}
+
+int RDDIAdapter_Connect(RDDIAdapter* adapter, const char* sdf, const char* address)
+{
+    int result = RDDI_Open(&adapter->handle, NULL);
+    if (result != RDDI_SUCCESS)
+    {
+        return result;
+    }
+
+    result = ConfigInfo_OpenFileAndRetarget(adapter->handle, sdf, address);
+    if (result != RDDI_SUCCESS)
+    {
+        RDDI_Close(adapter->handle);
+        return result;
+    }
+
+    char clientInfo[BUFFER_LENGTH];
+    char iceInfo[BUFFER_LENGTH];
+    char copyrightInfo[BUFFER_LENGTH];
+
+    result = Debug_Connect(adapter->handle,
+            "SDM Example",
+            clientInfo, BUFFER_LENGTH,
+            iceInfo, BUFFER_LENGTH,
+            copyrightInfo, BUFFER_LENGTH);
+
+    if (result != RDDI_SUCCESS)
+    {
+        RDDI_Close(adapter->handle);
+        return result;
+    }
+
+    return RDDI_SUCCESS;
+}
+
+int RDDIAdapter_OpenComPort(RDDIAdapter* adapter, SDMDebugArchitecture* debugArchitecture)
+{
+    // Connect to the SDC-600 device
+    int deviceId = 0;
+    int version = 0;
+    char message[BUFFER_LENGTH];
+
+    int result = Debug_OpenConn(adapter->handle, adapter->comPortDeviceIndex, &deviceId, &version, message, BUFFER_LENGTH);
+    if (result != RDDI_SUCCESS)
+    {
+        return result;
+    }
+
+    // Check if SDC-600 device is COM-AP (SoC-400) or APBCOM (SoC-600)
+    // AP templates return the contents of IDR, peripheral devices return pid
+    // The Control and Status Register have a different offset depending on the varient
+    static const uint32_t COMAP_IDR = 0x04762000;
+    static const uint32_t APMCOM_PID = 0x9ef;
+    if (deviceId == COMAP_IDR)
+    {
+        *debugArchitecture = SDMDebugArchitecture_ArmADIv5;
+    }
+    else if (deviceId == APMCOM_PID)
+    {
+        *debugArchitecture = SDMDebugArchitecture_ArmADIv6;
+    }
+    else
+    {
+        Debug_CloseConn(adapter->handle, adapter->comPortDeviceIndex);
+        return RDDI_WRONGDEV;
+    }
+
+    return RDDI_SUCCESS;
+}
+
+void RDDIAdapter_CloseComPort(RDDIAdapter* adapter)
+{
+    Debug_CloseConn(adapter->handle, adapter->comPortDeviceIndex);
+}
+
+int RDDIAdapter_Disconnect(RDDIAdapter* adapter)
+{
+    int disconResult = Debug_Disconnect(adapter->handle, 0);
+    int closeResult = RDDI_Close(adapter->handle);
+
+    return disconResult != RDDI_SUCCESS ? disconResult : closeResult;
+}
+
+void RDDIAdapter_SetCallbacks(SDMCallbacks* callbacks)
+{
+    callbacks->resetStart = RDDIAdapter_ResetStart;
+    callbacks->resetFinish = RDDIAdapter_ResetFinish;
+    callbacks->readMemory = RDDIAdapter_ReadMemory;
+    callbacks->writeMemory = RDDIAdapter_WriteMemory;
+    callbacks->registerAccess = RDDIAdapter_RegisterAccess;
+}
+
+SDMReturnCode RDDIAdapter_ResetStart(SDMResetType resetType, void* refcon)
+{
+    RDDIAdapter* adapter = (RDDIAdapter*)refcon;
+
+    if (resetType != SDMResetType_Default && resetType != SDMResetType_Hardware)
+    {
+        // Only hardware reset is supported in this example
+        printf("resetStart: unsupported reset type\n");
+        return SDMReturnCode_UnsupportedOperation;
+    }
+
+    int rddiReturnCode = systemResetStart(adapter);
+    if (rddiReturnCode != RDDI_SUCCESS)
+    {
+        printf("resetStart: failed with error [0x%04x]\n", (unsigned)rddiReturnCode);
+        return SDMReturnCode_InternalError;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode RDDIAdapter_ResetFinish(SDMResetType resetType, void* refcon)
+{
+    RDDIAdapter* adapter = (RDDIAdapter*)refcon;
+
+    if (resetType != SDMResetType_Default && resetType != SDMResetType_Hardware)
+    {
+        // Only hardware reset is supported in this example
+        printf("resetFinish: unsupported reset type\n");
+        return SDMReturnCode_UnsupportedOperation;
+    }
+
+    int rddiReturnCode = systemResetFinish(adapter);
+    if (rddiReturnCode != RDDI_SUCCESS)
+    {
+        printf("resetFinish: failed with error [0x%04x]\n", (unsigned)rddiReturnCode);
+        return SDMReturnCode_InternalError;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode RDDIAdapter_ReadMemory(const SDMDeviceDescriptor *device, uint64_t address, SDMTransferSize transferSize, size_t transferCount, uint32_t attributes, void *data, void *refcon)
+{
+    printf("readMemory: unsupported callback\n");
+    return SDMReturnCode_UnsupportedOperation;
+}
+
+SDMReturnCode RDDIAdapter_WriteMemory(const SDMDeviceDescriptor *device, uint64_t address, SDMTransferSize transferSize, size_t transferCount, uint32_t attributes, const void *value, void *refcon)
+{
+    printf("writeMemory: unsupported callback\n");
+    return SDMReturnCode_UnsupportedOperation;
+}
+
+SDMReturnCode RDDIAdapter_RegisterAccess(const SDMDeviceDescriptor *device, SDMTransferSize transferSize, const SDMRegisterAccess *accesses, size_t accessCount, size_t *accessesCompleted, void *refcon)
+{
+    RDDIAdapter* adapter = (RDDIAdapter*)refcon;
+
+    if (adapter == 0 || device == 0 || accesses == 0 || accessesCompleted == 0)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    *accessesCompleted = 0;
+    if (accessCount < 1)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    // abandon the session once the target is out of time, the library fails on the first refused access
+    if (pastDeadline(adapter))
+    {
+        return SDMReturnCode_TimeoutError;
+    }
+
+    // grow the op array to the largest list seen, so steady state accesses do not allocate
+    size_t opCount = adapter->maxListLength > 0 && adapter->maxListLength < accessCount ? adapter->maxListLength : accessCount;
+    if (adapter->ops.size() < opCount)
+    {
+        try
+        {
+            adapter->ops.resize(opCount);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return SDMReturnCode_InternalError;
+        }
+    }
+
+    // runs of reads and writes go to the probe as lists, split at each poll
+    size_t first = 0;
+    while (first < accessCount)
+    {
+        size_t end = first;
+        while (end < accessCount && accesses[end].op != SDMRegisterAccessOp_Poll)
+        {
+            end++;
+        }
+
+        if (end > first)
+        {
+            SDMReturnCode result = runList(adapter, &accesses[first], end - first, accessesCompleted);
+            if (result != SDMReturnCode_Success)
+            {
+                return result;
+            }
+        }
+
+        if (end < accessCount)
+        {
+            SDMReturnCode result = runPoll(adapter, accesses[end]);
+            if (result != SDMReturnCode_Success)
+            {
+                return result;
+            }
+            (*accessesCompleted)++;
+            end++;
+        }
+
+        first = end;
+    }
+
+    return SDMReturnCode_Success;
+}
@@ -0,0 +1,95 @@
+// rddi_adapter.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Secure Debug Manager callbacks implemented with RDDI, for one target.
+ *
+ * The callbacks take the RDDIAdapter of their target as refcon, so any number of
+ * targets can be driven concurrently, one SDM session and one RDDI connection each.
+ */
+
+#ifndef RDDI_ADAPTER_H
+#define RDDI_ADAPTER_H
+
+#include <stdint.h>
+
+#include <chrono>
+#include <vector>
+
+#include "secure_debug_manager.h"
+
+#include "rddi_debug.h"
+
+// Default longest list passed to a single Debug_RegRWList call
+#define RDDI_ADAPTER_DEFAULT_MAX_LIST_LENGTH 256
+
+struct RDDIAdapter
+{
+    RDDIHandle handle;
+    int dapIndex;            /*!< RDDI device index of the system DAP, used for resets */
+    int comPortDeviceIndex;  /*!< RDDI device index of the SDC-600 COM-AP or APBCOM */
+    bool verbose;            /*!< Print RDDI failures */
+
+    bool hasDeadline;        /*!< Fail register accesses once deadline has passed */
+    std::chrono::steady_clock::time_point deadline;
+    bool timedOut;           /*!< Set when a register access was refused at the deadline */
+
+    void* context;           /*!< Host data for its own callbacks, which also receive the adapter as refcon */
+
+    size_t maxListLength;    /*!< Longest list the probe accepts in one Debug_RegRWList call */
+    std::vector<RDDI_REG_ACC_OP> ops;  /*!< Reused for every registerAccess, grows to the largest batch */
+};
+
+/**
+ * \brief Initialize adapter for dapIndex and comPortDeviceIndex, without connecting.
+ */
+void RDDIAdapter_Init(RDDIAdapter* adapter, int dapIndex, int comPortDeviceIndex);
+
+/**
+ * \brief Open RDDI, configure it from an SDF file and connect to the debug probe at address.
+ *
+ * @return RDDI_SUCCESS or an RDDI error code.
+ */
+int RDDIAdapter_Connect(RDDIAdapter* adapter, const char* sdf, const char* address);
+
+/**
+ * \brief Connect to the SDC-600 device and detect its debug architecture.
+ *
+ * @return RDDI_SUCCESS, RDDI_WRONGDEV if the device is not an SDC-600 COM port,
+ *         or an RDDI error code.
+ */
+int RDDIAdapter_OpenComPort(RDDIAdapter* adapter, SDMDebugArchitecture* debugArchitecture);
+
+void RDDIAdapter_CloseComPort(RDDIAdapter* adapter);
+
+/**
+ * \brief Disconnect from the debug probe and close RDDI.
+ */
+int RDDIAdapter_Disconnect(RDDIAdapter* adapter);
+
+/**
+ * \brief Set the resetStart, resetFinish, readMemory, writeMemory and registerAccess callbacks.
+ *
+ * The SDMOpenParameters refcon must be the RDDIAdapter.
+ */
+void RDDIAdapter_SetCallbacks(SDMCallbacks* callbacks);
+
+SDMReturnCode RDDIAdapter_ResetStart(SDMResetType resetType, void* refcon);
+SDMReturnCode RDDIAdapter_ResetFinish(SDMResetType resetType, void* refcon);
+SDMReturnCode RDDIAdapter_ReadMemory(const SDMDeviceDescriptor *device, uint64_t address, SDMTransferSize transferSize, size_t transferCount, uint32_t attributes, void *data, void *refcon);
+SDMReturnCode RDDIAdapter_WriteMemory(const SDMDeviceDescriptor *device, uint64_t address, SDMTransferSize transferSize, size_t transferCount, uint32_t attributes, const void *value, void *refcon);
+
+/**
+ * \brief registerAccess callback.
+ *
+ * Reads and writes are passed to the probe as Debug_RegRWList calls of up to maxListLength
+ * operations. RDDI has no probe-side register poll, so SDMRegisterAccessOp_Poll is
+ * repeated from the host, up to retries reads.
+ */
+SDMReturnCode RDDIAdapter_RegisterAccess(const SDMDeviceDescriptor *device, SDMTransferSize transferSize, const SDMRegisterAccess *accesses, size_t accessCount, size_t *accessesCompleted, void *refcon);
+
+#endif // RDDI_ADAPTER_H
@@ -0,0 +1,224 @@
+// authentication_bundle.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "authentication_bundle.h"
+#include "psa_adac.h"
+#include "psa_adac_debug.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define ENTITY_NAME "AuthenticationBundle"
+
+namespace
+{
+    bool inBounds(uint64_t offset, uint64_t size, uint64_t limit)
+    {
+        return offset <= limit && size <= limit - offset;
+    }
+
+    bool isAbsolutePath(const std::string& path)
+    {
+#ifdef _WIN32
+        return (path.size() > 1 && path[1] == ':') || (!path.empty() && (path[0] == '\\' || path[0] == '/'));
+#else
+        return !path.empty() && path[0] == '/';
+#endif
+    }
+
+    std::string directoryOf(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+}
+
+AuthenticationBundle::AuthenticationBundle() :
+    mBase(NULL),
+    mMappedSize(0),
+#ifdef _WIN32
+    mFile(INVALID_HANDLE_VALUE),
+    mMapping(NULL),
+#endif
+    mHeader(NULL),
+    mCertificates(NULL)
+{
+}
+
+AuthenticationBundle::~AuthenticationBundle()
+{
+#ifdef _WIN32
+    if (mBase != NULL)
+    {
+        UnmapViewOfFile(mBase);
+    }
+    if (mMapping != NULL)
+    {
+        CloseHandle(mMapping);
+    }
+    if (mFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(mFile);
+    }
+#else
+    if (mBase != NULL)
+    {
+        munmap((void*)mBase, mMappedSize);
+    }
+#endif
+}
+
+ArenaPtr<AuthenticationBundle> AuthenticationBundle::Open(const char* path, SessionArena* arena)
+{
+    if (path == NULL)
+    {
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    ArenaPtr<AuthenticationBundle> bundle = ArenaNew<AuthenticationBundle>(arena);
+    if (!bundle)
+    {
+        return bundle;
+    }
+
+#ifdef _WIN32
+    bundle->mFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (bundle->mFile == INVALID_HANDLE_VALUE)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to open %s\n", path);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(bundle->mFile, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(SDMBundleHeader))
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Invalid bundle size %s\n", path);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    bundle->mMapping = CreateFileMappingA(bundle->mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (bundle->mMapping == NULL)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to map %s\n", path);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    bundle->mBase = (const uint8_t*)MapViewOfFile(bundle->mMapping, FILE_MAP_READ, 0, 0, 0);
+    bundle->mMappedSize = (size_t)fileSize.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to open %s\n", path);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)sizeof(SDMBundleHeader))
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Invalid bundle size %s\n", path);
+        close(fd);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    void* base = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base != MAP_FAILED)
+    {
+        bundle->mBase = (const uint8_t*)base;
+        bundle->mMappedSize = (size_t)fileStat.st_size;
+    }
+#endif
+
+    if (bundle->mBase == NULL)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to map %s\n", path);
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    if (!bundle->validate(bundle->mMappedSize, path))
+    {
+        return ArenaPtr<AuthenticationBundle>();
+    }
+
+    return bundle;
+}
+
+bool AuthenticationBundle::validate(size_t fileSize, const char* path)
+{
+    mHeader = (const SDMBundleHeader*)mBase;
+
+    if (mHeader->magic != SDM_BUNDLE_MAGIC || mHeader->version != SDM_BUNDLE_VERSION || mHeader->headerSize < sizeof(SDMBundleHeader))
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Unsupported bundle format %s\n", path);
+        return false;
+    }
+
+    if (mHeader->totalSize > fileSize ||
+        !inBounds(mHeader->keyReferenceOffset, mHeader->keyReferenceSize, mHeader->totalSize) ||
+        !inBounds(mHeader->chainOffset, mHeader->chainSize, mHeader->totalSize) ||
+        !inBounds(mHeader->certificateIndexOffset, (uint64_t)mHeader->certificateCount * sizeof(SDMBundleCertificate), mHeader->totalSize) ||
+        (mHeader->chainOffset % SDM_BUNDLE_ALIGNMENT) != 0 ||
+        (mHeader->certificateIndexOffset % SDM_BUNDLE_ALIGNMENT) != 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Truncated or malformed bundle %s\n", path);
+        return false;
+    }
+
+    if (mHeader->keyReferenceType != SDM_BUNDLE_KEY_FILE || mHeader->keyReferenceSize == 0 ||
+        mBase[mHeader->keyReferenceOffset + mHeader->keyReferenceSize - 1] != '\0')
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Invalid key reference %s\n", path);
+        return false;
+    }
+
+    mCertificates = (const SDMBundleCertificate*)(mBase + mHeader->certificateIndexOffset);
+    for (size_t i = 0; i < mHeader->certificateCount; i++)
+    {
+        const SDMBundleCertificate& certificate = mCertificates[i];
+        if (!inBounds(certificate.tlvOffset, certificate.tlvSize, mHeader->chainSize) || (certificate.tlvOffset % 4) != 0 ||
+            certificate.tlvSize < sizeof(psa_tlv_t))
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Invalid certificate %zu %s\n", i, path);
+            return false;
+        }
+
+        // the TLV header, the index and the precomputed request must all agree on the size
+        const psa_tlv_t* tlv = (const psa_tlv_t*)CertificateTlv(i);
+        if ((uint64_t)tlv->length_in_bytes + sizeof(psa_tlv_t) != certificate.tlvSize ||
+            certificate.command != ADAC_AUTH_RESPONSE_CMD ||
+            (uint64_t)certificate.dataCount * sizeof(uint32_t) != certificate.tlvSize)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Inconsistent certificate %zu %s\n", i, path);
+            return false;
+        }
+
+        if (HasFrames() &&
+            (certificate.frameWordCount == 0 ||
+             (certificate.frameOffset % sizeof(uint32_t)) != 0 ||
+             !inBounds(certificate.frameOffset, (uint64_t)certificate.frameWordCount * sizeof(uint32_t), mHeader->totalSize)))
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Invalid certificate frame %zu %s\n", i, path);
+            return false;
+        }
+    }
+
+    // resolve relative key paths against the bundle location
+    mKeyFile = (const char*)(mBase + mHeader->keyReferenceOffset);
+    if (!isAbsolutePath(mKeyFile))
+    {
+        mKeyFile = directoryOf(path) + mKeyFile;
+    }
+
+    return true;
+}
@@ -0,0 +1,126 @@
+// authentication_bundle.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Precompiled authentication bundle format.
+ *
+ * An authentication bundle packs everything SDMAuthenticate needs from the
+ * credentials into one file that is memory mapped and used in place:
+ *
+ *   SDMBundleHeader
+ *   key reference            NUL terminated private key file path
+ *   trust chain              raw TLV trust chain, as read by load_trust_chain
+ *   certificate index        SDMBundleCertificate[certificateCount]
+ *   frames (optional)        encoded DR words, see ExternalComPortDriver::EComPort_Encode
+ *
+ * All fields are little-endian. Sections start on SDM_BUNDLE_ALIGNMENT byte
+ * boundaries and offsets are relative to the start of the file.
+ *
+ * Bundles are produced by the sdm_bundle_tool in tools/.
+ */
+
+#ifndef AUTHENTICATION_BUNDLE_H
+#define AUTHENTICATION_BUNDLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include "session_arena.h"
+
+#define SDM_BUNDLE_MAGIC     0x424D4453 /* "SDMB" */
+#define SDM_BUNDLE_VERSION   1
+#define SDM_BUNDLE_ALIGNMENT 8
+
+/* Bundle flags */
+#define SDM_BUNDLE_FLAG_FRAMES 0x1 /*!< Certificates carry encoded DR word frames */
+
+/* Key reference types */
+#define SDM_BUNDLE_KEY_FILE 0x1 /*!< Key reference is a private key file path */
+
+typedef struct SDMBundleHeader {
+    uint32_t magic;                  /*!< SDM_BUNDLE_MAGIC */
+    uint16_t version;                /*!< SDM_BUNDLE_VERSION */
+    uint16_t headerSize;             /*!< sizeof(SDMBundleHeader) */
+    uint32_t flags;                  /*!< SDM_BUNDLE_FLAG_* */
+    uint32_t totalSize;              /*!< Size in bytes of the bundle */
+    uint32_t keyReferenceType;       /*!< SDM_BUNDLE_KEY_* */
+    uint32_t keyReferenceOffset;
+    uint32_t keyReferenceSize;       /*!< Including the NUL terminator */
+    uint32_t chainOffset;
+    uint32_t chainSize;
+    uint32_t certificateIndexOffset;
+    uint32_t certificateCount;
+    uint32_t frameWordBytes;         /*!< Message bytes per encoded DR word, 0 without frames */
+} SDMBundleHeader;
+
+typedef struct SDMBundleCertificate {
+    uint32_t tlvOffset;      /*!< Certificate TLV offset, relative to the trust chain */
+    uint32_t tlvSize;        /*!< Certificate TLV size in bytes, including the TLV header */
+    uint16_t command;        /*!< Precomputed request_packet_t command, ADAC_AUTH_RESPONSE_CMD */
+    uint16_t dataCount;      /*!< Precomputed request_packet_t data_count, tlvSize / 4. Checked
+                                  against the certificate by AuthenticationBundle::Open */
+    uint32_t frameOffset;    /*!< Encoded request offset, 0 without frames */
+    uint32_t frameWordCount; /*!< Encoded request size in DR words, 0 without frames */
+} SDMBundleCertificate;
+
+/**
+ * \brief A memory mapped, validated, authentication bundle.
+ */
+class AuthenticationBundle
+{
+public:
+    /**
+     * \brief Map and validate a bundle file.
+     *
+     * Only the header, the certificate index and the certificate TLV headers
+     * are validated, the bundle is otherwise used in place.
+     *
+     * @param[in] arena Session arena for the bundle object, NULL for the heap. The file mapping is not in the arena.
+     * @return The bundle, or an empty pointer if the file could not be mapped or is malformed.
+     */
+    static ArenaPtr<AuthenticationBundle> Open(const char* path, SessionArena* arena = NULL);
+
+    ~AuthenticationBundle();
+
+    /** Private key file path, relative paths resolved against the bundle directory */
+    const std::string& KeyFile() const { return mKeyFile; }
+
+    const uint8_t* Chain() const { return mBase + mHeader->chainOffset; }
+    size_t ChainSize() const { return mHeader->chainSize; }
+
+    size_t CertificateCount() const { return mHeader->certificateCount; }
+    const SDMBundleCertificate& Certificate(size_t index) const { return mCertificates[index]; }
+    const uint8_t* CertificateTlv(size_t index) const { return Chain() + mCertificates[index].tlvOffset; }
+
+    bool HasFrames() const { return (mHeader->flags & SDM_BUNDLE_FLAG_FRAMES) != 0; }
+    size_t FrameWordBytes() const { return mHeader->frameWordBytes; }
+    const uint32_t* Frame(size_t index) const { return (const uint32_t*)(mBase + mCertificates[index].frameOffset); }
+
+private:
+    template <class T, class... Args>
+    friend ArenaPtr<T> ArenaNew(SessionArena* arena, Args&&... args);
+
+    AuthenticationBundle();
+
+    bool validate(size_t fileSize, const char* path);
+
+    const uint8_t* mBase;
+    size_t mMappedSize;
+#ifdef _WIN32
+    void* mFile;
+    void* mMapping;
+#endif
+
+    const SDMBundleHeader* mHeader;
+    const SDMBundleCertificate* mCertificates;
+    std::string mKeyFile;
+};
+
+#endif // AUTHENTICATION_BUNDLE_H
@@ -0,0 +1,103 @@
+// certificate_frame_cache.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "certificate_frame_cache.h"
+
+#include <string.h>
+
+#include <list>
+#include <mutex>
+
+namespace
+{
+    struct CacheEntry
+    {
+        uint64_t hash;
+        std::vector<uint8_t> chain;
+        std::shared_ptr<const CertificateFrameCache::Frames> frames;
+    };
+
+    std::mutex gCacheMutex;
+
+    // most recently used first
+    std::list<CacheEntry> gCacheEntries;
+
+    // FNV-1a, only used to skip full comparisons on mismatching entries
+    uint64_t chainHash(const uint8_t* chain, size_t chainSize)
+    {
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (size_t i = 0; i < chainSize; i++)
+        {
+            hash ^= chain[i];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    std::list<CacheEntry>::iterator findEntry(uint64_t hash, const uint8_t* chain, size_t chainSize)
+    {
+        for (auto it = gCacheEntries.begin(); it != gCacheEntries.end(); ++it)
+        {
+            if (it->hash == hash && it->chain.size() == chainSize && memcmp(it->chain.data(), chain, chainSize) == 0)
+            {
+                return it;
+            }
+        }
+        return gCacheEntries.end();
+    }
+}
+
+std::shared_ptr<const CertificateFrameCache::Frames> CertificateFrameCache::Find(const uint8_t* chain, size_t chainSize)
+{
+    if (chain == NULL || chainSize == 0)
+    {
+        return std::shared_ptr<const Frames>();
+    }
+
+    uint64_t hash = chainHash(chain, chainSize);
+
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+
+    auto it = findEntry(hash, chain, chainSize);
+    if (it == gCacheEntries.end())
+    {
+        return std::shared_ptr<const Frames>();
+    }
+
+    gCacheEntries.splice(gCacheEntries.begin(), gCacheEntries, it);
+    return it->frames;
+}
+
+std::shared_ptr<const CertificateFrameCache::Frames> CertificateFrameCache::Insert(const uint8_t* chain, size_t chainSize, Frames&& frames)
+{
+    std::shared_ptr<const Frames> cachedFrames = std::make_shared<const Frames>(std::move(frames));
+    if (chain == NULL || chainSize == 0)
+    {
+        return cachedFrames;
+    }
+
+    uint64_t hash = chainHash(chain, chainSize);
+
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+
+    auto it = findEntry(hash, chain, chainSize);
+    if (it != gCacheEntries.end())
+    {
+        gCacheEntries.erase(it);
+    }
+
+    CacheEntry entry;
+    entry.hash = hash;
+    entry.chain.assign(chain, chain + chainSize);
+    entry.frames = cachedFrames;
+    gCacheEntries.push_front(std::move(entry));
+
+    if (gCacheEntries.size() > MAX_ENTRIES)
+    {
+        gCacheEntries.pop_back();
+    }
+
+    return cachedFrames;
+}
@@ -0,0 +1,47 @@
+// certificate_frame_cache.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef CERTIFICATE_FRAME_CACHE_H
+#define CERTIFICATE_FRAME_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+/**
+ * \brief Process-wide cache of encoded certificate requests.
+ *
+ * Certificate requests only depend on the trust chain, so their encoded DR word
+ * streams (see ExternalComPortDriver::EComPort_Encode) are kept across sessions,
+ * keyed by the trust chain contents. Sessions authenticating with a chain seen
+ * before send the cached frames without any per-byte encoding.
+ */
+class CertificateFrameCache
+{
+public:
+    /** Encoded ADAC_AUTH_RESPONSE_CMD requests, one per certificate, in chain order */
+    using Frames = std::vector<std::vector<uint32_t>>;
+
+    /**
+     * \brief Look up the frames encoded for a trust chain.
+     *
+     * @return The cached frames, or an empty pointer on a cache miss.
+     */
+    static std::shared_ptr<const Frames> Find(const uint8_t* chain, size_t chainSize);
+
+    /**
+     * \brief Add the frames encoded for a trust chain, evicting the least recently used chain if full.
+     *
+     * @return The cached frames.
+     */
+    static std::shared_ptr<const Frames> Insert(const uint8_t* chain, size_t chainSize, Frames&& frames);
+
+    /** Trust chains kept */
+    static const size_t MAX_ENTRIES = 8;
+};
+
+#endif // CERTIFICATE_FRAME_CACHE_H
@@ -0,0 +1,94 @@
+// ext_com_port_core.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief APBCOM register addresses and access list builders for the External COM Port Driver.
+ *
+ * The register block base depends only on the debug architecture, so the DR, SR and DBR
+ * addresses are template constants. The driver instantiates its transfer paths per
+ * architecture and TX register and picks one set when it is constructed, so building a
+ * list costs no base addition and no DR/DBR branch per access.
+ */
+
+#ifndef EXT_COM_PORT_CORE_H
+#define EXT_COM_PORT_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "secure_debug_manager.h"
+
+// APBCOM register offsets
+#define REG_DR  0x20
+#define REG_SR  0x2C
+#define REG_DBR 0x30
+
+// APBCOM register block base, per debug architecture
+#define REG_BASE_ADIv5 0x0
+#define REG_BASE_ADIv6 0xD00
+
+// DR word carrying a single byte, unused byte lanes filled with null flags (0xAF)
+#define DR_NULL_FILL_WORD(_byte) (0xAFAFAF00UL | (uint8_t)(_byte))
+
+/**
+ * \brief APBCOM register addresses of one debug architecture.
+ */
+template <SDMDebugArchitecture Arch>
+struct ComPortRegisters
+{
+    static const uint64_t BASE = Arch == SDMDebugArchitecture_ArmADIv5 ? REG_BASE_ADIv5 : REG_BASE_ADIv6;
+    static const uint64_t DR = BASE + REG_DR;
+    static const uint64_t SR = BASE + REG_SR;
+    static const uint64_t DBR = BASE + REG_DBR;
+
+    // TX register: DBR blocks on a full TX FIFO, DR does not
+    template <bool Block>
+    struct Tx
+    {
+        static const uint64_t ADDRESS = Block ? DBR : DR;
+    };
+};
+
+template <SDMDebugArchitecture Arch> const uint64_t ComPortRegisters<Arch>::BASE;
+template <SDMDebugArchitecture Arch> const uint64_t ComPortRegisters<Arch>::DR;
+template <SDMDebugArchitecture Arch> const uint64_t ComPortRegisters<Arch>::SR;
+template <SDMDebugArchitecture Arch> const uint64_t ComPortRegisters<Arch>::DBR;
+template <SDMDebugArchitecture Arch> template <bool Block> const uint64_t ComPortRegisters<Arch>::Tx<Block>::ADDRESS;
+
+/**
+ * \brief Build count accesses of one register, each with its own value.
+ *
+ * @tparam Address Register address.
+ * @tparam Op Register access op, read or write.
+ */
+template <uint64_t Address, SDMRegisterAccessOp Op>
+inline void ECPDFillAccesses(SDMRegisterAccess* accesses, uint32_t* values, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        accesses[i].address = Address;
+        accesses[i].op = Op;
+        accesses[i].value = &values[i];
+        accesses[i].pollMask = 0;
+        accesses[i].retries = 0;
+    }
+}
+
+/**
+ * \brief Extract the received bytes of count DR reads.
+ *
+ * RX engine width (FIDRXR.RXW) - only single byte implemented, one byte per DR value.
+ */
+inline void ECPDUnpackReads(const uint32_t* values, size_t count, uint8_t* bytes)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        bytes[i] = (uint8_t)values[i];
+    }
+}
+
+#endif // EXT_COM_PORT_CORE_H
@@ -4,8 +4,10 @@
 // License. See LICENSE.TXT for details.
 
 #include "ext_com_port_driver.h"
-#include "sdm_config.h"
+#include "ext_com_port_core.h"
 #include "psa_adac_debug.h"
+#include "sdm_log.h"
+#include "sdm_timeline.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -16,16 +18,90 @@
 #endif
 
 #include <algorithm>
+#include <chrono>
+#include <system_error>
 #include <vector>
 
 #define ENTITY_NAME "ExternalComPortDriver"
 
-#define REG_DR  0x20
-#define REG_SR  0x2C
-#define REG_DBR 0x30
+namespace
+{
+    bool isFlagByte(uint8_t byte)
+    {
+        return byte >= 0xA0 && byte < 0xC0;
+    }
+
+    // FLAG_START, the escaped message bytes and FLAG_END, one DR word per byte
+    template <class Frame>
+    SDMReturnCode encodeFrame(const uint8_t* data, size_t inSize, Frame& frame)
+    {
+        size_t frameLength = inSize + 2;
+        for (size_t i = 0; i < inSize; i++)
+        {
+            if (isFlagByte(data[i]))
+            {
+                frameLength++;
+            }
+        }
+
+        try
+        {
+            frame.resize(frameLength);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return SDMReturnCode_InternalError;
+        }
+
+        SDM_LOG_DUMP("  ----->  ", "data_to_send", data, inSize);
+
+        size_t word = 0;
+        frame[word++] = DR_NULL_FILL_WORD(FLAG_START);
+        for (size_t i = 0; i < inSize; i++)
+        {
+            /* Each Message byte that matches one of the Flag bytes is
+             * immediately preceded by the ESC Flag byte, and bit [7] of the Message byte is inverted. */
+            if (isFlagByte(data[i]))
+            {
+                frame[word++] = DR_NULL_FILL_WORD(FLAG_ESC);
+                frame[word++] = DR_NULL_FILL_WORD(data[i] & ~0x80UL);
+            }
+            else
+            {
+                frame[word++] = DR_NULL_FILL_WORD(data[i]);
+            }
+        }
+        frame[word++] = DR_NULL_FILL_WORD(FLAG_END);
+
+        return SDMReturnCode_Success;
+    }
+
+    // SR fields, any out param may be NULL
+    void decodeStatus(uint32_t srVal, uint8_t* txFree, uint8_t* txOverflow, uint8_t* rxData, uint8_t* linkErrs)
+    {
+        if (txFree != NULL)
+        {
+            *txFree = srVal & 0xFF;                     //SR[7:0] - TxEngine FIFO space
+        }
 
-#define REG_BASE_ADIv5 0x0
-#define REG_BASE_ADIv6 0xD00
+        if (txOverflow != NULL)
+        {
+            *txOverflow = ((1 << 13) & srVal) ? 1 : 0;  //SR[13] - TxEngine overflow
+        }
+
+        if (rxData != NULL)
+        {
+            *rxData = (srVal >> 16) & 0xFF;             //SR[23:16] - RxEngine full level
+        }
+
+        if (linkErrs != NULL)
+        {
+            *linkErrs = 0;
+            *linkErrs |= ((1 << 14) & srVal) ? 1 : 0;   //SR[14] - TxEngine link error detected
+            *linkErrs |= ((1 << 30) & srVal) ? 2 : 0;   //SR[30] - RxEngine link error detected
+        }
+    }
+}
 
 /******************************************************************************************************
  *
@@ -53,20 +129,93 @@ const char* ExternalComPortDriver::apbcomflagToStr(uint8_t flag)
 }
 
 SDMReturnCode ExternalComPortDriver::EComSendByte(uint8_t byte)
+{
+    return EComSendWord(DR_NULL_FILL_WORD(byte));
+}
+
+SDMReturnCode ExternalComPortDriver::EComSendWord(uint32_t word)
 {
     uint8_t txFree = 0;
+
+    SDMReturnCode result = EComWaitTxFree(&txFree);
+    if (result != SDMReturnCode_Success)
+    {
+        return result;
+    }
+
+    // write word to TX
+    result = EComTxWords(false, &word, 1, false);
+    if (result != SDMReturnCode_Success)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComTxWords failed with code: 0x%x\n", result);
+        return result;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode ExternalComPortDriver::EComSendBlock(const uint32_t* words, size_t wordCount, bool block)
+{
+    if (block && mConfig.txBlockChunk == 0)
+    {
+        SDMReturnCode result = EComTxWords(true, words, wordCount, true);
+        if (result != SDMReturnCode_Success)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComTxWords failed with code: 0x%x\n", result);
+            return result;
+        }
+    }
+    else if (block)
+    {
+        // each list only fills the TX FIFO space reported by SR, so none of its DBR writes
+        // stall the probe waiting for the target to drain
+        size_t sent = 0;
+        while (sent < wordCount)
+        {
+            uint8_t txFree = 0;
+            SDMReturnCode result = EComWaitTxFree(&txFree);
+            if (result != SDMReturnCode_Success)
+            {
+                return result;
+            }
+
+            size_t chunk = std::min(std::min(wordCount - sent, mConfig.txBlockChunk), (size_t)txFree);
+            result = EComTxWords(true, words + sent, chunk, false);
+            if (result != SDMReturnCode_Success)
+            {
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComTxWords failed with code: 0x%x\n", result);
+                return result;
+            }
+            sent += chunk;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < wordCount; i++)
+        {
+            SDMReturnCode result = EComSendWord(words[i]);
+            if (result != SDMReturnCode_Success)
+            {
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComSendWord failed with code: 0x%x\n", result);
+                return result;
+            }
+        }
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode ExternalComPortDriver::EComWaitTxFree(uint8_t* txFree)
+{
     uint8_t txOverflow = 0;
     uint8_t linkErrs = 0;
 
-    static const uint32_t MAX_NUM_OF_RETRIES = 5000;
     uint32_t numOfRetries = 0;
 
-    uint8_t txData[] = { byte };
-
     /* wait for TXS byte value to indicate that the TX FIFO is not full */
     do
     {
-        SDMReturnCode result = EComStatus(&txFree, &txOverflow, NULL, &linkErrs);
+        SDMReturnCode result = EComStatus(txFree, &txOverflow, NULL, &linkErrs);
         if (result != SDMReturnCode_Success)
         {
             PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComStatus failed with code: 0x%x\n", result);
@@ -85,48 +234,13 @@ SDMReturnCode ExternalComPortDriver::EComSendByte(uint8_t byte)
             return SDMReturnCode_IOError;
         }
     }
-    while (txFree == 0 && numOfRetries++  < MAX_NUM_OF_RETRIES);
+    while (*txFree == 0 && numOfRetries++  < mConfig.txRetries);
 
-    if (numOfRetries >= MAX_NUM_OF_RETRIES)
+    if (numOfRetries >= mConfig.txRetries)
     {
         return SDMReturnCode_TimeoutError;
     }
 
-    // write byte to TX
-    SDMReturnCode result = EComTxRaw(false, 1, txData);
-    if (result != SDMReturnCode_Success)
-    {
-        PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComTxRaw failed with code: 0x%x\n", result);
-        return result;
-    }
-
-    return SDMReturnCode_Success;
-}
-
-SDMReturnCode ExternalComPortDriver::EComSendBlock(uint8_t* byteData, size_t dataLen, bool block)
-{
-    if (block)
-    {
-        SDMReturnCode result = EComTxRaw(true, dataLen, byteData);
-        if (result != SDMReturnCode_Success)
-        {
-            PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComTxRaw failed with code: 0x%x\n", result);
-            return result;
-        }
-    }
-    else
-    {
-        for (int i = 0; i < dataLen; i++)
-        {
-            SDMReturnCode result = EComSendByte(byteData[i]);
-            if (result != SDMReturnCode_Success)
-            {
-                PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComSendByte failed with code: 0x%x\n", result);
-                return result;
-            }
-        }
-    }
-
     return SDMReturnCode_Success;
 }
 
@@ -136,11 +250,27 @@ SDMReturnCode ExternalComPortDriver::EComReadByte(uint8_t* byte)
     uint8_t rxStatusData = 0;
     uint8_t linkErrs = 0;
 
-    const uint32_t MAX_ATTEMPTS = 5000;
     uint32_t attempt = 0;
 
     uint8_t rxData = 0x0;
 
+    if (mRxPumpRunning)
+    {
+        return rxPumpPop(byte, 1);
+    }
+
+    // bytes the pump queued before it stopped come first, then the byte read along with the last TX frame
+    if (mRxQueue.Pop(byte, 1) == 1)
+    {
+        return SDMReturnCode_Success;
+    }
+    if (mHasReadAheadByte)
+    {
+        *byte = mReadAheadByte;
+        mHasReadAheadByte = false;
+        return SDMReturnCode_Success;
+    }
+
     do
     {
         SDMReturnCode result = EComStatus(NULL, &txOverflow, &rxStatusData, &linkErrs);
@@ -162,9 +292,9 @@ SDMReturnCode ExternalComPortDriver::EComReadByte(uint8_t* byte)
             return SDMReturnCode_IOError;
         }
     }
-    while (rxStatusData == 0 && attempt++ < MAX_ATTEMPTS);
+    while (rxStatusData == 0 && attempt++ < mConfig.rxRetries);
 
-    if (attempt >= MAX_ATTEMPTS)
+    if (attempt >= mConfig.rxRetries)
     {
         return SDMReturnCode_TimeoutError;
     }
@@ -183,7 +313,7 @@ SDMReturnCode ExternalComPortDriver::EComReadByte(uint8_t* byte)
 
 SDMReturnCode ExternalComPortDriver::EComSendFlag(uint8_t flag, const char* flag_name)
 {
-    PSA_ADAC_LOG_INFO("--------->", "%s\n", flag_name);
+    SDM_LOG_INFO("--------->", "%s\n", flag_name);
 
     return EComSendByte(flag);
 }
@@ -192,75 +322,74 @@ SDMReturnCode ExternalComPortDriver::EComWaitFlag(uint8_t flag, const char* flag
 {
     uint8_t byte = FLAG__NULL;
 
-    PSA_ADAC_LOG_DEBUG(ENTITY_NAME, "waiting for flag[%s]\n", apbcomflagToStr(flag));
+    SDM_LOG_DEBUG(ENTITY_NAME, "waiting for flag[%s]\n", apbcomflagToStr(flag));
 
-    do
+    // the byte read along with the last TX frame is older than anything a poll would see
+    if (mHasReadAheadByte)
     {
-        SDMReturnCode result = EComReadByte(&byte);
-        if (result != SDMReturnCode_Success)
+        mHasReadAheadByte = false;
+        if (mReadAheadByte == flag)
         {
-            return result;
+            SDM_LOG_INFO("<---------", "%s\n", flag_name);
+            return SDMReturnCode_Success;
         }
     }
-    while (byte != flag);
-
-    PSA_ADAC_LOG_INFO("<---------", "%s\n", flag_name);
-
-    return SDMReturnCode_Success;
-}
-
-
-SDMReturnCode ExternalComPortDriver::EComPortPrepareData(uint8_t startFlag, const uint8_t* data, size_t inSize, uint8_t* outData, size_t outDataBufferSize, size_t* outSize)
-{
-    uint8_t *tempData = (uint8_t*)calloc(1, (inSize * 2) + 2);
-    if (!tempData)
-    {
-        return SDMReturnCode_InternalError;
-    }
-
-    uint16_t outByteIndex = 0;
-    tempData[outByteIndex++] = FLAG_START;
 
-    for (uint32_t byte_index = 0; byte_index < inSize; ++byte_index)
+    // the DR poll would take bytes from under the RX pump
+    if (mConfig.pollMode == ECPD_POLL_PROBE && mProbePollSupported && !mRxPumpRunning)
     {
-        /* Each Message byte that matches one of the Flag bytes is
-         * immediately preceded by the ESC Flag byte, and bit [7] of the Message byte is inverted. */
-        if (data[byte_index] >= 0xA0 && data[byte_index] < 0xC0)
+        SDMTimelineScope scope(mTimeline, "DR poll", SDM_TIMELINE_DRIVER);
+
+        // DR reads discard bytes until the flag is received, let the debugger repeat them
+        uint32_t drValue = flag;
+        SDMRegisterAccess access = {
+            mCore->drAddress,         // address
+            SDMRegisterAccessOp_Poll, // op
+            &drValue,                 // value
+            0xFF,                     // pollMask
+            mConfig.rxRetries         // retries
+        };
+        size_t accessesCompleted = 0;
+
+        SDMReturnCode result = EComRegisterAccess(&access, 1, &accessesCompleted);
+        if (result == SDMReturnCode_UnsupportedOperation)
+        {
+            SDM_LOG_DEBUG(ENTITY_NAME, "register access poll unsupported, polling from host\n");
+            mProbePollSupported = false;
+        }
+        else if (result != SDMReturnCode_Success)
+        {
+            return result;
+        }
+        else if (accessesCompleted != 1)
         {
-            tempData[outByteIndex++] = FLAG_ESC;
-            tempData[outByteIndex++] = data[byte_index] & ~0x80UL;
+            return SDMReturnCode_RequestFailed;
         }
         else
         {
-            tempData[outByteIndex++] = data[byte_index];
+            SDM_LOG_INFO("<---------", "%s\n", flag_name);
+            return SDMReturnCode_Success;
         }
     }
 
-    tempData[outByteIndex++] = FLAG_END;
-
-    if (outByteIndex > outDataBufferSize)
-    {
-        *outSize = 0;
-        PSA_ADAC_LOG_ERR(ENTITY_NAME,
-                    "tempData buffer is too small, outByteIndex[%u] outDataBufferSize[%zu]\n",
-                    outByteIndex,
-                    outDataBufferSize);
-        free(tempData);
-        return SDMReturnCode_InternalError;
-    }
-    else
+    do
     {
-        memcpy(outData, tempData, outByteIndex);
-        *outSize = outByteIndex;
+        SDMReturnCode result = EComReadByte(&byte);
+        if (result != SDMReturnCode_Success)
+        {
+            return result;
+        }
     }
+    while (byte != flag);
+
+    SDM_LOG_INFO("<---------", "%s\n", flag_name);
 
-    free(tempData);
     return SDMReturnCode_Success;
 }
 
+
 SDMReturnCode ExternalComPortDriver::EComPortRxInt(uint8_t startFlag, uint8_t* rxBuffer, size_t rxBufferLength, size_t* actualLength)
 {
-    static const uint32_t MAX_PRE_NULL_FLAGS = 10000;
     uint32_t preNullFlags = 0;
 
     uint8_t read_byte = 0;
@@ -291,7 +420,7 @@ SDMReturnCode ExternalComPortDriver::EComPortRxInt(uint8_t startFlag, uint8_t* r
             if (!isStartRecv)
                 preNullFlags++;
 
-            if (preNullFlags > MAX_PRE_NULL_FLAGS)
+            if (preNullFlags > mConfig.rxMaxNullFlags)
                 return SDMReturnCode_TimeoutError;
 
             continue;
@@ -326,31 +455,70 @@ SDMReturnCode ExternalComPortDriver::EComPortRxInt(uint8_t startFlag, uint8_t* r
         }
     }
 
-    PSA_ADAC_LOG_DUMP("  <-----  ", "data_recv", rxBuffer, *actualLength);
+    SDM_LOG_DUMP("  <-----  ", "data_recv", rxBuffer, *actualLength);
 
     return (isStartRecv ^ isEndRecv) ? SDMReturnCode_InternalError : SDMReturnCode_Success;
 }
 
+template <SDMDebugArchitecture Arch>
+const ExternalComPortDriver::Core& ExternalComPortDriver::selectCore()
+{
+    static const Core core = {
+        ComPortRegisters<Arch>::DR,
+        ComPortRegisters<Arch>::SR,
+        { &ExternalComPortDriver::txWords<Arch, false>, &ExternalComPortDriver::txWords<Arch, true> },
+        &ExternalComPortDriver::rxReads<Arch>,
+        &ExternalComPortDriver::rxPumpLoop<Arch>,
+        &ExternalComPortDriver::txProducerLoop<Arch>
+    };
+    return core;
+}
+
 /******************************************************************************************************
  *
  * public
  *
  ******************************************************************************************************/
 
-ExternalComPortDriver::ExternalComPortDriver(SDMDeviceDescriptor device, SDMDebugArchitecture arch, SDMRegisterAccessCallback registerAccess, SDMResetCallback resetStart, SDMResetCallback resetEnd, void *refcon) :
+ExternalComPortDriver::ExternalComPortDriver(SDMDeviceDescriptor device, SDMDebugArchitecture arch, SDMRegisterAccessCallback registerAccess, SDMResetCallback resetStart, SDMResetCallback resetEnd, void *refcon, const ECPDConfig& config, SessionArena* arena) :
     mIsComPortInited(false),
     mComDevice(device),
     mRegisterAccessCallback(registerAccess),
     mResetStartCallback(resetStart),
     mResetEndCallback(resetEnd),
     mRefcon(refcon),
-    mComDeviceRegisterBase(REG_BASE_ADIv6)
+    mCore(arch == SDMDebugArchitecture_ArmADIv5 ? &selectCore<SDMDebugArchitecture_ArmADIv5>() : &selectCore<SDMDebugArchitecture_ArmADIv6>()),
+    mConfig(config),
+    mProbePollSupported(true),
+    mTimeline(NULL),
+    mTxFrame(ArenaAllocator<uint32_t>(arena)),
+    mTxValues(ArenaAllocator<uint32_t>(arena)),
+    mTxAccesses(ArenaAllocator<SDMRegisterAccess>(arena)),
+    mRxValues(ArenaAllocator<uint32_t>(arena)),
+    mRxAccesses(ArenaAllocator<SDMRegisterAccess>(arena)),
+    mAccessLists(ArenaAllocator<SDMRegisterAccessList>(arena)),
+    mTxChunks{ TxChunk(arena), TxChunk(arena) },
+    mTxProducerStop(false),
+    mTxJobData(NULL),
+    mTxJobLength(0),
+    mTxJobPending(false),
+    mTxJobDone(false),
+    mTxJobFrameLength(0),
+    mTxAbort(false),
+    mReadAheadValue(0),
+    mReadAheadByte(FLAG__NULL),
+    mHasReadAheadByte(false),
+    mRxPumpStop(false),
+    mRxPumpRunning(false),
+    mRxPumpError(SDMReturnCode_Success),
+    mRxPumpPolls(0),
+    mRxPumpHolds(0),
+    mRxPumpParked(true),
+    mRxQueueStorage(ArenaAllocator<uint8_t>(arena)),
+    mPumpValues(ArenaAllocator<uint32_t>(arena)),
+    mPumpAccesses(ArenaAllocator<SDMRegisterAccess>(arena)),
+    mPumpBytes(ArenaAllocator<uint8_t>(arena))
 {
-    if (arch == SDMDebugArchitecture_ArmADIv5)
-    {
-        mComDeviceRegisterBase = REG_BASE_ADIv5;
-    }
-
     // If present, copy mComDevice.armCoreSightComponent.memAp to be referenced locally
     if (mComDevice.deviceType == SDMDeviceType_ArmADI_CoreSightComponent && mComDevice.armCoreSightComponent.memAp != NULL)
     {
@@ -361,6 +529,8 @@ ExternalComPortDriver::ExternalComPortDriver(SDMDeviceDescriptor device, SDMDebu
 
 ExternalComPortDriver::~ExternalComPortDriver()
 {
+    stopRxPump();
+    stopTxProducer();
 }
 
 SDMReturnCode ExternalComPortDriver::EComPort_Init(ECPDRemoteResetType remoteReset, uint8_t* IDResponseBuffer, size_t IDBufferLength)
@@ -368,6 +538,12 @@ SDMReturnCode ExternalComPortDriver::EComPort_Init(ECPDRemoteResetType remoteRes
     SDMReturnCode res = SDMReturnCode_Success;
     size_t actualLength = 0;
     bool isTimeout = false;
+    SDMTimelineScope phase(mTimeline, SDM_TIMELINE_DRIVER);
+
+    // bytes left from an earlier link are stale
+    stopRxPump();
+    mRxQueue.Reset(mRxQueueStorage.data(), mRxQueueStorage.size());
+    mHasReadAheadByte = false;
 
     if (remoteReset == ECPD_REMOTE_RESET_SYSTEM)
     {
@@ -384,6 +560,7 @@ SDMReturnCode ExternalComPortDriver::EComPort_Init(ECPDRemoteResetType remoteRes
     // Establish the link:
     // 3.  Transmits LPH2RA flag to the External COM port TX. External COM port HW will set the LINKEST signal to the Internal COM Port and drop the flag.
     // In case of bad status, return with an error.
+    phase.Next("LPH2 handshake");
     PSA_ADAC_ASSERT(EComSendFlag(FLAG_LPH2RA, "LPH2RA"), SDMReturnCode_Success);
     
     if (remoteReset == ECPD_REMOTE_RESET_COM)
@@ -425,18 +602,25 @@ SDMReturnCode ExternalComPortDriver::EComPort_Init(ECPDRemoteResetType remoteRes
     //
     // External COM Port driver checks the debugged system protocol:
     // 13. The debugger transmits now an IDR flag - Identification Request (note: this is a single flag message with no START or END).
+    phase.Next("IDR/IDA");
     PSA_ADAC_ASSERT(EComSendFlag(FLAG_IDR, "IDR"), SDMReturnCode_Success);
 
     // 14. The debugged system IComPortInit() function responds and transmits to the debugger with Identification response message. Note: this response message format has a special format. It starts with IDA flag, followed by 6 bytes of debugged system ID hex value, and an END flag. If any of the platform ID bytes has MS bits value of 101b then the transmit driver must send an ESC flag following a flip of the MS bit of the byte to transmit.
     PSA_ADAC_ASSERT(EComPortRxInt(FLAG_IDA, IDResponseBuffer, IDBufferLength, &actualLength), SDMReturnCode_Success);
     PSA_ADAC_ASSERT_ERROR(actualLength == 0, false, SDMReturnCode_TransferError);
-    PSA_ADAC_LOG_DUMP("<---------", "IDResponseBuffer", IDResponseBuffer, actualLength);
+    SDM_LOG_DUMP("<---------", "IDResponseBuffer", IDResponseBuffer, actualLength);
+    phase.End();
 
     // 15. At this point the debugged system () API returns with success code.
     // 16. The debugger EComPort_Init() API saves the received platform ID (6IComPortInit bytes) in the provided buffer and returns with success code.
 
     mIsComPortInited = true;
 
+    if (mConfig.rxPump)
+    {
+        PSA_ADAC_ASSERT(startRxPump(), SDMReturnCode_Success);
+    }
+
 bail:
     return res;
 }
@@ -444,6 +628,9 @@ bail:
 SDMReturnCode ExternalComPortDriver::EComPort_Power(ECPDRequiredState RequiredState)
 {
     SDMReturnCode res = SDMReturnCode_Success;
+    SDMTimelineScope scope(mTimeline, RequiredState == ECPD_POWER_ON ? "power on" : "power off", SDM_TIMELINE_DRIVER);
+
+    stopRxPump();
 
     if (RequiredState == ECPD_POWER_ON)
     {
@@ -479,6 +666,8 @@ SDMReturnCode ExternalComPortDriver::EComPort_RReboot(void)
 {
     SDMReturnCode res = SDMReturnCode_Success;
 
+    stopRxPump();
+
     // External COM Port driver writes LPH2RR flag to the External COM Port TX.
     PSA_ADAC_ASSERT(EComSendFlag(FLAG_LPH2RR, "LPH1RR"), SDMReturnCode_Success);
 
@@ -498,35 +687,50 @@ SDMReturnCode ExternalComPortDriver::EComPort_Tx(uint8_t* TxBuffer, size_t TxBuf
 {
     SDMReturnCode res = SDMReturnCode_Success;
 
-    /* allocate new buffer that will include the extra bytes */
-    size_t tempBuffLen = TxBufferLength * 2 + 2;
-    uint8_t *tempBuffer = (uint8_t *) calloc(1, tempBuffLen);
-    PSA_ADAC_ASSERT_ERROR(tempBuffer != NULL, true, SDMReturnCode_InternalError);
-
     PSA_ADAC_ASSERT_ERROR(mIsComPortInited == true, true, SDMReturnCode_RequestFailed);
 
-    /* fill the array */
-    PSA_ADAC_ASSERT(EComPortPrepareData(FLAG_START,
-                                         TxBuffer,
-                                         TxBufferLength,
-                                         tempBuffer,
-                                         tempBuffLen,
-                                         actualLength),
-                     SDMReturnCode_Success);
-
-    PSA_ADAC_LOG_DUMP("  ----->  ", "data_to_send", tempBuffer, *actualLength);
+    if (block && mConfig.txPipelineChunk != 0)
+    {
+        res = EComTxPipelined(TxBuffer, TxBufferLength, actualLength);
+    }
+    else
+    {
+        /* fill the frame */
+        PSA_ADAC_ASSERT(encodeFrame(TxBuffer, TxBufferLength, mTxFrame), SDMReturnCode_Success);
+        *actualLength = mTxFrame.size();
 
-    res = EComSendBlock(tempBuffer, *actualLength, block);
+        res = EComPort_TxFrame(mTxFrame.data(), mTxFrame.size(), block);
+    }
     if (res != SDMReturnCode_Success)
     {
         PSA_ADAC_LOG_ERR(ENTITY_NAME, "failed to send block data[%u]\n", (uint32_t)*actualLength);
         goto bail;
     }
 
-    PSA_ADAC_LOG_DEBUG(ENTITY_NAME, "inSize[%zu] outSize[%zu]\n", TxBufferLength, *actualLength);
+    SDM_LOG_DEBUG(ENTITY_NAME, "inSize[%zu] outSize[%zu]\n", TxBufferLength, *actualLength);
+
+bail:
+    return res;
+}
+
+SDMReturnCode ExternalComPortDriver::EComPort_Encode(const uint8_t* txBuffer, size_t txBufferLength, std::vector<uint32_t>& frame)
+{
+    return encodeFrame(txBuffer, txBufferLength, frame);
+}
+
+SDMReturnCode ExternalComPortDriver::EComPort_TxFrame(const uint32_t* frame, size_t frameLength, bool block)
+{
+    SDMReturnCode res = SDMReturnCode_Success;
+
+    PSA_ADAC_ASSERT_ERROR(mIsComPortInited == true, true, SDMReturnCode_RequestFailed);
+    PSA_ADAC_ASSERT_ERROR(frame != NULL && frameLength != 0, true, SDMReturnCode_InvalidArgument);
+
+    {
+        SDMTimelineScope scope(mTimeline, "TX frame", SDM_TIMELINE_DRIVER);
+        res = EComSendBlock(frame, frameLength, block);
+    }
 
 bail:
-    free(tempBuffer);
     return res;
 }
 
@@ -536,8 +740,11 @@ SDMReturnCode ExternalComPortDriver::EComPort_Rx(uint8_t* RxBuffer, size_t RxBuf
 
     PSA_ADAC_ASSERT_ERROR(mIsComPortInited == true, true, SDMReturnCode_RequestFailed);
 
-    PSA_ADAC_ASSERT(EComPortRxInt(FLAG_START, RxBuffer, RxBufferLength, ActualLength),
-                     SDMReturnCode_Success);
+    {
+        SDMTimelineScope scope(mTimeline, "RX message", SDM_TIMELINE_DRIVER);
+        PSA_ADAC_ASSERT(EComPortRxInt(FLAG_START, RxBuffer, RxBufferLength, ActualLength),
+                         SDMReturnCode_Success);
+    }
 
 bail:
     return res;
@@ -563,6 +770,10 @@ SDMReturnCode ExternalComPortDriver::EComPort_Finalize()
     //     6.  The debugger knows now that the link from the Internal COM Port to the External COM Port is dropped.
 
     SDMReturnCode res = SDMReturnCode_Success;
+    SDMTimelineScope scope(mTimeline, "LPH2 release", SDM_TIMELINE_DRIVER);
+
+    // bytes already queued by the pump are still read first
+    stopRxPump();
 
     PSA_ADAC_ASSERT(EComSendFlag(FLAG_LPH2RL, "LPH2RL"), SDMReturnCode_Success);
     PSA_ADAC_ASSERT(EComWaitFlag(FLAG_LPH2RL, "LPH2RL"), SDMReturnCode_Success);
@@ -573,42 +784,271 @@ bail:
     return res;
 }
 
-SDMReturnCode ExternalComPortDriver::EComRxRaw(size_t numBytes, unsigned char* outBytes, size_t outBytesLength)
+void ExternalComPortDriver::SetTimeline(SDMTimeline* timeline)
+{
+    mTimeline = timeline;
+}
+
+void ExternalComPortDriver::SetRegisterAccessListsCallback(SDMRegisterAccessListsCallback registerAccessLists)
+{
+    mRegisterAccessListsCallback = registerAccessLists;
+}
+
+void ExternalComPortDriver::SetCancelCallback(ECPDCancelCallback cancel)
 {
-    if (numBytes == 0 || outBytesLength == 0 || outBytes == NULL)
+    mCancelCallback = cancel;
+}
+
+SDMReturnCode ExternalComPortDriver::startRxPump()
+{
+    // SR reports at most 255 bytes in the RX FIFO
+    const size_t maxBurst = 255;
+    size_t capacity = 256;
+    while (capacity < mConfig.rxPumpQueueSize && capacity < ((size_t)-1 >> 1))
+    {
+        capacity <<= 1;
+    }
+
+    try
+    {
+        mRxQueueStorage.resize(capacity);
+        mPumpValues.resize(maxBurst);
+        mPumpAccesses.resize(maxBurst);
+        mPumpBytes.resize(maxBurst);
+    }
+    catch (const std::bad_alloc&)
     {
         return SDMReturnCode_InternalError;
     }
-    
-    // Do reads to APBCOM.DR
-    // readSize = RxEngine width (FIDTXR.TXW) - only single byte implemented
-    size_t readSize = 1;
-    size_t drReads = (numBytes / readSize) + ((numBytes % readSize != 0) ? 1 : 0);
-    size_t bytesRemaining = numBytes;
-
-    // Create values and reg access op lists
-    std::vector<uint32_t> drVals;
-    std::vector<SDMRegisterAccess> accesses;
+
+    mRxQueue.Reset(mRxQueueStorage.data(), capacity);
+    mRxPumpStop = false;
+    mRxPumpError = SDMReturnCode_Success;
+    mRxPumpRunning = true;
+
     try
     {
-        drVals.assign(drReads, 0);
-        accesses.assign(drReads, { 0, 0, 0, 0, 0 });
+        mRxPump = std::thread(mCore->rxPumpLoop, this);
     }
-    catch(const std::bad_alloc&)
+    catch (const std::system_error&)
+    {
+        // RX stays pull driven
+        PSA_ADAC_LOG_WARN(ENTITY_NAME, "failed to start the RX pump thread\n");
+        mRxPumpRunning = false;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+void ExternalComPortDriver::stopRxPump()
+{
+    if (mRxPump.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(mRxPumpMutex);
+            mRxPumpStop = true;
+            mRxPumpWake.notify_all();
+        }
+        mRxPump.join();
+    }
+    mRxPumpRunning = false;
+}
+
+void ExternalComPortDriver::HoldRxPump()
+{
+    std::lock_guard<std::mutex> lock(mRxPumpMutex);
+    mRxPumpHolds++;
+    mRxPumpWake.notify_all();
+}
+
+void ExternalComPortDriver::ReleaseRxPump()
+{
+    std::unique_lock<std::mutex> lock(mRxPumpMutex);
+    if (mRxPumpHolds == 0 || --mRxPumpHolds != 0)
+    {
+        return;
+    }
+
+    // no register accesses from the pump once the caller returns to the debugger
+    mRxPumpWake.notify_all();
+    mRxPumpWake.wait(lock, [this]() { return mRxPumpParked; });
+}
+
+template <SDMDebugArchitecture Arch>
+void ExternalComPortDriver::rxPumpLoop()
+{
+    // SR reads back off while the RX FIFO stays empty
+    const std::chrono::microseconds minBackoff(50);
+    const std::chrono::microseconds maxBackoff(1000);
+    std::chrono::microseconds backoff(0);
+    SDMReturnCode error = SDMReturnCode_Success;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mRxPumpMutex);
+            if (backoff.count() > 0)
+            {
+                mRxPumpWake.wait_for(lock, backoff, [this]() { return mRxPumpHolds == 0 || mRxPumpStop; });
+            }
+            if (mRxPumpHolds == 0 && !mRxPumpStop)
+            {
+                mRxPumpParked = true;
+                mRxPumpWake.notify_all();
+                mRxPumpWake.wait(lock, [this]() { return mRxPumpHolds != 0 || mRxPumpStop; });
+                backoff = std::chrono::microseconds(0);
+            }
+            if (mRxPumpStop)
+            {
+                break;
+            }
+            mRxPumpParked = false;
+        }
+
+        // own SR read, kept off the timeline
+        uint32_t srVal = 0;
+        SDMRegisterAccess status = { ComPortRegisters<Arch>::SR, SDMRegisterAccessOp_Read, &srVal, 0, 0 };
+        size_t accessesCompleted = 0;
+        error = EComRegisterAccess(&status, 1, &accessesCompleted);
+        mRxPumpPolls++;
+        if (error == SDMReturnCode_Success && accessesCompleted != 1)
+        {
+            error = SDMReturnCode_RequestFailed;
+        }
+        if (error != SDMReturnCode_Success)
+        {
+            break;
+        }
+
+        uint8_t txOverflow = 0;
+        uint8_t rxLevel = 0;
+        uint8_t linkErrs = 0;
+        decodeStatus(srVal, NULL, &txOverflow, &rxLevel, &linkErrs);
+        if (linkErrs != 0 || txOverflow != 0)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "RX pump linkErrs[0x%02x] txOverflow[0x%02x]\n", linkErrs, txOverflow);
+            error = SDMReturnCode_IOError;
+            break;
+        }
+
+        // only read what the queue can take, the rest waits in the RX FIFO
+        size_t count = std::min(std::min((size_t)rxLevel, mRxQueue.Free()), mPumpBytes.size());
+        if (count == 0)
+        {
+            backoff = std::min(std::max(backoff * 2, minBackoff), maxBackoff);
+            continue;
+        }
+        backoff = std::chrono::microseconds(0);
+
+        ECPDFillAccesses<ComPortRegisters<Arch>::DR, SDMRegisterAccessOp_Read>(mPumpAccesses.data(), mPumpValues.data(), count);
+        error = EComRegisterAccess(mPumpAccesses.data(), count, &accessesCompleted);
+        if (error == SDMReturnCode_Success && accessesCompleted != count)
+        {
+            error = SDMReturnCode_RequestFailed;
+        }
+        if (error != SDMReturnCode_Success)
+        {
+            break;
+        }
+
+        ECPDUnpackReads(mPumpValues.data(), count, mPumpBytes.data());
+        mRxQueue.Push(mPumpBytes.data(), count);
+
+        std::lock_guard<std::mutex> lock(mRxPumpMutex);
+        mRxPumpWake.notify_all();
+    }
+
+    std::lock_guard<std::mutex> lock(mRxPumpMutex);
+    mRxPumpError = error;
+    mRxPumpParked = true;
+    mRxPumpWake.notify_all();
+}
+
+SDMReturnCode ExternalComPortDriver::rxPumpPop(uint8_t* bytes, size_t length)
+{
+    // a pending receive keeps the pump reading
+    ECPDRxPumpHold hold(this);
+
+    // the wait is bounded by rxRetries SR reads, as when polling from this thread
+    uint64_t start = mRxPumpPolls;
+    size_t received = 0;
+
+    std::unique_lock<std::mutex> lock(mRxPumpMutex);
+    for (;;)
+    {
+        received += mRxQueue.Pop(bytes + received, length - received);
+        if (received == length)
+        {
+            return SDMReturnCode_Success;
+        }
+
+        SDMReturnCode error = mRxPumpError;
+        if (error != SDMReturnCode_Success)
+        {
+            return error;
+        }
+
+        if (mRxPumpPolls - start > mConfig.rxRetries)
+        {
+            return SDMReturnCode_TimeoutError;
+        }
+
+        // woken by queued bytes or a pump error, the timeout rechecks the poll count
+        mRxPumpWake.wait_for(lock, std::chrono::milliseconds(1), [this]()
+        {
+            return mRxQueue.Size() != 0 || mRxPumpError != SDMReturnCode_Success;
+        });
+    }
+}
+
+SDMReturnCode ExternalComPortDriver::EComRxRaw(size_t numBytes, unsigned char* outBytes, size_t outBytesLength)
+{
+    if (numBytes == 0 || outBytesLength < numBytes || outBytes == NULL)
     {
         return SDMReturnCode_InternalError;
     }
 
-    uint32_t regAddr = mComDeviceRegisterBase + REG_DR;
-    for (unsigned int i = 0; i < drReads; i++)
+    if (mRxPumpRunning)
+    {
+        return rxPumpPop(outBytes, numBytes);
+    }
+
+    // bytes the pump queued before it stopped come first, then the byte read along with the last TX frame
+    size_t queued = mRxQueue.Pop(outBytes, numBytes);
+    if (queued < numBytes && mHasReadAheadByte)
+    {
+        outBytes[queued++] = mReadAheadByte;
+        mHasReadAheadByte = false;
+    }
+    if (queued == numBytes)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    return (this->*mCore->rxReads)(numBytes - queued, outBytes + queued);
+}
+
+template <SDMDebugArchitecture Arch>
+SDMReturnCode ExternalComPortDriver::rxReads(size_t numBytes, uint8_t* outBytes)
+{
+    // Do reads to APBCOM.DR, one byte each
+    size_t drReads = numBytes;
+
+    // values and reg access op lists are reused across reads
+    try
+    {
+        mRxValues.resize(drReads);
+        mRxAccesses.resize(drReads);
+    }
+    catch(const std::bad_alloc&)
     {
-        accesses[i].address = regAddr;
-        accesses[i].op = SDMRegisterAccessOp_Read;
-        accesses[i].value = &drVals[i];
+        return SDMReturnCode_InternalError;
     }
+    ECPDFillAccesses<ComPortRegisters<Arch>::DR, SDMRegisterAccessOp_Read>(mRxAccesses.data(), mRxValues.data(), drReads);
 
     size_t accessesCompleted = 0;
-    SDMReturnCode result = mRegisterAccessCallback(&mComDevice, SDMTransferSize_32, &accesses[0], drReads, &accessesCompleted, mRefcon);
+    SDMTimelineScope scope(mTimeline, "DR read burst", SDM_TIMELINE_DRIVER);
+    SDMReturnCode result = EComRegisterAccess(mRxAccesses.data(), drReads, &accessesCompleted);
     if (result != SDMReturnCode_Success)
     {
         return result;
@@ -619,70 +1059,287 @@ SDMReturnCode ExternalComPortDriver::EComRxRaw(size_t numBytes, unsigned char* o
         return SDMReturnCode_RequestFailed;
     }
 
-    // copy values to outBytes and check for individual errors
-    for (unsigned int i = 0; i < drReads; i++)
-    {
-        // check we are within outBytesLength before copying
-        size_t outBytesFree = outBytesLength - (i * readSize);
-        size_t copyBytes = std::min(std::min(readSize, outBytesFree), bytesRemaining);
+    ECPDUnpackReads(mRxValues.data(), drReads, outBytes);
 
-        memcpy(outBytes + (i * readSize), &drVals[i], copyBytes);
+    return result;
+}
 
-        bytesRemaining -= readSize;
+SDMReturnCode ExternalComPortDriver::EComTxWords(bool block, const uint32_t* words, size_t wordCount, bool readAhead)
+{
+    if (wordCount == 0 || words == NULL)
+    {
+        return SDMReturnCode_InternalError;
     }
 
-    return result;
+    return (this->*mCore->txWords[block ? 1 : 0])(words, wordCount, readAhead);
 }
 
-SDMReturnCode ExternalComPortDriver::EComTxRaw(bool block, size_t numBytes, const unsigned char* inData)
+template <SDMDebugArchitecture Arch, bool Block>
+SDMReturnCode ExternalComPortDriver::txWords(const uint32_t* words, size_t wordCount, bool readAhead)
 {
-    if (numBytes == 0 || inData == NULL)
+    // Do writes to APBCOM.DR or DBR, one write per pre-packed word
+    try
+    {
+        mTxValues.assign(words, words + wordCount);
+        mTxAccesses.resize(wordCount);
+    }
+    catch(const std::bad_alloc&)
     {
         return SDMReturnCode_InternalError;
     }
+    ECPDFillAccesses<ComPortRegisters<Arch>::template Tx<Block>::ADDRESS, SDMRegisterAccessOp_Write>(mTxAccesses.data(), mTxValues.data(), wordCount);
+
+    // the first DR read of the reply does not depend on the writes, so with a vectored
+    // callback it goes in the same call and saves the receive a round trip
+    readAhead = readAhead && mRegisterAccessListsCallback && !mRxPumpRunning && !mHasReadAheadByte;
+    const SDMRegisterAccess* runs[2] = { mTxAccesses.data(), &mReadAheadAccess };
+    size_t runLengths[2] = { wordCount, 1 };
+    if (readAhead)
+    {
+        ECPDFillAccesses<ComPortRegisters<Arch>::DR, SDMRegisterAccessOp_Read>(&mReadAheadAccess, &mReadAheadValue, 1);
+    }
 
-    // Do writes to APBCOM.DR
-    // writeSize = TxEngine width (FIDTXR.TXW) - only single byte implemented
-    size_t writeSize = 1;
-    size_t drWrites = (numBytes / writeSize) + ((numBytes % writeSize != 0) ? 1 : 0);
-    size_t bytesRemaining = numBytes;
+    size_t accessesCompleted = 0;
+    SDMTimelineScope scope(mTimeline, Block ? "DBR write burst" : "DR write burst", SDM_TIMELINE_DRIVER);
+    SDMReturnCode result = EComRegisterAccessRuns(runs, runLengths, readAhead ? 2 : 1, &accessesCompleted);
+    if (accessesCompleted < wordCount)
+    {
+        return SDMReturnCode_RequestFailed;
+    }
+
+    if (readAhead)
+    {
+        // an empty RX FIFO reads as a NULL flag, which every receive skips. A failed read
+        // is left to the receive to repeat, the frame was sent
+        uint8_t byte = FLAG__NULL;
+        if (accessesCompleted > wordCount)
+        {
+            ECPDUnpackReads(&mReadAheadValue, 1, &byte);
+        }
+        mReadAheadByte = byte;
+        mHasReadAheadByte = byte != FLAG__NULL;
+        return SDMReturnCode_Success;
+    }
+
+    return result;
+}
+
+SDMReturnCode ExternalComPortDriver::EComTxPipelined(const uint8_t* data, size_t dataLength, size_t* frameLength)
+{
+    // an escape sequence takes two words and is never split between chunks
+    const size_t chunkWords = std::max(mConfig.txPipelineChunk, (size_t)2);
 
-    // Create values and reg access op lists
-    std::vector<uint32_t> drVals;
-    std::vector<SDMRegisterAccess> accesses;
+    // a message that fits one chunk has nothing to overlap, as without a producer thread
+    bool pipelined = dataLength + 2 > chunkWords;
+
+    // sized here, the producer thread does not allocate. It is idle between transfers
     try
     {
-        drVals.assign(drWrites, 0xAFAFAFAF); // pre-fill values with null bytes (0xAF)
-        accesses.assign(drWrites, {0, 0, 0, 0, 0});
+        for (TxChunk& chunk : mTxChunks)
+        {
+            chunk.values.resize(chunkWords);
+            chunk.accesses.resize(chunkWords);
+            chunk.ready = false;
+            chunk.last = false;
+        }
     }
-    catch(const std::bad_alloc&)
+    catch (const std::bad_alloc&)
     {
         return SDMReturnCode_InternalError;
     }
 
-    // set reg acc op values
+    if (pipelined && !mTxProducer.joinable())
+    {
+        mTxProducerStop = false;
+        try
+        {
+            mTxProducer = std::thread(mCore->txProducerLoop, this);
+        }
+        catch (const std::system_error&)
+        {
+            PSA_ADAC_LOG_WARN(ENTITY_NAME, "failed to start the TX producer thread\n");
+            pipelined = false;
+        }
+    }
+
+    if (!pipelined)
+    {
+        SDMReturnCode res = encodeFrame(data, dataLength, mTxFrame);
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+        *frameLength = mTxFrame.size();
+        return EComPort_TxFrame(mTxFrame.data(), mTxFrame.size(), true);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mTxChunkMutex);
+        mTxJobData = data;
+        mTxJobLength = dataLength;
+        mTxJobPending = true;
+        mTxJobDone = false;
+        mTxAbort = false;
+        mTxChunkReady.notify_all();
+    }
 
-    uint32_t regAddr =  mComDeviceRegisterBase + (block ? REG_DBR : REG_DR);
-    for (unsigned int i = 0; i < drWrites; i++)
+    SDM_LOG_DUMP("  ----->  ", "data_to_send", data, dataLength);
+
+    SDMReturnCode res = SDMReturnCode_Success;
+    SDMTimelineScope scope(mTimeline, "TX frame", SDM_TIMELINE_DRIVER);
+    for (size_t n = 0; ; n++)
     {
-        // assuming writes are little-endian - specification states only LSB is used
-        memcpy(&drVals[i], inData + (i * writeSize), std::min(bytesRemaining, writeSize));
+        TxChunk& chunk = mTxChunks[n % 2];
+        {
+            std::unique_lock<std::mutex> lock(mTxChunkMutex);
+            mTxChunkReady.wait(lock, [&chunk]() { return chunk.ready; });
+        }
 
-        accesses[i].address = regAddr;
-        accesses[i].op = SDMRegisterAccessOp_Write;
-        accesses[i].value = &drVals[i];
+        // bounded by the TX FIFO free level as in EComSendBlock, if configured
+        for (size_t sent = 0; res == SDMReturnCode_Success && sent < chunk.count; )
+        {
+            size_t length = chunk.count - sent;
+            if (mConfig.txBlockChunk != 0)
+            {
+                uint8_t txFree = 0;
+                res = EComWaitTxFree(&txFree);
+                if (res != SDMReturnCode_Success)
+                {
+                    break;
+                }
+                length = std::min(std::min(length, mConfig.txBlockChunk), (size_t)txFree);
+            }
+
+            size_t accessesCompleted = 0;
+            {
+                SDMTimelineScope burst(mTimeline, "DBR write burst", SDM_TIMELINE_DRIVER);
+                res = EComRegisterAccess(chunk.accesses.data() + sent, length, &accessesCompleted);
+            }
+            if (res == SDMReturnCode_Success && accessesCompleted != length)
+            {
+                res = SDMReturnCode_RequestFailed;
+            }
+            sent += length;
+        }
 
-        bytesRemaining -= writeSize;
+        std::lock_guard<std::mutex> lock(mTxChunkMutex);
+        chunk.ready = false;
+        mTxAbort = res != SDMReturnCode_Success;
+        mTxChunkReady.notify_all();
+        if (chunk.last || mTxAbort)
+        {
+            break;
+        }
     }
 
-    size_t accessesCompleted = 0;
-    SDMReturnCode result = mRegisterAccessCallback(&mComDevice, SDMTransferSize_32, &accesses[0], drWrites, &accessesCompleted, mRefcon);
-    if (accessesCompleted != drWrites)
+    std::unique_lock<std::mutex> lock(mTxChunkMutex);
+    mTxChunkReady.wait(lock, [this]() { return mTxJobDone; });
+    *frameLength = mTxJobFrameLength;
+
+    return res;
+}
+
+void ExternalComPortDriver::stopTxProducer()
+{
+    if (mTxProducer.joinable())
     {
-        return SDMReturnCode_RequestFailed;
+        {
+            std::lock_guard<std::mutex> lock(mTxChunkMutex);
+            mTxProducerStop = true;
+            mTxChunkReady.notify_all();
+        }
+        mTxProducer.join();
     }
+}
 
-    return result;
+template <SDMDebugArchitecture Arch>
+void ExternalComPortDriver::txProducerLoop()
+{
+    std::unique_lock<std::mutex> lock(mTxChunkMutex);
+    for (;;)
+    {
+        mTxChunkReady.wait(lock, [this]() { return mTxJobPending || mTxProducerStop; });
+        if (mTxProducerStop)
+        {
+            break;
+        }
+        mTxJobPending = false;
+
+        const uint8_t* data = mTxJobData;
+        size_t dataLength = mTxJobLength;
+        lock.unlock();
+        size_t frameLength = txPipelineProduce<Arch>(data, dataLength);
+        lock.lock();
+
+        mTxJobFrameLength = frameLength;
+        mTxJobDone = true;
+        mTxChunkReady.notify_all();
+    }
+}
+
+template <SDMDebugArchitecture Arch>
+size_t ExternalComPortDriver::txPipelineProduce(const uint8_t* data, size_t dataLength)
+{
+    size_t frameLength = 0;
+    size_t next = 0;
+    bool last = false;
+
+    for (size_t n = 0; !last; n++)
+    {
+        TxChunk& chunk = mTxChunks[n % 2];
+        {
+            std::unique_lock<std::mutex> lock(mTxChunkMutex);
+            mTxChunkReady.wait(lock, [this, &chunk]() { return !chunk.ready || mTxAbort; });
+            if (mTxAbort)
+            {
+                break;
+            }
+        }
+
+        // the words of encodeFrame, packed straight into the chunk's access list
+        uint32_t* words = chunk.values.data();
+        size_t capacity = chunk.values.size();
+        size_t count = 0;
+        if (n == 0)
+        {
+            words[count++] = DR_NULL_FILL_WORD(FLAG_START);
+        }
+        for (; next < dataLength; next++)
+        {
+            if (isFlagByte(data[next]))
+            {
+                if (count + 2 > capacity)
+                {
+                    break;
+                }
+                words[count++] = DR_NULL_FILL_WORD(FLAG_ESC);
+                words[count++] = DR_NULL_FILL_WORD(data[next] & ~0x80UL);
+            }
+            else
+            {
+                if (count + 1 > capacity)
+                {
+                    break;
+                }
+                words[count++] = DR_NULL_FILL_WORD(data[next]);
+            }
+        }
+        if (next == dataLength && count < capacity)
+        {
+            words[count++] = DR_NULL_FILL_WORD(FLAG_END);
+            last = true;
+        }
+        ECPDFillAccesses<ComPortRegisters<Arch>::DBR, SDMRegisterAccessOp_Write>(chunk.accesses.data(), words, count);
+        frameLength += count;
+
+        std::lock_guard<std::mutex> lock(mTxChunkMutex);
+        chunk.count = count;
+        chunk.last = last;
+        chunk.ready = true;
+        mTxChunkReady.notify_all();
+    }
+
+    return frameLength;
 }
 
 SDMReturnCode ExternalComPortDriver::EComStatus(uint8_t* txFree, uint8_t* txOverflow, uint8_t* rxData, uint8_t* linkErrs)
@@ -690,16 +1347,17 @@ SDMReturnCode ExternalComPortDriver::EComStatus(uint8_t* txFree, uint8_t* txOver
     uint32_t srVal = 0;
     SDMRegisterAccess accesses[1] = {
         {
-            (uint64_t)(mComDeviceRegisterBase + REG_SR), // address
-            SDMRegisterAccessOp_Read,                    // op
-            &srVal,                                      // value
-            0x0,                                         // pollMask
-            0                                            // retries
+            mCore->srAddress,         // address
+            SDMRegisterAccessOp_Read, // op
+            &srVal,                   // value
+            0x0,                      // pollMask
+            0                         // retries
         }
     };
     size_t accessesCompleted = 0;
 
-    SDMReturnCode result = mRegisterAccessCallback(&mComDevice, SDMTransferSize_32, accesses, 1, &accessesCompleted, mRefcon);
+    SDMTimelineScope scope(mTimeline, "SR read", SDM_TIMELINE_DRIVER);
+    SDMReturnCode result = EComRegisterAccess(accesses, 1, &accessesCompleted);
     if (result != SDMReturnCode_Success)
     {
         return result;
@@ -710,27 +1368,103 @@ SDMReturnCode ExternalComPortDriver::EComStatus(uint8_t* txFree, uint8_t* txOver
         return SDMReturnCode_RequestFailed;
     }
 
-    //Build out params from SR
-    if (txFree != NULL)
+    decodeStatus(srVal, txFree, txOverflow, rxData, linkErrs);
+
+    return result;
+}
+
+SDMReturnCode ExternalComPortDriver::EComRegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted)
+{
+    return EComRegisterAccessRuns(&accesses, &accessCount, 1, accessesCompleted);
+}
+
+SDMReturnCode ExternalComPortDriver::EComRegisterAccessRuns(const SDMRegisterAccess* const* runs, const size_t* runLengths, size_t runCount, size_t* accessesCompleted)
+{
+    std::lock_guard<std::mutex> bus(mBusMutex);
+
+    // every polling loop makes a register access per iteration, so this bounds them all
+    if (mCancelCallback && mCancelCallback())
     {
-        *txFree = srVal & 0xFF;                     //SR[7:0] - TxEngine FIFO space
+        SDM_LOG_DEBUG(ENTITY_NAME, "cancelled, register accesses skipped\n");
+        return SDMReturnCode_RequestFailed;
     }
 
-    if (txOverflow != NULL)
+    // split lists longer than the debugger is configured to accept
+    size_t maxLength = mConfig.maxAccessListLength != 0 ? mConfig.maxAccessListLength : (size_t)-1;
+    size_t listCount = 0;
+    for (size_t run = 0; run < runCount; run++)
     {
-        *txOverflow = ((1 << 13) & srVal) ? 1 : 0;  //SR[13] - TxEngine overflow
+        listCount += runLengths[run] != 0 ? (runLengths[run] - 1) / maxLength + 1 : 0;
     }
 
-    if (rxData != NULL)
+    *accessesCompleted = 0;
+    if (mRegisterAccessListsCallback && listCount > 1)
     {
-        *rxData = (srVal >> 16) & 0xFF;             //SR[23:16] - RxEngine full level
+        return EComRegisterAccessLists(runs, runLengths, runCount, maxLength, listCount, accessesCompleted);
     }
 
-    if (linkErrs != NULL)
+    // runs are independent, but a later run is still not started once one fails
+    SDMReturnCode result = SDMReturnCode_Success;
+    for (size_t run = 0; run < runCount; run++)
     {
-        *linkErrs = 0;
-        *linkErrs |= ((1 << 14) & srVal) ? 1 : 0;   //SR[14] - TxEngine link error detected
-        *linkErrs |= ((1 << 30) & srVal) ? 2 : 0;   //SR[30] - RxEngine link error detected
+        size_t runCompleted = 0;
+        while (runCompleted < runLengths[run])
+        {
+            size_t length = std::min(maxLength, runLengths[run] - runCompleted);
+            size_t completed = 0;
+
+            result = mRegisterAccessCallback(&mComDevice, SDMTransferSize_32, runs[run] + runCompleted, length, &completed, mRefcon);
+            runCompleted += completed;
+            *accessesCompleted += completed;
+            if (result != SDMReturnCode_Success || completed != length)
+            {
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+SDMReturnCode ExternalComPortDriver::EComRegisterAccessLists(const SDMRegisterAccess* const* runs, const size_t* runLengths, size_t runCount, size_t maxLength, size_t listCount, size_t* accessesCompleted)
+{
+    // every list in one call, the debugger queues them back to back
+    try
+    {
+        mAccessLists.resize(listCount);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    size_t listIndex = 0;
+    for (size_t run = 0; run < runCount; run++)
+    {
+        for (size_t offset = 0; offset < runLengths[run]; offset += maxLength)
+        {
+            SDMRegisterAccessList& list = mAccessLists[listIndex++];
+            list.device = &mComDevice;
+            list.transferSize = SDMTransferSize_32;
+            list.accesses = runs[run] + offset;
+            list.accessCount = std::min(maxLength, runLengths[run] - offset);
+            list.accessesCompleted = 0;
+            list.result = SDMReturnCode_RequestFailed;
+        }
+    }
+
+    SDMReturnCode result = mRegisterAccessListsCallback(mAccessLists.data(), listCount, mRefcon);
+
+    // accesses are only counted up to the first list that did not complete
+    *accessesCompleted = 0;
+    for (size_t i = 0; i < listCount; i++)
+    {
+        const SDMRegisterAccessList& list = mAccessLists[i];
+        *accessesCompleted += std::min(list.accessesCompleted, list.accessCount);
+        if (list.result != SDMReturnCode_Success || list.accessesCompleted != list.accessCount)
+        {
+            return list.result != SDMReturnCode_Success ? list.result : result;
+        }
     }
 
     return result;
@@ -13,10 +13,20 @@
 #ifndef EXT_COM_PORT_DRIVER_H_
 #define EXT_COM_PORT_DRIVER_H_
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+#include "session_arena.h"
+#include "spsc_byte_queue.h"
+
+class SDMTimeline;
 
  /**
  * \brief SDC-600 COM port protocol flag bytes
@@ -52,13 +62,61 @@ typedef enum ECPDRemoteResetType {
     ECPD_REMOTE_RESET_COM
 } ECPDRemoteResetType;
 
+/**
+* \brief Strategies used by the driver to wait for flags from the target
+*/
+typedef enum ECPDPollMode {
+    ECPD_POLL_HOST, /*!< Read SR and DR from the host until the flag is received */
+    ECPD_POLL_PROBE /*!< Delegate the wait to the debugger with a single SDMRegisterAccessOp_Poll of DR.
+                         Falls back to ECPD_POLL_HOST if the debugger does not support polling */
+} ECPDPollMode;
+
+/**
+* \brief Driver tuning, defaults match the behaviour of previous releases
+*/
+struct ECPDConfig
+{
+    uint32_t txRetries;         /*!< SR reads waiting for TX FIFO space */
+    uint32_t rxRetries;         /*!< SR reads waiting for RX data, or DR poll retries with ECPD_POLL_PROBE */
+    uint32_t rxMaxNullFlags;    /*!< Null flags tolerated before the start of a message */
+    size_t maxAccessListLength; /*!< Maximum register accesses per callback, longer lists are split. 0 for no limit */
+    ECPDPollMode pollMode;
+    bool rxPump;                /*!< Drain the RX FIFO from a background thread once the link is up */
+    size_t rxPumpQueueSize;     /*!< Bytes buffered by the RX pump, rounded up to a power of two */
+    size_t txBlockChunk;        /*!< Maximum DBR writes per hardware blocking list, each also limited to the TX FIFO
+                                     free level read from SR before it. 0 sends a transfer as one list */
+    size_t txPipelineChunk;     /*!< DR words per chunk of a hardware blocking EComPort_Tx, encoded on the driver's
+                                     producer thread while the chunk before it is written. Messages that fit one chunk,
+                                     and 0, encode the whole message first */
+
+    ECPDConfig() :
+        txRetries(5000),
+        rxRetries(5000),
+        rxMaxNullFlags(10000),
+        maxAccessListLength(0),
+        pollMode(ECPD_POLL_HOST),
+        rxPump(false),
+        rxPumpQueueSize(4096),
+        txBlockChunk(0),
+        txPipelineChunk(0)
+    {
+    }
+};
+
 using SDMRegisterAccessCallback = std::function<SDMReturnCode(const SDMDeviceDescriptor *, SDMTransferSize, const SDMRegisterAccess *, size_t, size_t *, void *)>;
 
 using SDMResetCallback = std::function<SDMReturnCode(SDMResetType, void *)>;
 
+using SDMRegisterAccessListsCallback = std::function<SDMReturnCode(SDMRegisterAccessList *, size_t, void *)>;
+
+using ECPDCancelCallback = std::function<bool()>;
+
 class ExternalComPortDriver
 {
 public:
+    /** Message bytes carried by each DR word produced by {@link EComPort_Encode} */
+    static const size_t FRAME_WORD_BYTES = 1;
+
     /**
      * \brief ExternalComPortDriver class constructor
      * @param[in] comDevice The SDMDeviceDescriptor describing the SDC-600 COM port the driver
@@ -68,8 +126,10 @@ public:
      * @param[in] resetStart The SDMResetCallback to use to initiate target reset.
      * @param[in] resetEnd The SDMResetCallback to use to complete target reset.
      * @param[in] refcon To pass to callbacks.
+     * @param[in] config Driver tuning.
+     * @param[in] arena Session arena for the driver buffers, NULL for the heap. Must outlive the driver.
      */
-    ExternalComPortDriver(SDMDeviceDescriptor comDevice, SDMDebugArchitecture arch, SDMRegisterAccessCallback registerAccess, SDMResetCallback resetStart, SDMResetCallback resetEnd, void *refcon);
+    ExternalComPortDriver(SDMDeviceDescriptor comDevice, SDMDebugArchitecture arch, SDMRegisterAccessCallback registerAccess, SDMResetCallback resetStart, SDMResetCallback resetEnd, void *refcon, const ECPDConfig& config = ECPDConfig(), SessionArena* arena = NULL);
 
     /**
      * ExternalComPortDriver desctructor
@@ -140,6 +200,31 @@ public:
      */
     SDMReturnCode EComPort_Tx(uint8_t* txBuffer, size_t txBufferLength, size_t* actualLength, bool block);
 
+    /**
+     * Encodes a message as sent by {@link EComPort_Tx}: FLAG_START, the escaped
+     * message bytes and FLAG_END, packed into the DR words written to the External
+     * COM Port. The result only depends on the message, so it can be computed once
+     * and sent any number of times with {@link EComPort_TxFrame}. Does not access
+     * the target.
+     *
+     * @param[in] txBuffer Message buffer.
+     * @param[in] txBufferLength Size in bytes of the message buffer.
+     * @param[out] frame Receives the encoded DR words.
+     */
+    static SDMReturnCode EComPort_Encode(const uint8_t* txBuffer, size_t txBufferLength, std::vector<uint32_t>& frame);
+
+    /**
+     * Transmits a message previously encoded by {@link EComPort_Encode}. No per-byte
+     * processing is done, the DR words are copied into the register access list as-is.
+     *
+     * Same preconditions as {@link EComPort_Tx}.
+     *
+     * @param[in] frame Encoded DR words.
+     * @param[in] frameLength Number of DR words in frame.
+     * @param[in] block Whether to us blocking Tx. Polling Tx if false.
+     */
+    SDMReturnCode EComPort_TxFrame(const uint32_t* frame, size_t frameLength, bool block);
+
     /**
      * At its receive side, the External COM port driver receives from the SDC-600
      * External COM port receiver a protocol message (which is stuffed by the required
@@ -169,18 +254,105 @@ public:
      */
     SDMReturnCode EComPort_Rx(uint8_t* rxBuffer, size_t rxBufferLength, size_t* actualLength);
 
+    /**
+     * Records driver events, link handshakes, SR reads and DR bursts, on a session timeline.
+     *
+     * @param[in] timeline Timeline to record to, or NULL to stop recording. Not owned.
+     */
+    void SetTimeline(SDMTimeline* timeline);
+
+    /**
+     * Submits register accesses split by ECPDConfig::maxAccessListLength as several lists
+     * in one call, instead of one registerAccess call per list. A hardware blocking TX frame
+     * sent as one list also takes the first DR read of the reply along, in a list of its own.
+     *
+     * @param[in] registerAccessLists Vectored callback, see SDMRegisterAccessVectorCallback,
+     *            or empty to only use the registerAccess callback.
+     */
+    void SetRegisterAccessListsCallback(SDMRegisterAccessListsCallback registerAccessLists);
+
+    /**
+     * Checked before every register access callback, from the thread making the call.
+     * Once it returns true, the operation in progress fails with SDMReturnCode_RequestFailed
+     * instead of making further register accesses.
+     *
+     * @param[in] cancel Returns whether to stop, or empty to never stop.
+     */
+    void SetCancelCallback(ECPDCancelCallback cancel);
+
+    /**
+     * Whether the RX pump thread is draining the RX FIFO, see ECPDConfig::rxPump.
+     * It runs from a successful {@link EComPort_Init} until {@link EComPort_Finalize},
+     * {@link EComPort_Power} or {@link EComPort_RReboot}. After an RX error the pump stops
+     * reading and receives fail with that error. The pump is parked, making no register
+     * accesses, unless a receive is waiting on it or a {@link HoldRxPump} is in effect.
+     * While it reads, the register access callbacks are also called from the pump thread,
+     * but never concurrently.
+     */
+    bool RxPumpRunning() const { return mRxPumpRunning; }
+
+    /**
+     * Keep the RX pump draining the RX FIFO between receives, e.g. for the duration of an
+     * SDM call. Holds nest, each is ended by a {@link ReleaseRxPump}. Has no effect when
+     * the pump is not configured.
+     */
+    void HoldRxPump();
+
+    /**
+     * End a {@link HoldRxPump}. When the last hold ends, waits for the pump to finish its
+     * register access in progress and park.
+     */
+    void ReleaseRxPump();
+
 private:
     SDMReturnCode EComPortRxInt(uint8_t startFlag, uint8_t* rxBuffer, size_t rxBufferLength, size_t* actualLength);
-    SDMReturnCode EComPortPrepareData(uint8_t startFlag, const uint8_t* data, size_t inSize, uint8_t* outData, size_t outDataBufferSize, size_t* outSize);
     SDMReturnCode EComSendByte(uint8_t byte);
-    SDMReturnCode EComSendBlock(uint8_t* byteData, size_t dataLen, bool block);
+    SDMReturnCode EComSendWord(uint32_t word);
+    SDMReturnCode EComSendBlock(const uint32_t* words, size_t wordCount, bool block);
+    SDMReturnCode EComWaitTxFree(uint8_t* txFree);
     SDMReturnCode EComReadByte(uint8_t* byte);
     SDMReturnCode EComSendFlag(uint8_t flag, const char* flagName);
     SDMReturnCode EComWaitFlag(uint8_t flag, const char* flagName);
 
     SDMReturnCode EComRxRaw(size_t numBytes, unsigned char* outData, size_t outDataLength);
-    SDMReturnCode EComTxRaw(bool block, size_t numBytes, const unsigned char* inData);
+    SDMReturnCode EComTxWords(bool block, const uint32_t* words, size_t wordCount, bool readAhead);
+    SDMReturnCode EComTxPipelined(const uint8_t* data, size_t dataLength, size_t* frameLength);
+    void stopTxProducer();
     SDMReturnCode EComStatus(uint8_t * txFree, uint8_t * txOverflow, uint8_t * rxData, uint8_t * linkErrs);
+    SDMReturnCode EComRegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted);
+    SDMReturnCode EComRegisterAccessRuns(const SDMRegisterAccess* const* runs, const size_t* runLengths, size_t runCount, size_t* accessesCompleted);
+    SDMReturnCode startRxPump();
+    void stopRxPump();
+    SDMReturnCode rxPumpPop(uint8_t* bytes, size_t length);
+
+    SDMReturnCode EComRegisterAccessLists(const SDMRegisterAccess* const* runs, const size_t* runLengths, size_t runCount, size_t maxLength, size_t listCount, size_t* accessesCompleted);
+
+    // Register access paths, instantiated per debug architecture (and TX register) so the
+    // APBCOM addresses are constants, see ext_com_port_core.h
+    template <SDMDebugArchitecture Arch, bool Block>
+    SDMReturnCode txWords(const uint32_t* words, size_t wordCount, bool readAhead);
+    template <SDMDebugArchitecture Arch>
+    SDMReturnCode rxReads(size_t numBytes, uint8_t* outBytes);
+    template <SDMDebugArchitecture Arch>
+    void rxPumpLoop();
+    template <SDMDebugArchitecture Arch>
+    void txProducerLoop();
+    template <SDMDebugArchitecture Arch>
+    size_t txPipelineProduce(const uint8_t* data, size_t dataLength);
+
+    // the instantiations of one architecture, selected once by the constructor
+    struct Core
+    {
+        uint64_t drAddress;
+        uint64_t srAddress;
+        SDMReturnCode (ExternalComPortDriver::*txWords[2])(const uint32_t* words, size_t wordCount, bool readAhead); // indexed by block
+        SDMReturnCode (ExternalComPortDriver::*rxReads)(size_t numBytes, uint8_t* outBytes);
+        void (ExternalComPortDriver::*rxPumpLoop)();
+        void (ExternalComPortDriver::*txProducerLoop)();
+    };
+
+    template <SDMDebugArchitecture Arch>
+    static const Core& selectCore();
 
     const char* apbcomflagToStr(uint8_t flag);
 
@@ -189,12 +361,114 @@ private:
     SDMDeviceDescriptor mComDevice;
     SDMDeviceDescriptor mComDeviceAp;
     SDMRegisterAccessCallback mRegisterAccessCallback;
+    SDMRegisterAccessListsCallback mRegisterAccessListsCallback;
+    ECPDCancelCallback mCancelCallback;
     SDMResetCallback mResetStartCallback;
     SDMResetCallback mResetEndCallback;
 
     void *mRefcon;
 
-    uint32_t mComDeviceRegisterBase;
+    const Core* mCore;
+
+    ECPDConfig mConfig;
+    bool mProbePollSupported;
+
+    SDMTimeline* mTimeline;
+
+    // TX and RX scratch buffers, reused across transfers
+    ArenaVector<uint32_t> mTxFrame;
+    ArenaVector<uint32_t> mTxValues;
+    ArenaVector<SDMRegisterAccess> mTxAccesses;
+    ArenaVector<uint32_t> mRxValues;
+    ArenaVector<SDMRegisterAccess> mRxAccesses;
+    ArenaVector<SDMRegisterAccessList> mAccessLists;
+
+    // TX pipeline, see ECPDConfig::txPipelineChunk. The producer thread fills a chunk while the
+    // protocol thread writes the other, mTxChunkMutex guards the ready and last flags and the job
+    struct TxChunk
+    {
+        ArenaVector<uint32_t> values;
+        ArenaVector<SDMRegisterAccess> accesses;
+        size_t count;
+        bool ready;
+        bool last;
+
+        explicit TxChunk(SessionArena* arena) :
+            values(ArenaAllocator<uint32_t>(arena)),
+            accesses(ArenaAllocator<SDMRegisterAccess>(arena)),
+            count(0),
+            ready(false),
+            last(false)
+        {
+        }
+    };
+    TxChunk mTxChunks[2];
+    std::mutex mTxChunkMutex;
+    std::condition_variable mTxChunkReady;  // chunks, jobs and stop
+
+    // the producer is started by the first pipelined transfer and kept until the driver is destroyed
+    std::thread mTxProducer;
+    bool mTxProducerStop;
+    const uint8_t* mTxJobData;
+    size_t mTxJobLength;
+    bool mTxJobPending;
+    bool mTxJobDone;
+    size_t mTxJobFrameLength;
+    bool mTxAbort;                          // the protocol thread stopped writing chunks
+
+    // DR read submitted with a TX frame, see EComTxWords, and the byte it returned
+    SDMRegisterAccess mReadAheadAccess;
+    uint32_t mReadAheadValue;
+    uint8_t mReadAheadByte;
+    bool mHasReadAheadByte;
+
+    // serializes register access callbacks between the protocol and RX pump threads
+    std::mutex mBusMutex;
+
+    // RX pump, the thread is the only producer and the protocol thread the only consumer of mRxQueue
+    std::thread mRxPump;
+    std::atomic<bool> mRxPumpStop;
+    std::atomic<bool> mRxPumpRunning;
+    std::atomic<SDMReturnCode> mRxPumpError;
+    std::atomic<uint64_t> mRxPumpPolls;
+    std::mutex mRxPumpMutex;                // guards mRxPumpHolds and mRxPumpParked
+    std::condition_variable mRxPumpWake;    // holds, stop, parking and queued bytes
+    size_t mRxPumpHolds;
+    bool mRxPumpParked;
+    SpscByteQueue mRxQueue;
+    ArenaVector<uint8_t> mRxQueueStorage;
+    ArenaVector<uint32_t> mPumpValues;
+    ArenaVector<SDMRegisterAccess> mPumpAccesses;
+    ArenaVector<uint8_t> mPumpBytes;
+};
+
+/**
+ * \brief Holds the RX pump of a driver for its lifetime, see ExternalComPortDriver::HoldRxPump
+ */
+class ECPDRxPumpHold
+{
+public:
+    explicit ECPDRxPumpHold(ExternalComPortDriver* driver) : mDriver(driver)
+    {
+        if (mDriver != NULL)
+        {
+            mDriver->HoldRxPump();
+        }
+    }
+
+    ~ECPDRxPumpHold()
+    {
+        if (mDriver != NULL)
+        {
+            mDriver->ReleaseRxPump();
+        }
+    }
+
+    ECPDRxPumpHold(const ECPDRxPumpHold&) = delete;
+    ECPDRxPumpHold& operator=(const ECPDRxPumpHold&) = delete;
+
+private:
+    ExternalComPortDriver* mDriver;
 };
 
 #endif /* EXT_COM_PORT_DRIVER_H_ */
@@ -0,0 +1,235 @@
+// persistent_key_store.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "persistent_key_store.h"
+
+#include "psa_adac.h"
+#include "psa_adac_sdm.h"
+#include "psa_adac_debug.h"
+
+#include "mbedtls/pk.h"
+#include "mbedtls/platform_util.h"
+
+#include <new>
+#include <vector>
+
+#define ENTITY_NAME "PersistentKeyStore"
+
+namespace
+{
+    // DER encoding of an RSA 4096 key pair, with room to spare
+    const size_t MAX_KEY_MATERIAL_SIZE = 4096;
+
+    // private key in the psa_import_key format: the private value for ECC, an RSAPrivateKey for RSA
+    bool readKeyMaterial(const char* keyFile, std::vector<uint8_t>& material)
+    {
+        mbedtls_pk_context pk;
+        mbedtls_pk_init(&pk);
+
+        int ret = mbedtls_pk_parse_keyfile(&pk, keyFile, NULL);
+        if (ret != 0)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "mbedtls_pk_parse_keyfile failed %d\n", ret);
+            mbedtls_pk_free(&pk);
+            return false;
+        }
+
+        try
+        {
+            switch (mbedtls_pk_get_type(&pk))
+            {
+            case MBEDTLS_PK_ECKEY:
+            {
+                const mbedtls_ecp_keypair* ec = mbedtls_pk_ec(pk);
+                material.resize(PSA_BITS_TO_BYTES(ec->grp.pbits));
+                ret = mbedtls_mpi_write_binary(&ec->d, material.data(), material.size());
+                break;
+            }
+
+            case MBEDTLS_PK_RSA:
+            {
+                // written at the end of the buffer
+                material.resize(MAX_KEY_MATERIAL_SIZE);
+                ret = mbedtls_pk_write_key_der(&pk, material.data(), material.size());
+                if (ret > 0)
+                {
+                    material.erase(material.begin(), material.end() - ret);
+                    ret = 0;
+                }
+                break;
+            }
+
+            default:
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "Unsupported key type\n");
+                ret = -1;
+                break;
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            ret = -1;
+        }
+
+        mbedtls_pk_free(&pk);
+
+        if (ret != 0)
+        {
+            mbedtls_platform_zeroize(material.data(), material.size());
+            material.clear();
+            return false;
+        }
+        return true;
+    }
+
+    bool signatureTypeOf(const psa_key_attributes_t& attributes, uint8_t& signatureType)
+    {
+        psa_key_type_t type = psa_get_key_type(&attributes);
+        size_t bits = psa_get_key_bits(&attributes);
+
+        if (PSA_KEY_TYPE_IS_ECC(type) && PSA_KEY_TYPE_ECC_GET_FAMILY(type) == PSA_ECC_FAMILY_SECP_R1)
+        {
+            if (bits == 256)
+            {
+                signatureType = ECDSA_P256_SHA256;
+                return true;
+            }
+            if (bits == 521)
+            {
+                signatureType = ECDSA_P521_SHA512;
+                return true;
+            }
+        }
+        else if (PSA_KEY_TYPE_IS_RSA(type))
+        {
+            if (bits == 3072)
+            {
+                signatureType = RSA_3072_SHA256;
+                return true;
+            }
+            if (bits == 4096)
+            {
+                signatureType = RSA_4096_SHA256;
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+bool PersistentKeyStore::ValidKeyId(uint32_t keyId)
+{
+    return keyId >= PSA_KEY_ID_USER_MIN && keyId <= PSA_KEY_ID_USER_MAX;
+}
+
+SDMReturnCode PersistentKeyStore::Provision(const char* keyFile, uint32_t keyId)
+{
+    if (keyFile == NULL || !ValidKeyId(keyId))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    // import_private_key decides the attributes psa-adac signs with
+    uint8_t signatureType = 0;
+    psa_key_handle_t handle = 0;
+    if (import_private_key(keyFile, &signatureType, &handle) != 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "import_private_key failed\n");
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+    psa_status_t status = psa_get_key_attributes(handle, &attributes);
+    psa_destroy_key(handle);
+    if (status != PSA_SUCCESS || !signatureTypeOf(attributes, signatureType))
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Key type not supported by the persistent key store\n");
+        psa_reset_key_attributes(&attributes);
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    std::vector<uint8_t> material;
+    if (!readKeyMaterial(keyFile, material))
+    {
+        psa_reset_key_attributes(&attributes);
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    psa_set_key_id(&attributes, keyId);
+    psa_set_key_lifetime(&attributes, PSA_KEY_LIFETIME_PERSISTENT);
+
+    psa_key_id_t stored = 0;
+    status = psa_import_key(&attributes, material.data(), material.size(), &stored);
+    mbedtls_platform_zeroize(material.data(), material.size());
+    psa_reset_key_attributes(&attributes);
+
+    if (status == PSA_ERROR_ALREADY_EXISTS)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Key ID 0x%x already in use\n", (unsigned)keyId);
+        return SDMReturnCode_InvalidArgument;
+    }
+    if (status != PSA_SUCCESS)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "psa_import_key failed %d\n", (int)status);
+        return SDMReturnCode_InternalError;
+    }
+
+    // stored, release the slot
+    psa_close_key(stored);
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode PersistentKeyStore::Delete(uint32_t keyId)
+{
+    if (!ValidKeyId(keyId))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    psa_key_handle_t handle = 0;
+    psa_status_t status = psa_open_key(keyId, &handle);
+    if (status != PSA_SUCCESS)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Key ID 0x%x not found %d\n", (unsigned)keyId, (int)status);
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    status = psa_destroy_key(handle);
+    if (status != PSA_SUCCESS)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "psa_destroy_key failed %d\n", (int)status);
+        return SDMReturnCode_InternalError;
+    }
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode PersistentKeyStore::Open(uint32_t keyId, uint8_t& signatureType, psa_key_handle_t& handle)
+{
+    if (!ValidKeyId(keyId))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    psa_status_t status = psa_open_key(keyId, &handle);
+    if (status != PSA_SUCCESS)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Key ID 0x%x not found %d\n", (unsigned)keyId, (int)status);
+        return SDMReturnCode_InternalError;
+    }
+
+    psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
+    status = psa_get_key_attributes(handle, &attributes);
+    bool supported = status == PSA_SUCCESS && signatureTypeOf(attributes, signatureType);
+    psa_reset_key_attributes(&attributes);
+    if (!supported)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Key ID 0x%x is not a supported signing key\n", (unsigned)keyId);
+        psa_close_key(handle);
+        handle = 0;
+        return SDMReturnCode_InternalError;
+    }
+
+    return SDMReturnCode_Success;
+}
@@ -0,0 +1,59 @@
+// persistent_key_store.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef PERSISTENT_KEY_STORE_H
+#define PERSISTENT_KEY_STORE_H
+
+#include <stdint.h>
+
+#include "secure_debug_manager.h"
+#include "psa/crypto.h"
+
+/**
+ * \brief Private keys held in the PSA persistent key store.
+ *
+ * import_private_key parses the key file and imports a volatile key on every
+ * authentication. A key provisioned here is parsed once, stored by mbedtls in its
+ * file-backed internal trusted storage (the SDM_KEY_STORE_DIR CMake option, or the
+ * working directory), and opened by key ID afterwards.
+ *
+ * Every call must hold {@link PsaCryptoContext::Lock}.
+ */
+class PersistentKeyStore
+{
+public:
+    /**
+     * \brief Whether keyId is in the PSA user key ID range.
+     */
+    static bool ValidKeyId(uint32_t keyId);
+
+    /**
+     * \brief Store the private key in keyFile under keyId.
+     *
+     * The key gets the type, size, usage and algorithm import_private_key gives it.
+     *
+     * @return SDMReturnCode_InvalidArgument if the key ID is out of range, already in
+     *         use, or the key file cannot be parsed.
+     */
+    static SDMReturnCode Provision(const char* keyFile, uint32_t keyId);
+
+    /**
+     * \brief Remove the key stored under keyId.
+     */
+    static SDMReturnCode Delete(uint32_t keyId);
+
+    /**
+     * \brief Open the key stored under keyId for signing.
+     *
+     * The handle must be closed with psa_close_key, destroying it would remove the key
+     * from storage. See {@link PsaKey::Reset}.
+     *
+     * @param[out] signatureType Receives the psa-adac signature type of the key.
+     * @param[out] handle Receives the key handle.
+     */
+    static SDMReturnCode Open(uint32_t keyId, uint8_t& signatureType, psa_key_handle_t& handle);
+};
+
+#endif // PERSISTENT_KEY_STORE_H
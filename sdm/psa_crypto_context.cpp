@@ -0,0 +1,69 @@
+// psa_crypto_context.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "psa_crypto_context.h"
+
+#include "psa_adac.h"
+#include "psa_adac_debug.h"
+#include "psa/crypto.h"
+
+#include <mutex>
+
+#define ENTITY_NAME "PsaCryptoContext"
+
+PsaCryptoContext PsaCryptoContext::sInstance;
+std::mutex PsaCryptoContext::sMutex;
+std::mutex PsaCryptoContext::sInitMutex;
+
+PsaCryptoContext::PsaCryptoContext() :
+    mInitialized(false),
+    mInitResult(0)
+{
+}
+
+PsaCryptoContext::~PsaCryptoContext()
+{
+    // library unload
+    if (mInitialized)
+    {
+        mbedtls_psa_crypto_free();
+        mInitialized = false;
+    }
+}
+
+int PsaCryptoContext::Acquire()
+{
+    std::lock_guard<std::mutex> lock(sInitMutex);
+    if (sInstance.mInitialized)
+    {
+        return sInstance.mInitResult;
+    }
+
+    // only success is kept, a failure (e.g. entropy source not ready) is retried by the next call
+    int result = psa_adac_init();
+    if (result < 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "psa_adac_init failed %d\n", result);
+        return result;
+    }
+
+    sInstance.mInitResult = result;
+    sInstance.mInitialized = true;
+    return result;
+}
+
+std::unique_lock<std::mutex> PsaCryptoContext::Lock()
+{
+    return std::unique_lock<std::mutex>(sMutex);
+}
+
+size_t PsaCryptoContext::KeySlotsInUse()
+{
+    std::unique_lock<std::mutex> cryptoLock = Lock();
+
+    mbedtls_psa_stats_t stats;
+    mbedtls_psa_get_stats(&stats);
+    return stats.volatile_slots + stats.persistent_slots + stats.external_slots;
+}
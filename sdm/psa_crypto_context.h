@@ -0,0 +1,60 @@
+// psa_crypto_context.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#ifndef PSA_CRYPTO_CONTEXT_H
+#define PSA_CRYPTO_CONTEXT_H
+
+#include <stddef.h>
+
+#include <mutex>
+
+/**
+ * \brief Process-lifetime PSA crypto context.
+ *
+ * PSA crypto (entropy source and DRBG) is initialized once, on first use, and kept
+ * alive across Secure Debug Manager sessions. It is shut down when the library is
+ * unloaded.
+ *
+ * The key store and DRBG are shared by every session in the process, and mbedtls is
+ * built without MBEDTLS_THREADING_C, so concurrent sessions must hold {@link Lock}
+ * around PSA crypto calls.
+ */
+class PsaCryptoContext
+{
+public:
+    /**
+     * \brief Initialize PSA crypto if not already done. Thread-safe.
+     *
+     * A failed initialization is not kept, the next call tries again.
+     *
+     * @return The psa_adac_init result of the successful initialization,
+     *         or of this call's attempt, negative on failure.
+     */
+    static int Acquire();
+
+    /**
+     * \brief Serialize PSA crypto calls between sessions.
+     */
+    static std::unique_lock<std::mutex> Lock();
+
+    /**
+     * \brief Occupied slots of the PSA key store, volatile and persistent.
+     */
+    static size_t KeySlotsInUse();
+
+    ~PsaCryptoContext();
+
+private:
+    PsaCryptoContext();
+
+    static PsaCryptoContext sInstance;
+    static std::mutex sMutex;
+    static std::mutex sInitMutex;
+
+    bool mInitialized;
+    int mInitResult;
+};
+
+#endif // PSA_CRYPTO_CONTEXT_H
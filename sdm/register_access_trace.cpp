@@ -0,0 +1,339 @@
+// register_access_trace.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "register_access_trace.h"
+#include "psa_adac_debug.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+
+#define ENTITY_NAME "RegisterAccessTrace"
+
+/******************************************************************************************************
+ *
+ * RegisterAccessTraceRecorder
+ *
+ ******************************************************************************************************/
+
+RegisterAccessTraceRecorder::RegisterAccessTraceRecorder(FILE* file, SessionArena* arena) :
+    mFile(file),
+    mBuffer(ArenaAllocator<uint8_t>(arena)),
+    mValuesIn(ArenaAllocator<uint32_t>(arena)),
+    mEpoch(std::chrono::steady_clock::now())
+{
+}
+
+RegisterAccessTraceRecorder::~RegisterAccessTraceRecorder()
+{
+    Flush();
+    fclose(mFile);
+}
+
+ArenaPtr<RegisterAccessTraceRecorder> RegisterAccessTraceRecorder::Create(const char* path, SDMDebugArchitecture arch, SessionArena* arena)
+{
+    FILE* file = path != NULL ? fopen(path, "wb") : NULL;
+    if (file == NULL)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to create %s\n", path != NULL ? path : "(null)");
+        return ArenaPtr<RegisterAccessTraceRecorder>();
+    }
+
+    ArenaPtr<RegisterAccessTraceRecorder> recorder = ArenaNew<RegisterAccessTraceRecorder>(arena, file, arena);
+    if (!recorder)
+    {
+        fclose(file);
+        return recorder;
+    }
+
+    SDMTraceHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SDM_TRACE_MAGIC;
+    header.version = SDM_TRACE_VERSION;
+    header.headerSize = sizeof(SDMTraceHeader);
+    header.debugArchitecture = (uint32_t)arch;
+
+    try
+    {
+        recorder->mBuffer.reserve(FLUSH_THRESHOLD * 2);
+        recorder->append(&header, sizeof(header));
+    }
+    catch (const std::bad_alloc&)
+    {
+        return ArenaPtr<RegisterAccessTraceRecorder>();
+    }
+
+    return recorder;
+}
+
+SDMRegisterAccessCallback RegisterAccessTraceRecorder::Wrap(SDMRegisterAccessCallback callback)
+{
+    return [this, callback](const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses,
+                            size_t accessCount, size_t* accessesCompleted, void* refcon)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+
+        // values are updated in place by reads, keep what was passed in
+        try
+        {
+            mValuesIn.resize(accessCount);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return (SDMReturnCode)SDMReturnCode_InternalError;
+        }
+        for (size_t i = 0; i < accessCount; i++)
+        {
+            mValuesIn[i] = accesses[i].value != NULL ? *accesses[i].value : 0;
+        }
+
+        uint64_t startNs = now();
+        SDMReturnCode result = callback(device, transferSize, accesses, accessCount, accessesCompleted, refcon);
+        uint64_t endNs = now();
+
+        record(startNs, endNs, result, transferSize, accesses, mValuesIn.data(), accessCount, *accessesCompleted);
+
+        return result;
+    };
+}
+
+void RegisterAccessTraceRecorder::Flush()
+{
+    if (!mBuffer.empty())
+    {
+        if (fwrite(mBuffer.data(), 1, mBuffer.size(), mFile) != mBuffer.size())
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to write trace\n");
+        }
+        fflush(mFile);
+        mBuffer.clear();
+    }
+}
+
+void RegisterAccessTraceRecorder::record(uint64_t startNs, uint64_t endNs, SDMReturnCode result, SDMTransferSize transferSize,
+                                         const SDMRegisterAccess* accesses, const uint32_t* valuesIn, size_t accessCount, size_t accessesCompleted)
+{
+    SDMTraceCall call;
+    call.startNs = startNs;
+    call.durationNs = endNs - startNs;
+    call.result = (uint32_t)result;
+    call.transferSize = (uint32_t)transferSize;
+    call.accessCount = (uint32_t)accessCount;
+    call.accessesCompleted = (uint32_t)accessesCompleted;
+
+    try
+    {
+        append(&call, sizeof(call));
+
+        for (size_t i = 0; i < accessCount; i++)
+        {
+            SDMTraceAccess access;
+            access.address = accesses[i].address;
+            access.op = (uint32_t)accesses[i].op;
+            access.pollMask = accesses[i].pollMask;
+            access.retries = accesses[i].retries;
+            access.valueIn = valuesIn[i];
+            access.valueOut = accesses[i].value != NULL ? *accesses[i].value : 0;
+            access.reserved = 0;
+            append(&access, sizeof(access));
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        // keep the session going, the trace is diagnostic only
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Out of memory, trace truncated\n");
+        return;
+    }
+
+    if (mBuffer.size() >= FLUSH_THRESHOLD)
+    {
+        Flush();
+    }
+}
+
+void RegisterAccessTraceRecorder::append(const void* data, size_t size)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+}
+
+uint64_t RegisterAccessTraceRecorder::now() const
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - mEpoch).count();
+}
+
+/******************************************************************************************************
+ *
+ * RegisterAccessTraceReplay
+ *
+ ******************************************************************************************************/
+
+RegisterAccessTraceReplay::RegisterAccessTraceReplay() :
+    mDebugArchitecture(SDMDebugArchitecture_ArmADIv5),
+    mPosition(0),
+    mWriteValueMismatches(0),
+    mTiming(TIMING_FULL_SPEED),
+    mCheckWriteValues(false),
+    mStarted(false),
+    mFirstStartNs(0)
+{
+}
+
+std::unique_ptr<RegisterAccessTraceReplay> RegisterAccessTraceReplay::Open(const char* path)
+{
+    FILE* file = path != NULL ? fopen(path, "rb") : NULL;
+    if (file == NULL)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to open %s\n", path != NULL ? path : "(null)");
+        return std::unique_ptr<RegisterAccessTraceReplay>();
+    }
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay(new RegisterAccessTraceReplay());
+
+    SDMTraceHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != SDM_TRACE_MAGIC || header.version != SDM_TRACE_VERSION || header.headerSize < sizeof(SDMTraceHeader) ||
+        fseek(file, header.headerSize, SEEK_SET) != 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Unsupported trace format %s\n", path);
+        fclose(file);
+        return std::unique_ptr<RegisterAccessTraceReplay>();
+    }
+    replay->mDebugArchitecture = (SDMDebugArchitecture)header.debugArchitecture;
+
+    bool first = true;
+    SDMTraceCall call;
+    std::vector<SDMTraceAccess> accesses;
+    try
+    {
+        while (fread(&call, sizeof(call), 1, file) == 1)
+        {
+            accesses.resize(call.accessCount);
+            if (call.accessCount != 0 && fread(accesses.data(), sizeof(SDMTraceAccess), call.accessCount, file) != call.accessCount)
+            {
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "Truncated trace %s\n", path);
+                fclose(file);
+                return std::unique_ptr<RegisterAccessTraceReplay>();
+            }
+
+            if (first)
+            {
+                replay->mFirstStartNs = call.startNs;
+                first = false;
+            }
+
+            uint64_t endNs = call.startNs + call.durationNs;
+            size_t completed = std::min<size_t>(call.accessesCompleted, call.accessCount);
+            for (size_t i = 0; i < completed; i++)
+            {
+                ReplayAccess access = { accesses[i], SDMReturnCode_Success, true, endNs };
+                replay->mAccesses.push_back(access);
+            }
+
+            if (call.result != SDMReturnCode_Success)
+            {
+                if (completed < call.accessCount)
+                {
+                    // failed at the first access not completed
+                    ReplayAccess access = { accesses[completed], (SDMReturnCode)call.result, false, endNs };
+                    replay->mAccesses.push_back(access);
+                }
+                else if (completed != 0)
+                {
+                    // failed after completing every access
+                    replay->mAccesses.back().result = (SDMReturnCode)call.result;
+                }
+            }
+        }
+    }
+    catch (const std::bad_alloc&)
+    {
+        fclose(file);
+        return std::unique_ptr<RegisterAccessTraceReplay>();
+    }
+
+    fclose(file);
+    return replay;
+}
+
+void RegisterAccessTraceReplay::Rewind()
+{
+    mPosition = 0;
+    mWriteValueMismatches = 0;
+    mStarted = false;
+}
+
+SDMReturnCode RegisterAccessTraceReplay::Access(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted)
+{
+    if (!mStarted)
+    {
+        // align the replay with the first recorded access
+        mEpoch = std::chrono::steady_clock::now() - std::chrono::nanoseconds(mFirstStartNs);
+        mStarted = true;
+    }
+
+    SDMReturnCode result = SDMReturnCode_Success;
+    uint64_t endNs = 0;
+
+    *accessesCompleted = 0;
+    for (size_t i = 0; i < accessCount && result == SDMReturnCode_Success; i++)
+    {
+        if (mPosition >= mAccesses.size())
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Trace exhausted after %zu accesses\n", mPosition);
+            return SDMReturnCode_TransferError;
+        }
+
+        const ReplayAccess& expected = mAccesses[mPosition];
+        if (accesses[i].address != expected.access.address || (uint32_t)accesses[i].op != expected.access.op)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "Divergence at access %zu: address 0x%llx op %u, recorded address 0x%llx op %u\n",
+                             mPosition, (unsigned long long)accesses[i].address, (uint32_t)accesses[i].op,
+                             (unsigned long long)expected.access.address, expected.access.op);
+            return SDMReturnCode_TransferError;
+        }
+
+        if (accesses[i].op == SDMRegisterAccessOp_Write && *accesses[i].value != expected.access.valueIn)
+        {
+            mWriteValueMismatches++;
+            if (mCheckWriteValues)
+            {
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "Write value 0x%08x at access %zu, recorded 0x%08x\n",
+                                 *accesses[i].value, mPosition, expected.access.valueIn);
+                return SDMReturnCode_TransferError;
+            }
+        }
+
+        if (expected.performed)
+        {
+            if (accesses[i].op != SDMRegisterAccessOp_Write)
+            {
+                *accesses[i].value = expected.access.valueOut;
+            }
+            (*accessesCompleted)++;
+        }
+
+        result = expected.result;
+        endNs = expected.endNs;
+        mPosition++;
+    }
+
+    if (mTiming == TIMING_ORIGINAL && endNs != 0)
+    {
+        std::this_thread::sleep_until(mEpoch + std::chrono::nanoseconds(endNs));
+    }
+
+    return result;
+}
+
+SDMRegisterAccessCallback RegisterAccessTraceReplay::Callback()
+{
+    return [this](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses,
+                  size_t accessCount, size_t* accessesCompleted, void*)
+    {
+        return Access(accesses, accessCount, accessesCompleted);
+    };
+}
@@ -0,0 +1,189 @@
+// register_access_trace.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Register access trace recording and replay.
+ *
+ * A trace captures every register access list passed to the SDMRegisterAccessCallback
+ * of an ExternalComPortDriver, so a session can be reproduced without the target:
+ *
+ *   SDMTraceHeader
+ *   repeated for every callback invocation:
+ *     SDMTraceCall
+ *     SDMTraceAccess[accessCount]
+ *
+ * All fields are little-endian. Timestamps are nanoseconds since the recorder was created.
+ */
+
+#ifndef REGISTER_ACCESS_TRACE_H
+#define REGISTER_ACCESS_TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "ext_com_port_driver.h"
+#include "session_arena.h"
+
+#define SDM_TRACE_MAGIC   0x54444D53 /* "SDMT" */
+#define SDM_TRACE_VERSION 1
+
+typedef struct SDMTraceHeader {
+    uint32_t magic;             /*!< SDM_TRACE_MAGIC */
+    uint16_t version;           /*!< SDM_TRACE_VERSION */
+    uint16_t headerSize;        /*!< sizeof(SDMTraceHeader) */
+    uint32_t debugArchitecture; /*!< SDMDebugArchitecture of the recorded session */
+    uint32_t reserved;
+} SDMTraceHeader;
+
+typedef struct SDMTraceCall {
+    uint64_t startNs;           /*!< Callback entry time */
+    uint64_t durationNs;        /*!< Time spent in the callback */
+    uint32_t result;            /*!< SDMReturnCode returned by the callback */
+    uint32_t transferSize;      /*!< SDMTransferSize */
+    uint32_t accessCount;       /*!< Number of SDMTraceAccess records following */
+    uint32_t accessesCompleted; /*!< accessesCompleted returned by the callback */
+} SDMTraceCall;
+
+typedef struct SDMTraceAccess {
+    uint64_t address;
+    uint32_t op;                /*!< SDMRegisterAccessOp */
+    uint32_t pollMask;
+    uint32_t retries;
+    uint32_t valueIn;           /*!< Value before the callback: write data or poll value */
+    uint32_t valueOut;          /*!< Value after the callback: read data */
+    uint32_t reserved;
+} SDMTraceAccess;
+
+/**
+ * \brief Records register accesses to a trace file.
+ */
+class RegisterAccessTraceRecorder
+{
+public:
+    /**
+     * \brief Create a trace file, truncating any existing file.
+     *
+     * @param[in] arena Session arena for the recorder and its buffers, NULL for the heap.
+     * @return The recorder, or an empty pointer if the file could not be created.
+     */
+    static ArenaPtr<RegisterAccessTraceRecorder> Create(const char* path, SDMDebugArchitecture arch, SessionArena* arena = NULL);
+
+    ~RegisterAccessTraceRecorder();
+
+    /**
+     * \brief Wrap a callback so every invocation is recorded.
+     *
+     * The recorder must outlive the returned callback.
+     */
+    SDMRegisterAccessCallback Wrap(SDMRegisterAccessCallback callback);
+
+    /**
+     * \brief Write buffered records to the file.
+     */
+    void Flush();
+
+private:
+    template <class T, class... Args>
+    friend ArenaPtr<T> ArenaNew(SessionArena* arena, Args&&... args);
+
+    RegisterAccessTraceRecorder(FILE* file, SessionArena* arena);
+
+    void record(uint64_t startNs, uint64_t endNs, SDMReturnCode result, SDMTransferSize transferSize,
+                const SDMRegisterAccess* accesses, const uint32_t* valuesIn, size_t accessCount, size_t accessesCompleted);
+    void append(const void* data, size_t size);
+    uint64_t now() const;
+
+    static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    std::mutex mMutex;
+    FILE* mFile;
+    ArenaVector<uint8_t> mBuffer;
+    ArenaVector<uint32_t> mValuesIn;
+    std::chrono::steady_clock::time_point mEpoch;
+};
+
+/**
+ * \brief Replays a trace as an SDMRegisterAccessCallback.
+ *
+ * The trace is consumed as a stream of accesses rather than of callback invocations,
+ * so a driver splitting or merging access lists differently from the recorded session
+ * still replays. Reads and polls return the recorded values, writes are checked against
+ * the recorded address and operation. Write data is only compared if requested, since
+ * signatures differ between sessions.
+ */
+class RegisterAccessTraceReplay
+{
+public:
+    enum Timing
+    {
+        TIMING_FULL_SPEED, /*!< Answer every access immediately */
+        TIMING_ORIGINAL    /*!< Answer no earlier than the recorded session did */
+    };
+
+    /**
+     * \brief Load a trace file.
+     *
+     * @return The replay, or an empty pointer if the file could not be read or is malformed.
+     */
+    static std::unique_ptr<RegisterAccessTraceReplay> Open(const char* path);
+
+    SDMDebugArchitecture DebugArchitecture() const { return mDebugArchitecture; }
+
+    void SetTiming(Timing timing) { mTiming = timing; }
+    void SetCheckWriteValues(bool check) { mCheckWriteValues = check; }
+
+    /**
+     * \brief Restart the replay from the first access.
+     */
+    void Rewind();
+
+    /**
+     * \brief Replay the next accesses.
+     *
+     * Same contract as SDMRegisterAccessCallback. Returns SDMReturnCode_TransferError on
+     * divergence from the trace, or if the trace is exhausted.
+     */
+    SDMReturnCode Access(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted);
+
+    /**
+     * \brief A callback replaying this trace. The replay must outlive the returned callback.
+     */
+    SDMRegisterAccessCallback Callback();
+
+    size_t Position() const { return mPosition; }
+    size_t AccessCount() const { return mAccesses.size(); }
+    size_t WriteValueMismatches() const { return mWriteValueMismatches; }
+
+private:
+    struct ReplayAccess
+    {
+        SDMTraceAccess access;
+        SDMReturnCode result; /*!< Returned after this access, SDMReturnCode_Success unless the recorded callback failed here */
+        bool performed;       /*!< Whether the recorded callback completed this access */
+        uint64_t endNs;       /*!< Recorded callback return time */
+    };
+
+    RegisterAccessTraceReplay();
+
+    SDMDebugArchitecture mDebugArchitecture;
+    std::vector<ReplayAccess> mAccesses;
+    size_t mPosition;
+    size_t mWriteValueMismatches;
+    Timing mTiming;
+    bool mCheckWriteValues;
+    bool mStarted;
+    uint64_t mFirstStartNs;
+    std::chrono::steady_clock::time_point mEpoch;
+};
+
+#endif // REGISTER_ACCESS_TRACE_H
@@ -8,6 +8,8 @@
  *
  * Current values reflect the capabilities and layout of the Arm MPS3 Corstone-1000 (AN550)
  * platform running Trusted Firmware-M.
+ *
+ * These are the defaults of the runtime configuration, see sdm_runtime_config.h.
  */
 
 #ifndef SDM_CONFIG_H
@@ -78,7 +80,7 @@
 /* Values: SDMDeviceType_ArmADI_AP,                            */
 /*         SDMDeviceType_ArmADI_CoreSightComponent             */
 /*-------------------------------------------------------------*/
-#define SDM_CONFIG_COM_DEVICE_TYPE SDMDeviceType_ArmADI_CoreSightComponent;
+#define SDM_CONFIG_COM_DEVICE_TYPE SDMDeviceType_ArmADI_CoreSightComponent
 
 /*-------------------------------------------------------------*/
 /* The value of armAp.dpIndex or armCoreSightComponent.dpIndex */
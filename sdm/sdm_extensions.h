@@ -0,0 +1,295 @@
+// sdm_extensions.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Extensions to the Secure Debug Manager API provided by this implementation.
+ *
+ * Debuggers that only know the standard SDM API keep using {@link SDMOpen}. Clients that
+ * link against this library directly can use {@link SDMOpenEx} to pass additional,
+ * implementation specific, session parameters.
+ */
+
+#ifndef SDM_EXTENSIONS_H
+#define SDM_EXTENSIONS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "secure_debug_manager.h"
+
+#if defined(_WIN32)
+#if defined(SDM_EXPORT_SYMBOLS)
+#define SDM_EXT_EXTERN __declspec(dllexport)
+#else
+#define SDM_EXT_EXTERN __declspec(dllimport)
+#endif
+#else
+#define SDM_EXT_EXTERN __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * \brief Environment variable holding the private key file path.
+ *
+ * Used when no private key is supplied through {@link SDMOpenExtensions}.
+ */
+#define SDM_ENV_PRIVATE_KEY_FILE "SDM_PRIVATE_KEY_FILE"
+
+/**
+ * \brief Environment variable holding a persistent private key ID, see {@link SDMProvisionKey}.
+ *
+ * Used when no private key ID is supplied through {@link SDMOpenExtensions}. Decimal, or
+ * hexadecimal with a 0x prefix.
+ */
+#define SDM_ENV_PRIVATE_KEY_ID "SDM_PRIVATE_KEY_ID"
+
+/**
+ * \brief Environment variable holding the trust chain file path.
+ *
+ * Used when no trust chain is supplied through {@link SDMOpenExtensions}.
+ */
+#define SDM_ENV_TRUST_CHAIN_FILE "SDM_TRUST_CHAIN_FILE"
+
+/**
+ * \brief Environment variable holding the authentication bundle file path.
+ *
+ * Used when no authentication bundle is supplied through {@link SDMOpenExtensions}.
+ */
+#define SDM_ENV_AUTH_BUNDLE_FILE "SDM_AUTH_BUNDLE_FILE"
+
+/**
+ * \brief Memory source for a session, see SDMOpenExtensions::allocator
+ *
+ * The library takes blocks of at least SDMOpenExtensions::arenaBlockSize bytes for
+ * the session arena and returns them all when the session is closed. allocate returns
+ * NULL when the budget is exhausted, and the failing call returns SDMReturnCode_InternalError.
+ * Memory allocated internally by the crypto libraries does not come from this allocator.
+ */
+typedef struct SDMAllocator {
+    void *(*allocate)(size_t size, size_t alignment, void *context);           /*!< Allocate size bytes, or return NULL */
+    void (*deallocate)(void *ptr, size_t size, size_t alignment, void *context); /*!< Release a block from allocate */
+    void *context;                                                               /*!< Passed to both functions */
+} SDMAllocator;
+
+/**
+ * \brief One register access list of a vectored call, see {@link SDMRegisterAccessVectorCallback}
+ */
+typedef struct SDMRegisterAccessList {
+    const SDMDeviceDescriptor *device;  /*!< Device the accesses target */
+    SDMTransferSize transferSize;       /*!< Transfer size of every access in the list */
+    const SDMRegisterAccess *accesses;  /*!< Accesses, performed in order */
+    size_t accessCount;                 /*!< Number of accesses */
+    size_t accessesCompleted;           /*!< Set by the callback: accesses completed */
+    SDMReturnCode result;               /*!< Set by the callback: result of the list */
+} SDMRegisterAccessList;
+
+/**
+ * \brief Perform several register access lists in one call.
+ *
+ * Behaves as SDMCallbacks::registerAccess for each list in turn, but lets the debugger
+ * queue all of them to the probe at once, e.g. in a single USB or TCP packet. Lists may
+ * target different devices and transfer sizes. Lists are performed in order. Once a
+ * list does not complete, the lists after it are not performed and report 0 accesses
+ * completed and SDMReturnCode_RequestFailed.
+ *
+ * @param[in,out] lists Lists to perform, completion is reported in each list.
+ * @param[in] listCount Number of lists.
+ * @param[in] refcon SDMOpenParameters::refcon.
+ * @return SDMReturnCode_Success if every list completed, otherwise the result of the first list that did not.
+ */
+typedef SDMReturnCode (*SDMRegisterAccessVectorCallback)(SDMRegisterAccessList *lists, size_t listCount, void *refcon);
+
+/**
+ * \brief Cancellation token for a session, see SDMOpenExtensions::cancelRequested
+ *
+ * Polled before every register access the session makes, including during
+ * {@link SDMOpenEx}, when the caller has no handle to pass to {@link SDMCancel} yet.
+ * May be called from a thread other than the one that opened the session, but never
+ * concurrently with the register access callbacks. Must not block.
+ *
+ * @param[in] refcon SDMOpenParameters::refcon.
+ * @return Non-zero to cancel the operation in progress.
+ */
+typedef int (*SDMCancelRequestedCallback)(void *refcon);
+
+/**
+ * \brief When a session establishes the COM port link, see SDMOpenExtensions::lazyOpen
+ *
+ * Establishing the link initializes PSA crypto, resets the COM port and checks the
+ * target protocol. In the lazy modes {@link SDMOpenEx} only validates the parameters
+ * and records the device, and a failure to establish the link is returned by the
+ * first {@link SDMAuthenticate} instead.
+ */
+typedef enum SDMLazyOpenMode {
+    SDMLazyOpen_Config = 0,     /*!< As the lazy_open configuration key, SDMLazyOpen_Off by default */
+    SDMLazyOpen_Off,            /*!< Established by SDMOpenEx */
+    SDMLazyOpen_FirstUse,       /*!< Established by the first SDMAuthenticate. SDMClose does not establish
+                                     a link that was never used */
+    SDMLazyOpen_Background,     /*!< Established on a library thread started by SDMOpenEx, joined by the
+                                     first SDMAuthenticate or SDMClose. The debugger callbacks are
+                                     called from that thread until SDMOpenEx's caller makes another call
+                                     on the session */
+} SDMLazyOpenMode;
+
+/**
+ * \brief Limits of the debugger's probe, see {@link SDMQueryProbeCapabilitiesCallback}
+ *
+ * The library sets size and fills every field with the transfer settings it would
+ * otherwise use, from the build and runtime configuration. The callback overwrites the
+ * fields it knows, and only the fields that fit in size.
+ */
+typedef struct SDMProbeCapabilities {
+    size_t size;                /*!< sizeof(SDMProbeCapabilities), set by the library */
+    size_t maxAccessListLength; /*!< Maximum register accesses in one registerAccess call or vectored
+                                     list, 0 for no limit. Longer lists are split */
+    int pollSupported;          /*!< Non-zero if the probe performs SDMRegisterAccessOp_Poll */
+    int dbrStallTolerated;      /*!< Non-zero if the probe tolerates DBR writes that stall until the
+                                     target drains the COM port TX FIFO */
+} SDMProbeCapabilities;
+
+/**
+ * \brief Report the limits of the debugger's probe, see SDMOpenExtensions::queryProbeCapabilities
+ *
+ * Called once by {@link SDMOpenEx}, before the first register access. The library sizes
+ * its register access lists, chooses between polling the COM port itself and delegating
+ * polls to the probe, and bounds its hardware blocking writes from the result. The
+ * result only restricts the configuration: it never enables poll_mode = probe or
+ * hardware blocking, and a smaller configured max_access_list_length or tx_block_chunk
+ * still applies.
+ *
+ * @param[in,out] capabilities Filled with the library defaults, receives the probe limits.
+ * @param[in] refcon SDMOpenParameters::refcon.
+ * @return SDMReturnCode_Success to apply capabilities. On any other result the session
+ *         keeps its configured transfer settings.
+ */
+typedef SDMReturnCode (*SDMQueryProbeCapabilitiesCallback)(SDMProbeCapabilities *capabilities, void *refcon);
+
+/**
+ * \brief Additional session parameters for {@link SDMOpenEx}
+ *
+ * Fields are only ever appended to this structure. The library checks the
+ * size field before reading a field, so clients built against an older
+ * version of this header remain compatible. Zero-initialize the structure
+ * and set size to sizeof(SDMOpenExtensions) before filling in any field.
+ *
+ * Credentials supplied here are used in preference to the SDM_ENV_* environment
+ * variables, then the runtime configuration file (see sdm_runtime_config.h), then
+ * the presentForm callback.
+ * The presentForm callback is only invoked for credentials that could not be
+ * resolved non-interactively.
+ */
+typedef struct SDMOpenExtensions {
+    size_t size;                /*!< sizeof(SDMOpenExtensions) */
+    const char *privateKeyFile; /*!< Private key file path, or NULL */
+    const char *trustChainFile; /*!< Trust chain file path, or NULL */
+    const uint8_t *trustChain;  /*!< In-memory trust chain, or NULL. Takes precedence over trustChainFile */
+    size_t trustChainSize;      /*!< Size in bytes of trustChain */
+    const char *authenticationBundleFile; /*!< Authentication bundle (see tools/sdm_bundle_tool), or NULL.
+                                               Takes precedence over all other credentials */
+    const SDMAllocator *allocator; /*!< Source of the session arena blocks, or NULL for the heap. Copied */
+    size_t arenaBlockSize;      /*!< Minimum session arena block size in bytes, 0 for 16 KiB */
+    SDMRegisterAccessVectorCallback registerAccessVector; /*!< Vectored register access, or NULL if the
+                                                               debugger only provides SDMCallbacks::registerAccess */
+    SDMCancelRequestedCallback cancelRequested; /*!< Cancellation token, or NULL */
+    uint32_t privateKeyId;      /*!< Persistent private key ID (see {@link SDMProvisionKey}), or 0.
+                                     Takes precedence over privateKeyFile and the authentication bundle key */
+    SDMLazyOpenMode lazyOpen;   /*!< When the COM port link is established */
+    SDMQueryProbeCapabilitiesCallback queryProbeCapabilities; /*!< Probe limits query, or NULL to use
+                                                                   the configured transfer settings */
+    int callerThreadCallbacks;  /*!< Non-zero to only make callbacks from the thread of the SDM call in
+                                     progress, e.g. when they are forwarded over a connection that
+                                     carries one call at a time. Overrides rx_pump to false and runs
+                                     SDMLazyOpen_Background as SDMLazyOpen_FirstUse */
+} SDMOpenExtensions;
+
+/**
+ * \brief Whether an {@link SDMOpenExtensions} instance is large enough to hold a field.
+ */
+#define SDM_EXT_HAS_FIELD(ext, field) \
+    ((ext) != NULL && (ext)->size >= offsetof(SDMOpenExtensions, field) + sizeof((ext)->field))
+
+/**
+ * \brief Open a Secure Debug Manager session with implementation specific extensions.
+ *
+ * Behaves as SDMOpen, additionally applying the parameters in extensions.
+ *
+ * @param[out] handle Receives the session handle.
+ * @param[in] params Standard SDM API open parameters.
+ * @param[in] extensions Additional parameters, may be NULL.
+ */
+SDM_EXT_EXTERN SDMReturnCode SDMOpenEx(SDMHandle *handle, const SDMOpenParameters *params, const SDMOpenExtensions *extensions);
+
+/**
+ * \brief Cancel the operation in progress on a session.
+ *
+ * Safe to call from any thread while another thread is in {@link SDMAuthenticate},
+ * {@link SDMResumeBoot} or {@link SDMClose} on the same handle. The operation fails with
+ * SDMReturnCode_RequestFailed before its next register access, so it unwinds within
+ * one register access callback, e.g. one probe round trip. Polls delegated to the
+ * debugger as SDMRegisterAccessOp_Poll run to completion first. Every later operation
+ * on the session fails the same way, except {@link SDMClose}, which releases the
+ * session without touching the target. To cancel {@link SDMOpenEx} itself, use
+ * SDMOpenExtensions::cancelRequested.
+ *
+ * @param[in] handle Session to cancel.
+ */
+SDM_EXT_EXTERN SDMReturnCode SDMCancel(SDMHandle handle);
+
+/**
+ * \brief Store a private key in the PSA persistent key store.
+ *
+ * The key file is parsed once, here. Sessions then refer to the key by ID, see
+ * SDMOpenExtensions::privateKeyId, and open it from storage instead of importing the
+ * key file on every {@link SDMAuthenticate}. Storage is the mbedtls file-backed internal
+ * trusted storage, in the directory set at build time with SDM_KEY_STORE_DIR, or the
+ * working directory of the process.
+ *
+ * @param[in] privateKeyFile Private key file path, as for SDMOpenExtensions::privateKeyFile.
+ * @param[in] keyId Key ID, from 0x1 to 0x3FFFFFFF. Must not be in use.
+ */
+SDM_EXT_EXTERN SDMReturnCode SDMProvisionKey(const char *privateKeyFile, uint32_t keyId);
+
+/**
+ * \brief Remove a private key stored with {@link SDMProvisionKey}.
+ *
+ * @param[in] keyId Key ID of the stored key.
+ */
+SDM_EXT_EXTERN SDMReturnCode SDMDeleteKey(uint32_t keyId);
+
+/**
+ * \brief Resources held by the library, see {@link SDMGetResourceUsage}
+ *
+ * Versioned like {@link SDMOpenExtensions}: set size to sizeof(SDMResourceUsage), only
+ * the fields that fit are written.
+ */
+typedef struct SDMResourceUsage {
+    size_t size;                /*!< sizeof(SDMResourceUsage) */
+    size_t openSessions;        /*!< Sessions opened and not yet closed */
+    size_t sessionKeys;         /*!< PSA keys imported or opened by sessions and not yet released */
+    size_t sessionBuffers;      /*!< Trust chain and token buffers held by sessions */
+    size_t psaKeySlotsInUse;    /*!< Occupied PSA key store slots, whoever owns them */
+    size_t arenaBytes;          /*!< Bytes held by session arenas, see SDMAllocator */
+} SDMResourceUsage;
+
+/**
+ * \brief Report the resources currently held by the library.
+ *
+ * Between sessions every count is 0. A long running debugger can use this to check
+ * that sessions release what they acquire.
+ *
+ * @param[in,out] usage Size set by the caller, receives the counts.
+ */
+SDM_EXT_EXTERN SDMReturnCode SDMGetResourceUsage(SDMResourceUsage *usage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SDM_EXTENSIONS_H
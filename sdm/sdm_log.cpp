@@ -0,0 +1,567 @@
+// sdm_log.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "sdm_log.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/* Ring buffer capacity in records, a power of two */
+#define SDM_LOG_RING_SIZE 4096
+
+/* Background thread wake up interval when idle */
+#define SDM_LOG_DRAIN_INTERVAL_MS 5
+
+namespace
+{
+    int initialLevel()
+    {
+        int level = SDM_LOG_DEFAULT_LEVEL;
+        const char* envLevel = getenv(SDM_ENV_LOG_LEVEL);
+        if (envLevel != NULL && !SDMLog::ParseLevel(envLevel, level))
+        {
+            level = SDM_LOG_DEFAULT_LEVEL;
+        }
+        return level;
+    }
+}
+
+std::atomic<int> SDMLog::sLevel(initialLevel());
+
+namespace
+{
+    const char* levelNames[] = { "NONE", "ERROR", "WARN", "INFO", "DEBUG", "TRACE" };
+
+    uint64_t nowNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    uint32_t currentThreadId()
+    {
+        static std::atomic<uint32_t> nextId(1);
+        static thread_local uint32_t id = 0;
+        if (id == 0)
+        {
+            id = nextId.fetch_add(1, std::memory_order_relaxed);
+        }
+        return id;
+    }
+
+    /*
+     * Bounded multi producer queue of records, single consumer (D. Vyukov's design).
+     * Each slot carries a sequence number: pos when free for the producer at pos,
+     * pos + 1 when committed for the consumer.
+     */
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        SDMLogRecord record;
+    };
+
+    // formats one conversion of a printf format with a captured argument
+    void formatArg(std::string& out, std::string spec, char conversion, const SDMLogRecord& record, const SDMLogArg& arg)
+    {
+        char buffer[128];
+        int length = 0;
+
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            spec += "ll";
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(), (long long)arg.i);
+            break;
+        case 'u':
+        case 'x':
+        case 'X':
+        case 'o':
+        {
+            // mask to the width of the argument, as printf would see a promoted negative int
+            uint64_t value = arg.u;
+            if (arg.kind == SDMLogArg::SIGNED && arg.size < sizeof(uint64_t))
+            {
+                value &= (UINT64_C(1) << (arg.size * 8)) - 1;
+            }
+            spec += "ll";
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(), (unsigned long long)value);
+            break;
+        }
+        case 'c':
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(), (int)arg.i);
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(), arg.kind == SDMLogArg::DOUBLE ? arg.d : (double)arg.i);
+            break;
+        case 'p':
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(), arg.p);
+            break;
+        case 's':
+            spec += conversion;
+            length = snprintf(buffer, sizeof(buffer), spec.c_str(),
+                              arg.kind == SDMLogArg::STRING ? record.payload + arg.offset : "(?)");
+            break;
+        default:
+            out += spec;
+            out += conversion;
+            return;
+        }
+
+        if (length > 0)
+        {
+            out.append(buffer, (size_t)length < sizeof(buffer) ? (size_t)length : sizeof(buffer) - 1);
+        }
+    }
+
+    void formatText(std::string& out, const SDMLogRecord& record)
+    {
+        size_t argIndex = 0;
+        for (const char* p = record.format; *p != '\0'; p++)
+        {
+            if (*p != '%')
+            {
+                out += *p;
+                continue;
+            }
+
+            if (p[1] == '%')
+            {
+                out += '%';
+                p++;
+                continue;
+            }
+
+            // %[flags][width][.precision][length]conversion. Length modifiers are dropped,
+            // the captured argument is always 64 bit.
+            std::string spec = "%";
+            const char* q = p + 1;
+            while (*q != '\0' && strchr("-+ #0", *q) != NULL)
+            {
+                spec += *q++;
+            }
+            while (isdigit((unsigned char)*q) || *q == '.')
+            {
+                spec += *q++;
+            }
+            while (*q != '\0' && strchr("hlzjtLqI", *q) != NULL)
+            {
+                q++;
+            }
+
+            if (*q == '\0')
+            {
+                out += spec;
+                break;
+            }
+
+            if (argIndex < record.argCount)
+            {
+                formatArg(out, spec, *q, record, record.args[argIndex++]);
+            }
+            else
+            {
+                out.append(p, (size_t)(q - p + 1));
+            }
+            p = q;
+        }
+    }
+
+    void formatDump(std::string& out, const SDMLogRecord& record)
+    {
+        char buffer[64];
+        if (record.dumpOffset == 0)
+        {
+            snprintf(buffer, sizeof(buffer), " (%u bytes)\n", (unsigned)record.dumpSize);
+            out += record.format;
+            out += buffer;
+        }
+
+        for (uint16_t i = 0; i < record.payloadSize; i++)
+        {
+            uint32_t offset = record.dumpOffset + i;
+            if (offset % 16 == 0)
+            {
+                snprintf(buffer, sizeof(buffer), "%s%08x:", offset != record.dumpOffset ? "\n" : "", (unsigned)offset);
+                out += buffer;
+            }
+            snprintf(buffer, sizeof(buffer), " %02x", (uint8_t)record.payload[i]);
+            out += buffer;
+        }
+        out += '\n';
+    }
+
+    class Logger
+    {
+    public:
+        Logger() :
+            mSlots(new Slot[SDM_LOG_RING_SIZE]),
+            mEnqueuePos(0),
+            mDequeuePos(0),
+            mDropped(0),
+            mReportedDropped(0),
+            mStartNs(nowNs()),
+            mSink(NULL),
+            mOwnedSink(NULL),
+            mRunning(false),
+            mStop(false)
+        {
+            for (size_t i = 0; i < SDM_LOG_RING_SIZE; i++)
+            {
+                mSlots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+
+            const char* envFile = getenv(SDM_ENV_LOG_FILE);
+            if (envFile != NULL && envFile[0] != '\0')
+            {
+                mOwnedSink = fopen(envFile, "a");
+            }
+        }
+
+        ~Logger()
+        {
+            stopThread(true);
+            drain();
+            if (mOwnedSink != NULL)
+            {
+                fclose(mOwnedSink);
+            }
+        }
+
+        SDMLogRecord* acquire()
+        {
+            if (!mRunning.load(std::memory_order_acquire))
+            {
+                startThread();
+            }
+
+            size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Slot& slot = mSlots[pos & (SDM_LOG_RING_SIZE - 1)];
+                size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (diff == 0)
+                {
+                    if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        return &slot.record;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    // full, never block the caller
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                    return NULL;
+                }
+                else
+                {
+                    pos = mEnqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        void commit(SDMLogRecord* record)
+        {
+            // while owned by the producer the sequence still holds its enqueue position
+            Slot* slot = (Slot*)((char*)record - offsetof(Slot, record));
+            size_t pos = slot->sequence.load(std::memory_order_relaxed);
+            slot->sequence.store(pos + 1, std::memory_order_release);
+        }
+
+        void drain()
+        {
+            std::lock_guard<std::mutex> lock(mConsumerMutex);
+
+            std::string out;
+            for (;;)
+            {
+                size_t pos = mDequeuePos;
+                Slot& slot = mSlots[pos & (SDM_LOG_RING_SIZE - 1)];
+                if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+                {
+                    break;
+                }
+
+                format(out, slot.record);
+                slot.sequence.store(pos + SDM_LOG_RING_SIZE, std::memory_order_release);
+                mDequeuePos = pos + 1;
+            }
+
+            uint64_t dropped = mDropped.load(std::memory_order_relaxed);
+            if (dropped != mReportedDropped)
+            {
+                char buffer[96];
+                snprintf(buffer, sizeof(buffer), "SDMLog: %llu records dropped, ring buffer full\n",
+                         (unsigned long long)(dropped - mReportedDropped));
+                out += buffer;
+                mReportedDropped = dropped;
+            }
+
+            if (!out.empty())
+            {
+                FILE* sink = this->sink();
+                fwrite(out.data(), 1, out.size(), sink);
+                fflush(sink);
+            }
+        }
+
+        void setSink(FILE* file)
+        {
+            std::lock_guard<std::mutex> lock(mConsumerMutex);
+            mSink = file;
+        }
+
+        uint64_t dropped() const
+        {
+            return mDropped.load(std::memory_order_relaxed);
+        }
+
+        void stopThread(bool exiting)
+        {
+            std::unique_lock<std::mutex> lock(mThreadMutex);
+            if (!mThread.joinable())
+            {
+                return;
+            }
+
+            mStop = true;
+            mWake.notify_one();
+            lock.unlock();
+
+#ifdef _WIN32
+            // joining from static destructors of a DLL deadlocks on the loader lock
+            if (exiting)
+            {
+                mThread.detach();
+            }
+            else
+#endif
+            {
+                (void)exiting;
+                mThread.join();
+            }
+
+            lock.lock();
+            mStop = false;
+            mRunning.store(false, std::memory_order_release);
+        }
+
+    private:
+        FILE* sink() const
+        {
+            return mSink != NULL ? mSink : mOwnedSink != NULL ? mOwnedSink : stdout;
+        }
+
+        void format(std::string& out, const SDMLogRecord& record)
+        {
+            char prefix[96];
+            double seconds = (double)(record.timestampNs - mStartNs) / 1e9;
+            snprintf(prefix, sizeof(prefix), "[%12.6f] [T%u] %-5s %s: ", seconds, (unsigned)record.threadId,
+                     levelNames[record.level <= SDM_LOG_LEVEL_TRACE ? record.level : 0], record.entity);
+            out += prefix;
+
+            if (record.type == SDMLogRecord::DUMP)
+            {
+                formatDump(out, record);
+            }
+            else
+            {
+                formatText(out, record);
+            }
+        }
+
+        void startThread()
+        {
+            std::lock_guard<std::mutex> lock(mThreadMutex);
+            if (mRunning.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+
+            mThread = std::thread(&Logger::run, this);
+            mRunning.store(true, std::memory_order_release);
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mThreadMutex);
+            while (!mStop)
+            {
+                lock.unlock();
+                drain();
+                lock.lock();
+                // producers do not signal, they must not take a lock
+                mWake.wait_for(lock, std::chrono::milliseconds(SDM_LOG_DRAIN_INTERVAL_MS));
+            }
+            lock.unlock();
+            drain();
+        }
+
+        std::unique_ptr<Slot[]> mSlots;
+        std::atomic<size_t> mEnqueuePos;
+        size_t mDequeuePos;
+        std::atomic<uint64_t> mDropped;
+        uint64_t mReportedDropped;
+        uint64_t mStartNs;
+
+        std::mutex mConsumerMutex;
+        FILE* mSink;
+        FILE* mOwnedSink;
+
+        std::mutex mThreadMutex;
+        std::condition_variable mWake;
+        std::thread mThread;
+        std::atomic<bool> mRunning;
+        bool mStop;
+    };
+
+    Logger& logger()
+    {
+        static Logger instance;
+        return instance;
+    }
+}
+
+void SDMLog::SetLevel(int level)
+{
+    if (level < SDM_LOG_LEVEL_NONE)
+    {
+        level = SDM_LOG_LEVEL_NONE;
+    }
+    else if (level > SDM_LOG_LEVEL_TRACE)
+    {
+        level = SDM_LOG_LEVEL_TRACE;
+    }
+    sLevel.store(level, std::memory_order_relaxed);
+}
+
+bool SDMLog::ParseLevel(const char* text, int& level)
+{
+    std::string name;
+    for (const char* p = text; *p != '\0'; p++)
+    {
+        if (!isspace((unsigned char)*p))
+        {
+            name += (char)tolower((unsigned char)*p);
+        }
+    }
+
+    if (name.size() == 1 && name[0] >= '0' && name[0] <= '5')
+    {
+        level = name[0] - '0';
+        return true;
+    }
+
+    static const char* names[] = { "none", "error", "warn", "info", "debug", "trace" };
+    for (int i = SDM_LOG_LEVEL_NONE; i <= SDM_LOG_LEVEL_TRACE; i++)
+    {
+        if (name == names[i])
+        {
+            level = i;
+            return true;
+        }
+    }
+
+    if (name == "warning")
+    {
+        level = SDM_LOG_LEVEL_WARN;
+        return true;
+    }
+
+    return false;
+}
+
+void SDMLog::SetSink(FILE* file)
+{
+    logger().drain();
+    logger().setSink(file);
+}
+
+void SDMLog::Flush()
+{
+    logger().drain();
+}
+
+void SDMLog::Shutdown()
+{
+    logger().stopThread(false);
+    logger().drain();
+}
+
+uint64_t SDMLog::Dropped()
+{
+    return logger().dropped();
+}
+
+SDMLogRecord* SDMLog::Acquire(int level, SDMLogRecord::Type type, const char* entity, const char* format)
+{
+    SDMLogRecord* record = logger().acquire();
+    if (record != NULL)
+    {
+        record->timestampNs = nowNs();
+        record->entity = entity;
+        record->format = format;
+        record->threadId = currentThreadId();
+        record->level = (uint8_t)level;
+        record->type = type;
+        record->argCount = 0;
+        record->payloadSize = 0;
+        record->dumpOffset = 0;
+        record->dumpSize = 0;
+        record->payload[SDM_LOG_PAYLOAD_SIZE - 1] = '\0';
+    }
+    return record;
+}
+
+void SDMLog::Commit(SDMLogRecord* record)
+{
+    logger().commit(record);
+}
+
+void SDMLogDetail::Dump(int level, const char* entity, const char* label, const uint8_t* buffer, size_t size)
+{
+    // large buffers are split over consecutive records, an empty buffer still logs its label
+    size_t offset = 0;
+    do
+    {
+        SDMLogRecord* record = SDMLog::Acquire(level, SDMLogRecord::DUMP, entity, label);
+        if (record == NULL)
+        {
+            return;
+        }
+
+        size_t chunk = size - offset < SDM_LOG_PAYLOAD_SIZE ? size - offset : SDM_LOG_PAYLOAD_SIZE;
+        if (chunk > 0)
+        {
+            memcpy(record->payload, buffer + offset, chunk);
+        }
+        record->payloadSize = (uint16_t)chunk;
+        record->dumpOffset = (uint32_t)offset;
+        record->dumpSize = (uint32_t)size;
+        SDMLog::Commit(record);
+
+        offset += chunk;
+    } while (offset < size);
+}
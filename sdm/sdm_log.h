@@ -0,0 +1,264 @@
+// sdm_log.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Asynchronous logging for the protocol hot path.
+ *
+ * SDM_LOG_* calls copy their arguments into a fixed size binary record in a lock-free
+ * ring buffer and return. Records are formatted and written by a background thread,
+ * so enabling debug logging does not slow down or skew the timing of the protocol.
+ *
+ * - Records are dropped, and counted, rather than blocking when the ring is full.
+ * - The format and entity arguments must be string literals, they are formatted later.
+ *   %s arguments are copied, truncated to the record payload.
+ * - Levels above SDM_LOG_COMPILE_LEVEL are removed at compile time. Levels above the
+ *   runtime level (SDMLog::SetLevel, the SDM_LOG_LEVEL environment variable or the
+ *   log_level configuration key) cost a single relaxed atomic load.
+ *
+ * Error reporting stays on PSA_ADAC_LOG_ERR, which is synchronous.
+ */
+
+#ifndef SDM_LOG_H
+#define SDM_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+#define SDM_LOG_LEVEL_NONE  0
+#define SDM_LOG_LEVEL_ERROR 1
+#define SDM_LOG_LEVEL_WARN  2
+#define SDM_LOG_LEVEL_INFO  3
+#define SDM_LOG_LEVEL_DEBUG 4
+#define SDM_LOG_LEVEL_TRACE 5
+
+/* Levels above this are compiled out */
+#ifndef SDM_LOG_COMPILE_LEVEL
+#define SDM_LOG_COMPILE_LEVEL SDM_LOG_LEVEL_DEBUG
+#endif
+
+/* Runtime level used when neither SDM_LOG_LEVEL nor log_level are set */
+#define SDM_LOG_DEFAULT_LEVEL SDM_LOG_LEVEL_WARN
+
+/**
+ * \brief Environment variable holding the runtime log level: none, error, warn, info, debug, trace or 0-5.
+ */
+#define SDM_ENV_LOG_LEVEL "SDM_LOG_LEVEL"
+
+/**
+ * \brief Environment variable holding a file to append log output to, instead of stdout.
+ */
+#define SDM_ENV_LOG_FILE "SDM_LOG_FILE"
+
+#define SDM_LOG_MAX_ARGS     8
+#define SDM_LOG_PAYLOAD_SIZE 176
+
+struct SDMLogArg
+{
+    enum Kind : uint8_t { SIGNED, UNSIGNED, DOUBLE, POINTER, STRING };
+
+    union
+    {
+        uint64_t u;
+        int64_t i;
+        double d;
+        const void* p;
+    };
+    uint16_t offset; /*!< STRING: payload offset */
+    uint8_t size;    /*!< SIGNED, UNSIGNED: sizeof the argument */
+    Kind kind;
+};
+
+struct SDMLogRecord
+{
+    enum Type : uint8_t { TEXT, DUMP };
+
+    uint64_t timestampNs;
+    const char* entity;
+    const char* format;          /*!< TEXT: printf format, DUMP: label */
+    uint32_t threadId;
+    uint8_t level;
+    Type type;
+    uint8_t argCount;
+    uint16_t payloadSize;
+    uint32_t dumpOffset;         /*!< DUMP: offset of this chunk in the dumped buffer */
+    uint32_t dumpSize;           /*!< DUMP: size of the dumped buffer */
+    SDMLogArg args[SDM_LOG_MAX_ARGS];
+    char payload[SDM_LOG_PAYLOAD_SIZE];
+};
+
+class SDMLog
+{
+public:
+    static bool Enabled(int level)
+    {
+        return level <= sLevel.load(std::memory_order_relaxed);
+    }
+
+    static int Level() { return sLevel.load(std::memory_order_relaxed); }
+    static void SetLevel(int level);
+
+    /**
+     * \brief Parse a level name or number.
+     *
+     * @return false if text is not a level.
+     */
+    static bool ParseLevel(const char* text, int& level);
+
+    /**
+     * \brief Redirect output. NULL restores stdout. The caller keeps ownership of file.
+     */
+    static void SetSink(FILE* file);
+
+    /**
+     * \brief Format and write every record logged so far, on the calling thread.
+     */
+    static void Flush();
+
+    /**
+     * \brief Flush, and stop the background thread until the next record.
+     */
+    static void Shutdown();
+
+    /** Records dropped because the ring buffer was full */
+    static uint64_t Dropped();
+
+    // Used by the SDM_LOG_* macros
+    static SDMLogRecord* Acquire(int level, SDMLogRecord::Type type, const char* entity, const char* format);
+    static void Commit(SDMLogRecord* record);
+
+private:
+    static std::atomic<int> sLevel;
+};
+
+namespace SDMLogDetail
+{
+    inline void CaptureString(SDMLogRecord& record, SDMLogArg& arg, const char* text)
+    {
+        if (text == NULL)
+        {
+            text = "(null)";
+        }
+
+        // the last payload byte is kept as an empty string for arguments that do not fit
+        size_t available = SDM_LOG_PAYLOAD_SIZE - 1 - record.payloadSize;
+        size_t length = strlen(text);
+        if (length >= available)
+        {
+            length = available > 0 ? available - 1 : 0;
+        }
+
+        arg.kind = SDMLogArg::STRING;
+        if (available == 0)
+        {
+            arg.offset = SDM_LOG_PAYLOAD_SIZE - 1;
+            return;
+        }
+
+        arg.offset = record.payloadSize;
+        memcpy(record.payload + record.payloadSize, text, length);
+        record.payload[record.payloadSize + length] = '\0';
+        record.payloadSize = (uint16_t)(record.payloadSize + length + 1);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+    Capture(SDMLogRecord&, SDMLogArg& arg, T value)
+    {
+        arg.size = sizeof(T);
+        if (std::is_signed<T>::value)
+        {
+            arg.kind = SDMLogArg::SIGNED;
+            arg.i = (int64_t)value;
+        }
+        else
+        {
+            arg.kind = SDMLogArg::UNSIGNED;
+            arg.u = (uint64_t)value;
+        }
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    Capture(SDMLogRecord&, SDMLogArg& arg, T value)
+    {
+        arg.kind = SDMLogArg::DOUBLE;
+        arg.d = (double)value;
+    }
+
+    inline void Capture(SDMLogRecord& record, SDMLogArg& arg, const char* value)
+    {
+        CaptureString(record, arg, value);
+    }
+
+    inline void Capture(SDMLogRecord& record, SDMLogArg& arg, char* value)
+    {
+        CaptureString(record, arg, value);
+    }
+
+    template <typename T>
+    void Capture(SDMLogRecord&, SDMLogArg& arg, T* value)
+    {
+        arg.kind = SDMLogArg::POINTER;
+        arg.p = (const void*)value;
+    }
+
+    inline void CaptureAll(SDMLogRecord&)
+    {
+    }
+
+    template <typename T, typename... Args>
+    void CaptureAll(SDMLogRecord& record, T value, Args... args)
+    {
+        if (record.argCount < SDM_LOG_MAX_ARGS)
+        {
+            Capture(record, record.args[record.argCount++], value);
+            CaptureAll(record, args...);
+        }
+    }
+
+    template <typename... Args>
+    void Write(int level, const char* entity, const char* format, Args... args)
+    {
+        SDMLogRecord* record = SDMLog::Acquire(level, SDMLogRecord::TEXT, entity, format);
+        if (record != NULL)
+        {
+            CaptureAll(*record, args...);
+            SDMLog::Commit(record);
+        }
+    }
+
+    void Dump(int level, const char* entity, const char* label, const uint8_t* buffer, size_t size);
+}
+
+#define SDM_LOG_AT(_level, _entity, ...) \
+    do { \
+        if ((_level) <= SDM_LOG_COMPILE_LEVEL && SDMLog::Enabled(_level)) \
+        { \
+            SDMLogDetail::Write((_level), (_entity), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define SDM_LOG_WARN(_entity, ...)  SDM_LOG_AT(SDM_LOG_LEVEL_WARN, _entity, __VA_ARGS__)
+#define SDM_LOG_INFO(_entity, ...)  SDM_LOG_AT(SDM_LOG_LEVEL_INFO, _entity, __VA_ARGS__)
+#define SDM_LOG_DEBUG(_entity, ...) SDM_LOG_AT(SDM_LOG_LEVEL_DEBUG, _entity, __VA_ARGS__)
+#define SDM_LOG_TRACE(_entity, ...) SDM_LOG_AT(SDM_LOG_LEVEL_TRACE, _entity, __VA_ARGS__)
+
+/* Hex dump of size bytes at buffer, logged at debug level */
+#define SDM_LOG_DUMP(_entity, _label, _buffer, _size) \
+    do { \
+        if (SDM_LOG_LEVEL_DEBUG <= SDM_LOG_COMPILE_LEVEL && SDMLog::Enabled(SDM_LOG_LEVEL_DEBUG)) \
+        { \
+            SDMLogDetail::Dump(SDM_LOG_LEVEL_DEBUG, (_entity), (_label), (const uint8_t*)(_buffer), (size_t)(_size)); \
+        } \
+    } while (0)
+
+#endif // SDM_LOG_H
@@ -0,0 +1,503 @@
+// sdm_runtime_config.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "sdm_runtime_config.h"
+#include "sdm_config.h"
+#include "sdm_log.h"
+#include "sdm_timeline.h"
+#include "psa_adac_debug.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+
+#define ENTITY_NAME "SDMRuntimeConfig"
+
+namespace
+{
+    std::string trim(const std::string& text)
+    {
+        static const char* WHITESPACE = " \t\r\n";
+
+        size_t first = text.find_first_not_of(WHITESPACE);
+        if (first == std::string::npos)
+        {
+            return std::string();
+        }
+
+        size_t last = text.find_last_not_of(WHITESPACE);
+        return text.substr(first, last - first + 1);
+    }
+
+    std::string lower(std::string text)
+    {
+        for (char& c : text)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c = (char)(c - 'A' + 'a');
+            }
+        }
+        return text;
+    }
+
+    bool isAbsolutePath(const std::string& path)
+    {
+#ifdef _WIN32
+        return (path.size() > 1 && path[1] == ':') || (!path.empty() && (path[0] == '\\' || path[0] == '/'));
+#else
+        return !path.empty() && path[0] == '/';
+#endif
+    }
+
+    std::string directoryOf(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    std::string joinPath(const std::string& directory, const std::string& name)
+    {
+        if (directory.empty() || directory.back() == '/' || directory.back() == '\\')
+        {
+            return directory + name;
+        }
+        return directory + "/" + name;
+    }
+
+    bool fileExists(const std::string& path)
+    {
+        std::ifstream file(path.c_str());
+        return file.good();
+    }
+
+    bool parseUnsigned(const std::string& value, uint64_t max, uint64_t& result)
+    {
+        if (value.empty() || value[0] == '-')
+        {
+            return false;
+        }
+
+        char* end = NULL;
+        errno = 0;
+        unsigned long long parsed = strtoull(value.c_str(), &end, 0);
+        if (errno != 0 || end == value.c_str() || *end != '\0' || parsed > max)
+        {
+            return false;
+        }
+
+        result = parsed;
+        return true;
+    }
+
+    bool parseBool(const std::string& value, bool& result)
+    {
+        std::string text = lower(value);
+        if (text == "true" || text == "yes" || text == "on" || text == "1")
+        {
+            result = true;
+            return true;
+        }
+        if (text == "false" || text == "no" || text == "off" || text == "0")
+        {
+            result = false;
+            return true;
+        }
+        return false;
+    }
+}
+
+SDMRuntimeConfig::SDMRuntimeConfig() :
+    comDeviceType(SDM_CONFIG_COM_DEVICE_TYPE),
+    comDeviceDpIndex(SDM_CONFIG_COM_DEVICE_DP_INDEX),
+    comDeviceAddress(SDM_CONFIG_COM_DEVICE_ADDRESS),
+#ifdef SDM_CONFIG_COM_DEVICE_MEMAP_ADDRESS
+    comDeviceHasMemAp(true),
+    comDeviceMemApAddress(SDM_CONFIG_COM_DEVICE_MEMAP_ADDRESS),
+#else
+    comDeviceHasMemAp(false),
+    comDeviceMemApAddress(0),
+#endif
+    remoteResetType(SDM_CONFIG_REMOTE_RESET_TYPE),
+    lockOnClose(SDM_CONFIG_LOCK_ON_CLOSE),
+    resetOnClose(SDM_CONFIG_RESET_ON_CLOSE),
+    lazyOpen(SDMLazyOpen_Off),
+    comHwTxBlocking(SDM_CONFIG_COM_HW_TX_BLOCKING),
+    privateKeyId(0),
+    logLevel(-1)
+{
+}
+
+SDMReturnCode SDMRuntimeConfig::Load(const SDMOpenParameters* params)
+{
+    SDMReturnCode res = locateAndParse(params);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+
+    const char* envTraceFile = getenv(SDM_ENV_REGISTER_TRACE_FILE);
+    if (envTraceFile != NULL && envTraceFile[0] != '\0')
+    {
+        registerTraceFile = trim(envTraceFile);
+    }
+
+    const char* envTimelineFile = getenv(SDM_ENV_TIMELINE_FILE);
+    if (envTimelineFile != NULL && envTimelineFile[0] != '\0')
+    {
+        timelineFile = trim(envTimelineFile);
+    }
+
+    int envLogLevel = 0;
+    const char* envLogLevelText = getenv(SDM_ENV_LOG_LEVEL);
+    if (envLogLevelText != NULL && SDMLog::ParseLevel(envLogLevelText, envLogLevel))
+    {
+        logLevel = envLogLevel;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SDMRuntimeConfig::locateAndParse(const SDMOpenParameters* params)
+{
+    const char* envConfigFile = getenv(SDM_ENV_CONFIG_FILE);
+    if (envConfigFile != NULL && envConfigFile[0] != '\0')
+    {
+        // explicitly requested, so it must exist
+        return Parse(trim(envConfigFile));
+    }
+
+    std::string candidates[2];
+    if (params->resourcesDirectoryPath != NULL && params->resourcesDirectoryPath[0] != '\0')
+    {
+        candidates[0] = joinPath(params->resourcesDirectoryPath, SDM_RUNTIME_CONFIG_FILE_NAME);
+    }
+    if (params->manifestFilePath != NULL && params->manifestFilePath[0] != '\0')
+    {
+        candidates[1] = directoryOf(params->manifestFilePath) + SDM_RUNTIME_CONFIG_FILE_NAME;
+    }
+
+    for (const std::string& candidate : candidates)
+    {
+        if (!candidate.empty() && fileExists(candidate))
+        {
+            return Parse(candidate);
+        }
+    }
+
+    PSA_ADAC_LOG_DEBUG(ENTITY_NAME, "no %s found, using build defaults\n", SDM_RUNTIME_CONFIG_FILE_NAME);
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SDMRuntimeConfig::Parse(const std::string& configPath)
+{
+    std::ifstream file(configPath.c_str());
+    if (!file.good())
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to open %s\n", configPath.c_str());
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    std::string directory = directoryOf(configPath);
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        lineNumber++;
+
+        size_t comment = line.find_first_of("#;");
+        if (comment != std::string::npos)
+        {
+            line.erase(comment);
+        }
+
+        line = trim(line);
+        if (line.empty() || line[0] == '[')
+        {
+            continue;
+        }
+
+        size_t separator = line.find('=');
+        if (separator == std::string::npos)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "%s:%zu: expected key = value\n", configPath.c_str(), lineNumber);
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        std::string key = lower(trim(line.substr(0, separator)));
+        std::string value = trim(line.substr(separator + 1));
+        if (!apply(key, value, directory))
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "%s:%zu: invalid value for %s\n", configPath.c_str(), lineNumber, key.c_str());
+            return SDMReturnCode_InvalidArgument;
+        }
+    }
+
+    path = configPath;
+    PSA_ADAC_LOG_INFO(ENTITY_NAME, "applied %s\n", configPath.c_str());
+
+    return SDMReturnCode_Success;
+}
+
+void SDMRuntimeConfig::BuildComDevice(SDMDeviceDescriptor& device, SDMDeviceDescriptor& memAp) const
+{
+    memAp.deviceType = SDMDeviceType_ArmADI_AP;
+    memAp.armAP.dpIndex = comDeviceDpIndex;
+    memAp.armAP.address = comDeviceMemApAddress;
+
+    device.deviceType = comDeviceType;
+    if (device.deviceType == SDMDeviceType_ArmADI_AP)
+    {
+        device.armAP.dpIndex = comDeviceDpIndex;
+        device.armAP.address = comDeviceAddress;
+    }
+    else
+    {
+        device.armCoreSightComponent.dpIndex = comDeviceDpIndex;
+        device.armCoreSightComponent.baseAddress = comDeviceAddress;
+        device.armCoreSightComponent.memAp = comDeviceHasMemAp ? &memAp : NULL;
+    }
+}
+
+void SDMRuntimeConfig::GetProbeCapabilities(SDMProbeCapabilities& capabilities) const
+{
+    memset(&capabilities, 0, sizeof(capabilities));
+    capabilities.size = sizeof(capabilities);
+    capabilities.maxAccessListLength = driver.maxAccessListLength;
+    capabilities.pollSupported = driver.pollMode == ECPD_POLL_PROBE;
+    capabilities.dbrStallTolerated = comHwTxBlocking && driver.txBlockChunk == 0;
+}
+
+void SDMRuntimeConfig::ApplyProbeCapabilities(const SDMProbeCapabilities& capabilities)
+{
+    if (driver.maxAccessListLength == 0 || (capabilities.maxAccessListLength != 0 && capabilities.maxAccessListLength < driver.maxAccessListLength))
+    {
+        driver.maxAccessListLength = capabilities.maxAccessListLength;
+    }
+
+    // the probe can only take away what the configuration enabled
+    if (!capabilities.pollSupported)
+    {
+        driver.pollMode = ECPD_POLL_HOST;
+    }
+
+    if (!capabilities.dbrStallTolerated && comHwTxBlocking && driver.txBlockChunk == 0)
+    {
+        // bounded by the TX FIFO free level alone
+        driver.txBlockChunk = SIZE_MAX;
+    }
+}
+
+bool SDMRuntimeConfig::apply(const std::string& key, const std::string& value, const std::string& directory)
+{
+    uint64_t number = 0;
+    std::string text = lower(value);
+
+    // COM port device descriptor
+    if (key == "com_device_type")
+    {
+        if (text == "ap")
+        {
+            comDeviceType = SDMDeviceType_ArmADI_AP;
+        }
+        else if (text == "coresight")
+        {
+            comDeviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (key == "com_device_dp_index")
+    {
+        if (!parseUnsigned(value, UINT8_MAX, number))
+        {
+            return false;
+        }
+        comDeviceDpIndex = (uint8_t)number;
+    }
+    else if (key == "com_device_address")
+    {
+        if (!parseUnsigned(value, UINT64_MAX, comDeviceAddress))
+        {
+            return false;
+        }
+    }
+    else if (key == "com_device_memap_address")
+    {
+        // "none" removes a parent MEM-AP configured at build time
+        if (text == "none")
+        {
+            comDeviceHasMemAp = false;
+        }
+        else if (parseUnsigned(value, UINT64_MAX, comDeviceMemApAddress))
+        {
+            comDeviceHasMemAp = true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    // reset strategy
+    else if (key == "remote_reset_type")
+    {
+        if (text == "none")
+        {
+            remoteResetType = ECPD_REMOTE_RESET_NONE;
+        }
+        else if (text == "system")
+        {
+            remoteResetType = ECPD_REMOTE_RESET_SYSTEM;
+        }
+        else if (text == "com")
+        {
+            remoteResetType = ECPD_REMOTE_RESET_COM;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if (key == "lock_on_close")
+    {
+        return parseBool(value, lockOnClose);
+    }
+    else if (key == "reset_on_close")
+    {
+        return parseBool(value, resetOnClose);
+    }
+    else if (key == "lazy_open")
+    {
+        if (text == "off")
+        {
+            lazyOpen = SDMLazyOpen_Off;
+        }
+        else if (text == "first_use")
+        {
+            lazyOpen = SDMLazyOpen_FirstUse;
+        }
+        else if (text == "background")
+        {
+            lazyOpen = SDMLazyOpen_Background;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    // transfers
+    else if (key == "com_hw_tx_blocking")
+    {
+        return parseBool(value, comHwTxBlocking);
+    }
+    else if (key == "tx_retries" || key == "rx_retries" || key == "rx_max_null_flags")
+    {
+        if (!parseUnsigned(value, UINT32_MAX, number))
+        {
+            return false;
+        }
+
+        uint32_t& field = key == "tx_retries" ? driver.txRetries :
+                          key == "rx_retries" ? driver.rxRetries : driver.rxMaxNullFlags;
+        field = (uint32_t)number;
+    }
+    else if (key == "rx_pump")
+    {
+        return parseBool(value, driver.rxPump);
+    }
+    else if (key == "rx_pump_queue_size")
+    {
+        if (!parseUnsigned(value, SIZE_MAX, number) || number == 0)
+        {
+            return false;
+        }
+        driver.rxPumpQueueSize = (size_t)number;
+    }
+    else if (key == "max_access_list_length")
+    {
+        if (!parseUnsigned(value, SIZE_MAX, number))
+        {
+            return false;
+        }
+        driver.maxAccessListLength = (size_t)number;
+    }
+    else if (key == "tx_block_chunk")
+    {
+        if (!parseUnsigned(value, SIZE_MAX, number))
+        {
+            return false;
+        }
+        driver.txBlockChunk = (size_t)number;
+    }
+    else if (key == "tx_pipeline_chunk")
+    {
+        if (!parseUnsigned(value, SIZE_MAX, number))
+        {
+            return false;
+        }
+        driver.txPipelineChunk = (size_t)number;
+    }
+    else if (key == "poll_mode")
+    {
+        if (text == "host")
+        {
+            driver.pollMode = ECPD_POLL_HOST;
+        }
+        else if (text == "probe")
+        {
+            driver.pollMode = ECPD_POLL_PROBE;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    // credentials
+    else if (key == "private_key_file" || key == "trust_chain_file" || key == "authentication_bundle_file")
+    {
+        if (value.empty())
+        {
+            return false;
+        }
+
+        std::string& field = key == "private_key_file" ? privateKeyFile :
+                             key == "trust_chain_file" ? trustChainFile : authenticationBundleFile;
+        field = isAbsolutePath(value) ? value : directory + value;
+    }
+    else if (key == "private_key_id")
+    {
+        if (!parseUnsigned(value, UINT32_MAX, number) || number == 0)
+        {
+            return false;
+        }
+        privateKeyId = (uint32_t)number;
+    }
+    // diagnostics
+    else if (key == "register_trace_file" || key == "timeline_file")
+    {
+        if (value.empty())
+        {
+            return false;
+        }
+
+        std::string& field = key == "register_trace_file" ? registerTraceFile : timelineFile;
+        field = isAbsolutePath(value) ? value : directory + value;
+    }
+    else if (key == "log_level")
+    {
+        return SDMLog::ParseLevel(value.c_str(), logLevel);
+    }
+    else
+    {
+        // tolerate keys from newer releases
+        PSA_ADAC_LOG_WARN(ENTITY_NAME, "ignoring unknown key %s\n", key.c_str());
+    }
+
+    return true;
+}
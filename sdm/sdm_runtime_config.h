@@ -0,0 +1,134 @@
+// sdm_runtime_config.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Runtime configuration of the Secure Debug Manager.
+ *
+ * The build configurations in sdm_config.h are the defaults. At SDMOpen they can be
+ * overridden, without rebuilding the library, by a configuration file of key = value
+ * lines. '#' and ';' start comments and [section] lines are ignored. The file is:
+ *
+ *   the file named by the SDM_CONFIG_FILE environment variable, or else
+ *   sdm_config.ini in SDMOpenParameters::resourcesDirectoryPath, or else
+ *   sdm_config.ini in the directory of SDMOpenParameters::manifestFilePath.
+ *
+ * A missing file leaves the defaults in place. See README.md for the supported keys.
+ */
+
+#ifndef SDM_RUNTIME_CONFIG_H
+#define SDM_RUNTIME_CONFIG_H
+
+#include <stdint.h>
+
+#include <string>
+
+#include "ext_com_port_driver.h"
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+
+#define SDM_RUNTIME_CONFIG_FILE_NAME "sdm_config.ini"
+
+/**
+ * \brief Environment variable holding the configuration file path.
+ *
+ * Takes precedence over the configuration file in the resources directory.
+ */
+#define SDM_ENV_CONFIG_FILE "SDM_CONFIG_FILE"
+
+/**
+ * \brief Environment variable holding the register access trace file path.
+ *
+ * Takes precedence over the register_trace_file configuration key.
+ */
+#define SDM_ENV_REGISTER_TRACE_FILE "SDM_REGISTER_TRACE_FILE"
+
+/*
+ * SDM_ENV_TIMELINE_FILE (sdm_timeline.h) and SDM_ENV_LOG_LEVEL (sdm_log.h) likewise take
+ * precedence over the timeline_file and log_level keys
+ */
+
+struct SDMRuntimeConfig
+{
+    // SDMDeviceDescriptor of the SDC-600 COM port
+    SDMDeviceType comDeviceType;
+    uint8_t comDeviceDpIndex;
+    uint64_t comDeviceAddress;
+    bool comDeviceHasMemAp;
+    uint64_t comDeviceMemApAddress;
+
+    // session start and end
+    ECPDRemoteResetType remoteResetType;
+    bool lockOnClose;
+    bool resetOnClose;
+    SDMLazyOpenMode lazyOpen; // SDMLazyOpen_Off unless configured
+
+    // transfers
+    bool comHwTxBlocking;
+    ECPDConfig driver;
+
+    // credentials, empty if not configured. Relative paths are resolved against the configuration file directory
+    std::string privateKeyFile;
+    std::string trustChainFile;
+    std::string authenticationBundleFile;
+    uint32_t privateKeyId; // persistent key store ID, 0 if not configured
+
+    // diagnostics, empty if not configured
+    std::string registerTraceFile;
+    std::string timelineFile;
+    int logLevel; // SDM_LOG_LEVEL_*, -1 if not configured
+
+    // configuration file in use, empty if running on the defaults
+    std::string path;
+
+    /**
+     * \brief Defaults from sdm_config.h
+     */
+    SDMRuntimeConfig();
+
+    /**
+     * \brief Locate and apply the configuration file for a session.
+     *
+     * @return SDMReturnCode_Success if no configuration file exists, or it was applied.
+     *         SDMReturnCode_InvalidArgument if the file is malformed, or SDM_CONFIG_FILE names
+     *         a file that cannot be read.
+     */
+    SDMReturnCode Load(const SDMOpenParameters* params);
+
+    /**
+     * \brief Apply a configuration file.
+     */
+    SDMReturnCode Parse(const std::string& configPath);
+
+    /**
+     * \brief Build the COM port device descriptor.
+     *
+     * @param[out] device Receives the COM port descriptor.
+     * @param[out] memAp Storage for the parent MEM-AP descriptor referenced by device, if any.
+     */
+    void BuildComDevice(SDMDeviceDescriptor& device, SDMDeviceDescriptor& memAp) const;
+
+    /**
+     * \brief Describe the configured transfer settings as probe capabilities.
+     */
+    void GetProbeCapabilities(SDMProbeCapabilities& capabilities) const;
+
+    /**
+     * \brief Adapt the transfer settings to the limits reported by the debugger.
+     *
+     * Only restricts the configuration: the smaller of the configured and reported access
+     * list lengths applies, polls are made by the host if the probe does not perform them,
+     * and hardware blocking writes are chunked by the TX FIFO free level if the probe does
+     * not tolerate DBR stalls.
+     */
+    void ApplyProbeCapabilities(const SDMProbeCapabilities& capabilities);
+
+private:
+    SDMReturnCode locateAndParse(const SDMOpenParameters* params);
+    bool apply(const std::string& key, const std::string& value, const std::string& directory);
+};
+
+#endif // SDM_RUNTIME_CONFIG_H
@@ -0,0 +1,161 @@
+// sdm_timeline.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "sdm_timeline.h"
+#include "psa_adac_debug.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+#define ENTITY_NAME "SDMTimeline"
+
+namespace
+{
+    uint64_t nowNs()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // small stable ids, easier to read in the viewer than native thread ids
+    uint32_t currentThreadId()
+    {
+        static std::atomic<uint32_t> nextId(1);
+        static thread_local uint32_t id = 0;
+        if (id == 0)
+        {
+            id = nextId.fetch_add(1, std::memory_order_relaxed);
+        }
+        return id;
+    }
+
+    void writeJsonString(FILE* file, const std::string& text)
+    {
+        fputc('"', file);
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+            {
+                fputc('\\', file);
+                fputc(c, file);
+            }
+            else if ((unsigned char)c < 0x20)
+            {
+                fprintf(file, "\\u%04x", (unsigned)(unsigned char)c);
+            }
+            else
+            {
+                fputc(c, file);
+            }
+        }
+        fputc('"', file);
+    }
+}
+
+ArenaPtr<SDMTimeline> SDMTimeline::Create(const std::string& path, SessionArena* arena)
+{
+    return ArenaNew<SDMTimeline>(arena, path, arena);
+}
+
+SDMTimeline::SDMTimeline(const std::string& path, SessionArena* arena) :
+    mPath(path),
+    mStartNs(nowNs()),
+    mEvents(ArenaAllocator<Event>(arena)),
+    mWritten(false)
+{
+    // a typical session is a few thousand driver events
+    try
+    {
+        mEvents.reserve(4096);
+    }
+    catch (const std::bad_alloc&)
+    {
+    }
+}
+
+SDMTimeline::~SDMTimeline()
+{
+    if (!mWritten)
+    {
+        Write();
+    }
+}
+
+void SDMTimeline::Begin(SDMTimeline* timeline, const std::string& name, const char* category)
+{
+    if (timeline != NULL)
+    {
+        timeline->add(name, category, 'B');
+    }
+}
+
+void SDMTimeline::End(SDMTimeline* timeline, const std::string& name, const char* category)
+{
+    if (timeline != NULL)
+    {
+        timeline->add(name, category, 'E');
+    }
+}
+
+void SDMTimeline::add(const std::string& name, const char* category, char phase)
+{
+    uint64_t timestampNs = nowNs();
+    uint32_t threadId = currentThreadId();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    try
+    {
+        mEvents.push_back(Event { name, category, phase, threadId, timestampNs });
+    }
+    catch (const std::bad_alloc&)
+    {
+        // the timeline is diagnostic only, never fail the session
+    }
+}
+
+size_t SDMTimeline::EventCount() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEvents.size();
+}
+
+SDMReturnCode SDMTimeline::Write()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mWritten = true;
+
+    FILE* file = fopen(mPath.c_str(), "w");
+    if (file == NULL)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to create %s\n", mPath.c_str());
+        return SDMReturnCode_IOError;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"Secure Debug Manager\"}}");
+    for (const Event& event : mEvents)
+    {
+        // timestamps are in microseconds
+        fprintf(file, ",\n{\"name\":");
+        writeJsonString(file, event.name);
+        fprintf(file, ",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                event.category, event.phase, (double)(event.timestampNs - mStartNs) / 1000.0, (unsigned)event.threadId);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool failed = ferror(file) != 0;
+    failed |= fclose(file) != 0;
+    if (failed)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Failed to write %s\n", mPath.c_str());
+        return SDMReturnCode_IOError;
+    }
+
+    PSA_ADAC_LOG_INFO(ENTITY_NAME, "wrote %zu events to %s\n", mEvents.size(), mPath.c_str());
+    return SDMReturnCode_Success;
+}
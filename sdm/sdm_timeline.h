@@ -0,0 +1,181 @@
+// sdm_timeline.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Session timelines in the Chrome trace-event format.
+ *
+ * Records begin and end events for the phases of a session, with the thread they ran on,
+ * and writes them as a trace-event JSON file that can be opened in chrome://tracing or
+ * https://ui.perfetto.dev. Events are buffered in memory and written when the session ends.
+ *
+ * Every SDMTimeline method, and SDMTimelineScope, accept a NULL timeline and do nothing,
+ * so call sites need no checks when timelines are disabled.
+ */
+
+#ifndef SDM_TIMELINE_H
+#define SDM_TIMELINE_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "session_arena.h"
+
+/**
+ * \brief Environment variable holding the timeline file path.
+ *
+ * Takes precedence over the timeline_file configuration key.
+ */
+#define SDM_ENV_TIMELINE_FILE "SDM_TIMELINE_FILE"
+
+/* Categories, used to filter events in the viewer */
+#define SDM_TIMELINE_SESSION "session"
+#define SDM_TIMELINE_DRIVER  "driver"
+
+class SDMTimeline
+{
+public:
+    /**
+     * \brief Start a timeline, written to path by {@link Write}, or on destruction.
+     *
+     * @param[in] arena Session arena for the timeline and its events, NULL for the heap.
+     * @return NULL if out of memory.
+     */
+    static ArenaPtr<SDMTimeline> Create(const std::string& path, SessionArena* arena = NULL);
+
+    ~SDMTimeline();
+
+    static void Begin(SDMTimeline* timeline, const std::string& name, const char* category);
+    static void End(SDMTimeline* timeline, const std::string& name, const char* category);
+
+    /**
+     * \brief Write every event recorded so far.
+     *
+     * @return SDMReturnCode_IOError if the file cannot be written.
+     */
+    SDMReturnCode Write();
+
+    size_t EventCount() const;
+
+private:
+    struct Event
+    {
+        std::string name;
+        const char* category;
+        char phase;
+        uint32_t threadId;
+        uint64_t timestampNs;
+    };
+
+    template <class T, class... Args>
+    friend ArenaPtr<T> ArenaNew(SessionArena* arena, Args&&... args);
+
+    SDMTimeline(const std::string& path, SessionArena* arena);
+    void add(const std::string& name, const char* category, char phase);
+
+    std::string mPath;
+    uint64_t mStartNs;
+    mutable std::mutex mMutex;
+    ArenaVector<Event> mEvents;
+    bool mWritten;
+};
+
+/**
+ * \brief Begin event on construction, end event on destruction.
+ *
+ * Constructed without a name, the scope records a sequence of phases with {@link Next},
+ * which suits functions that leave through goto bail.
+ */
+class SDMTimelineScope
+{
+public:
+    SDMTimelineScope(SDMTimeline* timeline, const char* category) :
+        mTimeline(timeline),
+        mCategory(category),
+        mActive(false)
+    {
+    }
+
+    SDMTimelineScope(SDMTimeline* timeline, const char* name, const char* category) :
+        mTimeline(timeline),
+        mCategory(category),
+        mActive(false)
+    {
+        Next(name);
+    }
+
+    SDMTimelineScope(SDMTimeline* timeline, const std::string& name, const char* category) :
+        mTimeline(timeline),
+        mCategory(category),
+        mActive(false)
+    {
+        Next(name);
+    }
+
+    ~SDMTimelineScope()
+    {
+        End();
+    }
+
+    /**
+     * \brief End the current phase, if any, and begin name.
+     */
+    void Next(const char* name)
+    {
+        // no string is built when timelines are disabled
+        if (mTimeline != NULL)
+        {
+            Next(std::string(name));
+        }
+    }
+
+    /**
+     * \brief As {@link Next}, for numbered phases: "name index".
+     */
+    void Next(const char* name, size_t index)
+    {
+        if (mTimeline != NULL)
+        {
+            Next(std::string(name) + " " + std::to_string(index));
+        }
+    }
+
+    void Next(const std::string& name)
+    {
+        if (mTimeline != NULL)
+        {
+            End();
+            mName = name;
+            SDMTimeline::Begin(mTimeline, mName, mCategory);
+            mActive = true;
+        }
+    }
+
+    void End()
+    {
+        if (mActive)
+        {
+            SDMTimeline::End(mTimeline, mName, mCategory);
+            mActive = false;
+        }
+    }
+
+private:
+    SDMTimelineScope(const SDMTimelineScope&);
+    SDMTimelineScope& operator=(const SDMTimelineScope&);
+
+    SDMTimeline* mTimeline;
+    std::string mName;
+    const char* mCategory;
+    bool mActive;
+};
+
+#endif // SDM_TIMELINE_H
@@ -5,98 +5,232 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <new>
 
 #include "secure_debug_manager.h"
 #include "secure_debug_manager_impl.h"
+#include "sdm_extensions.h"
+#include "sdm_log.h"
+#include "persistent_key_store.h"
+#include "psa_crypto_context.h"
+#include "session_arena.h"
+#include "session_resources.h"
 
 namespace
 {
-    std::unique_ptr<SecureDebugManagerImpl> gSDMImpl = 0;
+    // Open sessions, one per target. Each session uses its own callbacks and refcon, so
+    // sessions may run concurrently on different threads. Calls on a single handle must
+    // not overlap.
+    std::mutex gSessionsMutex;
+
+    // A session and the arena holding its allocations, released in one step when the
+    // entry is erased. The arena is declared first, so it outlives the session.
+    struct Session
+    {
+        Session(const SDMAllocator* allocator, size_t blockSize) :
+            arena(allocator, blockSize)
+        {
+        }
+
+        SessionArena arena;
+        ArenaPtr<SecureDebugManagerImpl> impl;
+    };
+
+    std::map<SDMHandle, std::unique_ptr<Session>> gSessions;
+
+    SDMReturnCode findSession(SDMHandle handle, SecureDebugManagerImpl*& session)
+    {
+        std::lock_guard<std::mutex> lock(gSessionsMutex);
+        if (gSessions.empty())
+        {
+            // SDM not open
+            return SDMReturnCode_InternalError;
+        }
+
+        auto found = gSessions.find(handle);
+        if (found == gSessions.end())
+        {
+            // invalid handle
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        session = found->second->impl.get();
+        return SDMReturnCode_Success;
+    }
 }
 
 SDMReturnCode SDMOpen(SDMHandle *handle, const SDMOpenParameters* params)
 {
-    if (params == 0)
+    return SDMOpenEx(handle, params, NULL);
+}
+
+SDMReturnCode SDMOpenEx(SDMHandle *handle, const SDMOpenParameters* params, const SDMOpenExtensions *extensions)
+{
+    if (params == 0 || handle == 0)
     {
         return SDMReturnCode_InvalidArgument;
     }
 
-    if (gSDMImpl != 0)
+    const SDMAllocator* allocator = SDM_EXT_HAS_FIELD(extensions, allocator) ? extensions->allocator : NULL;
+    size_t arenaBlockSize = SDM_EXT_HAS_FIELD(extensions, arenaBlockSize) ? extensions->arenaBlockSize : 0;
+
+    std::unique_ptr<Session> session(new (std::nothrow) Session(allocator, arenaBlockSize));
+    if (session == 0)
     {
-        //SDM already open
         return SDMReturnCode_InternalError;
     }
 
-    gSDMImpl.reset(new SecureDebugManagerImpl());
-    if (gSDMImpl == 0)
+    session->impl = ArenaNew<SecureDebugManagerImpl>(&session->arena, &session->arena);
+    if (session->impl == 0)
     {
         return SDMReturnCode_InternalError;
     }
 
-    SDMReturnCode ret = gSDMImpl->SDMOpen(params);
+    SDMReturnCode ret = session->impl->SDMOpen(params, extensions);
     if (ret != SDMReturnCode_Success)
     {
-        gSDMImpl.reset();
         return ret;
     }
 
-    *handle = (SDMHandle)gSDMImpl.get();
+    SDMHandle sessionHandle = (SDMHandle)session->impl.get();
+    try
+    {
+        std::lock_guard<std::mutex> lock(gSessionsMutex);
+        gSessions[sessionHandle] = std::move(session);
+    }
+    catch (const std::bad_alloc&)
+    {
+        if (session)
+        {
+            session->impl->SDMClose();
+        }
+        return SDMReturnCode_InternalError;
+    }
+
+    *handle = sessionHandle;
 
     return ret;
 }
 
 SDMReturnCode SDMAuthenticate(SDMHandle handle, const SDMAuthenticateParameters *params)
 {
-    if (gSDMImpl == 0)
+    SecureDebugManagerImpl* session = 0;
+    SDMReturnCode found = findSession(handle, session);
+    if (found != SDMReturnCode_Success)
     {
-        // SDM not open
-        return SDMReturnCode_InternalError;
+        return found;
     }
 
-    if ((SDMHandle)handle != (SDMHandle)gSDMImpl.get())
+    return session->SDMAuthenticate(params);
+}
+
+SDMReturnCode SDMResumeBoot(SDMHandle handle)
+{
+    SecureDebugManagerImpl* session = 0;
+    SDMReturnCode found = findSession(handle, session);
+    if (found != SDMReturnCode_Success)
     {
-        // invalid handle
-        return SDMReturnCode_InvalidArgument;
+        return found;
     }
 
-    return gSDMImpl->SDMAuthenticate(params);
+    return session->SDMResumeBoot();
 }
 
-SDMReturnCode SDMResumeBoot(SDMHandle handle)
+
+SDMReturnCode SDMClose(SDMHandle handle)
 {
-    if (gSDMImpl == 0)
+    SecureDebugManagerImpl* session = 0;
+    SDMReturnCode found = findSession(handle, session);
+    if (found != SDMReturnCode_Success)
     {
-        // SDM not open
-        return SDMReturnCode_InternalError;
+        return found;
+    }
+
+    SDMReturnCode res = session->SDMClose();
+
+    bool lastSession = false;
+    {
+        std::lock_guard<std::mutex> lock(gSessionsMutex);
+        gSessions.erase(handle);
+        lastSession = gSessions.empty();
     }
 
-    if ((SDMHandle)handle != (SDMHandle)gSDMImpl.get())
+    if (lastSession)
+    {
+        // write out pending log records and stop the log thread while the host still owns the library
+        SDMLog::Shutdown();
+    }
+
+    return res;
+}
+
+SDMReturnCode SDMCancel(SDMHandle handle)
+{
+    // held while flagging the session, so a concurrent SDMClose cannot free it
+    std::lock_guard<std::mutex> lock(gSessionsMutex);
+
+    auto found = gSessions.find(handle);
+    if (found == gSessions.end())
     {
-        // invalid handle
         return SDMReturnCode_InvalidArgument;
     }
 
-    return gSDMImpl->SDMResumeBoot();
+    found->second->impl->Cancel();
+    return SDMReturnCode_Success;
 }
 
+SDMReturnCode SDMProvisionKey(const char *privateKeyFile, uint32_t keyId)
+{
+    if (privateKeyFile == 0)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    if (PsaCryptoContext::Acquire() < 0)
+    {
+        return SDMReturnCode_InternalError;
+    }
 
-SDMReturnCode SDMClose(SDMHandle handle)
+    std::unique_lock<std::mutex> cryptoLock = PsaCryptoContext::Lock();
+    return PersistentKeyStore::Provision(privateKeyFile, keyId);
+}
+
+SDMReturnCode SDMDeleteKey(uint32_t keyId)
 {
-    if (gSDMImpl == 0)
+    if (PsaCryptoContext::Acquire() < 0)
     {
-        // SDM not open
         return SDMReturnCode_InternalError;
     }
 
-    if ((SDMHandle)handle != (SDMHandle)gSDMImpl.get())
+    std::unique_lock<std::mutex> cryptoLock = PsaCryptoContext::Lock();
+    return PersistentKeyStore::Delete(keyId);
+}
+
+SDMReturnCode SDMGetResourceUsage(SDMResourceUsage *usage)
+{
+    if (usage == 0 || usage->size < sizeof(usage->size))
     {
-        // invalid handle
         return SDMReturnCode_InvalidArgument;
     }
 
-    SDMReturnCode res = gSDMImpl->SDMClose();
-    gSDMImpl.reset();
+    SDMResourceUsage current;
+    memset(&current, 0, sizeof(current));
+    {
+        std::lock_guard<std::mutex> lock(gSessionsMutex);
+        current.openSessions = gSessions.size();
+    }
+    current.sessionKeys = SessionResources::LiveKeys();
+    current.sessionBuffers = SessionResources::LiveBuffers();
+    current.psaKeySlotsInUse = PsaCryptoContext::KeySlotsInUse();
+    current.arenaBytes = SessionArena::TotalBytesReserved();
 
-    return res;
+    // clients built against an older header get the fields they know about
+    size_t size = usage->size < sizeof(current) ? usage->size : sizeof(current);
+    current.size = usage->size;
+    memcpy(usage, &current, size);
+
+    return SDMReturnCode_Success;
 }
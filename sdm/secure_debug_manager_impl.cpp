@@ -9,7 +9,10 @@
 #include "secure_debug_manager_impl.h"
 #include "secure_debug_manager.h"
 #include "ext_com_port_driver.h"
-#include "sdm_config.h"
+#include "psa_crypto_context.h"
+#include "persistent_key_store.h"
+#include "certificate_frame_cache.h"
+#include "sdm_log.h"
 
 #include "psa_adac_sdm.h"
 #include "psa_adac_debug.h"
@@ -18,6 +21,11 @@
 #include <stdlib.h>
 #include <vector>
 #include <regex>
+#include <chrono>
+#include <future>
+#include <utility>
+#include <mutex>
+#include <system_error>
 
 #define ENTITY_NAME     "SDM"
 #define SD_RESPONSE_LENGTH  6
@@ -26,10 +34,17 @@ static const uint8_t PROTOCOL[] = { 0x50, 0x53, 0x41, 0x44, 0x42, 0x47 };
 
 namespace {
 
+    struct SignedToken
+    {
+        int result;
+        PsaAdacBuffer token;
+        size_t size;
+    };
+
     SDMReturnCode CheckProtocol(uint8_t *idResBuff, const uint8_t *prot_id)
     {
-        PSA_ADAC_LOG_DUMP(ENTITY_NAME, "idResBuff", idResBuff, SD_RESPONSE_LENGTH);
-        PSA_ADAC_LOG_DUMP(ENTITY_NAME, "prot_id", prot_id, SD_RESPONSE_LENGTH);
+        SDM_LOG_DUMP(ENTITY_NAME, "idResBuff", idResBuff, SD_RESPONSE_LENGTH);
+        SDM_LOG_DUMP(ENTITY_NAME, "prot_id", prot_id, SD_RESPONSE_LENGTH);
 
         // check if protocol id matches 
         if (memcmp(prot_id, idResBuff, SD_RESPONSE_LENGTH) != 0)
@@ -58,7 +73,17 @@ namespace {
  *
  ******************************************************************************************************/
 
-SecureDebugManagerImpl::SecureDebugManagerImpl() : mOpen(false)
+SecureDebugManagerImpl::SecureDebugManagerImpl(SessionArena* arena) :
+    mArena(arena),
+    mMsgBuffer(ArenaAllocator<uint8_t>(arena)),
+    mPrivateKeyId(0),
+    mTrustChain(ArenaAllocator<uint8_t>(arena)),
+    mExtComPortDriver(NULL, ArenaDelete<ExternalComPortDriver>(arena)),
+    mLinkResult(SDMReturnCode_Success),
+    mOpen(false),
+    mCancelled(false),
+    mCancelRequested(NULL),
+    mCancelRefcon(NULL)
 {
 }
 
@@ -66,54 +91,125 @@ SecureDebugManagerImpl::~SecureDebugManagerImpl()
 {
 }
 
-SDMReturnCode SecureDebugManagerImpl::SDMOpen(const SDMOpenParameters* params)
+SDMReturnCode SecureDebugManagerImpl::SDMOpen(const SDMOpenParameters* params, const SDMOpenExtensions* extensions)
 {
     if (mOpen)
     {
         return SDMReturnCode_InternalError;
     }
 
+    SDMReturnCode res = openSession(params, extensions);
+    if (res != SDMReturnCode_Success)
+    {
+        // there will be no SDMClose, keep the timeline of the failed attempt
+        finishTimeline();
+    }
+
+    return res;
+}
+
+SDMReturnCode SecureDebugManagerImpl::openSession(const SDMOpenParameters* params, const SDMOpenExtensions* extensions)
+{
     if (params == 0)
     {
         return SDMReturnCode_InvalidArgument;
     }
 
-#ifdef SDM_CONFIG_COM_DEVICE_MEMAP_ADDRESS
-    SDMDeviceDescriptor comPortDeviceMemAp;
-    comPortDeviceMemAp.deviceType = SDMDeviceType_ArmADI_AP;
-    comPortDeviceMemAp.armAP.dpIndex = SDM_CONFIG_COM_DEVICE_DP_INDEX;
-    comPortDeviceMemAp.armAP.address = SDM_CONFIG_COM_DEVICE_MEMAP_ADDRESS;
-#endif
+    // build defaults, overridden by the board configuration file if present
+    mConfig = SDMRuntimeConfig();
+    SDMReturnCode res = mConfig.Load(params);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+
+    if (mConfig.logLevel >= 0)
+    {
+        SDMLog::SetLevel(mConfig.logLevel);
+    }
+
+    try
+    {
+        mMsgBuffer.assign(BUFFER_SIZE, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
 
     SDMDeviceDescriptor comPortDevice;
-    comPortDevice.deviceType = SDM_CONFIG_COM_DEVICE_TYPE;
-    if (comPortDevice.deviceType == SDMDeviceType_ArmADI_AP)
+    SDMDeviceDescriptor comPortDeviceMemAp;
+    mConfig.BuildComDevice(comPortDevice, comPortDeviceMemAp);
+
+    mExtComPortDriver.reset();
+    mTraceRecorder.reset();
+    mTimeline.reset();
+
+    if (!mConfig.timelineFile.empty())
     {
-        comPortDevice.armAP.dpIndex = SDM_CONFIG_COM_DEVICE_DP_INDEX;
-        comPortDevice.armAP.address = SDM_CONFIG_COM_DEVICE_ADDRESS;
+        mTimeline = SDMTimeline::Create(mConfig.timelineFile, mArena);
     }
-    else
+    SDMTimelineScope openScope(mTimeline.get(), "open", SDM_TIMELINE_SESSION);
+
+    // optionally record every register access for offline replay
+    SDMRegisterAccessCallback registerAccess = params->callbacks->registerAccess;
+    if (!mConfig.registerTraceFile.empty())
+    {
+        mTraceRecorder = RegisterAccessTraceRecorder::Create(mConfig.registerTraceFile.c_str(), params->debugArchitecture, mArena);
+        if (!mTraceRecorder)
+        {
+            return SDMReturnCode_InvalidArgument;
+        }
+        registerAccess = mTraceRecorder->Wrap(registerAccess);
+
+        // pump reads interleave with the session by timing, which replay cannot reproduce
+        mConfig.driver.rxPump = false;
+    }
+
+    // the pump and a background link make callbacks from library threads
+    bool callerThreadCallbacks = SDM_EXT_HAS_FIELD(extensions, callerThreadCallbacks) && extensions->callerThreadCallbacks != 0;
+    if (callerThreadCallbacks)
+    {
+        mConfig.driver.rxPump = false;
+    }
+
+    // size the transfers to the debugger's probe
+    if (SDM_EXT_HAS_FIELD(extensions, queryProbeCapabilities) && extensions->queryProbeCapabilities != NULL)
     {
-        comPortDevice.armCoreSightComponent.dpIndex = SDM_CONFIG_COM_DEVICE_DP_INDEX;
-        comPortDevice.armCoreSightComponent.baseAddress = SDM_CONFIG_COM_DEVICE_ADDRESS;
-#ifdef SDM_CONFIG_COM_DEVICE_MEMAP_ADDRESS
-        comPortDevice.armCoreSightComponent.memAp = &comPortDeviceMemAp;
-#else
-        comPortDevice.armCoreSightComponent.memAp = NULL;
-#endif
+        SDMProbeCapabilities capabilities;
+        mConfig.GetProbeCapabilities(capabilities);
+        res = extensions->queryProbeCapabilities(&capabilities, params->refcon);
+        if (res == SDMReturnCode_Success)
+        {
+            mConfig.ApplyProbeCapabilities(capabilities);
+            SDM_LOG_DEBUG(ENTITY_NAME, "probe capabilities: max access list length %zu, poll %d, DBR stall %d\n",
+                          capabilities.maxAccessListLength, capabilities.pollSupported, capabilities.dbrStallTolerated);
+        }
+        else
+        {
+            SDM_LOG_WARN(ENTITY_NAME, "probe capabilities query failed with code 0x%x, using the configured transfers\n", res);
+        }
     }
 
-    mExtComPortDriver.reset(new ExternalComPortDriver(comPortDevice, params->debugArchitecture, params->callbacks->registerAccess, params->callbacks->resetStart, params->callbacks->resetFinish, params->refcon));
+    mExtComPortDriver = ArenaNew<ExternalComPortDriver>(mArena, comPortDevice, params->debugArchitecture, registerAccess, params->callbacks->resetStart, params->callbacks->resetFinish, params->refcon, mConfig.driver, mArena);
     if (mExtComPortDriver == 0)
     {
         return SDMReturnCode_InternalError;
     }
+    mExtComPortDriver->SetTimeline(mTimeline.get());
 
-    // initialize mbedtools psa crypto api
-    if (psa_adac_init() < 0)
+    if (SDM_EXT_HAS_FIELD(extensions, cancelRequested))
     {
-        return SDMReturnCode_InternalError;
-    } 
+        mCancelRequested = extensions->cancelRequested;
+        mCancelRefcon = params->refcon;
+    }
+    mExtComPortDriver->SetCancelCallback([this]() { return cancelRequested(); });
+
+    // the trace recorder only wraps registerAccess, keep every access on it while recording
+    if (SDM_EXT_HAS_FIELD(extensions, registerAccessVector) && extensions->registerAccessVector != NULL && !mTraceRecorder)
+    {
+        mExtComPortDriver->SetRegisterAccessListsCallback(extensions->registerAccessVector);
+    }
 
     mSdmOpenParams.version = params->version;
     mSdmOpenParams.debugArchitecture = params->debugArchitecture;
@@ -125,10 +221,103 @@ SDMReturnCode SecureDebugManagerImpl::SDMOpen(const SDMOpenParameters* params)
     mSdmOpenParams.locales = params->locales;
     mSdmOpenParams.connectMode = params->connectMode;
 
+    // Record credentials supplied non-interactively, the extensions take precedence over the environment,
+    // which takes precedence over the configuration file
+    const char *envKeyFile = getenv(SDM_ENV_PRIVATE_KEY_FILE);
+    const char *envChainFile = getenv(SDM_ENV_TRUST_CHAIN_FILE);
+    mPrivateKeyFile = envKeyFile ? userInputStringTrim(envKeyFile) : mConfig.privateKeyFile;
+    mTrustChainFile = envChainFile ? userInputStringTrim(envChainFile) : mConfig.trustChainFile;
+
+    if (SDM_EXT_HAS_FIELD(extensions, privateKeyFile) && extensions->privateKeyFile != NULL)
+    {
+        mPrivateKeyFile = userInputStringTrim(extensions->privateKeyFile);
+    }
+
+    const char *envKeyId = getenv(SDM_ENV_PRIVATE_KEY_ID);
+    mPrivateKeyId = envKeyId ? (uint32_t)strtoul(envKeyId, NULL, 0) : mConfig.privateKeyId;
+    if (SDM_EXT_HAS_FIELD(extensions, privateKeyId) && extensions->privateKeyId != 0)
+    {
+        mPrivateKeyId = extensions->privateKeyId;
+    }
+
+    if (SDM_EXT_HAS_FIELD(extensions, trustChainFile) && extensions->trustChainFile != NULL)
+    {
+        mTrustChainFile = userInputStringTrim(extensions->trustChainFile);
+    }
+
+    if (SDM_EXT_HAS_FIELD(extensions, trustChainSize) && extensions->trustChain != NULL && extensions->trustChainSize > 0)
+    {
+        try
+        {
+            mTrustChain.assign(extensions->trustChain, extensions->trustChain + extensions->trustChainSize);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return SDMReturnCode_InternalError;
+        }
+    }
+
+    const char *envBundleFile = getenv(SDM_ENV_AUTH_BUNDLE_FILE);
+    mBundleFile = envBundleFile ? userInputStringTrim(envBundleFile) : mConfig.authenticationBundleFile;
+    if (SDM_EXT_HAS_FIELD(extensions, authenticationBundleFile) && extensions->authenticationBundleFile != NULL)
+    {
+        mBundleFile = userInputStringTrim(extensions->authenticationBundleFile);
+    }
+
+    SDMLazyOpenMode lazyOpen = mConfig.lazyOpen;
+    if (SDM_EXT_HAS_FIELD(extensions, lazyOpen) && extensions->lazyOpen != SDMLazyOpen_Config)
+    {
+        lazyOpen = extensions->lazyOpen;
+    }
+    if (callerThreadCallbacks && lazyOpen == SDMLazyOpen_Background)
+    {
+        lazyOpen = SDMLazyOpen_FirstUse;
+    }
+
+    mLinkResult = SDMReturnCode_Success;
+    mLink = std::future<SDMReturnCode>();
+    if (lazyOpen == SDMLazyOpen_FirstUse || lazyOpen == SDMLazyOpen_Background)
+    {
+        // joined by the first operation that needs the link, see joinLink
+        auto establish = [this]() { return establishLink(); };
+        try
+        {
+            mLink = std::async(lazyOpen == SDMLazyOpen_Background ? std::launch::async : std::launch::deferred, establish);
+        }
+        catch (const std::system_error&)
+        {
+            // no thread available, establish the link on first use
+            mLink = std::async(std::launch::deferred, establish);
+        }
+    }
+    else
+    {
+        res = establishLink();
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+    }
+
+    mOpen = true;
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SecureDebugManagerImpl::establishLink()
+{
+    SDMTimelineScope linkScope(mTimeline.get(), "link", SDM_TIMELINE_SESSION);
+
+    // initialize mbedtools psa crypto api, once per process
+    if (PsaCryptoContext::Acquire() < 0)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
     // SDMOpen calls the EComPort_Init.
     // Upon fail, exit with the fail code.
     uint8_t idResBuff[SD_RESPONSE_LENGTH];
-    SDMReturnCode res  = mExtComPortDriver->EComPort_Init(SDM_CONFIG_REMOTE_RESET_TYPE, idResBuff, SD_RESPONSE_LENGTH);
+    SDMReturnCode res = mExtComPortDriver->EComPort_Init(mConfig.remoteResetType, idResBuff, SD_RESPONSE_LENGTH);
     if (res != SDMReturnCode_Success)
     {
         PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComPort_Init failed [0x%04x]\n", res);
@@ -139,15 +328,26 @@ SDMReturnCode SecureDebugManagerImpl::SDMOpen(const SDMOpenParameters* params)
     // This is used to detect what high level protocol the remote system supports.
     // Verify the IDA response value to be as expected,
     // otherwise fail and return with a proper error code (unsupported remote platform protocol ID).
-    res = CheckProtocol(idResBuff, PROTOCOL);
-    if (res != SDMReturnCode_Success)
+    return CheckProtocol(idResBuff, PROTOCOL);
+}
+
+SDMReturnCode SecureDebugManagerImpl::joinLink(bool establish)
+{
+    if (mLink.valid())
     {
-        return res;
+        if (!establish && mLink.wait_for(std::chrono::seconds(0)) == std::future_status::deferred)
+        {
+            // never needed, not worth establishing just to close it
+            mLink = std::future<SDMReturnCode>();
+            mLinkResult = SDMReturnCode_RequestFailed;
+        }
+        else
+        {
+            mLinkResult = mLink.get();
+        }
     }
 
-    mOpen = true;
-
-    return SDMReturnCode_Success;
+    return mLinkResult;
 }
 
 SDMReturnCode SecureDebugManagerImpl::SDMAuthenticate(const SDMAuthenticateParameters *params)
@@ -159,14 +359,29 @@ SDMReturnCode SecureDebugManagerImpl::SDMAuthenticate(const SDMAuthenticateParam
         return SDMReturnCode_InternalError;
     }
 
+    // lazy open, see SDMLazyOpenMode
+    res = joinLink(true);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+
+    // the RX pump drains responses while this call signs and sends, and parks before it returns
+    ECPDRxPumpHold pumpHold(mExtComPortDriver.get());
+
+    SDMTimelineScope authScope(mTimeline.get(), "authenticate", SDM_TIMELINE_SESSION);
+    SDMTimelineScope phase(mTimeline.get(), SDM_TIMELINE_SESSION);
+
     // load private key and trust chain
     updateProgress("Loading credentials", 0);
+    phase.Next("credential load");
 
-    std::unique_ptr<uint8_t> chain;
+    // destroyed on every return, after the signing worker below has been joined
+    PsaAdacBuffer chain;
     size_t chainSize = 0;
     uint8_t signature_type = 0;
-    psa_key_handle_t handle = 0;
-    res = loadCredentials(chain, chainSize, signature_type, handle);
+    PsaKey key;
+    res = loadCredentials(chain, chainSize, signature_type, key);
     if (res != SDMReturnCode_Success)
     {
         return SDMReturnCode_InternalError;
@@ -174,6 +389,7 @@ SDMReturnCode SecureDebugManagerImpl::SDMAuthenticate(const SDMAuthenticateParam
 
     // start authentication
     updateProgress("Sending challenge request", 20);
+    phase.Next("auth start");
 
     res = sendAuthStartCmdRequest();
     if (res != SDMReturnCode_Success)
@@ -183,6 +399,7 @@ SDMReturnCode SecureDebugManagerImpl::SDMAuthenticate(const SDMAuthenticateParam
 
     // receive challenge
     updateProgress("Receiving challenge", 30);
+    phase.Next("challenge receive");
 
     psa_auth_challenge_t challenge;
     res = receiveAuthStartCmdResponse(&challenge);
@@ -191,64 +408,95 @@ SDMReturnCode SecureDebugManagerImpl::SDMAuthenticate(const SDMAuthenticateParam
         return SDMReturnCode_InternalError;
     }
 
-    // sign token
+    // sign token on a worker thread, overlapping with the certificate upload below
     updateProgress("Signing token", 40);
 
-    size_t tokenSize = 0;
-    uint8_t *token = 0;
-    int adac_res = psa_adac_sign_token(challenge.challenge_vector, sizeof(challenge.challenge_vector), signature_type, NULL, 0, &token, &tokenSize, NULL, handle, NULL, 0);
-    if (adac_res < 0)
+    SDMTimeline* timeline = mTimeline.get();
+    psa_key_handle_t handle = key.Get();
+    auto signToken = [&challenge, signature_type, handle, timeline]()
     {
-        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Error signing token %d\n", adac_res);
-        return SDMReturnCode_InternalError;
+        SDMTimelineScope signScope(timeline, "signing", SDM_TIMELINE_SESSION);
+        SignedToken signedToken = { 0, PsaAdacBuffer(), 0 };
+        uint8_t *token = NULL;
+        std::unique_lock<std::mutex> cryptoLock = PsaCryptoContext::Lock();
+        signedToken.result = psa_adac_sign_token(challenge.challenge_vector, sizeof(challenge.challenge_vector), signature_type, NULL, 0, &token, &signedToken.size, NULL, handle, NULL, 0);
+        signedToken.token = AdoptPsaAdacBuffer(token);
+        return signedToken;
+    };
+
+    std::future<SignedToken> tokenFuture;
+    try
+    {
+        tokenFuture = std::async(std::launch::async, signToken);
+    }
+    catch (const std::system_error&)
+    {
+        // no thread available, sign when the token is needed
+        tokenFuture = std::async(std::launch::deferred, signToken);
     }
 
-    // parse trust chain
+    // parse trust chain and encode the certificate requests, unless already cached from a previous session
     updateProgress("Parsing trust chain", 50);
+    phase.Next("certificate frames");
 
-    psa_tlv_t *exts[MAX_EXTENSIONS];
-    size_t exts_count = 0;
-    adac_res = split_tlv_static((uint32_t *)chain.get(), chainSize, exts, MAX_EXTENSIONS, &exts_count);
-    if (adac_res < 0)
+    ArenaVector<CertificateFrameView> certificateFrames((ArenaAllocator<CertificateFrameView>(mArena)));
+    std::shared_ptr<const CertificateFrameCache::Frames> cachedFrames;
+    try
+    {
+        res = loadCertificateFrames(chain.get(), chainSize, certificateFrames, cachedFrames);
+    }
+    catch (const std::bad_alloc&)
+    {
+        // the frame lists come from the session arena
+        res = SDMReturnCode_InternalError;
+    }
+    if (res != SDMReturnCode_Success)
     {
-        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Error parsing trust chain %d\n", adac_res);
         return SDMReturnCode_InternalError;
     }
 
-    PSA_ADAC_LOG_INFO(ENTITY_NAME, "Found %zu certificates\n", exts_count);
-
     // sending challenge response
     updateProgress("Sending challenge response", 60);
 
-    for (size_t i = 0; i < exts_count; i++) 
+    for (size_t i = 0; i < certificateFrames.size(); i++)
     {
-        if (exts[i]->type_id == PSA_BINARY_CRT)
+        // sending certificate
+        phase.Next("certificate TX", i + 1);
+        res = requestFrameSend(certificateFrames[i]);
+        if (res != SDMReturnCode_Success)
         {
-            // sending certificate
-            res = sendAuthResponseCmdRequest((uint8_t *)exts[i], exts[i]->length_in_bytes + sizeof(psa_tlv_t));
-            if (res != SDMReturnCode_Success)
-            {
-                return SDMReturnCode_InternalError;
-            }
+            return SDMReturnCode_InternalError;
+        }
 
-            // receiving authentication response
-            res = receiveAuthResponseCmdResponse();
-            if (res != SDMReturnCode_Success)
-            {
-                return SDMReturnCode_InternalError;
-            }
+        // receiving authentication response
+        phase.Next("certificate ack", i + 1);
+        res = receiveAuthResponseCmdResponse();
+        if (res != SDMReturnCode_Success)
+        {
+            return SDMReturnCode_InternalError;
         }
     }
 
+    // join the signing worker before sending the token
+    phase.Next("signing wait");
+    SignedToken signedToken = tokenFuture.get();
+    if (signedToken.result < 0)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Error signing token %d\n", signedToken.result);
+        return SDMReturnCode_InternalError;
+    }
+
     // receiving token_authentication response
     updateProgress("Receiving token authentication status", 90);
+    phase.Next("token TX");
 
-    res = sendAuthResponseCmdRequest((uint8_t *)token, tokenSize);
+    res = sendAuthResponseCmdRequest(signedToken.token.get(), signedToken.size);
     if (res != SDMReturnCode_Success)
     {
         return SDMReturnCode_InternalError;
     }
 
+    phase.Next("token ack");
     res = receiveAuthResponseCmdResponse();
     if (res != SDMReturnCode_Success)
     {
@@ -275,24 +523,35 @@ SDMReturnCode SecureDebugManagerImpl::SDMClose()
         return SDMReturnCode_InternalError;
     }
 
-#if SDM_CONFIG_LOCK_ON_CLOSE == true
-    // FUTURE: Send to the debugged system 'Lock Debug' command to securely
-    // close the debug session. It will not work with CryptoCell-312 in many platforms where the
-    // ROM locks DCUs at ROM exit. However, in CryptoIsland-300 it can work. In non CryptoIsland-300
-    // platforms, disabling of the debug ports when the ROM locks the DCUs can be implemented
-    // by calling SDMClose with remote reset. In this case the DCUs will return to
-    // their default values and ROM exit will lock the DCUs.
+    // a background link establishment must finish before the driver goes away
+    bool linkUp = joinLink(false) == SDMReturnCode_Success;
 
-    SDMReturnCode tmpRes = mExtComPortDriver->EComPort_Finalize();
-    if (tmpRes != SDMReturnCode_Success)
+    SDMTimeline::Begin(mTimeline.get(), "close", SDM_TIMELINE_SESSION);
+
+    // the target may be hung, release the session without talking to it
+    bool cancelled = cancelRequested();
+    if (cancelled)
     {
-        PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComPort_Finalize failed [0x%04x]\n", tmpRes);
-        res = tmpRes;
+        SDM_LOG_INFO(ENTITY_NAME, "session cancelled, closing without finalizing the link\n");
     }
-#endif
 
-#if SDM_CONFIG_RESET_ON_CLOSE == true
-    if (res == SDMReturnCode_Success && SDM_CONFIG_REMOTE_RESET_TYPE == ECPD_REMOTE_RESET_COM)
+    if (mConfig.lockOnClose && !cancelled && linkUp)
+    {
+        // FUTURE: Send to the debugged system 'Lock Debug' command to securely
+        // close the debug session. It will not work with CryptoCell-312 in many platforms where the
+        // ROM locks DCUs at ROM exit. However, in CryptoIsland-300 it can work. In non CryptoIsland-300
+        // platforms, disabling of the debug ports when the ROM locks the DCUs can be implemented
+        // by calling SDMClose with remote reset. In this case the DCUs will return to
+        // their default values and ROM exit will lock the DCUs.
+        SDMReturnCode tmpRes = mExtComPortDriver->EComPort_Finalize();
+        if (tmpRes != SDMReturnCode_Success)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "EComPort_Finalize failed [0x%04x]\n", tmpRes);
+            res = tmpRes;
+        }
+    }
+
+    if (mConfig.resetOnClose && !cancelled && linkUp && res == SDMReturnCode_Success && mConfig.remoteResetType == ECPD_REMOTE_RESET_COM)
     {
         SDMReturnCode tmpRes = mExtComPortDriver->EComPort_RReboot();
         if (tmpRes != SDMReturnCode_Success)
@@ -301,7 +560,14 @@ SDMReturnCode SecureDebugManagerImpl::SDMClose()
             res = tmpRes;
         }
     }
-#endif
+
+    if (mTraceRecorder)
+    {
+        mTraceRecorder->Flush();
+    }
+
+    SDMTimeline::End(mTimeline.get(), "close", SDM_TIMELINE_SESSION);
+    finishTimeline();
 
     mOpen = false;
     return res;
@@ -313,6 +579,38 @@ SDMReturnCode SecureDebugManagerImpl::SDMClose()
  *
  ******************************************************************************************************/
 
+void SecureDebugManagerImpl::Cancel()
+{
+    mCancelled = true;
+}
+
+bool SecureDebugManagerImpl::cancelRequested()
+{
+    // latched, so a token that is cleared again does not resume a half finished operation
+    if (!mCancelled && mCancelRequested != NULL && mCancelRequested(mCancelRefcon) != 0)
+    {
+        mCancelled = true;
+    }
+    return mCancelled;
+}
+
+void SecureDebugManagerImpl::finishTimeline()
+{
+    if (!mTimeline)
+    {
+        return;
+    }
+
+    if (mExtComPortDriver)
+    {
+        mExtComPortDriver->SetTimeline(NULL);
+    }
+
+    // diagnostic only, a write failure is logged but does not fail the session
+    mTimeline->Write();
+    mTimeline.reset();
+}
+
 SDMReturnCode SecureDebugManagerImpl::requestPacketSend(request_packet_t *packet)
 {
     if (packet == 0)
@@ -323,7 +621,7 @@ SDMReturnCode SecureDebugManagerImpl::requestPacketSend(request_packet_t *packet
     size_t size = sizeof(request_packet_t) + sizeof(uint32_t) * packet->data_count;
     size_t actual_size = 0;
 
-    SDMReturnCode res = mExtComPortDriver->EComPort_Tx((uint8_t *)packet, size, &actual_size, SDM_CONFIG_COM_HW_TX_BLOCKING);
+    SDMReturnCode res = mExtComPortDriver->EComPort_Tx((uint8_t *)packet, size, &actual_size, mConfig.comHwTxBlocking);
     if (res != SDMReturnCode_Success)
     {
         PSA_ADAC_LOG_ERR(ENTITY_NAME, "Request packet sendfailed\n");
@@ -332,6 +630,17 @@ SDMReturnCode SecureDebugManagerImpl::requestPacketSend(request_packet_t *packet
     return res;
 }
 
+SDMReturnCode SecureDebugManagerImpl::requestFrameSend(const CertificateFrameView& frame)
+{
+    SDMReturnCode res = mExtComPortDriver->EComPort_TxFrame(frame.words, frame.wordCount, mConfig.comHwTxBlocking);
+    if (res != SDMReturnCode_Success)
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Request frame send failed\n");
+    }
+
+    return res;
+}
+
 SDMReturnCode SecureDebugManagerImpl::responsePacketReceive(response_packet_t *packet, size_t max)
 {
     if (packet == 0 || max == 0)
@@ -350,10 +659,22 @@ SDMReturnCode SecureDebugManagerImpl::responsePacketReceive(response_packet_t *p
     return res;
 }
 
-SDMReturnCode SecureDebugManagerImpl::loadCredentials(std::unique_ptr<uint8_t>& chain, size_t& chain_size, uint8_t& signature_type, psa_key_handle_t& handle)
+SDMReturnCode SecureDebugManagerImpl::resolveCredentialPaths(std::string& keyFileStr, std::string& chainFileStr)
 {
+    keyFileStr = mPrivateKeyFile;
+    chainFileStr = mTrustChainFile;
+
+    bool needKeyFile = keyFileStr.empty() && mPrivateKeyId == 0;
+    bool needChainFile = chainFileStr.empty() && mTrustChain.empty();
+    if (!needKeyFile && !needChainFile)
+    {
+        // fully provisioned, no user interaction required
+        return SDMReturnCode_Success;
+    }
+
     if (mSdmOpenParams.callbacks->presentForm == 0)
     {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Credentials not supplied and no presentForm callback available\n");
         return SDMReturnCode_InternalError;
     }
 
@@ -382,7 +703,17 @@ SDMReturnCode SecureDebugManagerImpl::loadCredentials(std::unique_ptr<uint8_t>&
     trust_chain_file_element.pathSelect.pathBuffer = chainFile;
     trust_chain_file_element.pathSelect.pathBufferLength = FILENAME_MAX;
 
-    SDMFormElement const * elements[] = { &key_file_element, &trust_chain_file_element };
+    // only ask for the credentials that were not supplied non-interactively
+    SDMFormElement const * elements[2];
+    uint32_t elementCount = 0;
+    if (needKeyFile)
+    {
+        elements[elementCount++] = &key_file_element;
+    }
+    if (needChainFile)
+    {
+        elements[elementCount++] = &trust_chain_file_element;
+    }
 
     SDMForm credentials_form;
     credentials_form.id = "credentials_form";
@@ -390,7 +721,7 @@ SDMReturnCode SecureDebugManagerImpl::loadCredentials(std::unique_ptr<uint8_t>&
     credentials_form.info = 0;
     credentials_form.flags = 0;
     credentials_form.elements = elements;
-    credentials_form.elementCount = 2;
+    credentials_form.elementCount = elementCount;
 
     SDMReturnCode res = mSdmOpenParams.callbacks->presentForm(&credentials_form, mSdmOpenParams.refcon);
     if (res != SDMReturnCode_Success)
@@ -398,21 +729,102 @@ SDMReturnCode SecureDebugManagerImpl::loadCredentials(std::unique_ptr<uint8_t>&
         return res;
     }
 
-    std::string keyFileStr = userInputStringTrim(keyFile);
-    if (import_private_key(keyFileStr.c_str(), &signature_type, &handle) != 0)
+    if (needKeyFile)
     {
-        PSA_ADAC_LOG_ERR(ENTITY_NAME, "import_private_key failed\n");
-        return SDMReturnCode_InternalError;
+        keyFileStr = userInputStringTrim(keyFile);
+    }
+    if (needChainFile)
+    {
+        chainFileStr = userInputStringTrim(chainFile);
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SecureDebugManagerImpl::loadPrivateKey(const std::string& keyFile, uint8_t& signature_type, PsaKey& key)
+{
+    psa_key_handle_t handle = 0;
+    bool persistent = mPrivateKeyId != 0;
+
+    {
+        std::unique_lock<std::mutex> cryptoLock = PsaCryptoContext::Lock();
+        if (persistent)
+        {
+            // provisioned with SDMProvisionKey, no key file parsing
+            SDMReturnCode res = PersistentKeyStore::Open(mPrivateKeyId, signature_type, handle);
+            if (res != SDMReturnCode_Success)
+            {
+                return res;
+            }
+        }
+        else if (import_private_key(keyFile.c_str(), &signature_type, &handle) != 0)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "import_private_key failed\n");
+            return SDMReturnCode_InternalError;
+        }
+    }
+    key.Reset(handle, persistent);
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode SecureDebugManagerImpl::loadCredentials(PsaAdacBuffer& chain, size_t& chain_size, uint8_t& signature_type, PsaKey& key)
+{
+    if (!mBundleFile.empty())
+    {
+        // the bundle trust chain and certificate frames are used in place, see loadCertificateFrames
+        if (!mBundle)
+        {
+            mBundle = AuthenticationBundle::Open(mBundleFile.c_str(), mArena);
+            if (!mBundle)
+            {
+                return SDMReturnCode_InternalError;
+            }
+        }
+
+        SDMReturnCode res = loadPrivateKey(mBundle->KeyFile(), signature_type, key);
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+
+        chain.reset();
+        chain_size = 0;
+        return SDMReturnCode_Success;
+    }
+
+    std::string keyFileStr;
+    std::string chainFileStr;
+    SDMReturnCode res = resolveCredentialPaths(keyFileStr, chainFileStr);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+
+    res = loadPrivateKey(keyFileStr, signature_type, key);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
     }
 
     uint8_t* tmpChain = 0;
-    std::string chainFileStr = userInputStringTrim(chainFile);
-    if (load_trust_chain(chainFileStr.c_str(), &tmpChain, &chain_size) != 0)
+    if (!mTrustChain.empty())
+    {
+        // in-memory trust chain, copied to match the ownership of load_trust_chain buffers
+        tmpChain = (uint8_t *) malloc(mTrustChain.size());
+        if (tmpChain == 0)
+        {
+            return SDMReturnCode_InternalError;
+        }
+        memcpy(tmpChain, mTrustChain.data(), mTrustChain.size());
+        chain_size = mTrustChain.size();
+    }
+    else if (load_trust_chain(chainFileStr.c_str(), &tmpChain, &chain_size) != 0)
     {
         PSA_ADAC_LOG_ERR(ENTITY_NAME, "load_trust_chain failed\n");
         return SDMReturnCode_InternalError;
     }
-    chain.reset(tmpChain);
+    chain = AdoptPsaAdacBuffer(tmpChain);
 
     return SDMReturnCode_Success;
 }
@@ -454,14 +866,121 @@ SDMReturnCode SecureDebugManagerImpl::receiveAuthStartCmdResponse(psa_auth_chall
     return SDMReturnCode_Success;
 }
 
-SDMReturnCode SecureDebugManagerImpl::sendAuthResponseCmdRequest(uint8_t *cert, size_t certLength)
+request_packet_t *SecureDebugManagerImpl::buildAuthResponseCmdRequest(const uint8_t *cert, size_t certLength)
 {
+    if (sizeof(request_packet_t) + certLength > mMsgBuffer.size())
+    {
+        PSA_ADAC_LOG_ERR(ENTITY_NAME, "Auth Response Command request too large [%zu]\n", certLength);
+        return 0;
+    }
+
     request_packet_t *request = (request_packet_t *) mMsgBuffer.data();
     request->command = ADAC_AUTH_RESPONSE_CMD;
     request->data_count = certLength / sizeof(uint32_t);
-    memcpy((void *) request->data, (void *) cert, certLength);
+    memcpy((void *) request->data, (const void *) cert, certLength);
+
+    return request;
+}
+
+SDMReturnCode SecureDebugManagerImpl::sendAuthResponseCmdRequest(uint8_t *cert, size_t certLength)
+{
+    return requestPacketSend(buildAuthResponseCmdRequest(cert, certLength));
+}
+
+SDMReturnCode SecureDebugManagerImpl::loadCertificateFrames(uint8_t *chain, size_t chainSize, ArenaVector<CertificateFrameView>& frames, std::shared_ptr<const CertificateFrameCache::Frames>& cachedFrames)
+{
+    frames.clear();
+
+    if (mBundle && mBundle->HasFrames() && mBundle->FrameWordBytes() == ExternalComPortDriver::FRAME_WORD_BYTES)
+    {
+        // pre-encoded by the bundle tool, sent straight from the mapping
+        for (size_t i = 0; i < mBundle->CertificateCount(); i++)
+        {
+            CertificateFrameView frame = { mBundle->Frame(i), mBundle->Certificate(i).frameWordCount };
+            frames.push_back(frame);
+        }
 
-    return requestPacketSend(request);
+        SDM_LOG_INFO(ENTITY_NAME, "Using %zu bundled certificate frames\n", frames.size());
+        return SDMReturnCode_Success;
+    }
+
+    const uint8_t *chainBytes = mBundle ? mBundle->Chain() : chain;
+    size_t chainBytesSize = mBundle ? mBundle->ChainSize() : chainSize;
+
+    cachedFrames = CertificateFrameCache::Find(chainBytes, chainBytesSize);
+    if (cachedFrames)
+    {
+        SDM_LOG_INFO(ENTITY_NAME, "Using %zu cached certificate frames\n", cachedFrames->size());
+    }
+    else
+    {
+        // certificate TLVs and their sizes
+        ArenaVector<std::pair<const uint8_t *, size_t>> certificates((ArenaAllocator<std::pair<const uint8_t *, size_t>>(mArena)));
+        if (mBundle)
+        {
+            // the bundle carries an index of the certificate TLVs, with sizes checked by AuthenticationBundle::Open
+            for (size_t i = 0; i < mBundle->CertificateCount(); i++)
+            {
+                certificates.push_back(std::make_pair(mBundle->CertificateTlv(i), (size_t)mBundle->Certificate(i).tlvSize));
+            }
+        }
+        else
+        {
+            psa_tlv_t *exts[MAX_EXTENSIONS];
+            size_t exts_count = 0;
+            int adac_res = split_tlv_static((uint32_t *)chain, chainSize, exts, MAX_EXTENSIONS, &exts_count);
+            if (adac_res < 0)
+            {
+                PSA_ADAC_LOG_ERR(ENTITY_NAME, "Error parsing trust chain %d\n", adac_res);
+                return SDMReturnCode_InternalError;
+            }
+
+            SDM_LOG_INFO(ENTITY_NAME, "Found %zu certificates\n", exts_count);
+
+            for (size_t i = 0; i < exts_count; i++)
+            {
+                if (exts[i]->type_id == PSA_BINARY_CRT)
+                {
+                    certificates.push_back(std::make_pair((const uint8_t *)exts[i], exts[i]->length_in_bytes + sizeof(psa_tlv_t)));
+                }
+            }
+        }
+
+        CertificateFrameCache::Frames newFrames;
+        try
+        {
+            for (const std::pair<const uint8_t *, size_t>& certificate : certificates)
+            {
+                request_packet_t *request = buildAuthResponseCmdRequest(certificate.first, certificate.second);
+                if (request == 0)
+                {
+                    return SDMReturnCode_InternalError;
+                }
+
+                size_t size = sizeof(request_packet_t) + sizeof(uint32_t) * request->data_count;
+                newFrames.emplace_back();
+                SDMReturnCode res = ExternalComPortDriver::EComPort_Encode((uint8_t *)request, size, newFrames.back());
+                if (res != SDMReturnCode_Success)
+                {
+                    return res;
+                }
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            return SDMReturnCode_InternalError;
+        }
+
+        cachedFrames = CertificateFrameCache::Insert(chainBytes, chainBytesSize, std::move(newFrames));
+    }
+
+    for (const std::vector<uint32_t>& cachedFrame : *cachedFrames)
+    {
+        CertificateFrameView frame = { cachedFrame.data(), cachedFrame.size() };
+        frames.push_back(frame);
+    }
+
+    return SDMReturnCode_Success;
 }
 
 SDMReturnCode SecureDebugManagerImpl::receiveAuthResponseCmdResponse()
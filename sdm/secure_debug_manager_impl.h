@@ -7,9 +7,20 @@
 #define SECURE_DEBUG_MANAGER_IMPL_H
 
 #include <memory.h>
+#include <atomic>
+#include <future>
+#include <string>
 #include <vector>
 
+#include "authentication_bundle.h"
+#include "certificate_frame_cache.h"
 #include "ext_com_port_driver.h"
+#include "register_access_trace.h"
+#include "sdm_extensions.h"
+#include "sdm_runtime_config.h"
+#include "sdm_timeline.h"
+#include "session_arena.h"
+#include "session_resources.h"
 #include "psa_adac.h"
 
 #define BUFFER_SIZE 4096
@@ -18,35 +29,91 @@ class SecureDebugManagerImpl
 {
 public:
 
-    SecureDebugManagerImpl();
+    /**
+     * @param[in] arena Session arena for the driver and message buffers, NULL for the heap. Must outlive the session.
+     */
+    explicit SecureDebugManagerImpl(SessionArena* arena = NULL);
     ~SecureDebugManagerImpl();
 
-    SDMReturnCode SDMOpen(const SDMOpenParameters* params);
+    SDMReturnCode SDMOpen(const SDMOpenParameters* params, const SDMOpenExtensions* extensions = NULL);
     SDMReturnCode SDMAuthenticate(const SDMAuthenticateParameters *params);
     SDMReturnCode SDMResumeBoot();
     SDMReturnCode SDMClose();
 
+    /**
+     * Fail the operation in progress, and any later one, before its next register access.
+     * May be called from any thread.
+     */
+    void Cancel();
+
 private:
 
+    struct CertificateFrameView
+    {
+        const uint32_t *words;
+        size_t wordCount;
+    };
+
+    SDMReturnCode openSession(const SDMOpenParameters* params, const SDMOpenExtensions* extensions);
+    SDMReturnCode establishLink();
+    /** Wait for a lazy link establishment. A deferred one is only run if establish is set */
+    SDMReturnCode joinLink(bool establish);
+    void finishTimeline();
+    bool cancelRequested();
+
     SDMReturnCode requestPacketSend(request_packet_t *packet);
+    SDMReturnCode requestFrameSend(const CertificateFrameView& frame);
     SDMReturnCode responsePacketReceive(response_packet_t *packet, size_t max);
-    SDMReturnCode loadCredentials(std::unique_ptr<uint8_t>& chain, size_t& chain_size, uint8_t& signature_type, psa_key_handle_t& handle);
+    SDMReturnCode loadPrivateKey(const std::string& keyFile, uint8_t& signature_type, PsaKey& key);
+    SDMReturnCode loadCredentials(PsaAdacBuffer& chain, size_t& chain_size, uint8_t& signature_type, PsaKey& key);
+    SDMReturnCode resolveCredentialPaths(std::string& keyFile, std::string& chainFile);
     
     SDMReturnCode sendAuthStartCmdRequest();
     SDMReturnCode receiveAuthStartCmdResponse(psa_auth_challenge_t *challenge);
+    request_packet_t *buildAuthResponseCmdRequest(const uint8_t *ext, size_t extLength);
     SDMReturnCode sendAuthResponseCmdRequest(uint8_t *ext, size_t extLength);
+    SDMReturnCode loadCertificateFrames(uint8_t *chain, size_t chainSize, ArenaVector<CertificateFrameView>& frames, std::shared_ptr<const CertificateFrameCache::Frames>& cachedFrames);
     SDMReturnCode receiveAuthResponseCmdResponse();
 
     void updateProgress(const char *progressMessage, uint8_t percentComplete);
 
-    std::vector<uint8_t> mMsgBuffer = std::vector<uint8_t>(BUFFER_SIZE, 0);
+    SessionArena* mArena;
+
+    ArenaVector<uint8_t> mMsgBuffer;
 
     SDMOpenParameters mSdmOpenParams;
 
-    std::unique_ptr<ExternalComPortDriver> mExtComPortDriver;
+    SDMRuntimeConfig mConfig;
+
+    // Credentials supplied non-interactively at open, empty if not supplied
+    std::string mPrivateKeyFile;
+    uint32_t mPrivateKeyId;
+    std::string mTrustChainFile;
+    ArenaVector<uint8_t> mTrustChain;
+    std::string mBundleFile;
+
+    ArenaPtr<AuthenticationBundle> mBundle;
+
+    // must outlive mExtComPortDriver, which holds the wrapped callback
+    ArenaPtr<RegisterAccessTraceRecorder> mTraceRecorder;
+
+    // session timeline, NULL unless configured. Must outlive mExtComPortDriver
+    ArenaPtr<SDMTimeline> mTimeline;
+
+    ArenaPtr<ExternalComPortDriver> mExtComPortDriver;
+
+    // pending lazy link establishment, invalid once joined. Declared after the driver, so it
+    // is joined before the driver is destroyed
+    std::future<SDMReturnCode> mLink;
+    SDMReturnCode mLinkResult;
 
     bool mInitialized;
     bool mOpen;
+
+    // set by Cancel, or polled from the client's token
+    std::atomic<bool> mCancelled;
+    SDMCancelRequestedCallback mCancelRequested;
+    void* mCancelRefcon;
 };
 
 #endif //SECURE_DEBUG_MANAGER_IMPL_H
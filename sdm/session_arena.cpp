@@ -0,0 +1,123 @@
+// session_arena.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "session_arena.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <cstddef>
+
+namespace
+{
+    std::atomic<size_t> gTotalBytesReserved(0);
+
+    // blocks are aligned for any type, as malloc
+    const size_t BLOCK_ALIGNMENT = alignof(std::max_align_t);
+
+    void* heapAllocate(size_t size, size_t alignment, void* context)
+    {
+        return malloc(size);
+    }
+
+    void heapDeallocate(void* ptr, size_t size, size_t alignment, void* context)
+    {
+        free(ptr);
+    }
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+}
+
+SessionArena::SessionArena(const SDMAllocator* allocator, size_t blockSize) :
+    mBlockSize(blockSize != 0 ? blockSize : SESSION_ARENA_DEFAULT_BLOCK_SIZE),
+    mBlocks(NULL),
+    mCursor(NULL),
+    mEnd(NULL),
+    mBytesReserved(0)
+{
+    if (allocator != NULL && allocator->allocate != NULL && allocator->deallocate != NULL)
+    {
+        mAllocator = *allocator;
+    }
+    else
+    {
+        mAllocator.allocate = heapAllocate;
+        mAllocator.deallocate = heapDeallocate;
+        mAllocator.context = NULL;
+    }
+}
+
+SessionArena::~SessionArena()
+{
+    Release();
+}
+
+void* SessionArena::Allocate(size_t size, size_t alignment)
+{
+    if (alignment == 0)
+    {
+        alignment = 1;
+    }
+
+    if (mCursor != NULL)
+    {
+        uint8_t* p = (uint8_t*)alignUp((uintptr_t)mCursor, alignment);
+        if (p <= mEnd && size <= (size_t)(mEnd - p))
+        {
+            mCursor = p + size;
+            return p;
+        }
+    }
+
+    // the rest of the current block is abandoned, large requests get a block of their own
+    const size_t header = alignUp(sizeof(Block), BLOCK_ALIGNMENT);
+    if (size > (size_t)-1 - header - alignment)
+    {
+        return NULL;
+    }
+    size_t needed = header + size + alignment;
+    size_t blockSize = needed > mBlockSize ? needed : mBlockSize;
+
+    Block* block = (Block*)mAllocator.allocate(blockSize, BLOCK_ALIGNMENT, mAllocator.context);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->next = mBlocks;
+    block->size = blockSize;
+    mBlocks = block;
+    mBytesReserved += blockSize;
+    gTotalBytesReserved += blockSize;
+
+    mCursor = (uint8_t*)block + header;
+    mEnd = (uint8_t*)block + blockSize;
+
+    uint8_t* p = (uint8_t*)alignUp((uintptr_t)mCursor, alignment);
+    mCursor = p + size;
+    return p;
+}
+
+void SessionArena::Release()
+{
+    while (mBlocks != NULL)
+    {
+        Block* block = mBlocks;
+        mBlocks = block->next;
+        gTotalBytesReserved -= block->size;
+        mAllocator.deallocate(block, block->size, BLOCK_ALIGNMENT, mAllocator.context);
+    }
+
+    mCursor = NULL;
+    mEnd = NULL;
+    mBytesReserved = 0;
+}
+
+size_t SessionArena::TotalBytesReserved()
+{
+    return gTotalBytesReserved;
+}
@@ -0,0 +1,182 @@
+// session_arena.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Monotonic per-session memory arena.
+ *
+ * A session's driver, message buffers and register access lists are allocated from
+ * its SessionArena. Blocks are taken from the caller's {@link SDMAllocator}, or the
+ * heap, and only returned when the arena is destroyed at SDMClose. Individual
+ * deallocations are no-ops, so buffers that are reused across transfers cost nothing
+ * once grown to the largest message.
+ *
+ * Allocation is not thread safe. A session's calls must not overlap, see SDMOpenEx.
+ */
+
+#ifndef SESSION_ARENA_H
+#define SESSION_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "sdm_extensions.h"
+
+/** Arena block size used when SDMOpenExtensions::arenaBlockSize is 0 */
+#define SESSION_ARENA_DEFAULT_BLOCK_SIZE (16 * 1024)
+
+class SessionArena
+{
+public:
+    /**
+     * @param[in] allocator Source of the arena blocks, NULL for the heap. Copied.
+     * @param[in] blockSize Minimum size of each block, 0 for the default.
+     */
+    SessionArena(const SDMAllocator* allocator, size_t blockSize);
+    ~SessionArena();
+
+    SessionArena(const SessionArena&) = delete;
+    SessionArena& operator=(const SessionArena&) = delete;
+
+    /**
+     * \brief Allocate size bytes aligned to alignment, NULL if the allocator fails.
+     */
+    void* Allocate(size_t size, size_t alignment);
+
+    /**
+     * \brief Return every block to the allocator. Objects in the arena must already be destroyed.
+     */
+    void Release();
+
+    /** Bytes held in blocks by this arena */
+    size_t BytesReserved() const { return mBytesReserved; }
+
+    /** Bytes held in blocks by all arenas */
+    static size_t TotalBytesReserved();
+
+private:
+    struct Block
+    {
+        Block* next;
+        size_t size;
+    };
+
+    SDMAllocator mAllocator;
+    size_t mBlockSize;
+    Block* mBlocks;
+    uint8_t* mCursor;
+    uint8_t* mEnd;
+    size_t mBytesReserved;
+};
+
+/**
+ * \brief Standard allocator over a SessionArena, or the heap when the arena is NULL.
+ *
+ * Throws std::bad_alloc when the arena cannot grow, like the default allocator.
+ */
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    ArenaAllocator(SessionArena* arena = NULL) : mArena(arena) {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.Arena()) {}
+
+    T* allocate(size_t n)
+    {
+        if (n > (size_t)-1 / sizeof(T))
+        {
+            throw std::bad_alloc();
+        }
+        if (mArena == NULL)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+        void* p = mArena->Allocate(n * sizeof(T), alignof(T));
+        if (p == NULL)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (mArena == NULL)
+        {
+            ::operator delete(p);
+        }
+    }
+
+    SessionArena* Arena() const { return mArena; }
+
+private:
+    SessionArena* mArena;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.Arena() == b.Arena(); }
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.Arena() != b.Arena(); }
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+/**
+ * \brief Destroys an object created by {@link ArenaNew}, leaving its memory to the arena.
+ */
+template <class T>
+struct ArenaDelete
+{
+    SessionArena* arena;
+
+    ArenaDelete(SessionArena* owner = NULL) : arena(owner) {}
+
+    void operator()(T* p) const
+    {
+        if (arena == NULL)
+        {
+            delete p;
+        }
+        else if (p != NULL)
+        {
+            p->~T();
+        }
+    }
+};
+
+template <class T>
+using ArenaPtr = std::unique_ptr<T, ArenaDelete<T>>;
+
+/**
+ * \brief Construct a T in arena, or on the heap if arena is NULL. Empty if out of memory.
+ */
+template <class T, class... Args>
+ArenaPtr<T> ArenaNew(SessionArena* arena, Args&&... args)
+{
+    if (arena == NULL)
+    {
+        return ArenaPtr<T>(new (std::nothrow) T(std::forward<Args>(args)...), ArenaDelete<T>(NULL));
+    }
+
+    void* p = arena->Allocate(sizeof(T), alignof(T));
+    if (p == NULL)
+    {
+        return ArenaPtr<T>(NULL, ArenaDelete<T>(arena));
+    }
+    return ArenaPtr<T>(new (p) T(std::forward<Args>(args)...), ArenaDelete<T>(arena));
+}
+
+#endif // SESSION_ARENA_H
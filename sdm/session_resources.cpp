@@ -0,0 +1,108 @@
+// session_resources.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "session_resources.h"
+#include "psa_crypto_context.h"
+
+#include "psa_adac_debug.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <mutex>
+
+#define ENTITY_NAME "SessionResources"
+
+namespace
+{
+    std::atomic<size_t> gLiveKeys(0);
+    std::atomic<size_t> gLiveBuffers(0);
+}
+
+void PsaAdacFree::operator()(uint8_t* buffer) const
+{
+    if (buffer != NULL)
+    {
+        free(buffer);
+        gLiveBuffers--;
+    }
+}
+
+PsaAdacBuffer AdoptPsaAdacBuffer(uint8_t* buffer)
+{
+    if (buffer != NULL)
+    {
+        gLiveBuffers++;
+    }
+    return PsaAdacBuffer(buffer);
+}
+
+PsaKey::PsaKey() :
+    mHandle(0),
+    mPersistent(false)
+{
+}
+
+PsaKey::PsaKey(psa_key_handle_t handle) :
+    mHandle(0),
+    mPersistent(false)
+{
+    Reset(handle);
+}
+
+PsaKey::PsaKey(PsaKey&& other) :
+    mHandle(other.mHandle),
+    mPersistent(other.mPersistent)
+{
+    other.mHandle = 0;
+}
+
+PsaKey& PsaKey::operator=(PsaKey&& other)
+{
+    if (this != &other)
+    {
+        Reset();
+        mHandle = other.mHandle;
+        mPersistent = other.mPersistent;
+        other.mHandle = 0;
+    }
+    return *this;
+}
+
+PsaKey::~PsaKey()
+{
+    Reset();
+}
+
+void PsaKey::Reset(psa_key_handle_t handle, bool persistent)
+{
+    if (mHandle != 0)
+    {
+        std::unique_lock<std::mutex> cryptoLock = PsaCryptoContext::Lock();
+        psa_status_t status = mPersistent ? psa_close_key(mHandle) : psa_destroy_key(mHandle);
+        if (status != PSA_SUCCESS)
+        {
+            PSA_ADAC_LOG_ERR(ENTITY_NAME, "%s failed %d\n", mPersistent ? "psa_close_key" : "psa_destroy_key", (int)status);
+        }
+        gLiveKeys--;
+    }
+
+    mHandle = handle;
+    mPersistent = persistent;
+    if (mHandle != 0)
+    {
+        gLiveKeys++;
+    }
+}
+
+size_t SessionResources::LiveKeys()
+{
+    return gLiveKeys;
+}
+
+size_t SessionResources::LiveBuffers()
+{
+    return gLiveBuffers;
+}
@@ -0,0 +1,97 @@
+// session_resources.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Owners for the resources a session acquires from psa-adac.
+ *
+ * load_trust_chain and psa_adac_sign_token return malloc'd buffers, owned by a
+ * PsaAdacBuffer. import_private_key creates a volatile PSA key, owned by a PsaKey, as is a
+ * key opened from the persistent key store.
+ * Live owners are counted, see {@link SDMGetResourceUsage}.
+ */
+
+#ifndef SESSION_RESOURCES_H
+#define SESSION_RESOURCES_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+
+#include "psa/crypto.h"
+
+/**
+ * \brief Frees a psa-adac buffer.
+ */
+struct PsaAdacFree
+{
+    void operator()(uint8_t* buffer) const;
+};
+
+using PsaAdacBuffer = std::unique_ptr<uint8_t[], PsaAdacFree>;
+
+/**
+ * \brief Take ownership of a buffer allocated with malloc by psa-adac, or NULL.
+ */
+PsaAdacBuffer AdoptPsaAdacBuffer(uint8_t* buffer);
+
+/**
+ * \brief Owns a PSA key, destroying it when reset or destroyed.
+ *
+ * Persistent keys are closed instead, leaving them in storage.
+ *
+ * Destroying a key takes {@link PsaCryptoContext::Lock}, so a PsaKey must not be
+ * reset or destroyed while the lock is held.
+ */
+class PsaKey
+{
+public:
+    PsaKey();
+
+    /**
+     * \brief Take ownership of handle, 0 for none.
+     */
+    explicit PsaKey(psa_key_handle_t handle);
+
+    PsaKey(PsaKey&& other);
+    PsaKey& operator=(PsaKey&& other);
+
+    PsaKey(const PsaKey&) = delete;
+    PsaKey& operator=(const PsaKey&) = delete;
+
+    ~PsaKey();
+
+    /**
+     * \brief Release the owned key, then take ownership of handle, 0 for none.
+     *
+     * @param[in] persistent Whether handle was opened from the persistent key store.
+     */
+    void Reset(psa_key_handle_t handle = 0, bool persistent = false);
+
+    psa_key_handle_t Get() const { return mHandle; }
+
+    bool Valid() const { return mHandle != 0; }
+
+private:
+    psa_key_handle_t mHandle;
+    bool mPersistent;
+};
+
+/**
+ * \brief Counts of live session resources.
+ */
+class SessionResources
+{
+public:
+    /** PsaKey instances owning a key */
+    static size_t LiveKeys();
+
+    /** Non-null PsaAdacBuffer instances */
+    static size_t LiveBuffers();
+};
+
+#endif // SESSION_RESOURCES_H
@@ -0,0 +1,123 @@
+// spsc_byte_queue.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Lock-free single producer, single consumer byte queue.
+ *
+ * Hands received bytes from the External COM Port Driver RX pump thread to the
+ * protocol thread. One thread may call Push, one other thread may call Pop, without
+ * locking. Storage is supplied by the owner and must hold a power of two bytes.
+ */
+
+#ifndef SPSC_BYTE_QUEUE_H
+#define SPSC_BYTE_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <atomic>
+
+class SpscByteQueue
+{
+public:
+    SpscByteQueue() :
+        mStorage(NULL),
+        mMask(0),
+        mHead(0),
+        mTail(0)
+    {
+    }
+
+    SpscByteQueue(const SpscByteQueue&) = delete;
+    SpscByteQueue& operator=(const SpscByteQueue&) = delete;
+
+    /**
+     * \brief Use storage for the queue, emptying it. Neither thread may be using the queue.
+     *
+     * @param[in] storage Queue storage, or NULL to detach.
+     * @param[in] capacity Size of storage, a power of two.
+     */
+    void Reset(uint8_t* storage, size_t capacity)
+    {
+        mStorage = storage;
+        mMask = storage != NULL ? capacity - 1 : 0;
+        mHead.store(0, std::memory_order_relaxed);
+        mTail.store(0, std::memory_order_relaxed);
+    }
+
+    size_t Capacity() const { return mStorage != NULL ? mMask + 1 : 0; }
+
+    /**
+     * \brief Producer: append up to length bytes, returning the number appended.
+     */
+    size_t Push(const uint8_t* bytes, size_t length)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        const size_t head = mHead.load(std::memory_order_acquire);
+        size_t count = Capacity() - (tail - head);
+        count = length < count ? length : count;
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        size_t offset = tail & mMask;
+        size_t first = count < Capacity() - offset ? count : Capacity() - offset;
+        memcpy(mStorage + offset, bytes, first);
+        memcpy(mStorage, bytes + first, count - first);
+
+        mTail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * \brief Consumer: remove up to length bytes, returning the number removed.
+     */
+    size_t Pop(uint8_t* bytes, size_t length)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        const size_t tail = mTail.load(std::memory_order_acquire);
+        size_t count = tail - head;
+        count = length < count ? length : count;
+        if (count == 0)
+        {
+            return 0;
+        }
+
+        size_t offset = head & mMask;
+        size_t first = count < Capacity() - offset ? count : Capacity() - offset;
+        memcpy(bytes, mStorage + offset, first);
+        memcpy(bytes + first, mStorage, count - first);
+
+        mHead.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /** Bytes queued, exact on the consumer thread, a lower bound elsewhere */
+    size_t Size() const
+    {
+        return mTail.load(std::memory_order_acquire) - mHead.load(std::memory_order_acquire);
+    }
+
+    /** Space left, exact on the producer thread, a lower bound elsewhere */
+    size_t Free() const
+    {
+        return Capacity() - Size();
+    }
+
+private:
+    uint8_t* mStorage;
+    size_t mMask;
+
+    // free running indices, padded apart so the two threads do not share a cache line
+    std::atomic<size_t> mHead;
+    uint8_t mPadding[64];
+    std::atomic<size_t> mTail;
+};
+
+#endif // SPSC_BYTE_QUEUE_H
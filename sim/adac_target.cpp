@@ -0,0 +1,168 @@
+// adac_target.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "adac_target.h"
+#include "sdc600_model.h"
+
+#include <string.h>
+
+namespace
+{
+    // certificate_header_t starts with format_version, signature_type and key_type,
+    // token_header_t with format_version and signature_type
+    const size_t SIGNATURE_TYPE_OFFSET = sizeof(psa_version_t);
+    const size_t KEY_TYPE_OFFSET = sizeof(psa_version_t) + 1;
+}
+
+AdacTarget::AdacTarget(uint32_t seed) :
+    mState(STATE_IDLE),
+    mRandom(seed),
+    mKeyType(0),
+    mAuthentications(0),
+    mFailures(0)
+{
+    memset(&mChallenge, 0, sizeof(mChallenge));
+}
+
+void AdacTarget::Attach(Sdc600Model& model)
+{
+    model.SetMessageHandler([this](const std::vector<uint8_t>& message, std::vector<uint8_t>& response)
+    {
+        HandleMessage(message, response);
+    });
+}
+
+void AdacTarget::SetVerifier(Verifier verifier)
+{
+    mVerifier = verifier;
+}
+
+void AdacTarget::HandleMessage(const std::vector<uint8_t>& message, std::vector<uint8_t>& response)
+{
+    std::vector<uint32_t> data;
+    uint16_t status = ADAC_INVALID_COMMAND;
+
+    // the request, word aligned for the TLV parsing below
+    std::vector<uint32_t> words((message.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t), 0);
+    memcpy(words.data(), message.data(), message.size());
+    const request_packet_t* request = (const request_packet_t*)words.data();
+
+    if (message.size() >= sizeof(request_packet_t) &&
+        message.size() >= sizeof(request_packet_t) + request->data_count * sizeof(uint32_t))
+    {
+        switch (request->command)
+        {
+        case ADAC_DISCOVERY_CMD:
+            status = ADAC_SUCCESS;
+            break;
+
+        case ADAC_AUTH_START_CMD:
+            status = authStart(data);
+            break;
+
+        case ADAC_AUTH_RESPONSE_CMD:
+            status = authResponse(request);
+            break;
+
+        case ADAC_CLOSE_SESSION_CMD:
+        case ADAC_LOCK_DEBUG_CMD:
+            mState = STATE_IDLE;
+            status = ADAC_SUCCESS;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    response.assign(sizeof(response_packet_t) + data.size() * sizeof(uint32_t), 0);
+    response_packet_t* packet = (response_packet_t*)response.data();
+    packet->status = status;
+    packet->data_count = (uint16_t)data.size();
+    if (!data.empty())
+    {
+        memcpy(packet->data, data.data(), data.size() * sizeof(uint32_t));
+    }
+}
+
+uint16_t AdacTarget::authStart(std::vector<uint32_t>& data)
+{
+    memset(&mChallenge, 0, sizeof(mChallenge));
+    mChallenge.format_version.major = 1;
+    mChallenge.format_version.minor = 0;
+    for (size_t i = 0; i < sizeof(mChallenge.challenge_vector); i++)
+    {
+        mChallenge.challenge_vector[i] = (uint8_t)mRandom();
+    }
+
+    mCertificates.clear();
+    mKeyType = 0;
+    mState = STATE_CHALLENGE_ISSUED;
+
+    data.assign(sizeof(mChallenge) / sizeof(uint32_t), 0);
+    memcpy(data.data(), &mChallenge, sizeof(mChallenge));
+    return ADAC_SUCCESS;
+}
+
+uint16_t AdacTarget::authResponse(const request_packet_t* request)
+{
+    if (mState != STATE_CHALLENGE_ISSUED)
+    {
+        return fail();
+    }
+
+    size_t size = request->data_count * sizeof(uint32_t);
+    const psa_tlv_t* tlv = (const psa_tlv_t*)request->data;
+    if (size < sizeof(psa_tlv_t) || sizeof(psa_tlv_t) + tlv->length_in_bytes > size || tlv->length_in_bytes <= KEY_TYPE_OFFSET)
+    {
+        return fail();
+    }
+
+    // each certificate and the token are signed with the key of the certificate before them,
+    // the root certificate with its own
+    uint8_t signatureType = tlv->value[SIGNATURE_TYPE_OFFSET];
+    uint8_t keyType = tlv->value[KEY_TYPE_OFFSET];
+    if (!mCertificates.empty() && signatureType != mKeyType)
+    {
+        return fail();
+    }
+
+    const uint8_t* bytes = (const uint8_t*)tlv;
+    std::vector<uint8_t> element(bytes, bytes + sizeof(psa_tlv_t) + tlv->length_in_bytes);
+
+    if (tlv->type_id == PSA_BINARY_CRT)
+    {
+        if (mCertificates.empty() && signatureType != keyType)
+        {
+            return fail();
+        }
+
+        mCertificates.push_back(element);
+        mKeyType = keyType;
+        return ADAC_NEED_MORE_DATA;
+    }
+
+    if (tlv->type_id != PSA_BINARY_TOKEN || mCertificates.empty())
+    {
+        return fail();
+    }
+
+    if (mVerifier && !mVerifier(mCertificates, element, mChallenge))
+    {
+        return fail();
+    }
+
+    mState = STATE_AUTHENTICATED;
+    mAuthentications++;
+    return ADAC_SUCCESS;
+}
+
+uint16_t AdacTarget::fail()
+{
+    // a new challenge is needed before the next attempt
+    mState = STATE_IDLE;
+    mFailures++;
+    return ADAC_FAILURE;
+}
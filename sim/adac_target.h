@@ -0,0 +1,101 @@
+// adac_target.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief ADAC Secure Debug Authenticator emulation, behind an Sdc600Model.
+ *
+ * Answers the ADAC commands the Secure Debug Manager sends through the Internal COM
+ * Port: ADAC_AUTH_START_CMD issues a challenge, each ADAC_AUTH_RESPONSE_CMD carrying a
+ * certificate is checked and answered with ADAC_NEED_MORE_DATA, and the token that
+ * follows the certificates completes the authentication with ADAC_SUCCESS or
+ * ADAC_FAILURE. Attached to an Sdc600Model, full SDMOpen/SDMAuthenticate/SDMClose
+ * sessions run offline through the register access callback.
+ *
+ * Certificates and tokens are checked structurally: TLV framing, command order, and
+ * signature types that match the key type of the issuing certificate. Signatures are
+ * only verified by the {@link Verifier}, when one is set.
+ */
+
+#ifndef ADAC_TARGET_H
+#define ADAC_TARGET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "psa_adac.h"
+
+class Sdc600Model;
+
+class AdacTarget
+{
+public:
+    /**
+     * \brief Verifies the signatures of a complete authentication response.
+     *
+     * @param[in] certificates Certificate TLVs in the order received, header included.
+     * @param[in] token Token TLV, header included.
+     * @param[in] challenge The challenge issued for this authentication.
+     * @return Whether to grant access.
+     */
+    using Verifier = std::function<bool(const std::vector<std::vector<uint8_t>>& certificates, const std::vector<uint8_t>& token, const psa_auth_challenge_t& challenge)>;
+
+    /**
+     * @param[in] seed Seed of the challenge vectors, fixed for reproducible sessions.
+     */
+    explicit AdacTarget(uint32_t seed = std::random_device()());
+
+    /**
+     * \brief Answer the messages received by model.
+     *
+     * The target must outlive the model's use of the handler.
+     */
+    void Attach(Sdc600Model& model);
+
+    void SetVerifier(Verifier verifier);
+
+    /**
+     * \brief Handle one ADAC request packet, with the semantics of Sdc600Model::MessageHandler.
+     */
+    void HandleMessage(const std::vector<uint8_t>& message, std::vector<uint8_t>& response);
+
+    /** Whether the last authentication succeeded, and debug has not been locked since */
+    bool Authenticated() const { return mState == STATE_AUTHENTICATED; }
+
+    size_t Authentications() const { return mAuthentications; }
+    size_t Failures() const { return mFailures; }
+
+    /** Certificates accepted during the current or last authentication */
+    size_t CertificateCount() const { return mCertificates.size(); }
+
+private:
+    enum State
+    {
+        STATE_IDLE,
+        STATE_CHALLENGE_ISSUED,
+        STATE_AUTHENTICATED,
+    };
+
+    uint16_t authStart(std::vector<uint32_t>& data);
+    uint16_t authResponse(const request_packet_t* request);
+    uint16_t fail();
+
+    State mState;
+    std::mt19937 mRandom;
+    psa_auth_challenge_t mChallenge;
+    std::vector<std::vector<uint8_t>> mCertificates;
+    uint8_t mKeyType; // of the last certificate
+    Verifier mVerifier;
+
+    size_t mAuthentications;
+    size_t mFailures;
+};
+
+#endif // ADAC_TARGET_H
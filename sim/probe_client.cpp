@@ -0,0 +1,259 @@
+// probe_client.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "probe_client.h"
+#include "probe_protocol.h"
+
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <new>
+
+ProbeClient::ProbeClient() :
+    mSocket(-1),
+    mTransactions(0)
+{
+}
+
+ProbeClient::~ProbeClient()
+{
+    Close();
+}
+
+SDMReturnCode ProbeClient::Connect(const char* host, uint16_t port)
+{
+    Close();
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (host == NULL || inet_pton(AF_INET, host, &address.sin_addr) != 1)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    mSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (mSocket < 0)
+    {
+        return SDMReturnCode_IOError;
+    }
+
+    if (connect(mSocket, (sockaddr*)&address, sizeof(address)) != 0)
+    {
+        Close();
+        return SDMReturnCode_IOError;
+    }
+
+    int noDelay = 1;
+    setsockopt(mSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    return SDMReturnCode_Success;
+}
+
+void ProbeClient::Close()
+{
+    if (mSocket >= 0)
+    {
+        close(mSocket);
+        mSocket = -1;
+    }
+}
+
+SDMReturnCode ProbeClient::appendList(const SDMRegisterAccess* accesses, size_t accessCount)
+{
+    if (accessCount > SDM_PROBE_MAX_ACCESSES || (accessCount > 0 && accesses == NULL))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    ProbeRequestHeader header = { SDM_PROBE_MAGIC, (uint32_t)accessCount };
+    size_t offset = mRequest.size();
+    try
+    {
+        mRequest.resize(offset + sizeof(header) + accessCount * sizeof(ProbeAccessRecord));
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    memcpy(&mRequest[offset], &header, sizeof(header));
+    ProbeAccessRecord* records = (ProbeAccessRecord*)(&mRequest[offset] + sizeof(header));
+    for (size_t i = 0; i < accessCount; i++)
+    {
+        if (accesses[i].value == NULL)
+        {
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        ProbeAccessRecord record = {
+            accesses[i].address,
+            accesses[i].op,
+            *accesses[i].value,
+            accesses[i].pollMask,
+            accesses[i].retries
+        };
+        memcpy(&records[i], &record, sizeof(record));
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode ProbeClient::receiveList(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, SDMReturnCode* result)
+{
+    try
+    {
+        mValues.resize(accessCount);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    ProbeResponseHeader response;
+    if (!ProbeRecv(mSocket, &response, sizeof(response)) ||
+        (accessCount > 0 && !ProbeRecv(mSocket, mValues.data(), accessCount * sizeof(uint32_t))))
+    {
+        Close();
+        return SDMReturnCode_IOError;
+    }
+
+    if (response.completed > accessCount)
+    {
+        return SDMReturnCode_TransferError;
+    }
+
+    for (size_t i = 0; i < response.completed; i++)
+    {
+        *accesses[i].value = mValues[i];
+    }
+    *accessesCompleted = response.completed;
+    *result = (SDMReturnCode)response.result;
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode ProbeClient::RegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted)
+{
+    *accessesCompleted = 0;
+
+    if (mSocket < 0)
+    {
+        return SDMReturnCode_RequestFailed;
+    }
+
+    // header and records in one send, so each list is a single segment on the wire
+    mRequest.clear();
+    SDMReturnCode res = appendList(accesses, accessCount);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+
+    if (!ProbeSend(mSocket, mRequest.data(), mRequest.size()))
+    {
+        Close();
+        return SDMReturnCode_IOError;
+    }
+
+    SDMReturnCode result = SDMReturnCode_Success;
+    res = receiveList(accesses, accessCount, accessesCompleted, &result);
+    if (res != SDMReturnCode_Success)
+    {
+        return res;
+    }
+    mTransactions++;
+
+    return result;
+}
+
+SDMReturnCode ProbeClient::RegisterAccessLists(SDMRegisterAccessList* lists, size_t listCount)
+{
+    for (size_t i = 0; i < listCount; i++)
+    {
+        lists[i].accessesCompleted = 0;
+        lists[i].result = SDMReturnCode_RequestFailed;
+    }
+
+    if (mSocket < 0)
+    {
+        return SDMReturnCode_RequestFailed;
+    }
+
+    if (listCount > SDM_PROBE_MAX_LISTS)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    // the server models one COM port, every list is sent to it whatever its device
+    ProbeRequestHeader header = { SDM_PROBE_BATCH_MAGIC, (uint32_t)listCount };
+    try
+    {
+        mRequest.assign((const uint8_t*)&header, (const uint8_t*)&header + sizeof(header));
+    }
+    catch (const std::bad_alloc&)
+    {
+        return SDMReturnCode_InternalError;
+    }
+
+    for (size_t i = 0; i < listCount; i++)
+    {
+        SDMReturnCode res = appendList(lists[i].accesses, lists[i].accessCount);
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+    }
+
+    if (!ProbeSend(mSocket, mRequest.data(), mRequest.size()))
+    {
+        Close();
+        return SDMReturnCode_IOError;
+    }
+
+    SDMReturnCode firstFailure = SDMReturnCode_Success;
+    for (size_t i = 0; i < listCount; i++)
+    {
+        SDMReturnCode res = receiveList(lists[i].accesses, lists[i].accessCount, &lists[i].accessesCompleted, &lists[i].result);
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+
+        if (firstFailure == SDMReturnCode_Success && lists[i].result != SDMReturnCode_Success)
+        {
+            firstFailure = lists[i].result;
+        }
+    }
+    mTransactions++;
+
+    return firstFailure;
+}
+
+SDMReturnCode ProbeClient::RegisterAccessCallback(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+{
+    if (refcon == NULL || accesses == NULL || accessesCompleted == NULL)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    return ((ProbeClient*)refcon)->RegisterAccess(accesses, accessCount, accessesCompleted);
+}
+
+SDMReturnCode ProbeClient::RegisterAccessVectorCallback(SDMRegisterAccessList* lists, size_t listCount, void* refcon)
+{
+    if (refcon == NULL || (listCount > 0 && lists == NULL))
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    return ((ProbeClient*)refcon)->RegisterAccessLists(lists, listCount);
+}
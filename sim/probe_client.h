@@ -0,0 +1,81 @@
+// probe_client.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief SDMRegisterAccessCallback that forwards register access lists to a ProbeServer.
+ */
+
+#ifndef PROBE_CLIENT_H
+#define PROBE_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+
+class ProbeClient
+{
+public:
+    ProbeClient();
+
+    /**
+     * Closes the connection.
+     */
+    ~ProbeClient();
+
+    /**
+     * \brief Connect to a ProbeServer.
+     *
+     * @param[in] host IPv4 address, e.g. "127.0.0.1".
+     * @param[in] port TCP port.
+     */
+    SDMReturnCode Connect(const char* host, uint16_t port);
+
+    void Close();
+
+    /**
+     * \brief Perform register accesses on the server, in a single round trip.
+     */
+    SDMReturnCode RegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted);
+
+    /**
+     * \brief SDMRegisterAccessCallback, with the ProbeClient as refcon.
+     */
+    static SDMReturnCode RegisterAccessCallback(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon);
+
+    /**
+     * \brief Perform several register access lists on the server, in a single round trip.
+     */
+    SDMReturnCode RegisterAccessLists(SDMRegisterAccessList* lists, size_t listCount);
+
+    /**
+     * \brief SDMRegisterAccessVectorCallback, with the ProbeClient as refcon.
+     */
+    static SDMReturnCode RegisterAccessVectorCallback(SDMRegisterAccessList* lists, size_t listCount, void* refcon);
+
+    /** Round trips made */
+    uint64_t TransactionCount() const { return mTransactions; }
+
+private:
+    // appends one list to mRequest
+    SDMReturnCode appendList(const SDMRegisterAccess* accesses, size_t accessCount);
+
+    // receives the response to one list
+    SDMReturnCode receiveList(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, SDMReturnCode* result);
+
+    int mSocket;
+    uint64_t mTransactions;
+
+    // reused across transactions
+    std::vector<uint8_t> mRequest;
+    std::vector<uint32_t> mValues;
+};
+
+#endif // PROBE_CLIENT_H
@@ -0,0 +1,106 @@
+// probe_protocol.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Wire format between ProbeClient and ProbeServer.
+ *
+ * Each register access list is one transaction:
+ *
+ *   client -> server: ProbeRequestHeader, ProbeAccessRecord[count]
+ *   server -> client: ProbeResponseHeader, uint32_t value[count]
+ *
+ * The response carries the value of every access after it was performed: read data,
+ * the matched value of a poll, or the write data unchanged. Fields are in host byte
+ * order, the server only listens on the loopback interface.
+ *
+ * Several lists can be sent as one batch transaction, answered after a single latency:
+ *
+ *   client -> server: ProbeRequestHeader (SDM_PROBE_BATCH_MAGIC, list count),
+ *                     then each list as above
+ *   server -> client: each list response as above
+ *
+ * Lists after the first one that does not complete are not performed, they report
+ * SDMReturnCode_RequestFailed, 0 completed and their values unchanged.
+ */
+
+#ifndef PROBE_PROTOCOL_H
+#define PROBE_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sys/socket.h>
+
+#define SDM_PROBE_MAGIC        0x504D4453 /* "SDMP" */
+#define SDM_PROBE_MAX_ACCESSES 65536
+#define SDM_PROBE_BATCH_MAGIC  0x42444D53 /* "SMDB" */
+#define SDM_PROBE_MAX_LISTS    4096
+
+typedef struct ProbeRequestHeader {
+    uint32_t magic;             /*!< SDM_PROBE_MAGIC, or SDM_PROBE_BATCH_MAGIC */
+    uint32_t count;             /*!< Number of ProbeAccessRecord following, up to SDM_PROBE_MAX_ACCESSES,
+                                     or of lists in a batch, up to SDM_PROBE_MAX_LISTS */
+} ProbeRequestHeader;
+
+typedef struct ProbeAccessRecord {
+    uint64_t address;
+    uint32_t op;                /*!< SDMRegisterAccessOp */
+    uint32_t value;             /*!< Write data or poll value */
+    uint32_t pollMask;
+    uint32_t retries;
+} ProbeAccessRecord;
+
+typedef struct ProbeResponseHeader {
+    uint32_t result;            /*!< SDMReturnCode */
+    uint32_t completed;         /*!< Accesses completed */
+} ProbeResponseHeader;
+
+static_assert(sizeof(ProbeAccessRecord) == 24, "ProbeAccessRecord must not be padded");
+
+/**
+ * \brief Receive exactly length bytes.
+ *
+ * @return false if the connection closed or failed first.
+ */
+inline bool ProbeRecv(int socket, void* data, size_t length)
+{
+    uint8_t* bytes = (uint8_t*)data;
+    while (length > 0)
+    {
+        ssize_t received = recv(socket, bytes, length, 0);
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        length -= (size_t)received;
+    }
+    return true;
+}
+
+/**
+ * \brief Send exactly length bytes.
+ *
+ * @return false if the connection closed or failed first.
+ */
+inline bool ProbeSend(int socket, const void* data, size_t length)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    while (length > 0)
+    {
+        ssize_t sent = send(socket, bytes, length, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        bytes += sent;
+        length -= (size_t)sent;
+    }
+    return true;
+}
+
+#endif // PROBE_PROTOCOL_H
@@ -0,0 +1,234 @@
+// probe_server.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "probe_server.h"
+#include "probe_protocol.h"
+
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+ProbeServer::ProbeServer(const ProbeServerOptions& options) :
+    mOptions(options),
+    mListenSocket(-1),
+    mPort(0),
+    mStopping(false),
+    mTransactions(0)
+{
+}
+
+ProbeServer::~ProbeServer()
+{
+    Stop();
+}
+
+SDMReturnCode ProbeServer::Start()
+{
+    mListenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (mListenSocket < 0)
+    {
+        return SDMReturnCode_IOError;
+    }
+
+    int reuse = 1;
+    setsockopt(mListenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(mOptions.port);
+
+    socklen_t addressLength = sizeof(address);
+    if (bind(mListenSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+        listen(mListenSocket, 16) != 0 ||
+        getsockname(mListenSocket, (sockaddr*)&address, &addressLength) != 0)
+    {
+        close(mListenSocket);
+        mListenSocket = -1;
+        return SDMReturnCode_IOError;
+    }
+
+    mPort = ntohs(address.sin_port);
+    mStopping = false;
+    mAcceptThread = std::thread(&ProbeServer::acceptLoop, this);
+
+    return SDMReturnCode_Success;
+}
+
+void ProbeServer::Stop()
+{
+    if (mListenSocket < 0)
+    {
+        return;
+    }
+
+    // unblocks accept and every connection waiting in recv
+    mStopping = true;
+    shutdown(mListenSocket, SHUT_RDWR);
+    mAcceptThread.join();
+    close(mListenSocket);
+    mListenSocket = -1;
+
+    {
+        std::lock_guard<std::mutex> lock(mConnectionsMutex);
+        for (int connection : mConnections)
+        {
+            shutdown(connection, SHUT_RDWR);
+        }
+    }
+
+    for (std::thread& thread : mConnectionThreads)
+    {
+        thread.join();
+    }
+    mConnectionThreads.clear();
+}
+
+void ProbeServer::acceptLoop()
+{
+    while (!mStopping)
+    {
+        int connection = accept(mListenSocket, NULL, NULL);
+        if (connection < 0)
+        {
+            continue;
+        }
+
+        // requests are small and latency bound
+        int noDelay = 1;
+        setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        std::lock_guard<std::mutex> lock(mConnectionsMutex);
+        if (mStopping)
+        {
+            close(connection);
+            break;
+        }
+        mConnections.push_back(connection);
+        mConnectionThreads.push_back(std::thread(&ProbeServer::serve, this, connection));
+    }
+}
+
+void ProbeServer::serve(int connection)
+{
+    Sdc600Model model(mOptions.arch);
+    if (mOptions.setupModel)
+    {
+        mOptions.setupModel(model);
+    }
+
+    std::mt19937 random(std::random_device{}());
+    std::uniform_int_distribution<uint32_t> jitter(0, mOptions.jitterUs);
+
+    ListBuffers buffers;
+    std::vector<uint8_t> reply;
+
+    for (;;)
+    {
+        ProbeRequestHeader request;
+        if (!ProbeRecv(connection, &request, sizeof(request)))
+        {
+            break;
+        }
+
+        // the response goes out no sooner than a probe round trip after the request arrived
+        std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now() +
+            std::chrono::microseconds(mOptions.latencyUs + (mOptions.jitterUs != 0 ? jitter(random) : 0));
+
+        reply.clear();
+        bool complete = false;
+        bool ok = false;
+        if (request.magic == SDM_PROBE_MAGIC)
+        {
+            ok = serveList(connection, model, request.count, true, buffers, reply, complete);
+        }
+        else if (request.magic == SDM_PROBE_BATCH_MAGIC && request.count <= SDM_PROBE_MAX_LISTS)
+        {
+            ok = true;
+            bool perform = true;
+            for (uint32_t i = 0; i < request.count && ok; i++)
+            {
+                ProbeRequestHeader list;
+                ok = ProbeRecv(connection, &list, sizeof(list)) && list.magic == SDM_PROBE_MAGIC &&
+                     serveList(connection, model, list.count, perform, buffers, reply, complete);
+                perform = perform && complete;
+            }
+        }
+
+        if (!ok)
+        {
+            break;
+        }
+
+        std::this_thread::sleep_until(due);
+        mTransactions++;
+
+        if (!ProbeSend(connection, reply.data(), reply.size()))
+        {
+            break;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mConnectionsMutex);
+    mConnections.erase(std::remove(mConnections.begin(), mConnections.end(), connection), mConnections.end());
+    close(connection);
+}
+
+bool ProbeServer::serveList(int connection, Sdc600Model& model, uint32_t count, bool perform, ListBuffers& buffers, std::vector<uint8_t>& reply, bool& complete)
+{
+    complete = false;
+    if (count > SDM_PROBE_MAX_ACCESSES)
+    {
+        return false;
+    }
+
+    buffers.records.resize(count);
+    buffers.values.resize(count);
+    buffers.accesses.resize(count);
+    if (count > 0 && !ProbeRecv(connection, buffers.records.data(), count * sizeof(ProbeAccessRecord)))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const ProbeAccessRecord& record = buffers.records[i];
+        buffers.values[i] = record.value;
+        buffers.accesses[i].address = record.address;
+        buffers.accesses[i].op = record.op;
+        buffers.accesses[i].value = &buffers.values[i];
+        buffers.accesses[i].pollMask = record.pollMask;
+        buffers.accesses[i].retries = record.retries;
+    }
+
+    // a list after an incomplete one in the same batch is skipped
+    ProbeResponseHeader response = { SDMReturnCode_RequestFailed, 0 };
+    if (perform)
+    {
+        size_t completed = 0;
+        response.result = model.RegisterAccess(buffers.accesses.data(), count, &completed);
+        response.completed = (uint32_t)completed;
+        complete = response.result == SDMReturnCode_Success && completed == count;
+    }
+
+    size_t offset = reply.size();
+    reply.resize(offset + sizeof(response) + count * sizeof(uint32_t));
+    memcpy(&reply[offset], &response, sizeof(response));
+    if (count > 0)
+    {
+        memcpy(&reply[offset + sizeof(response)], buffers.values.data(), count * sizeof(uint32_t));
+    }
+
+    return true;
+}
@@ -0,0 +1,104 @@
+// probe_server.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Loopback TCP stand-in for a network attached debug probe.
+ *
+ * Serves register access lists (see probe_protocol.h) against an Sdc600Model, one model
+ * per connection, so every client sees its own target. Each transaction is answered no
+ * sooner than the configured latency plus a uniformly distributed jitter, to reproduce
+ * the round trip bound behaviour of a real probe.
+ */
+
+#ifndef PROBE_SERVER_H
+#define PROBE_SERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "probe_protocol.h"
+#include "sdc600_model.h"
+
+struct ProbeServerOptions
+{
+    uint16_t port;                  /*!< TCP port on 127.0.0.1, 0 for any free port */
+    uint32_t latencyUs;             /*!< Added to every transaction */
+    uint32_t jitterUs;              /*!< Up to this much more is added at random */
+    SDMDebugArchitecture arch;      /*!< Register layout of the modelled COM port */
+    std::function<void(Sdc600Model&)> setupModel; /*!< Called for each new connection, e.g. to set a message handler */
+
+    ProbeServerOptions() :
+        port(0),
+        latencyUs(0),
+        jitterUs(0),
+        arch(SDMDebugArchitecture_ArmADIv6)
+    {
+    }
+};
+
+class ProbeServer
+{
+public:
+    explicit ProbeServer(const ProbeServerOptions& options);
+
+    /**
+     * Stops the server.
+     */
+    ~ProbeServer();
+
+    /**
+     * \brief Listen and start accepting connections on a background thread.
+     *
+     * @return SDMReturnCode_IOError if the socket could not be bound.
+     */
+    SDMReturnCode Start();
+
+    /**
+     * \brief Close the listening socket and all connections, and wait for their threads.
+     */
+    void Stop();
+
+    /** Port listened on, valid after Start */
+    uint16_t Port() const { return mPort; }
+
+    /** Transactions served, over all connections */
+    uint64_t TransactionCount() const { return mTransactions; }
+
+private:
+    void acceptLoop();
+    // request buffers of a connection, reused across lists
+    struct ListBuffers
+    {
+        std::vector<ProbeAccessRecord> records;
+        std::vector<uint32_t> values;
+        std::vector<SDMRegisterAccess> accesses;
+    };
+
+    void serve(int socket);
+
+    // receives one list and appends its response to reply, false if the connection failed
+    bool serveList(int connection, Sdc600Model& model, uint32_t count, bool perform, ListBuffers& buffers, std::vector<uint8_t>& reply, bool& complete);
+
+    ProbeServerOptions mOptions;
+    int mListenSocket;
+    uint16_t mPort;
+    std::atomic<bool> mStopping;
+    std::atomic<uint64_t> mTransactions;
+
+    std::thread mAcceptThread;
+    std::mutex mConnectionsMutex;
+    std::vector<int> mConnections;
+    std::vector<std::thread> mConnectionThreads;
+};
+
+#endif // PROBE_SERVER_H
@@ -0,0 +1,251 @@
+// sdc600_model.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "sdc600_model.h"
+#include "ext_com_port_driver.h"
+
+#include <string.h>
+
+#define REG_DR  0x20
+#define REG_SR  0x2C
+#define REG_DBR 0x30
+
+#define REG_BASE_ADIv5 0x0
+#define REG_BASE_ADIv6 0xD00
+
+// SR[7:0] TX FIFO free space, the model drains TX immediately
+#define SR_TX_FREE 0x04
+
+Sdc600Model::Sdc600Model(SDMDebugArchitecture arch) :
+    mRegisterBase(arch == SDMDebugArchitecture_ArmADIv5 ? REG_BASE_ADIv5 : REG_BASE_ADIv6),
+    mHandler([](const std::vector<uint8_t>& message, std::vector<uint8_t>& response) { response = message; }),
+    mInMessage(false),
+    mEscape(false),
+    mLinkEstablished(false),
+    mMessageCount(0)
+{
+    static const uint8_t defaultId[SDC600_ID_LENGTH] = { 0x53, 0x44, 0x43, 0x36, 0x30, 0x30 }; // "SDC600"
+    memcpy(mId, defaultId, sizeof(mId));
+}
+
+void Sdc600Model::SetMessageHandler(MessageHandler handler)
+{
+    mHandler = handler;
+}
+
+void Sdc600Model::SetIdentification(const uint8_t id[SDC600_ID_LENGTH])
+{
+    memcpy(mId, id, sizeof(mId));
+}
+
+SDMReturnCode Sdc600Model::RegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted)
+{
+    *accessesCompleted = 0;
+
+    for (size_t i = 0; i < accessCount; i++)
+    {
+        const SDMRegisterAccess& access = accesses[i];
+        if (access.value == NULL || access.address < mRegisterBase)
+        {
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        uint32_t offset = (uint32_t)(access.address - mRegisterBase);
+        if (access.op == SDMRegisterAccessOp_Read)
+        {
+            if (!read(offset, *access.value))
+            {
+                return SDMReturnCode_TransferError;
+            }
+        }
+        else if (access.op == SDMRegisterAccessOp_Write)
+        {
+            if (!write(offset, *access.value))
+            {
+                return SDMReturnCode_TransferError;
+            }
+        }
+        else if (access.op == SDMRegisterAccessOp_Poll)
+        {
+            const uint32_t expected = *access.value & access.pollMask;
+            bool matched = false;
+            for (uint32_t attempt = 0; !matched && (attempt < access.retries || attempt == 0); attempt++)
+            {
+                uint32_t value = 0;
+                if (!read(offset, value))
+                {
+                    return SDMReturnCode_TransferError;
+                }
+
+                if ((value & access.pollMask) == expected)
+                {
+                    *access.value = value;
+                    matched = true;
+                }
+            }
+
+            if (!matched)
+            {
+                return SDMReturnCode_TimeoutError;
+            }
+        }
+        else
+        {
+            return SDMReturnCode_InvalidArgument;
+        }
+
+        (*accessesCompleted)++;
+    }
+
+    return SDMReturnCode_Success;
+}
+
+SDMReturnCode Sdc600Model::RegisterAccessCallback(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+{
+    if (refcon == NULL || accesses == NULL || accessesCompleted == NULL)
+    {
+        return SDMReturnCode_InvalidArgument;
+    }
+
+    return ((Sdc600Model*)refcon)->RegisterAccess(accesses, accessCount, accessesCompleted);
+}
+
+bool Sdc600Model::read(uint32_t offset, uint32_t& value)
+{
+    if (offset == REG_DR)
+    {
+        // an empty RX FIFO reads as null flags
+        uint8_t byte = FLAG__NULL;
+        if (!mRxFifo.empty())
+        {
+            byte = mRxFifo.front();
+            mRxFifo.pop_front();
+        }
+        value = 0xAFAFAF00UL | byte;
+        return true;
+    }
+
+    if (offset == REG_SR)
+    {
+        uint32_t rxLevel = mRxFifo.size() < 0xFF ? (uint32_t)mRxFifo.size() : 0xFF;
+        value = SR_TX_FREE | (rxLevel << 16);
+        return true;
+    }
+
+    return false;
+}
+
+bool Sdc600Model::write(uint32_t offset, uint32_t value)
+{
+    if (offset != REG_DR && offset != REG_DBR)
+    {
+        return false;
+    }
+
+    // byte lanes from the least significant, null flags fill unused lanes
+    for (int lane = 0; lane < 4; lane++)
+    {
+        receiveByte((uint8_t)(value >> (lane * 8)));
+    }
+
+    return true;
+}
+
+void Sdc600Model::receiveByte(uint8_t byte)
+{
+    switch (byte)
+    {
+    case FLAG__NULL:
+        break;
+
+    case FLAG_LPH1RA:
+        sendFlag(FLAG_LPH1RA);
+        break;
+
+    case FLAG_LPH1RL:
+        mLinkEstablished = false;
+        sendFlag(FLAG_LPH1RL);
+        break;
+
+    case FLAG_LPH2RA:
+        mLinkEstablished = true;
+        sendFlag(FLAG_LPH2RA);
+        break;
+
+    case FLAG_LPH2RL:
+        mLinkEstablished = false;
+        sendFlag(FLAG_LPH2RL);
+        break;
+
+    case FLAG_LPH2RR:
+        // remote reboot, the target comes back up with nothing to send
+        mRxFifo.clear();
+        mInMessage = false;
+        mEscape = false;
+        mLinkEstablished = false;
+        break;
+
+    case FLAG_IDR:
+        sendFrame(FLAG_IDA, mId, sizeof(mId));
+        break;
+
+    case FLAG_START:
+        mMessage.clear();
+        mInMessage = true;
+        mEscape = false;
+        break;
+
+    case FLAG_END:
+        if (mInMessage && mLinkEstablished)
+        {
+            std::vector<uint8_t> response;
+            mMessageCount++;
+            mHandler(mMessage, response);
+            if (!response.empty())
+            {
+                sendFrame(FLAG_START, response.data(), response.size());
+            }
+        }
+        mInMessage = false;
+        break;
+
+    case FLAG_ESC:
+        mEscape = true;
+        break;
+
+    default:
+        // other flags carry no data, escaped data bytes are never in the flag range
+        if (mInMessage && (byte < 0xA0 || byte >= 0xC0))
+        {
+            mMessage.push_back(mEscape ? (uint8_t)(byte | 0x80) : byte);
+            mEscape = false;
+        }
+        break;
+    }
+}
+
+void Sdc600Model::sendFlag(uint8_t flag)
+{
+    mRxFifo.push_back(flag);
+}
+
+void Sdc600Model::sendFrame(uint8_t startFlag, const uint8_t* data, size_t length)
+{
+    mRxFifo.push_back(startFlag);
+    for (size_t i = 0; i < length; i++)
+    {
+        // flag valued bytes are escaped with bit 7 inverted
+        if (data[i] >= 0xA0 && data[i] < 0xC0)
+        {
+            mRxFifo.push_back(FLAG_ESC);
+            mRxFifo.push_back(data[i] & ~0x80);
+        }
+        else
+        {
+            mRxFifo.push_back(data[i]);
+        }
+    }
+    mRxFifo.push_back(FLAG_END);
+}
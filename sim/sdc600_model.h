@@ -0,0 +1,91 @@
+// sdc600_model.h
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Register level model of an SDC-600 External COM Port and its target.
+ *
+ * The model answers DR, SR and DBR accesses the way the External COM Port Driver
+ * expects: link phase flags and IDR are acknowledged by the modelled Internal COM
+ * Port, and each START ... END message written by the debugger is unescaped and
+ * passed to a message handler, whose response is queued in the RX FIFO framed and
+ * escaped. The default handler echoes every message back.
+ *
+ * The TX FIFO drains immediately, so SR always reports free space.
+ */
+
+#ifndef SDC600_MODEL_H
+#define SDC600_MODEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "secure_debug_manager.h"
+
+#define SDC600_ID_LENGTH 6
+
+class Sdc600Model
+{
+public:
+    /**
+     * \brief Handles a message received by the target.
+     *
+     * @param[in] message Unescaped message bytes, without START and END.
+     * @param[out] response Message to send back, empty for none.
+     */
+    using MessageHandler = std::function<void(const std::vector<uint8_t>& message, std::vector<uint8_t>& response)>;
+
+    explicit Sdc600Model(SDMDebugArchitecture arch);
+
+    void SetMessageHandler(MessageHandler handler);
+
+    /**
+     * \brief Set the platform ID bytes sent after IDA in response to IDR.
+     */
+    void SetIdentification(const uint8_t id[SDC600_ID_LENGTH]);
+
+    /**
+     * \brief Perform register accesses, with the semantics of SDMRegisterAccessCallback.
+     *
+     * Polls read the register until (value & pollMask) == (*value & pollMask), up to
+     * retries reads, and return SDMReturnCode_TimeoutError if it never matches.
+     */
+    SDMReturnCode RegisterAccess(const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted);
+
+    /**
+     * \brief SDMRegisterAccessCallback, with the Sdc600Model as refcon.
+     */
+    static SDMReturnCode RegisterAccessCallback(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon);
+
+    /** Number of messages passed to the message handler */
+    size_t MessageCount() const { return mMessageCount; }
+
+    bool LinkEstablished() const { return mLinkEstablished; }
+
+private:
+    bool read(uint32_t offset, uint32_t& value);
+    bool write(uint32_t offset, uint32_t value);
+    void receiveByte(uint8_t byte);
+    void sendFlag(uint8_t flag);
+    void sendFrame(uint8_t startFlag, const uint8_t* data, size_t length);
+
+    uint32_t mRegisterBase;
+    MessageHandler mHandler;
+    uint8_t mId[SDC600_ID_LENGTH];
+
+    std::deque<uint8_t> mRxFifo; // towards the debugger
+    std::vector<uint8_t> mMessage;
+    bool mInMessage;
+    bool mEscape;
+    bool mLinkEstablished;
+    size_t mMessageCount;
+};
+
+#endif // SDC600_MODEL_H
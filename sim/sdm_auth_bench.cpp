@@ -0,0 +1,190 @@
+// sdm_auth_bench.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Measures end to end authentication through the Secure Debug Manager library.
+ *
+ * Runs SDMOpenEx, SDMAuthenticate and SDMClose against an in-process SDC-600 model and
+ * ADAC target emulation, with an optional delay per register access callback standing
+ * in for the probe round trip, and reports the time and round trips of each call.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+#include "adac_target.h"
+#include "sdc600_model.h"
+
+namespace
+{
+    const uint8_t PSADBG_ID[SDC600_ID_LENGTH] = { 0x50, 0x53, 0x41, 0x44, 0x42, 0x47 };
+
+    struct Bench
+    {
+        Sdc600Model* target;
+        std::chrono::microseconds latency;
+        unsigned long long roundTrips;
+    };
+
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--sessions N] [--latency US] [--adiv5] KEY_FILE CHAIN_FILE\n", binname);
+        fprintf(stderr, "\t--sessions N : Sessions run. Default 10.\n");
+        fprintf(stderr, "\t--latency US : Microseconds added to every register access callback. Default 0.\n");
+        fprintf(stderr, "\t--adiv5 : Model a COM-AP (ADIv5) register layout rather than an APBCOM (ADIv6).\n");
+        fprintf(stderr, "\tKEY_FILE, CHAIN_FILE : Credentials, as for SDMOpenExtensions.\n");
+    }
+
+    SDMReturnCode registerAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+    {
+        Bench* bench = (Bench*)refcon;
+        bench->roundTrips++;
+        if (bench->latency.count() > 0)
+        {
+            std::this_thread::sleep_for(bench->latency);
+        }
+        return bench->target->RegisterAccess(accesses, accessCount, accessesCompleted);
+    }
+
+    SDMReturnCode resetCallback(SDMResetType resetType, void* refcon)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void PrintTimes(const char* name, std::vector<double>& times, unsigned long long roundTrips)
+    {
+        std::sort(times.begin(), times.end());
+        double total = 0;
+        for (double time : times)
+        {
+            total += time;
+        }
+        printf("%-12s min %.3f ms, median %.3f ms, max %.3f ms, mean %.3f ms, %.1f round trips\n", name,
+               times.front(), times[times.size() / 2], times.back(), total / (double)times.size(),
+               (double)roundTrips / (double)times.size());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    unsigned long sessions = 10;
+    unsigned long latencyUs = 0;
+    SDMDebugArchitecture arch = SDMDebugArchitecture_ArmADIv6;
+
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (strcmp(argv[arg], "--sessions") == 0 && arg + 1 < argc)
+        {
+            sessions = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--latency") == 0 && arg + 1 < argc)
+        {
+            latencyUs = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--adiv5") == 0)
+        {
+            arch = SDMDebugArchitecture_ArmADIv5;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - arg != 2 || sessions == 0)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<double> openTimes;
+    std::vector<double> authenticateTimes;
+    std::vector<double> closeTimes;
+    unsigned long long openRoundTrips = 0;
+    unsigned long long authenticateRoundTrips = 0;
+    unsigned long long closeRoundTrips = 0;
+
+    for (unsigned long i = 0; i < sessions; i++)
+    {
+        Sdc600Model target(arch);
+        target.SetIdentification(PSADBG_ID);
+        AdacTarget adac;
+        adac.Attach(target);
+
+        Bench bench = { &target, std::chrono::microseconds(latencyUs), 0 };
+
+        SDMCallbacks callbacks;
+        memset(&callbacks, 0, sizeof(callbacks));
+        callbacks.registerAccess = registerAccess;
+        callbacks.resetStart = resetCallback;
+        callbacks.resetFinish = resetCallback;
+
+        SDMOpenParameters params;
+        memset(&params, 0, sizeof(params));
+        params.version.major = SDMVersion_CurrentMajor;
+        params.version.minor = SDMVersion_CurrentMinor;
+        params.debugArchitecture = arch;
+        params.callbacks = &callbacks;
+        params.refcon = &bench;
+
+        SDMOpenExtensions extensions;
+        memset(&extensions, 0, sizeof(extensions));
+        extensions.size = sizeof(extensions);
+        extensions.privateKeyFile = argv[arg];
+        extensions.trustChainFile = argv[arg + 1];
+
+        SDMHandle handle = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        SDMReturnCode result = SDMOpenEx(&handle, &params, &extensions);
+        openTimes.push_back(elapsedMs(start));
+        openRoundTrips += bench.roundTrips;
+        if (result != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: SDMOpenEx failed with code 0x%08x\n", result);
+            return EXIT_FAILURE;
+        }
+
+        bench.roundTrips = 0;
+        start = std::chrono::steady_clock::now();
+        result = SDMAuthenticate(handle, NULL);
+        authenticateTimes.push_back(elapsedMs(start));
+        authenticateRoundTrips += bench.roundTrips;
+        if (result != SDMReturnCode_Success || !adac.Authenticated())
+        {
+            fprintf(stderr, "Error: SDMAuthenticate failed with code 0x%08x, %zu target failures\n", result, adac.Failures());
+            SDMClose(handle);
+            return EXIT_FAILURE;
+        }
+
+        bench.roundTrips = 0;
+        start = std::chrono::steady_clock::now();
+        SDMClose(handle);
+        closeTimes.push_back(elapsedMs(start));
+        closeRoundTrips += bench.roundTrips;
+    }
+
+    PrintTimes("Open:", openTimes, openRoundTrips);
+    PrintTimes("Authenticate:", authenticateTimes, authenticateRoundTrips);
+    PrintTimes("Close:", closeTimes, closeRoundTrips);
+
+    return EXIT_SUCCESS;
+}
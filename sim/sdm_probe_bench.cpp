@@ -0,0 +1,170 @@
+// sdm_probe_bench.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Measures External COM Port Driver round trips against a ProbeServer.
+ *
+ * Initializes the COM port link, then sends messages to the echoing target and
+ * receives them back, reporting the time and register access round trips taken by
+ * each phase. Use it to compare driver settings under a given probe latency.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "ext_com_port_driver.h"
+#include "probe_client.h"
+#include "sdc600_model.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--host ADDRESS] [--messages N] [--size BYTES] [--poll-mode host|probe] [--max-list N] [--lists] [--block] [--adiv5] PORT\n", binname);
+        fprintf(stderr, "\t--host ADDRESS : Server address. Default 127.0.0.1.\n");
+        fprintf(stderr, "\t--messages N : Messages echoed. Default 10.\n");
+        fprintf(stderr, "\t--size BYTES : Bytes per message. Default 256.\n");
+        fprintf(stderr, "\t--poll-mode : Driver poll mode, as the poll_mode configuration key. Default host.\n");
+        fprintf(stderr, "\t--max-list N : Driver maximum register accesses per callback. Default 0, no limit.\n");
+        fprintf(stderr, "\t--lists : Send the lists split by --max-list in one round trip, with the vectored callback.\n");
+        fprintf(stderr, "\t--block : Transmit with DBR blocking writes instead of polling SR.\n");
+        fprintf(stderr, "\t--adiv5 : The server models a COM-AP (ADIv5).\n");
+        fprintf(stderr, "\tPORT : Server port.\n");
+    }
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    const char* host = "127.0.0.1";
+    unsigned long messages = 10;
+    unsigned long size = 256;
+    bool block = false;
+    bool lists = false;
+    SDMDebugArchitecture arch = SDMDebugArchitecture_ArmADIv6;
+    ECPDConfig config;
+
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (strcmp(argv[arg], "--host") == 0 && arg + 1 < argc)
+        {
+            host = argv[++arg];
+        }
+        else if (strcmp(argv[arg], "--messages") == 0 && arg + 1 < argc)
+        {
+            messages = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--size") == 0 && arg + 1 < argc)
+        {
+            size = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--poll-mode") == 0 && arg + 1 < argc)
+        {
+            config.pollMode = strcmp(argv[++arg], "probe") == 0 ? ECPD_POLL_PROBE : ECPD_POLL_HOST;
+        }
+        else if (strcmp(argv[arg], "--max-list") == 0 && arg + 1 < argc)
+        {
+            config.maxAccessListLength = strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--lists") == 0)
+        {
+            lists = true;
+        }
+        else if (strcmp(argv[arg], "--block") == 0)
+        {
+            block = true;
+        }
+        else if (strcmp(argv[arg], "--adiv5") == 0)
+        {
+            arch = SDMDebugArchitecture_ArmADIv5;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (argc - arg != 1 || size == 0)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ProbeClient client;
+    if (client.Connect(host, (uint16_t)strtoul(argv[arg], NULL, 0)) != SDMReturnCode_Success)
+    {
+        fprintf(stderr, "Error: failed to connect to %s:%s\n", host, argv[arg]);
+        return EXIT_FAILURE;
+    }
+
+    SDMDeviceDescriptor comDevice;
+    memset(&comDevice, 0, sizeof(comDevice));
+    comDevice.deviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+
+    ExternalComPortDriver driver(comDevice, arch, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client, config);
+    if (lists)
+    {
+        driver.SetRegisterAccessListsCallback(ProbeClient::RegisterAccessVectorCallback);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint8_t id[SDC600_ID_LENGTH];
+    SDMReturnCode result = driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id));
+    if (result != SDMReturnCode_Success)
+    {
+        fprintf(stderr, "Error: EComPort_Init failed with code 0x%08x\n", result);
+        return EXIT_FAILURE;
+    }
+    printf("Init: %.3f ms, %llu round trips\n", elapsedMs(start), (unsigned long long)client.TransactionCount());
+
+    std::vector<uint8_t> message(size);
+    std::vector<uint8_t> echo(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        // covers the flag range, so escaping is exercised
+        message[i] = (uint8_t)(i * 7);
+    }
+
+    uint64_t transactions = client.TransactionCount();
+    start = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < messages; i++)
+    {
+        size_t actualLength = 0;
+        result = driver.EComPort_Tx(message.data(), message.size(), &actualLength, block);
+        if (result == SDMReturnCode_Success)
+        {
+            result = driver.EComPort_Rx(echo.data(), echo.size(), &actualLength);
+        }
+
+        if (result != SDMReturnCode_Success || actualLength != size || echo != message)
+        {
+            fprintf(stderr, "Error: message %lu failed with code 0x%08x\n", i, result);
+            return EXIT_FAILURE;
+        }
+    }
+
+    double messagesMs = elapsedMs(start);
+    transactions = client.TransactionCount() - transactions;
+    printf("Echo: %lu x %lu bytes in %.3f ms, %.3f ms and %.1f round trips per message\n",
+           messages, size, messagesMs,
+           messages > 0 ? messagesMs / (double)messages : 0.0,
+           messages > 0 ? (double)transactions / (double)messages : 0.0);
+
+    driver.EComPort_Finalize();
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,85 @@
+// sdm_probe_server.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Runs a ProbeServer until interrupted.
+ *
+ * Each connection gets its own SDC-600 model whose target echoes every message.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "probe_server.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--port N] [--latency US] [--jitter US] [--adiv5]\n", binname);
+        fprintf(stderr, "\t--port N : TCP port on 127.0.0.1. Default: any free port, which is printed.\n");
+        fprintf(stderr, "\t--latency US : Microseconds added to every register access list.\n");
+        fprintf(stderr, "\t--jitter US : Up to this many more microseconds added at random.\n");
+        fprintf(stderr, "\t--adiv5 : Model a COM-AP (ADIv5) register layout rather than an APBCOM (ADIv6).\n");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    ProbeServerOptions options;
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--port") == 0 && arg + 1 < argc)
+        {
+            options.port = (uint16_t)strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--latency") == 0 && arg + 1 < argc)
+        {
+            options.latencyUs = (uint32_t)strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--jitter") == 0 && arg + 1 < argc)
+        {
+            options.jitterUs = (uint32_t)strtoul(argv[++arg], NULL, 0);
+        }
+        else if (strcmp(argv[arg], "--adiv5") == 0)
+        {
+            options.arch = SDMDebugArchitecture_ArmADIv5;
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    ProbeServer server(options);
+    if (server.Start() != SDMReturnCode_Success)
+    {
+        fprintf(stderr, "Error: failed to listen on port %u\n", (unsigned)options.port);
+        return EXIT_FAILURE;
+    }
+
+    printf("Listening on 127.0.0.1:%u, latency %u us, jitter %u us\n", (unsigned)server.Port(), options.latencyUs, options.jitterUs);
+    fflush(stdout);
+
+    int signal = 0;
+    sigwait(&signals, &signal);
+
+    server.Stop();
+    printf("%llu transactions served\n", (unsigned long long)server.TransactionCount());
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,182 @@
+// adac_target_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "adac_target.h"
+
+#include <string.h>
+
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    std::vector<uint8_t> request(uint16_t command, const std::vector<uint8_t>& data = std::vector<uint8_t>())
+    {
+        std::vector<uint8_t> message(sizeof(request_packet_t) + data.size(), 0);
+        request_packet_t* packet = (request_packet_t*)message.data();
+        packet->command = command;
+        packet->data_count = (uint16_t)(data.size() / sizeof(uint32_t));
+        if (!data.empty())
+        {
+            memcpy(packet->data, data.data(), data.size());
+        }
+        return message;
+    }
+
+    // a certificate or token TLV, with the header fields the target checks
+    std::vector<uint8_t> element(uint16_t type, uint8_t signatureType, uint8_t keyType, size_t length = 64)
+    {
+        std::vector<uint8_t> tlv(sizeof(psa_tlv_t) + length, 0xA5);
+        psa_tlv_t* header = (psa_tlv_t*)tlv.data();
+        header->_reserved = 0;
+        header->type_id = type;
+        header->length_in_bytes = (uint32_t)length;
+        header->value[0] = 1;
+        header->value[1] = 0;
+        header->value[2] = signatureType;
+        header->value[3] = keyType;
+        return tlv;
+    }
+
+    uint16_t send(AdacTarget& target, const std::vector<uint8_t>& message, std::vector<uint8_t>* data = NULL)
+    {
+        std::vector<uint8_t> response;
+        target.HandleMessage(message, response);
+        EXPECT_GE(response.size(), sizeof(response_packet_t));
+
+        const response_packet_t* packet = (const response_packet_t*)response.data();
+        EXPECT_EQ(sizeof(response_packet_t) + packet->data_count * sizeof(uint32_t), response.size());
+        if (data != NULL)
+        {
+            data->assign(response.begin() + sizeof(response_packet_t), response.end());
+        }
+        return packet->status;
+    }
+}
+
+TEST(AdacTargetTest, Authenticates)
+{
+    AdacTarget target(1);
+
+    std::vector<uint8_t> data;
+    ASSERT_EQ(ADAC_SUCCESS, send(target, request(ADAC_AUTH_START_CMD), &data));
+    ASSERT_EQ(sizeof(psa_auth_challenge_t), data.size());
+
+    EXPECT_EQ(ADAC_NEED_MORE_DATA, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256))));
+    EXPECT_EQ(ADAC_NEED_MORE_DATA, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P521_SHA512))));
+    EXPECT_FALSE(target.Authenticated());
+    EXPECT_EQ(ADAC_SUCCESS, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_TOKEN, ECDSA_P521_SHA512, 0))));
+
+    EXPECT_TRUE(target.Authenticated());
+    EXPECT_EQ(2u, target.CertificateCount());
+    EXPECT_EQ(1u, target.Authentications());
+    EXPECT_EQ(0u, target.Failures());
+
+    EXPECT_EQ(ADAC_SUCCESS, send(target, request(ADAC_LOCK_DEBUG_CMD)));
+    EXPECT_FALSE(target.Authenticated());
+}
+
+TEST(AdacTargetTest, ChallengesDiffer)
+{
+    AdacTarget target(1);
+
+    std::vector<uint8_t> first;
+    std::vector<uint8_t> second;
+    send(target, request(ADAC_AUTH_START_CMD), &first);
+    send(target, request(ADAC_AUTH_START_CMD), &second);
+    EXPECT_NE(first, second);
+
+    // reproducible from the seed
+    AdacTarget again(1);
+    std::vector<uint8_t> replayed;
+    send(again, request(ADAC_AUTH_START_CMD), &replayed);
+    EXPECT_EQ(first, replayed);
+}
+
+TEST(AdacTargetTest, RejectsOutOfOrderResponses)
+{
+    AdacTarget target(1);
+
+    // no challenge issued
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256))));
+
+    // token without certificates
+    send(target, request(ADAC_AUTH_START_CMD));
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_TOKEN, ECDSA_P256_SHA256, 0))));
+
+    // the failure ends the attempt
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256))));
+    EXPECT_EQ(3u, target.Failures());
+    EXPECT_FALSE(target.Authenticated());
+}
+
+TEST(AdacTargetTest, RejectsMismatchedSignatureTypes)
+{
+    AdacTarget target(1);
+
+    // root not self-signed
+    send(target, request(ADAC_AUTH_START_CMD));
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, RSA_3072_SHA256))));
+
+    // token not signed with the leaf key
+    send(target, request(ADAC_AUTH_START_CMD));
+    EXPECT_EQ(ADAC_NEED_MORE_DATA, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256))));
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_TOKEN, RSA_3072_SHA256, 0))));
+
+    EXPECT_EQ(2u, target.Failures());
+}
+
+TEST(AdacTargetTest, RejectsTruncatedElements)
+{
+    AdacTarget target(1);
+    send(target, request(ADAC_AUTH_START_CMD));
+
+    std::vector<uint8_t> certificate = element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256);
+    ((psa_tlv_t*)certificate.data())->length_in_bytes += 4;
+    EXPECT_EQ(ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, certificate)));
+
+    // packet shorter than its data count
+    std::vector<uint8_t> message = request(ADAC_AUTH_START_CMD);
+    ((request_packet_t*)message.data())->data_count = 4;
+    EXPECT_EQ(ADAC_INVALID_COMMAND, send(target, message));
+}
+
+TEST(AdacTargetTest, VerifierDecides)
+{
+    AdacTarget target(1);
+
+    psa_auth_challenge_t issued;
+    size_t verified = 0;
+    bool grant = false;
+    target.SetVerifier([&](const std::vector<std::vector<uint8_t>>& certificates, const std::vector<uint8_t>& token, const psa_auth_challenge_t& challenge)
+    {
+        verified = certificates.size();
+        EXPECT_EQ(0, memcmp(&issued, &challenge, sizeof(challenge)));
+        EXPECT_EQ(PSA_BINARY_TOKEN, ((const psa_tlv_t*)token.data())->type_id);
+        return grant;
+    });
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        std::vector<uint8_t> data;
+        send(target, request(ADAC_AUTH_START_CMD), &data);
+        memcpy(&issued, data.data(), sizeof(issued));
+        send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_CRT, ECDSA_P256_SHA256, ECDSA_P256_SHA256)));
+        EXPECT_EQ(grant ? ADAC_SUCCESS : ADAC_FAILURE, send(target, request(ADAC_AUTH_RESPONSE_CMD, element(PSA_BINARY_TOKEN, ECDSA_P256_SHA256, 0))));
+        EXPECT_EQ(1u, verified);
+        EXPECT_EQ(grant, target.Authenticated());
+        grant = true;
+    }
+}
+
+TEST(AdacTargetTest, UnknownCommand)
+{
+    AdacTarget target(1);
+    EXPECT_EQ(ADAC_INVALID_COMMAND, send(target, request(0x99)));
+    EXPECT_EQ(ADAC_SUCCESS, send(target, request(ADAC_DISCOVERY_CMD)));
+}
@@ -0,0 +1,177 @@
+// authentication_bundle_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "authentication_bundle.h"
+#include "psa_adac.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    // a bundle with one certificate, as laid out by sdm_bundle_tool
+    struct BundleImage
+    {
+        SDMBundleHeader header;
+        char keyReference[16];
+        uint32_t chain[6];
+        SDMBundleCertificate certificate;
+        uint32_t frame[2];
+
+        BundleImage() : header(), keyReference(), chain(), certificate(), frame()
+        {
+            header.magic = SDM_BUNDLE_MAGIC;
+            header.version = SDM_BUNDLE_VERSION;
+            header.headerSize = sizeof(header);
+            header.flags = SDM_BUNDLE_FLAG_FRAMES;
+            header.totalSize = sizeof(*this);
+            header.keyReferenceType = SDM_BUNDLE_KEY_FILE;
+            header.keyReferenceOffset = offsetof(BundleImage, keyReference);
+            header.keyReferenceSize = sizeof(keyReference);
+            header.chainOffset = offsetof(BundleImage, chain);
+            header.chainSize = sizeof(chain);
+            header.certificateIndexOffset = offsetof(BundleImage, certificate);
+            header.certificateCount = 1;
+            header.frameWordBytes = 4;
+            strcpy(keyReference, "keys/key.pem");
+
+            // a certificate TLV with 8 value bytes, after a 4 byte TLV it is not indexed
+            psa_tlv_t* tlv = (psa_tlv_t*)&chain[1];
+            tlv->type_id = PSA_BINARY_CRT;
+            tlv->length_in_bytes = 8;
+
+            certificate.tlvOffset = sizeof(uint32_t);
+            certificate.tlvSize = sizeof(psa_tlv_t) + 8;
+            certificate.command = ADAC_AUTH_RESPONSE_CMD;
+            certificate.dataCount = (uint16_t)(certificate.tlvSize / sizeof(uint32_t));
+            certificate.frameOffset = offsetof(BundleImage, frame);
+            certificate.frameWordCount = 2;
+        }
+    };
+
+    class AuthenticationBundleTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            char path[] = "/tmp/sdm_bundle_test.XXXXXX";
+            int fd = mkstemp(path);
+            ASSERT_GE(fd, 0);
+            close(fd);
+            bundlePath = path;
+        }
+
+        virtual void TearDown()
+        {
+            unlink(bundlePath.c_str());
+        }
+
+    protected:
+        ArenaPtr<AuthenticationBundle> open(const BundleImage& image, size_t size = sizeof(BundleImage), SessionArena* arena = NULL)
+        {
+            FILE* file = fopen(bundlePath.c_str(), "wb");
+            EXPECT_TRUE(file != NULL);
+            if (file == NULL)
+            {
+                return ArenaPtr<AuthenticationBundle>();
+            }
+            EXPECT_EQ(size, fwrite(&image, 1, size, file));
+            fclose(file);
+            return AuthenticationBundle::Open(bundlePath.c_str(), arena);
+        }
+
+        std::string bundlePath;
+        BundleImage image;
+    };
+}
+
+TEST_F(AuthenticationBundleTest, Valid)
+{
+    ArenaPtr<AuthenticationBundle> bundle = open(image);
+    ASSERT_TRUE(bundle != nullptr);
+    EXPECT_EQ("/tmp/keys/key.pem", bundle->KeyFile());
+    ASSERT_EQ(1u, bundle->CertificateCount());
+    EXPECT_EQ(sizeof(psa_tlv_t) + 8, bundle->Certificate(0).tlvSize);
+    EXPECT_EQ((const uint8_t*)bundle->Chain() + sizeof(uint32_t), bundle->CertificateTlv(0));
+    EXPECT_TRUE(bundle->HasFrames());
+}
+
+TEST_F(AuthenticationBundleTest, InArena)
+{
+    SessionArena arena(NULL, 0);
+    ArenaPtr<AuthenticationBundle> bundle = open(image, sizeof(image), &arena);
+    ASSERT_TRUE(bundle != nullptr);
+    EXPECT_EQ(&arena, bundle.get_deleter().arena);
+    EXPECT_EQ(1u, bundle->CertificateCount());
+}
+
+TEST_F(AuthenticationBundleTest, Truncated)
+{
+    EXPECT_TRUE(open(image, sizeof(image) - sizeof(uint32_t)) == nullptr);
+    EXPECT_TRUE(open(image, sizeof(SDMBundleHeader) - 1) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, UnsupportedFormat)
+{
+    image.header.version = SDM_BUNDLE_VERSION + 1;
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, KeyReferenceNotTerminated)
+{
+    memset(image.keyReference, 'k', sizeof(image.keyReference));
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, CertificateOutsideChain)
+{
+    image.certificate.tlvOffset = sizeof(image.chain) - sizeof(uint32_t);
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, CertificateSmallerThanTlvHeader)
+{
+    image.certificate.tlvSize = sizeof(psa_tlv_t) - sizeof(uint32_t);
+    image.certificate.dataCount = (uint16_t)(image.certificate.tlvSize / sizeof(uint32_t));
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, CertificateLengthDisagreesWithIndex)
+{
+    // the mapped TLV claims more than the index, whose size is the one bounds checked
+    ((psa_tlv_t*)&image.chain[1])->length_in_bytes = 0x10000;
+    EXPECT_TRUE(open(image) == nullptr);
+
+    ((psa_tlv_t*)&image.chain[1])->length_in_bytes = 4;
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, PrecomputedRequestDisagrees)
+{
+    image.certificate.command = ADAC_AUTH_START_CMD;
+    EXPECT_TRUE(open(image) == nullptr);
+
+    image.certificate.command = ADAC_AUTH_RESPONSE_CMD;
+    image.certificate.dataCount++;
+    EXPECT_TRUE(open(image) == nullptr);
+}
+
+TEST_F(AuthenticationBundleTest, FrameOutsideBundle)
+{
+    image.certificate.frameWordCount = 3;
+    EXPECT_TRUE(open(image) == nullptr);
+
+    image.certificate.frameWordCount = 0;
+    EXPECT_TRUE(open(image) == nullptr);
+}
@@ -0,0 +1,99 @@
+// certificate_frame_cache_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "certificate_frame_cache.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    // a chain only this test uses, the cache is process wide
+    std::vector<uint8_t> chain(uint8_t test, uint8_t index)
+    {
+        return std::vector<uint8_t>({ 'c', 'f', 'c', test, index, 0x5A, 0xA5 });
+    }
+
+    CertificateFrameCache::Frames frames(uint32_t word)
+    {
+        return CertificateFrameCache::Frames(1, std::vector<uint32_t>(3, word));
+    }
+
+    std::shared_ptr<const CertificateFrameCache::Frames> find(const std::vector<uint8_t>& key)
+    {
+        return CertificateFrameCache::Find(key.data(), key.size());
+    }
+
+    std::shared_ptr<const CertificateFrameCache::Frames> insert(const std::vector<uint8_t>& key, uint32_t word)
+    {
+        return CertificateFrameCache::Insert(key.data(), key.size(), frames(word));
+    }
+}
+
+TEST(CertificateFrameCacheTest, FindInserted)
+{
+    std::vector<uint8_t> key = chain(1, 0);
+    EXPECT_TRUE(find(key) == nullptr);
+
+    std::shared_ptr<const CertificateFrameCache::Frames> inserted = insert(key, 0xAFAFAF11);
+    ASSERT_TRUE(inserted != nullptr);
+    EXPECT_EQ(frames(0xAFAFAF11), *inserted);
+    EXPECT_EQ(inserted, find(key));
+
+    // same size, different contents
+    EXPECT_TRUE(find(chain(1, 1)) == nullptr);
+
+    // inserting again replaces the frames
+    insert(key, 0xAFAFAF22);
+    ASSERT_TRUE(find(key) != nullptr);
+    EXPECT_EQ(frames(0xAFAFAF22), *find(key));
+}
+
+TEST(CertificateFrameCacheTest, EmptyChainNotCached)
+{
+    std::shared_ptr<const CertificateFrameCache::Frames> inserted = CertificateFrameCache::Insert(NULL, 0, frames(1));
+    ASSERT_TRUE(inserted != nullptr);
+    EXPECT_EQ(frames(1), *inserted);
+    EXPECT_TRUE(CertificateFrameCache::Find(NULL, 0) == nullptr);
+}
+
+TEST(CertificateFrameCacheTest, EvictsLeastRecentlyUsed)
+{
+    const size_t entries = CertificateFrameCache::MAX_ENTRIES;
+    for (size_t i = 0; i < entries; i++)
+    {
+        insert(chain(2, (uint8_t)i), (uint32_t)i);
+    }
+
+    // a lookup makes the oldest chain the most recently used
+    EXPECT_TRUE(find(chain(2, 0)) != nullptr);
+
+    insert(chain(2, (uint8_t)entries), (uint32_t)entries);
+    EXPECT_TRUE(find(chain(2, 1)) == nullptr);
+    for (size_t i = 0; i <= entries; i++)
+    {
+        EXPECT_EQ(i != 1, find(chain(2, (uint8_t)i)) != nullptr) << i;
+    }
+}
+
+TEST(CertificateFrameCacheTest, EvictedFramesStayValid)
+{
+    std::shared_ptr<const CertificateFrameCache::Frames> held = insert(chain(3, 0), 0xAFAFAF33);
+    for (size_t i = 1; i <= CertificateFrameCache::MAX_ENTRIES; i++)
+    {
+        insert(chain(3, (uint8_t)i), (uint32_t)i);
+    }
+
+    // a session still sending the frames keeps them
+    EXPECT_TRUE(find(chain(3, 0)) == nullptr);
+    ASSERT_TRUE(held != nullptr);
+    EXPECT_EQ(frames(0xAFAFAF33), *held);
+}
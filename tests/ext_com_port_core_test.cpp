@@ -0,0 +1,60 @@
+// ext_com_port_core_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "ext_com_port_core.h"
+
+#include <string.h>
+
+#include <vector>
+
+using namespace testing;
+
+TEST(ExtComPortCoreTest, ArchitectureRegisters)
+{
+    typedef ComPortRegisters<SDMDebugArchitecture_ArmADIv5> V5;
+    typedef ComPortRegisters<SDMDebugArchitecture_ArmADIv6> V6;
+
+    EXPECT_EQ(0x20u, V5::DR);
+    EXPECT_EQ(0x2Cu, V5::SR);
+    EXPECT_EQ(0x30u, V5::DBR);
+    EXPECT_EQ(0xD20u, V6::DR);
+    EXPECT_EQ(0xD2Cu, V6::SR);
+    EXPECT_EQ(0xD30u, V6::DBR);
+
+    EXPECT_EQ(V6::DR, V6::Tx<false>::ADDRESS);
+    EXPECT_EQ(V6::DBR, V6::Tx<true>::ADDRESS);
+}
+
+TEST(ExtComPortCoreTest, FillAccesses)
+{
+    std::vector<SDMRegisterAccess> accesses(5);
+    std::vector<uint32_t> values(5);
+    memset(accesses.data(), 0xFF, accesses.size() * sizeof(SDMRegisterAccess));
+
+    ECPDFillAccesses<ComPortRegisters<SDMDebugArchitecture_ArmADIv6>::DBR, SDMRegisterAccessOp_Write>(accesses.data(), values.data(), 5);
+
+    for (size_t i = 0; i < 5; i++)
+    {
+        EXPECT_EQ(0xD30u, accesses[i].address);
+        EXPECT_EQ((SDMRegisterAccessOp)SDMRegisterAccessOp_Write, accesses[i].op);
+        EXPECT_EQ(&values[i], accesses[i].value);
+        EXPECT_EQ(0u, accesses[i].pollMask);
+        EXPECT_EQ(0u, accesses[i].retries);
+    }
+}
+
+TEST(ExtComPortCoreTest, UnpackReads)
+{
+    const uint32_t values[3] = { DR_NULL_FILL_WORD(0xA0), DR_NULL_FILL_WORD(0x12), 0x000000AF };
+    uint8_t bytes[3] = { 0, 0, 0 };
+
+    ECPDUnpackReads(values, 3, bytes);
+
+    EXPECT_EQ(0xA0, bytes[0]);
+    EXPECT_EQ(0x12, bytes[1]);
+    EXPECT_EQ(0xAF, bytes[2]);
+}
@@ -34,6 +34,7 @@ namespace
         void ExpectSendFlag(Sequence&, uint32_t&, uint8_t);
         void ExpectWaitFlag(Sequence&, uint8_t);
         void ExpectWaitFlagNull(Sequence&);
+        void ExpectPollFlag(Sequence&, uint8_t, SDMReturnCode);
         void ExpectRxInt(Sequence&, uint8_t*, size_t);
         void ExpectTx(Sequence&, uint8_t*, size_t);
 
@@ -206,6 +207,30 @@ void ExternalComPortDriverTest::ExpectWaitFlag(Sequence& s, uint8_t flag)
         .WillOnce(DoAll(SDMRegisterAccessSetValue(0xAFAFAF00 | flag), Return(SDMReturnCode_Success)));
 }
 
+void ExternalComPortDriverTest::ExpectPollFlag(Sequence& s, uint8_t flag, SDMReturnCode result)
+{
+    // DR register
+    const uint64_t regAddr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x20 : 0xD20;
+
+    static uint32_t registerAccessValue = 0x0;
+    registerAccessValue = flag;
+    SDMRegisterAccess expectedRegisterAccess[1] = {
+        {
+            regAddr,                  // address
+            SDMRegisterAccessOp_Poll, // op
+            &registerAccessValue,     // value
+            0xFF,                     // pollMask
+            ECPDConfig().rxRetries    // retries
+        }
+    };
+
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 1, _, refcon))
+        .With(Args<2, 3>(ElementsAreArray(expectedRegisterAccess)))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(DoAll(SDMRegisterAccessSetAccessesComplete(), Return(result)));
+}
+
 void ExternalComPortDriverTest::ExpectRxInt(Sequence& s, uint8_t* data, size_t dataSize)
 {
     static const size_t REG_VALUES_LEN = 1024;
@@ -507,6 +532,25 @@ TEST_P(ExternalComPortDriverTest, EComPort_RemoteReboot)
     EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_RReboot());
 }
 
+TEST_P(ExternalComPortDriverTest, EComPort_Rx_Cancelled)
+{
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    // nothing reaches the debugger once cancelled
+    bool cancelled = true;
+    extCom.SetCancelCallback([&cancelled]() { return cancelled; });
+    EXPECT_CALL(mockRegAccessCallback, Call(_, _, _, _, _, _)).Times(0);
+
+    size_t actualLen = 0;
+    uint8_t data[4] = { 0x0 };
+    EXPECT_EQ(SDMReturnCode_RequestFailed, extCom.EComPort_Rx(data, 4, &actualLen));
+    EXPECT_EQ(0, actualLen);
+}
+
 TEST_P(ExternalComPortDriverTest, EComPort_Tx_NoInit)
 {
     ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
@@ -565,6 +609,65 @@ TEST_P(ExternalComPortDriverTest, EComPort_Tx_2)
     EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Tx(data, 7, &actualLen, true));
 }
 
+TEST_P(ExternalComPortDriverTest, EComPort_Encode)
+{
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
+
+    // encoding does not access the target
+    EXPECT_CALL(mockRegAccessCallback, Call(_, _, _, _, _, _)).Times(0);
+
+    uint8_t data[] = {
+        0x12, 0xA0, 0x34, 0xAF
+    };
+    std::vector<uint32_t> frame;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Encode(data, 4, frame));
+
+    // one DR word per byte, unused byte lanes filled with null flags
+    uint32_t expectedFrame[] = {
+        0xAFAFAF00 | FLAG_START, 0xAFAFAF12, 0xAFAFAF00 | FLAG_ESC, 0xAFAFAF20,
+        0xAFAFAF34, 0xAFAFAF00 | FLAG_ESC, 0xAFAFAF2F, 0xAFAFAF00 | FLAG_END
+    };
+    EXPECT_THAT(frame, ElementsAreArray(expectedFrame));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_NoInit)
+{
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
+
+    uint32_t frame[] = {
+        0xAFAFAF00 | FLAG_START, 0xAFAFAF12, 0xAFAFAF00 | FLAG_END
+    };
+    EXPECT_EQ(SDMReturnCode_RequestFailed, extCom.EComPort_TxFrame(frame, 3, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame)
+{
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint8_t data[] = {
+        0x12, 0xA0, 0x34, 0xA2,
+        0x56, 0xAF, 0x78
+    };
+    std::vector<uint32_t> frame;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Encode(data, 7, frame));
+
+    // sending the encoded frame is equivalent to EComPort_Tx, every time it is sent
+    uint8_t expectedData[] = {
+        FLAG_START, 0x12, FLAG_ESC, 0x20,
+        0x34, FLAG_ESC, 0x22, 0x56,
+        FLAG_ESC, 0x2F, 0x78, FLAG_END
+    };
+    ExpectTx(s, expectedData, 12);
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame.data(), frame.size(), true));
+
+    ExpectTx(s, expectedData, 12);
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame.data(), frame.size(), true));
+}
+
 TEST_P(ExternalComPortDriverTest, EComPort_Rx_NoInit)
 {
     ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
@@ -729,3 +832,441 @@ TEST_P(ExternalComPortDriverTest, EComPort_Rx_OutOfOrder)
     EXPECT_EQ(SDMReturnCode_InternalError, extCom.EComPort_Rx(data, 4, &actualLen));
     EXPECT_EQ(0, actualLen);
 }
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_MaxAccessListLength)
+{
+    ECPDConfig config;
+    config.maxAccessListLength = 5;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[12];
+    for (size_t i = 0; i < 12; i++)
+    {
+        frame[i] = 0xAFAFAF00 | (uint32_t)i;
+    }
+
+    // 12 writes are split into lists of 5, 5 and 2
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 5, _, refcon))
+        .Times(Exactly(2))
+        .InSequence(s)
+        .WillRepeatedly(DoAll(SDMRegisterAccessSetAccessesComplete(), Return(SDMReturnCode_Success)));
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 2, _, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(DoAll(SDMRegisterAccessSetAccessesComplete(), Return(SDMReturnCode_Success)));
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame, 12, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_BlockChunks)
+{
+    ECPDConfig config;
+    config.txBlockChunk = 5;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[12];
+    for (size_t i = 0; i < 12; i++)
+    {
+        frame[i] = 0xAFAFAF00 | (uint32_t)i;
+    }
+
+    // TX FIFO free levels reported by successive SR reads
+    const uint32_t txFree[] = { 4, 0, 8, 2, 16 };
+    size_t srReads = 0;
+    std::vector<size_t> chunks;
+    std::vector<uint32_t> written;
+
+    const uint64_t sr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x2C : 0xD2C;
+    const uint64_t dbr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x30 : 0xD30;
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, _, _, refcon))
+        .WillRepeatedly(Invoke([&](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+        {
+            if (accesses[0].address == sr)
+            {
+                EXPECT_LT(srReads, sizeof(txFree) / sizeof(txFree[0]));
+                *accesses[0].value = txFree[srReads++ % (sizeof(txFree) / sizeof(txFree[0]))];
+            }
+            else
+            {
+                chunks.push_back(accessCount);
+                for (size_t i = 0; i < accessCount; i++)
+                {
+                    EXPECT_EQ(dbr, accesses[i].address);
+                    written.push_back(*accesses[i].value);
+                }
+            }
+            *accessesCompleted = accessCount;
+            return SDMReturnCode_Success;
+        }));
+
+    // each list fits the free level read before it and the configured bound
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame, 12, true));
+    EXPECT_EQ(5u, srReads);
+    EXPECT_THAT(chunks, ElementsAre(4, 5, 2, 1));
+    EXPECT_THAT(written, ElementsAreArray(frame));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_BlockChunksLinkError)
+{
+    ECPDConfig config;
+    config.txBlockChunk = 5;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[12] = { 0 };
+
+    // a link error reported by SR stops the transfer before any DBR write
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 1, _, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(DoAll(SDMRegisterAccessSetValue((1u << 14) | 0x04), Return(SDMReturnCode_Success)));
+
+    EXPECT_EQ(SDMReturnCode_IOError, extCom.EComPort_TxFrame(frame, 12, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Tx_Pipelined)
+{
+    ECPDConfig config;
+    config.txPipelineChunk = 4;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint8_t data[] = {
+        0x12, 0x34, 0xA0, 0x56,
+        0xA2, 0x78, 0x9A
+    };
+    std::vector<uint32_t> frame;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Encode(data, 7, frame));
+
+    std::vector<size_t> chunks;
+    std::vector<uint32_t> written;
+    const uint64_t dbr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x30 : 0xD30;
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, _, _, refcon))
+        .WillRepeatedly(Invoke([&](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+        {
+            chunks.push_back(accessCount);
+            for (size_t i = 0; i < accessCount; i++)
+            {
+                EXPECT_EQ(dbr, accesses[i].address);
+                EXPECT_EQ(SDMRegisterAccessOp_Write, accesses[i].op);
+                written.push_back(*accesses[i].value);
+            }
+            *accessesCompleted = accessCount;
+            return SDMReturnCode_Success;
+        }));
+
+    // escape sequences are not split, so some chunks are a word short, and FLAG_END
+    // may be left for a chunk of its own
+    for (int i = 0; i < 2; i++)
+    {
+        chunks.clear();
+        written.clear();
+        size_t actualLength = 0;
+        EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Tx(data, 7, &actualLength, true));
+        EXPECT_EQ(frame.size(), actualLength);
+        EXPECT_THAT(chunks, ElementsAre(3, 3, 4, 1));
+        EXPECT_EQ(frame, written);
+    }
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Tx_PipelinedSingleChunk)
+{
+    ECPDConfig config;
+    config.txPipelineChunk = 9;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint8_t data[] = {
+        0x12, 0x34, 0xA0, 0x56,
+        0xA2, 0x78, 0x9A
+    };
+    std::vector<uint32_t> frame;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Encode(data, 7, frame));
+
+    std::vector<uint32_t> written;
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, frame.size(), _, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(Invoke([&](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+        {
+            for (size_t i = 0; i < accessCount; i++)
+            {
+                written.push_back(*accesses[i].value);
+            }
+            *accessesCompleted = accessCount;
+            return SDMReturnCode_Success;
+        }));
+
+    // the message fits a chunk, so it is encoded whole and sent as one list
+    size_t actualLength = 0;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Tx(data, 7, &actualLength, true));
+    EXPECT_EQ(frame.size(), actualLength);
+    EXPECT_EQ(frame, written);
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Tx_PipelinedBlockChunks)
+{
+    ECPDConfig config;
+    config.txPipelineChunk = 4;
+    config.txBlockChunk = SIZE_MAX;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint8_t data[] = {
+        0x12, 0x34, 0xA0, 0x56,
+        0xA2, 0x78, 0x9A
+    };
+    std::vector<uint32_t> frame;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Encode(data, 7, frame));
+
+    std::vector<size_t> lists;
+    std::vector<uint32_t> written;
+    const uint64_t sr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x2C : 0xD2C;
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, _, _, refcon))
+        .WillRepeatedly(Invoke([&](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+        {
+            if (accesses[0].address == sr)
+            {
+                // two words free
+                *accesses[0].value = 2;
+            }
+            else
+            {
+                lists.push_back(accessCount);
+                for (size_t i = 0; i < accessCount; i++)
+                {
+                    written.push_back(*accesses[i].value);
+                }
+            }
+            *accessesCompleted = accessCount;
+            return SDMReturnCode_Success;
+        }));
+
+    // the chunks of 3, 3, 4 and 1 words are still encoded ahead, and written in lists
+    // that fit the free level
+    size_t actualLength = 0;
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Tx(data, 7, &actualLength, true));
+    EXPECT_EQ(frame.size(), actualLength);
+    EXPECT_THAT(lists, ElementsAre(2, 1, 2, 1, 2, 2, 1));
+    EXPECT_EQ(frame, written);
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Tx_PipelinedError)
+{
+    ECPDConfig config;
+    config.txPipelineChunk = 2;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint8_t data[64] = { 0 };
+
+    // the second chunk fails, the producer stops and no further chunk is written
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 2, _, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(DoAll(SDMRegisterAccessSetAccessesComplete(), Return(SDMReturnCode_Success)));
+    EXPECT_CALL(mockRegAccessCallback, Call(Pointee(comDevice), _, _, 2, _, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(Return(SDMReturnCode_TransferError));
+
+    size_t actualLength = 0;
+    EXPECT_EQ(SDMReturnCode_TransferError, extCom.EComPort_Tx(data, 64, &actualLength, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_RegisterAccessLists)
+{
+    ECPDConfig config;
+    config.maxAccessListLength = 5;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    MockFunction<SDMReturnCode(SDMRegisterAccessList *, size_t, void *)> mockRegAccessListsCallback;
+    extCom.SetRegisterAccessListsCallback(mockRegAccessListsCallback.AsStdFunction());
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[12];
+    for (size_t i = 0; i < 12; i++)
+    {
+        frame[i] = 0xAFAFAF00 | (uint32_t)i;
+    }
+
+    // the lists of 5, 5 and 2 writes go in a single call, followed by the first DR read of the reply
+    const uint64_t dbr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x30 : 0xD30;
+    const uint64_t dr = GetParam() == SDMDebugArchitecture_ArmADIv5 ? 0x20 : 0xD20;
+    EXPECT_CALL(mockRegAccessListsCallback, Call(_, 4, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(Invoke([&](SDMRegisterAccessList* lists, size_t listCount, void*)
+        {
+            EXPECT_EQ(5u, lists[0].accessCount);
+            EXPECT_EQ(5u, lists[1].accessCount);
+            EXPECT_EQ(2u, lists[2].accessCount);
+            for (size_t i = 0; i < 3; i++)
+            {
+                EXPECT_TRUE(*lists[i].device == comDevice);
+                EXPECT_EQ(dbr, lists[i].accesses[0].address);
+                EXPECT_EQ(frame[i * 5], *lists[i].accesses[0].value);
+            }
+            EXPECT_EQ(1u, lists[3].accessCount);
+            EXPECT_EQ(dr, lists[3].accesses[0].address);
+            EXPECT_EQ(SDMRegisterAccessOp_Read, lists[3].accesses[0].op);
+            *lists[3].accesses[0].value = 0xAFAFAF00 | FLAG__NULL;
+            for (size_t i = 0; i < listCount; i++)
+            {
+                lists[i].accessesCompleted = lists[i].accessCount;
+                lists[i].result = SDMReturnCode_Success;
+            }
+            return SDMReturnCode_Success;
+        }));
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame, 12, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_RegisterAccessListsIncomplete)
+{
+    ECPDConfig config;
+    config.maxAccessListLength = 5;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    MockFunction<SDMReturnCode(SDMRegisterAccessList *, size_t, void *)> mockRegAccessListsCallback;
+    extCom.SetRegisterAccessListsCallback(mockRegAccessListsCallback.AsStdFunction());
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[12] = { 0 };
+
+    // the second list stops after 3 writes, the third and the DR read are not performed
+    EXPECT_CALL(mockRegAccessListsCallback, Call(_, 4, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(Invoke([](SDMRegisterAccessList* lists, size_t, void*)
+        {
+            lists[0].accessesCompleted = 5;
+            lists[0].result = SDMReturnCode_Success;
+            lists[1].accessesCompleted = 3;
+            lists[1].result = SDMReturnCode_TransferError;
+            lists[2].accessesCompleted = 0;
+            lists[2].result = SDMReturnCode_RequestFailed;
+            lists[3].accessesCompleted = 0;
+            lists[3].result = SDMReturnCode_RequestFailed;
+            return SDMReturnCode_TransferError;
+        }));
+
+    EXPECT_EQ(SDMReturnCode_RequestFailed, extCom.EComPort_TxFrame(frame, 12, true));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_TxFrame_ReadAheadReply)
+{
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon);
+
+    MockFunction<SDMReturnCode(SDMRegisterAccessList *, size_t, void *)> mockRegAccessListsCallback;
+    extCom.SetRegisterAccessListsCallback(mockRegAccessListsCallback.AsStdFunction());
+
+    Sequence s;
+
+    testInit(s, extCom);
+
+    uint32_t frame[6] = { 0 };
+
+    // the frame and the first DR read of the reply in one call, with no list length limit
+    uint8_t rxData[] = {
+        FLAG_START, 0x12, 0x34, FLAG_END
+    };
+    EXPECT_CALL(mockRegAccessListsCallback, Call(_, 2, refcon))
+        .Times(Exactly(1))
+        .InSequence(s)
+        .WillOnce(Invoke([&](SDMRegisterAccessList* lists, size_t listCount, void*)
+        {
+            EXPECT_EQ(6u, lists[0].accessCount);
+            EXPECT_EQ(1u, lists[1].accessCount);
+            EXPECT_EQ(SDMRegisterAccessOp_Read, lists[1].accesses[0].op);
+            *lists[1].accesses[0].value = 0xAFAFAF00 | rxData[0];
+            for (size_t i = 0; i < listCount; i++)
+            {
+                lists[i].accessesCompleted = lists[i].accessCount;
+                lists[i].result = SDMReturnCode_Success;
+            }
+            return SDMReturnCode_Success;
+        }));
+
+    // the receive starts with the byte already read
+    ExpectRxInt(s, rxData + 1, 3);
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame, 6, true));
+
+    size_t actualLen = 0;
+    uint8_t data[4] = { 0x0 };
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Rx(data, 4, &actualLen));
+    EXPECT_EQ(2u, actualLen);
+    EXPECT_EQ(0x12, data[0]);
+    EXPECT_EQ(0x34, data[1]);
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Power_ProbePoll)
+{
+    ECPDConfig config;
+    config.pollMode = ECPD_POLL_PROBE;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    // flag waits are a single DR poll
+    uint32_t flagLPH1RL;
+    ExpectSendFlag(s, flagLPH1RL, FLAG_LPH1RL);
+    ExpectPollFlag(s, FLAG_LPH1RL, SDMReturnCode_Success);
+
+    uint32_t flagLPH1RA;
+    ExpectSendFlag(s, flagLPH1RA, FLAG_LPH1RA);
+    ExpectPollFlag(s, FLAG_LPH1RA, SDMReturnCode_Success);
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Power(ECPD_POWER_ON));
+}
+
+TEST_P(ExternalComPortDriverTest, EComPort_Power_ProbePollUnsupported)
+{
+    ECPDConfig config;
+    config.pollMode = ECPD_POLL_PROBE;
+    ExternalComPortDriver extCom(comDevice, GetParam(), mockRegAccessCallback.AsStdFunction(), mockResetStartCallback.AsStdFunction(), mockResetEndCallback.AsStdFunction(), refcon, config);
+
+    Sequence s;
+
+    // falls back to host polling, and does not try the poll again
+    uint32_t flagLPH1RL;
+    ExpectSendFlag(s, flagLPH1RL, FLAG_LPH1RL);
+    ExpectPollFlag(s, FLAG_LPH1RL, SDMReturnCode_UnsupportedOperation);
+    ExpectWaitFlag(s, FLAG_LPH1RL);
+
+    uint32_t flagLPH1RA;
+    ExpectSendFlag(s, flagLPH1RA, FLAG_LPH1RA);
+    ExpectWaitFlag(s, FLAG_LPH1RA);
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Power(ECPD_POWER_ON));
+}
@@ -0,0 +1,308 @@
+// probe_server_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "ext_com_port_driver.h"
+#include "probe_client.h"
+#include "probe_server.h"
+#include "sdc600_model.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    SDMDeviceDescriptor comDevice()
+    {
+        SDMDeviceDescriptor device;
+        memset(&device, 0, sizeof(device));
+        device.deviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+        return device;
+    }
+
+    // link setup, IDR/IDA and one echoed message, returning the round trips taken
+    uint64_t runSession(ProbeServer& server, const ECPDConfig& config)
+    {
+        ProbeClient client;
+        EXPECT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+
+        ExternalComPortDriver driver(comDevice(), SDMDebugArchitecture_ArmADIv6, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client, config);
+
+        uint8_t id[SDC600_ID_LENGTH] = { 0 };
+        EXPECT_EQ(SDMReturnCode_Success, driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id)));
+        EXPECT_EQ(0, memcmp(id, "SDC600", sizeof(id)));
+
+        // includes flag valued bytes, which are escaped both ways
+        std::vector<uint8_t> message = { 0x01, 0xA0, 0xAC, 0xAD, 0xAE, 0xAF, 0xBF, 0xC0, 0x7F };
+        std::vector<uint8_t> echo(message.size());
+        size_t actualLength = 0;
+        EXPECT_EQ(SDMReturnCode_Success, driver.EComPort_Tx(message.data(), message.size(), &actualLength, false));
+        EXPECT_EQ(SDMReturnCode_Success, driver.EComPort_Rx(echo.data(), echo.size(), &actualLength));
+        EXPECT_EQ(message.size(), actualLength);
+        EXPECT_EQ(message, echo);
+
+        EXPECT_EQ(SDMReturnCode_Success, driver.EComPort_Finalize());
+
+        return client.TransactionCount();
+    }
+}
+
+TEST(ProbeServerTest, DriverSessionOverLoopback)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+    EXPECT_NE(0, server.Port());
+
+    uint64_t transactions = runSession(server, ECPDConfig());
+    EXPECT_GT(transactions, 0u);
+    EXPECT_EQ(transactions, server.TransactionCount());
+}
+
+TEST(ProbeServerTest, ProbePollSavesRoundTrips)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ECPDConfig hostPoll;
+    ECPDConfig probePoll;
+    probePoll.pollMode = ECPD_POLL_PROBE;
+
+    EXPECT_LT(runSession(server, probePoll), runSession(server, hostPoll));
+}
+
+TEST(ProbeServerTest, RxPumpSession)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ECPDConfig pump;
+    pump.rxPump = true;
+    pump.rxPumpQueueSize = 16;
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+    ExternalComPortDriver driver(comDevice(), SDMDebugArchitecture_ArmADIv6, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client, pump);
+
+    uint8_t id[SDC600_ID_LENGTH];
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id)));
+    EXPECT_TRUE(driver.RxPumpRunning());
+
+    // parked, no probe traffic between calls
+    uint64_t transactions = server.TransactionCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(transactions, server.TransactionCount());
+
+    // longer than the queue, the rest waits in the RX FIFO
+    for (int i = 0; i < 3; i++)
+    {
+        std::vector<uint8_t> message(100, (uint8_t)(0xA0 + i));
+        std::vector<uint8_t> echo(message.size());
+        size_t actualLength = 0;
+        ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Tx(message.data(), message.size(), &actualLength, true));
+        ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Rx(echo.data(), echo.size(), &actualLength));
+        EXPECT_EQ(message, echo);
+    }
+
+    // a hold keeps it reading, and it parks again once released
+    driver.HoldRxPump();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_LT(transactions, server.TransactionCount());
+    driver.ReleaseRxPump();
+    transactions = server.TransactionCount();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(transactions, server.TransactionCount());
+
+    EXPECT_EQ(SDMReturnCode_Success, driver.EComPort_Finalize());
+    EXPECT_FALSE(driver.RxPumpRunning());
+    EXPECT_EQ(client.TransactionCount(), server.TransactionCount());
+}
+
+TEST(ProbeServerTest, RegisterAccessListsInOneRoundTrip)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ECPDConfig lists;
+    lists.maxAccessListLength = 8;
+
+    // same session with the vectored callback
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+    ExternalComPortDriver driver(comDevice(), SDMDebugArchitecture_ArmADIv6, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client, lists);
+    driver.SetRegisterAccessListsCallback(ProbeClient::RegisterAccessVectorCallback);
+
+    uint8_t id[SDC600_ID_LENGTH];
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id)));
+
+    std::vector<uint8_t> message(100, 0x42);
+    std::vector<uint8_t> echo(message.size());
+    size_t actualLength = 0;
+    uint64_t before = client.TransactionCount();
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Tx(message.data(), message.size(), &actualLength, true));
+
+    // 102 DBR writes in lists of 8, one round trip
+    EXPECT_EQ(before + 1, client.TransactionCount());
+    EXPECT_EQ(client.TransactionCount(), server.TransactionCount());
+
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Rx(echo.data(), echo.size(), &actualLength));
+    EXPECT_EQ(message, echo);
+}
+
+TEST(ProbeServerTest, RegisterAccessListsStopAtIncompleteList)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+
+    // nothing was sent, the poll in the first list never matches
+    uint32_t poll = FLAG_LPH2RA;
+    uint32_t status = 0;
+    SDMRegisterAccess first = { 0xD20, SDMRegisterAccessOp_Poll, &poll, 0xFF, 5 };
+    SDMRegisterAccess second = { 0xD2C, SDMRegisterAccessOp_Read, &status, 0, 0 };
+
+    SDMRegisterAccessList lists[2];
+    memset(lists, 0, sizeof(lists));
+    lists[0].accesses = &first;
+    lists[0].accessCount = 1;
+    lists[1].accesses = &second;
+    lists[1].accessCount = 1;
+
+    EXPECT_EQ(SDMReturnCode_TimeoutError, ProbeClient::RegisterAccessVectorCallback(lists, 2, &client));
+    EXPECT_EQ(SDMReturnCode_TimeoutError, lists[0].result);
+    EXPECT_EQ(0u, lists[0].accessesCompleted);
+    EXPECT_EQ(SDMReturnCode_RequestFailed, lists[1].result);
+    EXPECT_EQ(0u, lists[1].accessesCompleted);
+    EXPECT_EQ(1u, client.TransactionCount());
+}
+
+TEST(ProbeServerTest, MessageHandlerPerConnection)
+{
+    ProbeServerOptions options;
+    options.setupModel = [](Sdc600Model& model)
+    {
+        model.SetMessageHandler([](const std::vector<uint8_t>& message, std::vector<uint8_t>& response)
+        {
+            response.assign(message.rbegin(), message.rend());
+        });
+    };
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+    ExternalComPortDriver driver(comDevice(), SDMDebugArchitecture_ArmADIv6, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client);
+
+    uint8_t id[SDC600_ID_LENGTH];
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id)));
+
+    uint8_t message[] = { 1, 2, 3 };
+    uint8_t response[3] = { 0 };
+    size_t actualLength = 0;
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Tx(message, sizeof(message), &actualLength, true));
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Rx(response, sizeof(response), &actualLength));
+    EXPECT_EQ(3, response[0]);
+    EXPECT_EQ(1, response[2]);
+}
+
+TEST(ProbeServerTest, LatencyAddedPerTransaction)
+{
+    ProbeServerOptions options;
+    options.latencyUs = 2000;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+
+    // SR of an ADIv6 APBCOM
+    uint32_t values[4] = { 0 };
+    SDMRegisterAccess accesses[4];
+    for (int i = 0; i < 4; i++)
+    {
+        accesses[i] = { 0xD2C, SDMRegisterAccessOp_Read, &values[i], 0, 0 };
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 5; i++)
+    {
+        size_t completed = 0;
+        ASSERT_EQ(SDMReturnCode_Success, client.RegisterAccess(accesses, 4, &completed));
+        EXPECT_EQ(4u, completed);
+    }
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+
+    // latency is per list, not per access
+    EXPECT_GE(elapsed, std::chrono::microseconds(5 * 2000));
+    EXPECT_EQ(5u, client.TransactionCount());
+    EXPECT_EQ(0x4u, values[0] & 0xFF);
+}
+
+TEST(ProbeServerTest, PollTimesOut)
+{
+    ProbeServerOptions options;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+
+    // nothing was sent, so DR only ever reads null flags
+    uint32_t value = FLAG_LPH2RA;
+    SDMRegisterAccess access = { 0xD20, SDMRegisterAccessOp_Poll, &value, 0xFF, 10 };
+    size_t completed = 0;
+    EXPECT_EQ(SDMReturnCode_TimeoutError, client.RegisterAccess(&access, 1, &completed));
+    EXPECT_EQ(0u, completed);
+}
+
+TEST(ProbeServerTest, CancelFromAnotherThread)
+{
+    ProbeServerOptions options;
+    options.latencyUs = 1000;
+    ProbeServer server(options);
+    ASSERT_EQ(SDMReturnCode_Success, server.Start());
+
+    // nothing is sent, the receive would read null flags for a long time
+    ECPDConfig patient;
+    patient.rxMaxNullFlags = UINT32_MAX;
+
+    ProbeClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect("127.0.0.1", server.Port()));
+    ExternalComPortDriver driver(comDevice(), SDMDebugArchitecture_ArmADIv6, ProbeClient::RegisterAccessCallback, SDMResetCallback(), SDMResetCallback(), &client, patient);
+
+    uint8_t id[SDC600_ID_LENGTH];
+    ASSERT_EQ(SDMReturnCode_Success, driver.EComPort_Init(ECPD_REMOTE_RESET_NONE, id, sizeof(id)));
+
+    std::atomic<bool> cancelled(false);
+    driver.SetCancelCallback([&cancelled]() { return cancelled.load(); });
+    std::thread scheduler([&cancelled]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        cancelled = true;
+    });
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    uint8_t response[8];
+    size_t actualLength = 0;
+    EXPECT_EQ(SDMReturnCode_RequestFailed, driver.EComPort_Rx(response, sizeof(response), &actualLength));
+    std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+    scheduler.join();
+
+    EXPECT_LT(elapsed, std::chrono::seconds(2));
+    EXPECT_EQ(client.TransactionCount(), server.TransactionCount());
+}
@@ -0,0 +1,58 @@
+// psa_crypto_context_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "psa_crypto_context.h"
+#include "psa_adac.h"
+#include "psa/crypto.h"
+
+#include <string.h>
+
+using namespace testing;
+
+// the unit tests link without PSA crypto, these stand in for it
+namespace
+{
+    int gInitCalls = 0;
+    int gInitFailures = 0;
+}
+
+int psa_adac_init(void)
+{
+    gInitCalls++;
+    if (gInitFailures > 0)
+    {
+        gInitFailures--;
+        return -1;
+    }
+    return 0;
+}
+
+void mbedtls_psa_crypto_free(void)
+{
+}
+
+void mbedtls_psa_get_stats(mbedtls_psa_stats_t* stats)
+{
+    memset(stats, 0, sizeof(*stats));
+}
+
+TEST(PsaCryptoContextTest, RetriesFailedInit)
+{
+    // PsaCryptoContext is process-wide, this is the only test that acquires it
+    gInitCalls = 0;
+    gInitFailures = 1;
+
+    EXPECT_LT(PsaCryptoContext::Acquire(), 0);
+    EXPECT_EQ(1, gInitCalls);
+
+    EXPECT_EQ(0, PsaCryptoContext::Acquire());
+    EXPECT_EQ(2, gInitCalls);
+
+    // initialized, not run again
+    EXPECT_EQ(0, PsaCryptoContext::Acquire());
+    EXPECT_EQ(2, gInitCalls);
+}
@@ -0,0 +1,177 @@
+// register_access_trace_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "register_access_trace.h"
+
+#include <deque>
+#include <string>
+
+using namespace testing;
+
+namespace
+{
+    // Minimal SDC-600 target: SR always reports TX space and RX data, DR reads return a script
+    class ScriptedTarget
+    {
+    public:
+        ScriptedTarget(std::initializer_list<uint8_t> rx) : mRx(rx) {}
+
+        SDMRegisterAccessCallback Callback()
+        {
+            return [this](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+            {
+                for (size_t i = 0; i < accessCount; i++)
+                {
+                    if (accesses[i].op == SDMRegisterAccessOp_Read && (accesses[i].address & 0xFF) == 0x2C)
+                    {
+                        *accesses[i].value = 0x10001;
+                    }
+                    else if (accesses[i].op == SDMRegisterAccessOp_Read)
+                    {
+                        uint8_t byte = FLAG__NULL;
+                        if (!mRx.empty())
+                        {
+                            byte = mRx.front();
+                            mRx.pop_front();
+                        }
+                        *accesses[i].value = 0xAFAFAF00 | byte;
+                    }
+                }
+                *accessesCompleted = accessCount;
+                return (SDMReturnCode)SDMReturnCode_Success;
+            };
+        }
+
+    private:
+        std::deque<uint8_t> mRx;
+    };
+
+    class RegisterAccessTraceTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            comDevice.deviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+            comDevice.armCoreSightComponent.dpIndex = 0;
+            comDevice.armCoreSightComponent.memAp = NULL;
+            comDevice.armCoreSightComponent.baseAddress = 0x12345678;
+
+            tracePath = TempDir() + "register_access_trace_test.trace";
+        }
+
+    protected:
+        // Records EComPort_Init followed by a blocking transmit of frame
+        void recordSession(const std::vector<uint32_t>& frame)
+        {
+            ScriptedTarget target({ FLAG_LPH1RL, FLAG_LPH1RA, FLAG_LPH2RA, FLAG_IDA, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, FLAG_END });
+
+            ArenaPtr<RegisterAccessTraceRecorder> recorder = RegisterAccessTraceRecorder::Create(tracePath.c_str(), SDMDebugArchitecture_ArmADIv6);
+            ASSERT_TRUE((bool)recorder);
+
+            ExternalComPortDriver extCom(comDevice, SDMDebugArchitecture_ArmADIv6, recorder->Wrap(target.Callback()), nullptr, nullptr, NULL);
+
+            uint8_t idResBuff[6];
+            ASSERT_EQ(SDMReturnCode_Success, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+            ASSERT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame.data(), frame.size(), true));
+        }
+
+        SDMDeviceDescriptor comDevice;
+        std::string tracePath;
+    };
+}
+
+TEST_F(RegisterAccessTraceTest, Replay)
+{
+    std::vector<uint32_t> frame(10, 0xAFAFAF12);
+    recordSession(frame);
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay = RegisterAccessTraceReplay::Open(tracePath.c_str());
+    ASSERT_TRUE((bool)replay);
+    EXPECT_EQ(SDMDebugArchitecture_ArmADIv6, replay->DebugArchitecture());
+
+    ExternalComPortDriver extCom(comDevice, replay->DebugArchitecture(), replay->Callback(), nullptr, nullptr, NULL);
+
+    uint8_t idResBuff[6] = { 0 };
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+
+    uint8_t expectedID[] = {
+        0x12, 0x34, 0x56, 0x78,
+        0x9A, 0xBC
+    };
+    EXPECT_THAT(idResBuff, ElementsAreArray(expectedID));
+
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame.data(), frame.size(), true));
+    EXPECT_EQ(replay->AccessCount(), replay->Position());
+    EXPECT_EQ(0, replay->WriteValueMismatches());
+}
+
+TEST_F(RegisterAccessTraceTest, Replay_SplitAccessLists)
+{
+    std::vector<uint32_t> frame(10, 0xAFAFAF12);
+    recordSession(frame);
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay = RegisterAccessTraceReplay::Open(tracePath.c_str());
+    ASSERT_TRUE((bool)replay);
+
+    // the trace is replayed as a stream of accesses, independent of how they are batched
+    ECPDConfig config;
+    config.maxAccessListLength = 3;
+    ExternalComPortDriver extCom(comDevice, replay->DebugArchitecture(), replay->Callback(), nullptr, nullptr, NULL, config);
+
+    uint8_t idResBuff[6] = { 0 };
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_TxFrame(frame.data(), frame.size(), true));
+    EXPECT_EQ(replay->AccessCount(), replay->Position());
+}
+
+TEST_F(RegisterAccessTraceTest, Replay_WriteValues)
+{
+    std::vector<uint32_t> frame(10, 0xAFAFAF12);
+    recordSession(frame);
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay = RegisterAccessTraceReplay::Open(tracePath.c_str());
+    ASSERT_TRUE((bool)replay);
+
+    ExternalComPortDriver extCom(comDevice, replay->DebugArchitecture(), replay->Callback(), nullptr, nullptr, NULL);
+
+    uint8_t idResBuff[6] = { 0 };
+    EXPECT_EQ(SDMReturnCode_Success, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+
+    // different data is counted, and only fails if requested. The driver reports the incomplete list
+    std::vector<uint32_t> otherFrame(10, 0xAFAFAF34);
+    replay->SetCheckWriteValues(true);
+    EXPECT_EQ(SDMReturnCode_RequestFailed, extCom.EComPort_TxFrame(otherFrame.data(), otherFrame.size(), true));
+    EXPECT_EQ(1, replay->WriteValueMismatches());
+}
+
+TEST_F(RegisterAccessTraceTest, Replay_Divergence)
+{
+    std::vector<uint32_t> frame(10, 0xAFAFAF12);
+    recordSession(frame);
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay = RegisterAccessTraceReplay::Open(tracePath.c_str());
+    ASSERT_TRUE((bool)replay);
+
+    // ADIv5 register offsets differ from the recorded ADIv6 session
+    ExternalComPortDriver extCom(comDevice, SDMDebugArchitecture_ArmADIv5, replay->Callback(), nullptr, nullptr, NULL);
+
+    uint8_t idResBuff[6] = { 0 };
+    EXPECT_EQ(SDMReturnCode_TransferError, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+    EXPECT_EQ(0, replay->Position());
+}
+
+TEST_F(RegisterAccessTraceTest, Open_Invalid)
+{
+    EXPECT_FALSE((bool)RegisterAccessTraceReplay::Open((TempDir() + "does_not_exist.trace").c_str()));
+
+    FILE* file = fopen(tracePath.c_str(), "wb");
+    ASSERT_TRUE(file != NULL);
+    fputs("not a trace", file);
+    fclose(file);
+    EXPECT_FALSE((bool)RegisterAccessTraceReplay::Open(tracePath.c_str()));
+}
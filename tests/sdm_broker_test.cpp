@@ -0,0 +1,329 @@
+// sdm_broker_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "broker_client.h"
+#include "sdm_broker_server.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    // session side: an SDM API that exercises the callbacks it is opened with
+    struct FakeSession
+    {
+        SDMCallbacks* callbacks;
+        void* refcon;
+        std::string resourcesDirectoryPath;
+        uint32_t values[3];
+        size_t completed;
+        int closes;
+        bool callerThreadCallbacks;
+    };
+
+    FakeSession gSession;
+
+    SDMReturnCode fakeOpen(SDMHandle* handle, const SDMOpenParameters* params, const SDMOpenExtensions* extensions)
+    {
+        gSession.callerThreadCallbacks = SDM_EXT_HAS_FIELD(extensions, callerThreadCallbacks) && extensions->callerThreadCallbacks != 0;
+        gSession.callbacks = params->callbacks;
+        gSession.refcon = params->refcon;
+        gSession.resourcesDirectoryPath = params->resourcesDirectoryPath != NULL ? params->resourcesDirectoryPath : "(null)";
+
+        SDMDeviceDescriptor memAp;
+        memset(&memAp, 0, sizeof(memAp));
+        memAp.deviceType = SDMDeviceType_ArmADI_AP;
+        memAp.armAP.dpIndex = 1;
+        memAp.armAP.address = 0x2000000;
+
+        SDMDeviceDescriptor device;
+        memset(&device, 0, sizeof(device));
+        device.deviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+        device.armCoreSightComponent.dpIndex = 1;
+        device.armCoreSightComponent.memAp = &memAp;
+        device.armCoreSightComponent.baseAddress = 0xD00;
+
+        gSession.values[0] = 0xAFAFAFA0;
+        gSession.values[1] = 0;
+        gSession.values[2] = 0;
+        SDMRegisterAccess accesses[3] = {
+            { 0xD20, SDMRegisterAccessOp_Write, &gSession.values[0], 0, 0 },
+            { 0xD2C, SDMRegisterAccessOp_Read, &gSession.values[1], 0, 0 },
+            { 0xD20, SDMRegisterAccessOp_Read, &gSession.values[2], 0, 0 },
+        };
+
+        params->callbacks->updateProgress("Opening", 10, params->refcon);
+        SDMReturnCode res = params->callbacks->resetStart(SDMResetType_Default, params->refcon);
+        if (res != SDMReturnCode_Success)
+        {
+            return res;
+        }
+        res = params->callbacks->registerAccess(&device, SDMTransferSize_32, accesses, 3, &gSession.completed, params->refcon);
+
+        *handle = (SDMHandle)&gSession;
+        return res;
+    }
+
+    SDMReturnCode fakeAuthenticate(SDMHandle handle, const SDMAuthenticateParameters* params)
+    {
+        // more than fit in the shared region at once
+        std::vector<uint32_t> values(SDM_BROKER_MAX_ACCESSES + 10, 0);
+        std::vector<SDMRegisterAccess> accesses(values.size());
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            accesses[i] = { 0xD20, SDMRegisterAccessOp_Read, &values[i], 0, 0 };
+        }
+
+        SDMDeviceDescriptor device;
+        memset(&device, 0, sizeof(device));
+        device.deviceType = SDMDeviceType_ArmADI_AP;
+
+        size_t completed = 0;
+        SDMReturnCode res = gSession.callbacks->registerAccess(&device, SDMTransferSize_32, accesses.data(), accesses.size(), &completed, gSession.refcon);
+        if (res != SDMReturnCode_Success || completed != accesses.size() || values.back() != 0xD21)
+        {
+            return SDMReturnCode_TransferError;
+        }
+
+        return params->flags == 7 ? SDMReturnCode_Success : SDMReturnCode_InvalidArgument;
+    }
+
+    SDMReturnCode fakeResumeBoot(SDMHandle handle)
+    {
+        return SDMReturnCode_UnsupportedOperation;
+    }
+
+    SDMReturnCode fakeClose(SDMHandle handle)
+    {
+        gSession.closes++;
+        return SDMReturnCode_Success;
+    }
+
+    // debugger side
+    struct Debugger
+    {
+        std::vector<std::string> progress;
+        int resets;
+        int registerAccessCalls;
+        SDMDeviceDescriptor device;
+        SDMDeviceDescriptor memAp;
+        std::vector<uint32_t> writes;
+    };
+
+    SDMReturnCode debuggerRegisterAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+    {
+        Debugger* debugger = (Debugger*)refcon;
+        debugger->registerAccessCalls++;
+        debugger->device = *device;
+        if (device->deviceType == SDMDeviceType_ArmADI_CoreSightComponent && device->armCoreSightComponent.memAp != NULL)
+        {
+            debugger->memAp = *device->armCoreSightComponent.memAp;
+        }
+
+        // reads return their address plus one
+        for (size_t i = 0; i < accessCount; i++)
+        {
+            if (accesses[i].op == SDMRegisterAccessOp_Write)
+            {
+                debugger->writes.push_back(*accesses[i].value);
+            }
+            else
+            {
+                *accesses[i].value = (uint32_t)accesses[i].address + 1;
+            }
+        }
+        *accessesCompleted = accessCount;
+        return SDMReturnCode_Success;
+    }
+
+    SDMReturnCode debuggerReset(SDMResetType resetType, void* refcon)
+    {
+        ((Debugger*)refcon)->resets++;
+        return SDMReturnCode_Success;
+    }
+
+    void debuggerProgress(const char* message, uint8_t percent, void* refcon)
+    {
+        ((Debugger*)refcon)->progress.push_back(message);
+    }
+
+    size_t threadCount()
+    {
+        size_t count = 0;
+        DIR* tasks = opendir("/proc/self/task");
+        if (tasks != NULL)
+        {
+            while (dirent* entry = readdir(tasks))
+            {
+                count += entry->d_name[0] != '.';
+            }
+            closedir(tasks);
+        }
+        return count;
+    }
+
+    class SdmBrokerTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            gSession.callbacks = NULL;
+            gSession.refcon = NULL;
+            gSession.resourcesDirectoryPath.clear();
+            gSession.completed = 0;
+            gSession.closes = 0;
+            gSession.callerThreadCallbacks = false;
+
+            char path[64];
+            snprintf(path, sizeof(path), "/tmp/sdm_broker_test.%ld.sock", (long)getpid());
+            options.socketPath = path;
+            options.api.open = fakeOpen;
+            options.api.authenticate = fakeAuthenticate;
+            options.api.resumeBoot = fakeResumeBoot;
+            options.api.close = fakeClose;
+
+            debugger.resets = 0;
+            debugger.registerAccessCalls = 0;
+            memset(&callbacks, 0, sizeof(callbacks));
+            callbacks.registerAccess = debuggerRegisterAccess;
+            callbacks.resetStart = debuggerReset;
+            callbacks.resetFinish = debuggerReset;
+            callbacks.updateProgress = debuggerProgress;
+
+            memset(&params, 0, sizeof(params));
+            params.version.major = SDMVersion_CurrentMajor;
+            params.debugArchitecture = SDMDebugArchitecture_ArmADIv6;
+            params.callbacks = &callbacks;
+            params.refcon = &debugger;
+            params.resourcesDirectoryPath = "/opt/board";
+        }
+
+    protected:
+        SdmBrokerOptions options;
+        Debugger debugger;
+        SDMCallbacks callbacks;
+        SDMOpenParameters params;
+    };
+}
+
+TEST_F(SdmBrokerTest, SessionCallbacksReachClient)
+{
+    SdmBroker broker(options);
+    ASSERT_EQ(SDMReturnCode_Success, broker.Start());
+
+    BrokerClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect(options.socketPath.c_str()));
+    ASSERT_EQ(SDMReturnCode_Success, client.Open(&params));
+
+    EXPECT_EQ("/opt/board", gSession.resourcesDirectoryPath);
+
+    // no library threads, whatever rx_pump and lazy_open are configured to
+    EXPECT_TRUE(gSession.callerThreadCallbacks);
+    ASSERT_EQ(1u, debugger.progress.size());
+    EXPECT_EQ("Opening", debugger.progress[0]);
+    EXPECT_EQ(1, debugger.resets);
+
+    // device and register values cross both ways
+    EXPECT_EQ(3u, gSession.completed);
+    EXPECT_EQ(0xD2Du, gSession.values[1]);
+    EXPECT_EQ(0xD21u, gSession.values[2]);
+    ASSERT_EQ(1u, debugger.writes.size());
+    EXPECT_EQ(0xAFAFAFA0u, debugger.writes[0]);
+    EXPECT_EQ(0xD00u, debugger.device.armCoreSightComponent.baseAddress);
+    EXPECT_EQ(0x2000000u, debugger.memAp.armAP.address);
+    EXPECT_EQ(1, debugger.memAp.armAP.dpIndex);
+
+    SDMAuthenticateParameters authenticate;
+    memset(&authenticate, 0, sizeof(authenticate));
+    authenticate.flags = 7;
+    EXPECT_EQ(SDMReturnCode_Success, client.Authenticate(&authenticate));
+    EXPECT_EQ(3, debugger.registerAccessCalls);
+    EXPECT_EQ(SDMReturnCode_UnsupportedOperation, client.ResumeBoot());
+
+    EXPECT_EQ(1u, broker.OpenSessionCount());
+    EXPECT_EQ(SDMReturnCode_Success, client.Close());
+    EXPECT_EQ(1, gSession.closes);
+    EXPECT_EQ(0u, broker.OpenSessionCount());
+    EXPECT_EQ(1u, broker.SessionCount());
+}
+
+TEST_F(SdmBrokerTest, CallsBeforeOpenFail)
+{
+    SdmBroker broker(options);
+    ASSERT_EQ(SDMReturnCode_Success, broker.Start());
+
+    BrokerClient client;
+    ASSERT_EQ(SDMReturnCode_Success, client.Connect(options.socketPath.c_str()));
+
+    SDMAuthenticateParameters authenticate;
+    memset(&authenticate, 0, sizeof(authenticate));
+    EXPECT_EQ(SDMReturnCode_InternalError, client.Authenticate(&authenticate));
+    EXPECT_EQ(SDMReturnCode_InternalError, client.Close());
+    EXPECT_EQ(0, gSession.closes);
+}
+
+TEST_F(SdmBrokerTest, DisconnectClosesSession)
+{
+    SdmBroker broker(options);
+    ASSERT_EQ(SDMReturnCode_Success, broker.Start());
+
+    {
+        BrokerClient client;
+        ASSERT_EQ(SDMReturnCode_Success, client.Connect(options.socketPath.c_str()));
+        ASSERT_EQ(SDMReturnCode_Success, client.Open(&params));
+    }
+
+    // the client went away without SDMClose
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (broker.OpenSessionCount() != 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(0u, broker.OpenSessionCount());
+    EXPECT_EQ(1, gSession.closes);
+}
+
+TEST_F(SdmBrokerTest, FinishedConnectionsAreReaped)
+{
+    SdmBroker broker(options);
+    ASSERT_EQ(SDMReturnCode_Success, broker.Start());
+    size_t baseline = threadCount();
+
+    for (int i = 0; i < 20; i++)
+    {
+        BrokerClient client;
+        ASSERT_EQ(SDMReturnCode_Success, client.Connect(options.socketPath.c_str()));
+        ASSERT_EQ(SDMReturnCode_Success, client.Open(&params));
+        ASSERT_EQ(SDMReturnCode_Success, client.Close());
+    }
+
+    // the threads of clients that are gone exit without waiting for Stop
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((broker.ConnectionCount() != 0 || threadCount() > baseline) && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(0u, broker.ConnectionCount());
+    EXPECT_EQ(baseline, threadCount());
+    EXPECT_EQ(20u, broker.SessionCount());
+}
+
+TEST_F(SdmBrokerTest, NoBrokerRunning)
+{
+    BrokerClient client;
+    EXPECT_EQ(SDMReturnCode_IOError, client.Connect(options.socketPath.c_str()));
+    EXPECT_EQ(SDMReturnCode_RequestFailed, client.Open(&params));
+}
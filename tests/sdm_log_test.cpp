@@ -0,0 +1,147 @@
+// sdm_log_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "sdm_log.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    class SDMLogTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            previousLevel = SDMLog::Level();
+            sink = tmpfile();
+            ASSERT_TRUE(sink != NULL);
+            SDMLog::SetSink(sink);
+        }
+
+        virtual void TearDown()
+        {
+            SDMLog::SetSink(NULL);
+            SDMLog::SetLevel(previousLevel);
+            fclose(sink);
+        }
+
+    protected:
+        std::string output()
+        {
+            SDMLog::Flush();
+
+            std::string text;
+            char buffer[256];
+            rewind(sink);
+            size_t read;
+            while ((read = fread(buffer, 1, sizeof(buffer), sink)) > 0)
+            {
+                text.append(buffer, read);
+            }
+            return text;
+        }
+
+        FILE* sink;
+        int previousLevel;
+    };
+}
+
+TEST_F(SDMLogTest, DeferredFormatting)
+{
+    SDMLog::SetLevel(SDM_LOG_LEVEL_DEBUG);
+
+    char name[] = "LPH2RA";
+    SDM_LOG_INFO("test", "flag[%s] code[0x%08x] size[%zu] signed[%d] char[%c] pct[100%%]\n", name, 0xA6u, (size_t)42, -3, 'x');
+    // strings are copied when logged, not when formatted
+    strcpy(name, "XXXXXX");
+    SDM_LOG_DEBUG("test", "masked[%x] padded[%-4u|] wide[%llx]\n", (int8_t)-1, 7u, (unsigned long long)0x123456789ULL);
+
+    std::string text = output();
+    EXPECT_THAT(text, HasSubstr("INFO  test: flag[LPH2RA] code[0x000000a6] size[42] signed[-3] char[x] pct[100%]\n"));
+    EXPECT_THAT(text, HasSubstr("DEBUG test: masked[ff] padded[7   |] wide[123456789]\n"));
+}
+
+TEST_F(SDMLogTest, RuntimeLevel)
+{
+    SDMLog::SetLevel(SDM_LOG_LEVEL_INFO);
+    SDM_LOG_INFO("test", "kept\n");
+    SDM_LOG_DEBUG("test", "filtered\n");
+
+    std::string text = output();
+    EXPECT_THAT(text, HasSubstr("kept"));
+    EXPECT_THAT(text, Not(HasSubstr("filtered")));
+
+    int level = 0;
+    EXPECT_TRUE(SDMLog::ParseLevel(" Debug ", level));
+    EXPECT_EQ(SDM_LOG_LEVEL_DEBUG, level);
+    EXPECT_TRUE(SDMLog::ParseLevel("0", level));
+    EXPECT_EQ(SDM_LOG_LEVEL_NONE, level);
+    EXPECT_FALSE(SDMLog::ParseLevel("verbose", level));
+}
+
+TEST_F(SDMLogTest, CompileLevel)
+{
+    SDMLog::SetLevel(SDM_LOG_LEVEL_TRACE);
+
+    // removed at compile time, the arguments are never evaluated
+    int evaluated = 0;
+    SDM_LOG_AT(SDM_LOG_COMPILE_LEVEL + 1, "test", "%d\n", ++evaluated);
+    EXPECT_EQ(0, evaluated);
+    EXPECT_THAT(output(), Not(HasSubstr("test:")));
+}
+
+TEST_F(SDMLogTest, Dump)
+{
+    SDMLog::SetLevel(SDM_LOG_LEVEL_DEBUG);
+
+    std::vector<uint8_t> data(SDM_LOG_PAYLOAD_SIZE + 4);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = (uint8_t)i;
+    }
+    SDM_LOG_DUMP("test", "data", data.data(), data.size());
+
+    std::string text = output();
+    EXPECT_THAT(text, HasSubstr("test: data (180 bytes)\n00000000: 00 01 02 03"));
+    // split over two records
+    EXPECT_THAT(text, HasSubstr("test: 000000b0: b0 b1 b2 b3\n"));
+}
+
+TEST_F(SDMLogTest, ConcurrentProducers)
+{
+    SDMLog::SetLevel(SDM_LOG_LEVEL_INFO);
+    uint64_t dropped = SDMLog::Dropped();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.push_back(std::thread([t]() {
+            for (int i = 0; i < 500; i++)
+            {
+                SDM_LOG_INFO("test", "thread %d record %d\n", t, i);
+            }
+        }));
+    }
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::string text = output();
+    size_t records = 0;
+    for (size_t pos = text.find(" record "); pos != std::string::npos; pos = text.find(" record ", pos + 1))
+    {
+        records++;
+    }
+    EXPECT_EQ(2000u, records + (SDMLog::Dropped() - dropped));
+    EXPECT_THAT(text, HasSubstr("thread 3 record 499\n"));
+}
@@ -0,0 +1,306 @@
+// sdm_runtime_config_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "sdm_runtime_config.h"
+#include "sdm_config.h"
+#include "sdm_log.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    class SDMRuntimeConfigFileTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            char path[] = "/tmp/sdm_runtime_config_test.XXXXXX";
+            ASSERT_TRUE(mkdtemp(path) != NULL);
+            directory = std::string(path) + "/";
+            unsetenv(SDM_ENV_CONFIG_FILE);
+        }
+
+        virtual void TearDown()
+        {
+            for (const std::string& file : files)
+            {
+                unlink(file.c_str());
+            }
+            rmdir((directory + "resources").c_str());
+            rmdir(directory.c_str());
+            unsetenv(SDM_ENV_CONFIG_FILE);
+        }
+
+    protected:
+        std::string write(const std::string& name, const std::string& contents)
+        {
+            std::string path = directory + name;
+            FILE* file = fopen(path.c_str(), "w");
+            EXPECT_TRUE(file != NULL);
+            if (file != NULL)
+            {
+                fputs(contents.c_str(), file);
+                fclose(file);
+                files.push_back(path);
+            }
+            return path;
+        }
+
+        SDMReturnCode parse(const std::string& contents)
+        {
+            return config.Parse(write(SDM_RUNTIME_CONFIG_FILE_NAME, contents));
+        }
+
+        std::string directory;
+        std::vector<std::string> files;
+        SDMRuntimeConfig config;
+    };
+
+    SDMProbeCapabilities reported(size_t maxAccessListLength, int pollSupported, int dbrStallTolerated)
+    {
+        SDMProbeCapabilities capabilities;
+        memset(&capabilities, 0, sizeof(capabilities));
+        capabilities.size = sizeof(capabilities);
+        capabilities.maxAccessListLength = maxAccessListLength;
+        capabilities.pollSupported = pollSupported;
+        capabilities.dbrStallTolerated = dbrStallTolerated;
+        return capabilities;
+    }
+}
+
+TEST(SDMRuntimeConfigTest, ProbeCapabilitiesDescribeConfig)
+{
+    SDMRuntimeConfig config;
+    config.comHwTxBlocking = true;
+    config.driver.maxAccessListLength = 32;
+    config.driver.pollMode = ECPD_POLL_PROBE;
+
+    SDMProbeCapabilities capabilities;
+    config.GetProbeCapabilities(capabilities);
+    EXPECT_EQ(sizeof(capabilities), capabilities.size);
+    EXPECT_EQ(32u, capabilities.maxAccessListLength);
+    EXPECT_NE(0, capabilities.pollSupported);
+    EXPECT_NE(0, capabilities.dbrStallTolerated);
+
+    config.driver.txBlockChunk = 8;
+    config.GetProbeCapabilities(capabilities);
+    EXPECT_EQ(0, capabilities.dbrStallTolerated);
+}
+
+TEST(SDMRuntimeConfigTest, ProbeCapabilitiesLimitListLength)
+{
+    SDMRuntimeConfig config;
+    config.ApplyProbeCapabilities(reported(16, 0, 1));
+    EXPECT_EQ(16u, config.driver.maxAccessListLength);
+
+    // the smaller limit wins, no limit reported keeps the configured one
+    config.ApplyProbeCapabilities(reported(64, 0, 1));
+    EXPECT_EQ(16u, config.driver.maxAccessListLength);
+    config.ApplyProbeCapabilities(reported(0, 0, 1));
+    EXPECT_EQ(16u, config.driver.maxAccessListLength);
+    config.ApplyProbeCapabilities(reported(4, 0, 1));
+    EXPECT_EQ(4u, config.driver.maxAccessListLength);
+}
+
+TEST(SDMRuntimeConfigTest, ProbeCapabilitiesNeverEnable)
+{
+    SDMRuntimeConfig config;
+    config.comHwTxBlocking = false;
+    config.driver.pollMode = ECPD_POLL_HOST;
+
+    // a capable probe leaves host polling and status polled TX as configured
+    config.ApplyProbeCapabilities(reported(0, 1, 1));
+    EXPECT_EQ(ECPD_POLL_HOST, config.driver.pollMode);
+    EXPECT_FALSE(config.comHwTxBlocking);
+    EXPECT_EQ(0u, config.driver.txBlockChunk);
+
+    config.ApplyProbeCapabilities(reported(0, 0, 0));
+    EXPECT_FALSE(config.comHwTxBlocking);
+    EXPECT_EQ(0u, config.driver.txBlockChunk);
+}
+
+TEST(SDMRuntimeConfigTest, ProbeCapabilitiesRestrict)
+{
+    SDMRuntimeConfig config;
+    config.comHwTxBlocking = true;
+    config.driver.pollMode = ECPD_POLL_PROBE;
+    config.driver.txPipelineChunk = 32;
+
+    config.ApplyProbeCapabilities(reported(0, 1, 1));
+    EXPECT_EQ(ECPD_POLL_PROBE, config.driver.pollMode);
+    EXPECT_EQ(0u, config.driver.txBlockChunk);
+
+    // chunked by the free level alone, the pipeline still applies
+    config.ApplyProbeCapabilities(reported(0, 0, 0));
+    EXPECT_EQ(ECPD_POLL_HOST, config.driver.pollMode);
+    EXPECT_TRUE(config.comHwTxBlocking);
+    EXPECT_EQ(SIZE_MAX, config.driver.txBlockChunk);
+    EXPECT_EQ(32u, config.driver.txPipelineChunk);
+
+    // a configured chunk is kept
+    SDMRuntimeConfig chunked;
+    chunked.comHwTxBlocking = true;
+    chunked.driver.txBlockChunk = 8;
+    chunked.ApplyProbeCapabilities(reported(0, 0, 0));
+    EXPECT_EQ(8u, chunked.driver.txBlockChunk);
+}
+
+TEST_F(SDMRuntimeConfigFileTest, Defaults)
+{
+    ECPDConfig driver;
+    EXPECT_EQ(SDM_CONFIG_COM_DEVICE_TYPE, config.comDeviceType);
+    EXPECT_EQ((uint64_t)SDM_CONFIG_COM_DEVICE_ADDRESS, config.comDeviceAddress);
+    EXPECT_EQ(SDM_CONFIG_REMOTE_RESET_TYPE, config.remoteResetType);
+    EXPECT_EQ(SDM_CONFIG_COM_HW_TX_BLOCKING, config.comHwTxBlocking);
+    EXPECT_EQ(SDMLazyOpen_Off, config.lazyOpen);
+    EXPECT_EQ(driver.txRetries, config.driver.txRetries);
+    EXPECT_EQ(driver.rxPumpQueueSize, config.driver.rxPumpQueueSize);
+    EXPECT_EQ(0u, config.driver.txPipelineChunk);
+    EXPECT_EQ(0u, config.privateKeyId);
+    EXPECT_EQ(-1, config.logLevel);
+    EXPECT_TRUE(config.privateKeyFile.empty());
+    EXPECT_TRUE(config.path.empty());
+
+    // an empty file, or one of comments and sections, changes nothing
+    EXPECT_EQ(SDMReturnCode_Success, parse("# comment\n\n[sdm]\n; comment\n"));
+    EXPECT_EQ(driver.txRetries, config.driver.txRetries);
+    EXPECT_EQ(directory + SDM_RUNTIME_CONFIG_FILE_NAME, config.path);
+}
+
+TEST_F(SDMRuntimeConfigFileTest, AppliesKeys)
+{
+    EXPECT_EQ(SDMReturnCode_Success, parse(
+        "[com]\n"
+        "com_device_type = ap\n"
+        "COM_Device_Address = 0x10000   # hex\n"
+        "com_device_dp_index=2\n"
+        "remote_reset_type = COM\n"
+        "lazy_open = background\n"
+        "com_hw_tx_blocking = no\n"
+        "tx_retries = 17\n"
+        "rx_pump = on\n"
+        "rx_pump_queue_size = 1024\n"
+        "tx_pipeline_chunk = 64\n"
+        "poll_mode = probe\n"
+        "private_key_id = 0x5D0001\n"
+        "log_level = debug\n"));
+
+    EXPECT_EQ((SDMDeviceType)SDMDeviceType_ArmADI_AP, config.comDeviceType);
+    EXPECT_EQ(0x10000u, config.comDeviceAddress);
+    EXPECT_EQ(2u, config.comDeviceDpIndex);
+    EXPECT_EQ(ECPD_REMOTE_RESET_COM, config.remoteResetType);
+    EXPECT_EQ(SDMLazyOpen_Background, config.lazyOpen);
+    EXPECT_FALSE(config.comHwTxBlocking);
+    EXPECT_EQ(17u, config.driver.txRetries);
+    EXPECT_TRUE(config.driver.rxPump);
+    EXPECT_EQ(1024u, config.driver.rxPumpQueueSize);
+    EXPECT_EQ(64u, config.driver.txPipelineChunk);
+    EXPECT_EQ(ECPD_POLL_PROBE, config.driver.pollMode);
+    EXPECT_EQ(0x5D0001u, config.privateKeyId);
+    EXPECT_EQ(SDM_LOG_LEVEL_DEBUG, config.logLevel);
+}
+
+TEST_F(SDMRuntimeConfigFileTest, UnknownKeysIgnored)
+{
+    // keys from newer releases are skipped, the rest of the file still applies
+    EXPECT_EQ(SDMReturnCode_Success, parse("future_key = 1\ntx_retries = 3\nanother_key = text\n"));
+    EXPECT_EQ(3u, config.driver.txRetries);
+}
+
+TEST_F(SDMRuntimeConfigFileTest, RejectsBadValues)
+{
+    const char* lines[] = {
+        "tx_retries = -1\n",
+        "tx_retries = 12x\n",
+        "tx_retries = 0x100000000\n",
+        "tx_retries =\n",
+        "com_device_dp_index = 256\n",
+        "rx_pump_queue_size = 0\n",
+        "private_key_id = 0\n",
+        "rx_pump = maybe\n",
+        "poll_mode = fast\n",
+        "lazy_open = later\n",
+        "log_level = loud\n",
+        "private_key_file =\n",
+        "tx_retries 3\n",
+    };
+
+    for (const char* line : lines)
+    {
+        SDMRuntimeConfig rejected;
+        EXPECT_EQ(SDMReturnCode_InvalidArgument, rejected.Parse(write(SDM_RUNTIME_CONFIG_FILE_NAME, line))) << line;
+        EXPECT_TRUE(rejected.path.empty()) << line;
+    }
+
+    EXPECT_EQ(SDMReturnCode_InvalidArgument, config.Parse(directory + "missing.ini"));
+}
+
+TEST_F(SDMRuntimeConfigFileTest, ResolvesPaths)
+{
+    EXPECT_EQ(SDMReturnCode_Success, parse(
+        "private_key_file = keys/key.pem\n"
+        "trust_chain_file = /opt/chain.psa\n"
+        "authentication_bundle_file = bundle.sdmb\n"
+        "register_trace_file = trace.txt\n"
+        "timeline_file = /var/tmp/timeline.json\n"));
+
+    // relative to the configuration file, absolute paths as given
+    EXPECT_EQ(directory + "keys/key.pem", config.privateKeyFile);
+    EXPECT_EQ("/opt/chain.psa", config.trustChainFile);
+    EXPECT_EQ(directory + "bundle.sdmb", config.authenticationBundleFile);
+    EXPECT_EQ(directory + "trace.txt", config.registerTraceFile);
+    EXPECT_EQ("/var/tmp/timeline.json", config.timelineFile);
+}
+
+TEST_F(SDMRuntimeConfigFileTest, LocatesFile)
+{
+    SDMOpenParameters params;
+    memset(&params, 0, sizeof(params));
+
+    // nothing to find leaves the defaults
+    EXPECT_EQ(SDMReturnCode_Success, config.Load(&params));
+    EXPECT_TRUE(config.path.empty());
+
+    // next to the manifest, unless the resources directory has one
+    std::string manifest = directory + "manifest.xml";
+    std::string found = write(SDM_RUNTIME_CONFIG_FILE_NAME, "tx_retries = 3\n");
+    params.manifestFilePath = manifest.c_str();
+    EXPECT_EQ(SDMReturnCode_Success, config.Load(&params));
+    EXPECT_EQ(found, config.path);
+    EXPECT_EQ(3u, config.driver.txRetries);
+
+    std::string resources = directory + "resources";
+    ASSERT_EQ(0, mkdir(resources.c_str(), 0700));
+    std::string resourcesFile = write("resources/" SDM_RUNTIME_CONFIG_FILE_NAME, "tx_retries = 5\n");
+    params.resourcesDirectoryPath = resources.c_str();
+    SDMRuntimeConfig fromResources;
+    EXPECT_EQ(SDMReturnCode_Success, fromResources.Load(&params));
+    EXPECT_EQ(resourcesFile, fromResources.path);
+    EXPECT_EQ(5u, fromResources.driver.txRetries);
+
+    // SDM_CONFIG_FILE takes precedence and must exist
+    std::string explicitFile = write("explicit.ini", "tx_retries = 4\n");
+    setenv(SDM_ENV_CONFIG_FILE, explicitFile.c_str(), 1);
+    SDMRuntimeConfig fromEnv;
+    EXPECT_EQ(SDMReturnCode_Success, fromEnv.Load(&params));
+    EXPECT_EQ(explicitFile, fromEnv.path);
+    EXPECT_EQ(4u, fromEnv.driver.txRetries);
+
+    setenv(SDM_ENV_CONFIG_FILE, (directory + "missing.ini").c_str(), 1);
+    SDMRuntimeConfig missing;
+    EXPECT_EQ(SDMReturnCode_InvalidArgument, missing.Load(&params));
+}
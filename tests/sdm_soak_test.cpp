@@ -0,0 +1,436 @@
+// sdm_soak_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * Repeated open/authenticate/close cycles through the library, against an in-process
+ * SDC-600 model and ADAC target emulation. Checks that sessions release
+ * what they acquire: no resident memory growth, no PSA key slots or arena blocks in use.
+ *
+ * SDM_SOAK_CYCLES overrides the number of cycles.
+ */
+
+#include "gtest/gtest.h"
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+#include "sdc600_model.h"
+#include "adac_target.h"
+#include "psa_adac.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+namespace
+{
+    const uint8_t PSADBG_ID[SDC600_ID_LENGTH] = { 0x50, 0x53, 0x41, 0x44, 0x42, 0x47 };
+
+    SDMReturnCode resetCallback(SDMResetType resetType, void* refcon)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    void updateProgress(const char* progressMessage, uint8_t percentComplete, void* refcon)
+    {
+    }
+
+    void setErrorMessage(const char* errorMessage, const char* errorDetails, void* refcon)
+    {
+    }
+
+    size_t residentBytes()
+    {
+        long pages = 0;
+        long resident = 0;
+        FILE* statm = fopen("/proc/self/statm", "r");
+        if (statm == NULL)
+        {
+            return 0;
+        }
+        int fields = fscanf(statm, "%ld %ld", &pages, &resident);
+        fclose(statm);
+        return fields == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+    }
+
+    SDMResourceUsage resourceUsage()
+    {
+        SDMResourceUsage usage;
+        memset(&usage, 0, sizeof(usage));
+        usage.size = sizeof(usage);
+        EXPECT_EQ(SDMReturnCode_Success, SDMGetResourceUsage(&usage));
+        return usage;
+    }
+
+    // a session on the model, authenticated with the example credentials
+    struct ModelSession
+    {
+        Sdc600Model target;
+        AdacTarget adac;
+        SDMCallbacks callbacks;
+        SDMOpenParameters params;
+        SDMOpenExtensions extensions;
+
+        ModelSession(const std::string& keyFile, const std::string& chainFile) :
+            target(SDMDebugArchitecture_ArmADIv6)
+        {
+            target.SetIdentification(PSADBG_ID);
+            adac.Attach(target);
+
+            memset(&callbacks, 0, sizeof(callbacks));
+            callbacks.registerAccess = Sdc600Model::RegisterAccessCallback;
+            callbacks.resetStart = resetCallback;
+            callbacks.resetFinish = resetCallback;
+            callbacks.updateProgress = updateProgress;
+            callbacks.setErrorMessage = setErrorMessage;
+
+            memset(&params, 0, sizeof(params));
+            params.version.major = SDMVersion_CurrentMajor;
+            params.version.minor = SDMVersion_CurrentMinor;
+            params.debugArchitecture = SDMDebugArchitecture_ArmADIv6;
+            params.callbacks = &callbacks;
+            params.refcon = &target;
+
+            memset(&extensions, 0, sizeof(extensions));
+            extensions.size = sizeof(extensions);
+            extensions.privateKeyFile = keyFile.c_str();
+            extensions.trustChainFile = chainFile.c_str();
+        }
+    };
+
+    void runCycle(const std::string& keyFile, const std::string& chainFile, uint32_t keyId = 0)
+    {
+        ModelSession session(keyFile, chainFile);
+        session.extensions.privateKeyId = keyId;
+
+        SDMHandle handle = 0;
+        ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        EXPECT_EQ(SDMReturnCode_Success, SDMAuthenticate(handle, NULL));
+        EXPECT_TRUE(session.adac.Authenticated());
+        EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+    }
+
+    // SDM_CONFIG_FILE naming a temporary file with the given settings, while in scope
+    class ScopedConfigFile
+    {
+    public:
+        explicit ScopedConfigFile(const char* settings)
+        {
+            strcpy(mPath, "/tmp/sdm_soak_config.XXXXXX");
+            int fd = mkstemp(mPath);
+            EXPECT_GE(fd, 0);
+            if (fd >= 0)
+            {
+                EXPECT_EQ((ssize_t)strlen(settings), write(fd, settings, strlen(settings)));
+                close(fd);
+            }
+            setenv("SDM_CONFIG_FILE", mPath, 1);
+        }
+
+        ~ScopedConfigFile()
+        {
+            unsetenv("SDM_CONFIG_FILE");
+            unlink(mPath);
+        }
+
+    private:
+        char mPath[32];
+    };
+
+    // the persistent key store is in the working directory unless fixed by the build, keep
+    // the test's keys out of the real one
+    class ScopedWorkingDirectory
+    {
+    public:
+        ScopedWorkingDirectory()
+        {
+            strcpy(mPath, "/tmp/sdm_soak_keys.XXXXXX");
+            EXPECT_TRUE(mkdtemp(mPath) != NULL);
+            EXPECT_TRUE(getcwd(mPrevious, sizeof(mPrevious)) != NULL);
+            EXPECT_EQ(0, chdir(mPath));
+        }
+
+        ~ScopedWorkingDirectory()
+        {
+            EXPECT_EQ(0, chdir(mPrevious));
+
+            DIR* directory = opendir(mPath);
+            if (directory != NULL)
+            {
+                for (struct dirent* entry = readdir(directory); entry != NULL; entry = readdir(directory))
+                {
+                    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                    {
+                        unlink((std::string(mPath) + "/" + entry->d_name).c_str());
+                    }
+                }
+                closedir(directory);
+            }
+            rmdir(mPath);
+        }
+
+    private:
+        char mPath[32];
+        char mPrevious[PATH_MAX];
+    };
+
+    // register accesses made with the limits reported by probeCapabilities
+    struct LimitedProbe
+    {
+        Sdc600Model* target;
+        int pollSupported;
+        size_t longestList;
+        size_t longestDbrList;
+        size_t polls;
+    };
+
+    SDMReturnCode limitedRegisterAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+    {
+        LimitedProbe* probe = (LimitedProbe*)refcon;
+        probe->longestList = std::max(probe->longestList, accessCount);
+
+        size_t dbrWrites = 0;
+        for (size_t i = 0; i < accessCount; i++)
+        {
+            dbrWrites += (accesses[i].address & 0xFF) == 0x30 ? 1 : 0;
+            probe->polls += accesses[i].op == SDMRegisterAccessOp_Poll ? 1 : 0;
+        }
+        probe->longestDbrList = std::max(probe->longestDbrList, dbrWrites);
+
+        return probe->target->RegisterAccess(accesses, accessCount, accessesCompleted);
+    }
+
+    // register accesses and the threads they are made from
+    struct ThreadCheckedProbe
+    {
+        Sdc600Model* target;
+        std::thread::id caller;
+        size_t accesses;
+        size_t otherThreadAccesses;
+    };
+
+    SDMReturnCode threadCheckedRegisterAccess(const SDMDeviceDescriptor* device, SDMTransferSize transferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void* refcon)
+    {
+        ThreadCheckedProbe* probe = (ThreadCheckedProbe*)refcon;
+        probe->accesses++;
+        probe->otherThreadAccesses += std::this_thread::get_id() != probe->caller ? 1 : 0;
+        return probe->target->RegisterAccess(accesses, accessCount, accessesCompleted);
+    }
+
+    SDMReturnCode probeCapabilities(SDMProbeCapabilities* capabilities, void* refcon)
+    {
+        // prefilled from the configuration, which never limits the list length here
+        EXPECT_EQ(sizeof(SDMProbeCapabilities), capabilities->size);
+        EXPECT_EQ(0u, capabilities->maxAccessListLength);
+        EXPECT_NE(0, capabilities->dbrStallTolerated);
+
+        capabilities->maxAccessListLength = 16;
+        capabilities->pollSupported = ((LimitedProbe*)refcon)->pollSupported;
+        capabilities->dbrStallTolerated = 0;
+        return SDMReturnCode_Success;
+    }
+
+    LimitedProbe runLimitedSession(const std::string& keyFile, const std::string& chainFile, int pollSupported)
+    {
+        ModelSession session(keyFile, chainFile);
+        LimitedProbe probe = { &session.target, pollSupported, 0, 0, 0 };
+        session.callbacks.registerAccess = limitedRegisterAccess;
+        session.params.refcon = &probe;
+        session.extensions.queryProbeCapabilities = probeCapabilities;
+
+        SDMHandle handle = 0;
+        EXPECT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        if (handle != 0)
+        {
+            EXPECT_EQ(SDMReturnCode_Success, SDMAuthenticate(handle, NULL));
+            EXPECT_TRUE(session.adac.Authenticated());
+            EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+        }
+
+        probe.target = NULL;
+        return probe;
+    }
+}
+
+TEST(SDMSoakTest, OpenAuthenticateCloseCycles)
+{
+    const char* cyclesEnv = getenv("SDM_SOAK_CYCLES");
+    const unsigned long cycles = cyclesEnv != NULL ? strtoul(cyclesEnv, NULL, 0) : 2000;
+    const unsigned long warmup = cycles / 10;
+
+    const std::string keyFile = std::string(SDM_SOAK_DATA_DIR) + "/keys/EcdsaP256Key-3.pem";
+    const std::string chainFile = std::string(SDM_SOAK_DATA_DIR) + "/chains/chain.EcdsaP256-3";
+
+    // caches and the PSA context settle during the first cycles
+    for (unsigned long i = 0; i < warmup; i++)
+    {
+        runCycle(keyFile, chainFile);
+    }
+    size_t baseline = residentBytes();
+
+    for (unsigned long i = warmup; i < cycles && !HasFailure(); i++)
+    {
+        runCycle(keyFile, chainFile);
+
+        SDMResourceUsage usage = resourceUsage();
+        ASSERT_EQ(0u, usage.openSessions) << "cycle " << i;
+        ASSERT_EQ(0u, usage.sessionKeys) << "cycle " << i;
+        ASSERT_EQ(0u, usage.sessionBuffers) << "cycle " << i;
+        ASSERT_EQ(0u, usage.psaKeySlotsInUse) << "cycle " << i;
+        ASSERT_EQ(0u, usage.arenaBytes) << "cycle " << i;
+    }
+
+    // allow for allocator noise, a per-cycle leak of a token or chain buffer is far larger over the run
+    size_t growth = residentBytes() - std::min(baseline, residentBytes());
+    EXPECT_LT(growth, (size_t)1024 * 1024) << "resident memory grew by " << growth << " bytes";
+}
+
+TEST(SDMSoakTest, PersistentKeyCycles)
+{
+    const std::string keyFile = std::string(SDM_SOAK_DATA_DIR) + "/keys/EcdsaP256Key-3.pem";
+    const std::string chainFile = std::string(SDM_SOAK_DATA_DIR) + "/chains/chain.EcdsaP256-3";
+    const uint32_t keyId = 0x5D0001;
+
+#ifdef SDM_KEY_STORE_DIR
+    // the test would delete and provision keys in the store used by debuggers
+#ifdef GTEST_SKIP
+    GTEST_SKIP() << "key store fixed at " SDM_KEY_STORE_DIR " by the build";
+#else
+    FAIL() << "key store fixed at " SDM_KEY_STORE_DIR " by the build, run with a build that keeps it in the working directory";
+#endif
+#endif
+
+    ScopedWorkingDirectory keyStore;
+
+    ASSERT_EQ(SDMReturnCode_Success, SDMProvisionKey(keyFile.c_str(), keyId));
+    EXPECT_EQ(SDMReturnCode_InvalidArgument, SDMProvisionKey(keyFile.c_str(), keyId));
+    EXPECT_EQ(0u, resourceUsage().psaKeySlotsInUse);
+
+    // the key file is never read by the sessions
+    for (int i = 0; i < 20 && !HasFailure(); i++)
+    {
+        runCycle("/nonexistent.pem", chainFile, keyId);
+
+        SDMResourceUsage usage = resourceUsage();
+        ASSERT_EQ(0u, usage.sessionKeys) << "cycle " << i;
+        ASSERT_EQ(0u, usage.psaKeySlotsInUse) << "cycle " << i;
+    }
+
+    EXPECT_EQ(SDMReturnCode_Success, SDMDeleteKey(keyId));
+    EXPECT_EQ(SDMReturnCode_InvalidArgument, SDMDeleteKey(keyId));
+}
+
+TEST(SDMSoakTest, LazyOpen)
+{
+    const std::string keyFile = std::string(SDM_SOAK_DATA_DIR) + "/keys/EcdsaP256Key-3.pem";
+    const std::string chainFile = std::string(SDM_SOAK_DATA_DIR) + "/chains/chain.EcdsaP256-3";
+
+    // established by SDMAuthenticate
+    {
+        ModelSession session(keyFile, chainFile);
+        session.extensions.lazyOpen = SDMLazyOpen_FirstUse;
+
+        SDMHandle handle = 0;
+        ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        EXPECT_FALSE(session.target.LinkEstablished());
+        EXPECT_EQ(SDMReturnCode_Success, SDMAuthenticate(handle, NULL));
+        EXPECT_TRUE(session.target.LinkEstablished());
+        EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+    }
+
+    // never used, never established
+    {
+        ModelSession session(keyFile, chainFile);
+        session.extensions.lazyOpen = SDMLazyOpen_FirstUse;
+
+        SDMHandle handle = 0;
+        ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+        EXPECT_FALSE(session.target.LinkEstablished());
+    }
+
+    // established on a library thread, joined by SDMAuthenticate
+    {
+        ModelSession session(keyFile, chainFile);
+        session.extensions.lazyOpen = SDMLazyOpen_Background;
+
+        SDMHandle handle = 0;
+        ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        EXPECT_EQ(SDMReturnCode_Success, SDMAuthenticate(handle, NULL));
+        EXPECT_TRUE(session.target.LinkEstablished());
+        EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+    }
+
+    // an unsupported target is reported by SDMAuthenticate
+    {
+        const uint8_t otherId[SDC600_ID_LENGTH] = { 0x4F, 0x54, 0x48, 0x45, 0x52, 0x00 };
+        ModelSession session(keyFile, chainFile);
+        session.target.SetIdentification(otherId);
+        session.extensions.lazyOpen = SDMLazyOpen_Background;
+
+        SDMHandle handle = 0;
+        ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+        EXPECT_EQ(SDMReturnCode_UnsupportedOperation, SDMAuthenticate(handle, NULL));
+        EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+    }
+
+    EXPECT_EQ(0u, resourceUsage().openSessions);
+}
+
+TEST(SDMSoakTest, ProbeCapabilities)
+{
+    const std::string keyFile = std::string(SDM_SOAK_DATA_DIR) + "/keys/EcdsaP256Key-3.pem";
+    const std::string chainFile = std::string(SDM_SOAK_DATA_DIR) + "/chains/chain.EcdsaP256-3";
+
+    // lists split at the reported length and no DBR list longer than the TX FIFO free
+    // level the model reports. Probe polls are not configured, reporting them does not
+    // turn them on
+    LimitedProbe probe = runLimitedSession(keyFile, chainFile, 1);
+    EXPECT_LE(probe.longestList, 16u);
+    EXPECT_EQ(0u, probe.polls);
+    EXPECT_GT(probe.longestDbrList, 0u);
+    EXPECT_LE(probe.longestDbrList, 4u);
+
+    // configured probe polls are used if the probe reports them, and only then
+    ScopedConfigFile config("poll_mode = probe\n");
+    EXPECT_GT(runLimitedSession(keyFile, chainFile, 1).polls, 0u);
+    EXPECT_EQ(0u, runLimitedSession(keyFile, chainFile, 0).polls);
+}
+
+TEST(SDMSoakTest, CallerThreadCallbacks)
+{
+    const std::string keyFile = std::string(SDM_SOAK_DATA_DIR) + "/keys/EcdsaP256Key-3.pem";
+    const std::string chainFile = std::string(SDM_SOAK_DATA_DIR) + "/chains/chain.EcdsaP256-3";
+
+    // both modes that make callbacks from library threads
+    ScopedConfigFile config("rx_pump = true\nlazy_open = background\n");
+
+    ModelSession session(keyFile, chainFile);
+    ThreadCheckedProbe probe = { &session.target, std::this_thread::get_id(), 0, 0 };
+    session.callbacks.registerAccess = threadCheckedRegisterAccess;
+    session.params.refcon = &probe;
+    session.extensions.callerThreadCallbacks = 1;
+
+    SDMHandle handle = 0;
+    ASSERT_EQ(SDMReturnCode_Success, SDMOpenEx(&handle, &session.params, &session.extensions));
+    size_t openAccesses = probe.accesses;
+    EXPECT_EQ(SDMReturnCode_Success, SDMAuthenticate(handle, NULL));
+    EXPECT_TRUE(session.adac.Authenticated());
+    EXPECT_EQ(SDMReturnCode_Success, SDMClose(handle));
+
+    // the link was left to SDMAuthenticate, and every access made from this thread
+    EXPECT_EQ(0u, openAccesses);
+    EXPECT_GT(probe.accesses, 0u);
+    EXPECT_EQ(0u, probe.otherThreadAccesses);
+}
@@ -0,0 +1,146 @@
+// sdm_timeline_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+
+#include "sdm_timeline.h"
+#include "ext_com_port_driver.h"
+
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace testing;
+
+namespace
+{
+    class SDMTimelineTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            timelinePath = TempDir() + "sdm_timeline_test.json";
+        }
+
+    protected:
+        std::string readTimeline()
+        {
+            std::ifstream file(timelinePath.c_str());
+            std::stringstream text;
+            text << file.rdbuf();
+            return text.str();
+        }
+
+        std::string timelinePath;
+    };
+}
+
+TEST_F(SDMTimelineTest, Scopes)
+{
+    ArenaPtr<SDMTimeline> timeline = SDMTimeline::Create(timelinePath);
+    ASSERT_TRUE((bool)timeline);
+
+    {
+        SDMTimelineScope outer(timeline.get(), "authenticate", SDM_TIMELINE_SESSION);
+        SDMTimelineScope phase(timeline.get(), SDM_TIMELINE_SESSION);
+        phase.Next("credential load");
+        phase.Next("certificate TX", 1);
+        std::thread([&timeline]() { SDMTimelineScope scope(timeline.get(), "signing \"token\"", SDM_TIMELINE_SESSION); }).join();
+    }
+    // B/E for authenticate, credential load, certificate TX 1 and signing
+    EXPECT_EQ(8u, timeline->EventCount());
+    EXPECT_EQ(SDMReturnCode_Success, timeline->Write());
+
+    std::string text = readTimeline();
+    EXPECT_THAT(text, StartsWith("{\"displayTimeUnit\":\"ms\",\"traceEvents\":["));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"credential load\",\"cat\":\"session\",\"ph\":\"B\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"credential load\",\"cat\":\"session\",\"ph\":\"E\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"certificate TX 1\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"signing \\\"token\\\"\""));
+    EXPECT_THAT(text, HasSubstr("\"tid\":"));
+}
+
+TEST_F(SDMTimelineTest, InArena)
+{
+    SessionArena arena(NULL, 0);
+    {
+        ArenaPtr<SDMTimeline> timeline = SDMTimeline::Create(timelinePath, &arena);
+        ASSERT_TRUE((bool)timeline);
+
+        // the timeline and its reserved events are taken from the arena
+        EXPECT_GT(arena.BytesReserved(), sizeof(SDMTimeline));
+        SDMTimeline::Begin(timeline.get(), "open", SDM_TIMELINE_SESSION);
+        SDMTimeline::End(timeline.get(), "open", SDM_TIMELINE_SESSION);
+        EXPECT_EQ(2u, timeline->EventCount());
+    }
+
+    // written on destruction
+    EXPECT_THAT(readTimeline(), HasSubstr("{\"name\":\"open\",\"cat\":\"session\",\"ph\":\"E\""));
+}
+
+TEST_F(SDMTimelineTest, Disabled)
+{
+    // a NULL timeline makes every scope a no-op
+    SDMTimelineScope scope(NULL, "open", SDM_TIMELINE_SESSION);
+    SDMTimelineScope phase(NULL, SDM_TIMELINE_SESSION);
+    phase.Next("power");
+    phase.End();
+    SDMTimeline::Begin(NULL, "close", SDM_TIMELINE_SESSION);
+    SDMTimeline::End(NULL, "close", SDM_TIMELINE_SESSION);
+}
+
+TEST_F(SDMTimelineTest, DriverEvents)
+{
+    std::deque<uint8_t> rx = { FLAG_LPH1RL, FLAG_LPH1RA, FLAG_LPH2RA, FLAG_IDA, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, FLAG_END };
+    SDMRegisterAccessCallback target = [&rx](const SDMDeviceDescriptor*, SDMTransferSize, const SDMRegisterAccess* accesses, size_t accessCount, size_t* accessesCompleted, void*)
+    {
+        for (size_t i = 0; i < accessCount; i++)
+        {
+            if (accesses[i].op == SDMRegisterAccessOp_Read && (accesses[i].address & 0xFF) == 0x2C)
+            {
+                *accesses[i].value = 0x10001;
+            }
+            else if (accesses[i].op == SDMRegisterAccessOp_Read)
+            {
+                uint8_t byte = FLAG__NULL;
+                if (!rx.empty())
+                {
+                    byte = rx.front();
+                    rx.pop_front();
+                }
+                *accesses[i].value = 0xAFAFAF00 | byte;
+            }
+        }
+        *accessesCompleted = accessCount;
+        return (SDMReturnCode)SDMReturnCode_Success;
+    };
+
+    SDMDeviceDescriptor comDevice;
+    comDevice.deviceType = SDMDeviceType_ArmADI_CoreSightComponent;
+    comDevice.armCoreSightComponent.dpIndex = 0;
+    comDevice.armCoreSightComponent.memAp = NULL;
+    comDevice.armCoreSightComponent.baseAddress = 0x12345678;
+
+    ArenaPtr<SDMTimeline> timeline = SDMTimeline::Create(timelinePath);
+    ASSERT_TRUE((bool)timeline);
+
+    ExternalComPortDriver extCom(comDevice, SDMDebugArchitecture_ArmADIv6, target, nullptr, nullptr, NULL);
+    extCom.SetTimeline(timeline.get());
+
+    uint8_t idResBuff[6];
+    ASSERT_EQ(SDMReturnCode_Success, extCom.EComPort_Init(ECPD_REMOTE_RESET_NONE, idResBuff, sizeof(idResBuff)));
+    ASSERT_EQ(SDMReturnCode_Success, timeline->Write());
+
+    std::string text = readTimeline();
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"power on\",\"cat\":\"driver\",\"ph\":\"B\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"LPH2 handshake\",\"cat\":\"driver\",\"ph\":\"E\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"IDR/IDA\",\"cat\":\"driver\",\"ph\":\"E\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"SR read\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"DR read burst\""));
+    EXPECT_THAT(text, HasSubstr("{\"name\":\"DR write burst\""));
+}
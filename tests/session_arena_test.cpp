@@ -0,0 +1,149 @@
+// session_arena_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "session_arena.h"
+#include "ext_com_port_driver.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+using namespace testing;
+
+namespace
+{
+    // heap allocator with a byte budget
+    struct Budget
+    {
+        size_t limit;
+        size_t inUse;
+        size_t blocks;
+    };
+
+    void* budgetAllocate(size_t size, size_t alignment, void* context)
+    {
+        Budget* budget = (Budget*)context;
+        if (budget->inUse + size > budget->limit)
+        {
+            return NULL;
+        }
+        budget->inUse += size;
+        budget->blocks++;
+        return malloc(size);
+    }
+
+    void budgetDeallocate(void* ptr, size_t size, size_t alignment, void* context)
+    {
+        Budget* budget = (Budget*)context;
+        budget->inUse -= size;
+        budget->blocks--;
+        free(ptr);
+    }
+
+    class SessionArenaTest : public Test
+    {
+    public:
+        virtual void SetUp()
+        {
+            budget = { 64 * 1024, 0, 0 };
+            allocator.allocate = budgetAllocate;
+            allocator.deallocate = budgetDeallocate;
+            allocator.context = &budget;
+        }
+
+    protected:
+        Budget budget;
+        SDMAllocator allocator;
+    };
+}
+
+TEST_F(SessionArenaTest, AllocationsShareBlocks)
+{
+    SessionArena arena(&allocator, 4096);
+
+    uint8_t* a = (uint8_t*)arena.Allocate(10, 1);
+    uint64_t* b = (uint64_t*)arena.Allocate(sizeof(uint64_t), alignof(uint64_t));
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    EXPECT_EQ(0u, (uintptr_t)b % alignof(uint64_t));
+    EXPECT_GE((uint8_t*)b, a + 10);
+    EXPECT_EQ(1u, budget.blocks);
+    EXPECT_EQ(arena.BytesReserved(), budget.inUse);
+}
+
+TEST_F(SessionArenaTest, LargeAllocationGetsOwnBlock)
+{
+    SessionArena arena(&allocator, 4096);
+
+    ASSERT_NE(nullptr, arena.Allocate(16, 8));
+    ASSERT_NE(nullptr, arena.Allocate(10000, 8));
+    EXPECT_EQ(2u, budget.blocks);
+    EXPECT_GE(budget.inUse, 4096u + 10000u);
+}
+
+TEST_F(SessionArenaTest, ReleaseReturnsEveryBlock)
+{
+    size_t before = SessionArena::TotalBytesReserved();
+    {
+        SessionArena arena(&allocator, 1024);
+        for (int i = 0; i < 20; i++)
+        {
+            ASSERT_NE(nullptr, arena.Allocate(500, 4));
+        }
+        EXPECT_GT(budget.blocks, 1u);
+        EXPECT_EQ(before + arena.BytesReserved(), SessionArena::TotalBytesReserved());
+    }
+    EXPECT_EQ(0u, budget.blocks);
+    EXPECT_EQ(0u, budget.inUse);
+    EXPECT_EQ(before, SessionArena::TotalBytesReserved());
+}
+
+TEST_F(SessionArenaTest, ExhaustedBudgetThrowsBadAlloc)
+{
+    budget.limit = 8 * 1024;
+    SessionArena arena(&allocator, 4096);
+
+    EXPECT_EQ(nullptr, arena.Allocate(16 * 1024, 8));
+
+    ArenaVector<uint32_t> words{ ArenaAllocator<uint32_t>(&arena) };
+    EXPECT_THROW(words.resize(16 * 1024), std::bad_alloc);
+    EXPECT_NO_THROW(words.resize(256));
+}
+
+TEST_F(SessionArenaTest, ArenaNewDestroysInPlace)
+{
+    SessionArena arena(&allocator, 4096);
+
+    SDMDeviceDescriptor device;
+    memset(&device, 0, sizeof(device));
+    ArenaPtr<ExternalComPortDriver> driver = ArenaNew<ExternalComPortDriver>(&arena, device, SDMDebugArchitecture_ArmADIv6, SDMRegisterAccessCallback(), SDMResetCallback(), SDMResetCallback(), (void*)NULL, ECPDConfig(), &arena);
+    ASSERT_TRUE((bool)driver);
+    EXPECT_EQ(1u, budget.blocks);
+
+    driver.reset();
+    EXPECT_EQ(1u, budget.blocks);
+}
+
+TEST_F(SessionArenaTest, NullArenaUsesHeap)
+{
+    ArenaVector<uint8_t> bytes;
+    bytes.assign(100000, 0xAB);
+    EXPECT_EQ(0xAB, bytes.back());
+
+    ArenaPtr<int> value = ArenaNew<int>(NULL, 42);
+    ASSERT_TRUE((bool)value);
+    EXPECT_EQ(42, *value);
+}
+
+TEST_F(SessionArenaTest, DefaultsToHeapBlocks)
+{
+    SessionArena arena(NULL, 0);
+    ASSERT_NE(nullptr, arena.Allocate(100, 16));
+    EXPECT_EQ((size_t)SESSION_ARENA_DEFAULT_BLOCK_SIZE, arena.BytesReserved());
+    EXPECT_EQ(0u, budget.blocks);
+}
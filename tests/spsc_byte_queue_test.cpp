@@ -0,0 +1,87 @@
+// spsc_byte_queue_test.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+#include "gtest/gtest.h"
+
+#include "spsc_byte_queue.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace testing;
+
+TEST(SpscByteQueueTest, WrapsAround)
+{
+    uint8_t storage[8];
+    SpscByteQueue queue;
+    queue.Reset(storage, sizeof(storage));
+    EXPECT_EQ(8u, queue.Capacity());
+
+    const uint8_t first[6] = { 1, 2, 3, 4, 5, 6 };
+    EXPECT_EQ(6u, queue.Push(first, sizeof(first)));
+
+    uint8_t out[8] = { 0 };
+    EXPECT_EQ(4u, queue.Pop(out, 4));
+    EXPECT_EQ(4, out[3]);
+
+    // crosses the end of storage, and only fills the free space
+    const uint8_t second[8] = { 7, 8, 9, 10, 11, 12, 13, 14 };
+    EXPECT_EQ(6u, queue.Push(second, sizeof(second)));
+    EXPECT_EQ(0u, queue.Free());
+
+    EXPECT_EQ(8u, queue.Pop(out, sizeof(out)));
+    const uint8_t expected[8] = { 5, 6, 7, 8, 9, 10, 11, 12 };
+    EXPECT_EQ(0, memcmp(expected, out, sizeof(out)));
+    EXPECT_EQ(0u, queue.Pop(out, sizeof(out)));
+}
+
+TEST(SpscByteQueueTest, TwoThreadsKeepOrder)
+{
+    const size_t total = 1 << 20;
+    std::vector<uint8_t> storage(64);
+    SpscByteQueue queue;
+    queue.Reset(storage.data(), storage.size());
+
+    std::thread producer([&queue, total]()
+    {
+        uint8_t chunk[13];
+        size_t sent = 0;
+        while (sent < total)
+        {
+            size_t length = std::min(sizeof(chunk), total - sent);
+            for (size_t i = 0; i < length; i++)
+            {
+                chunk[i] = (uint8_t)(sent + i);
+            }
+            size_t pushed = 0;
+            while (pushed < length)
+            {
+                pushed += queue.Push(chunk + pushed, length - pushed);
+            }
+            sent += length;
+        }
+    });
+
+    size_t received = 0;
+    size_t mismatches = 0;
+    uint8_t chunk[29];
+    while (received < total)
+    {
+        size_t count = queue.Pop(chunk, sizeof(chunk));
+        for (size_t i = 0; i < count; i++)
+        {
+            mismatches += chunk[i] != (uint8_t)(received + i);
+        }
+        received += count;
+    }
+    producer.join();
+
+    EXPECT_EQ(total, received);
+    EXPECT_EQ(0u, mismatches);
+    EXPECT_EQ(0u, queue.Size());
+}
@@ -0,0 +1,207 @@
+// sdm_bundle_tool.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Compiles a private key reference and trust chain into an authentication bundle.
+ *
+ * See sdm/authentication_bundle.h for the bundle format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "authentication_bundle.h"
+#include "ext_com_port_driver.h"
+
+#include "psa_adac.h"
+#include "psa_adac_sdm.h"
+#include "psa/crypto.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s KEY_FILE CHAIN_FILE BUNDLE_FILE [--no-frames]\n", binname);
+        fprintf(stderr, "\tKEY_FILE : Path to the private key file, recorded in the bundle as given.\n");
+        fprintf(stderr, "\t           Relative paths are resolved against the bundle directory when loaded.\n");
+        fprintf(stderr, "\tCHAIN_FILE : Path to the trust chain file.\n");
+        fprintf(stderr, "\tBUNDLE_FILE : Path of the bundle to write.\n");
+        fprintf(stderr, "\t--no-frames : Do not include pre-encoded SDC-600 certificate frames.\n");
+    }
+
+    size_t Align(size_t offset)
+    {
+        return (offset + SDM_BUNDLE_ALIGNMENT - 1) & ~(size_t)(SDM_BUNDLE_ALIGNMENT - 1);
+    }
+
+    void Append(std::vector<uint8_t>& bundle, size_t offset, const void* data, size_t size)
+    {
+        if (bundle.size() < offset + size)
+        {
+            bundle.resize(offset + size, 0);
+        }
+        memcpy(bundle.data() + offset, data, size);
+    }
+
+    bool ValidateKey(const char* keyFile)
+    {
+        if (psa_adac_init() < 0)
+        {
+            fprintf(stderr, "Error: PSA crypto initialization failed\n");
+            return false;
+        }
+
+        uint8_t signatureType = 0;
+        psa_key_handle_t handle = 0;
+        if (import_private_key(keyFile, &signatureType, &handle) != 0)
+        {
+            fprintf(stderr, "Error: failed to import private key %s\n", keyFile);
+            return false;
+        }
+
+        psa_destroy_key(handle);
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4 && !(argc == 5 && strcmp(argv[4], "--no-frames") == 0))
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const char* keyFile = argv[1];
+    const char* chainFile = argv[2];
+    const char* bundleFile = argv[3];
+    bool withFrames = argc == 4;
+
+    if (!ValidateKey(keyFile))
+    {
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* chain = NULL;
+    size_t chainSize = 0;
+    if (load_trust_chain(chainFile, &chain, &chainSize) != 0)
+    {
+        fprintf(stderr, "Error: failed to load trust chain %s\n", chainFile);
+        return EXIT_FAILURE;
+    }
+
+    psa_tlv_t* exts[MAX_EXTENSIONS];
+    size_t extsCount = 0;
+    if (split_tlv_static((uint32_t*)chain, chainSize, exts, MAX_EXTENSIONS, &extsCount) < 0)
+    {
+        fprintf(stderr, "Error: failed to parse trust chain %s\n", chainFile);
+        free(chain);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<SDMBundleCertificate> certificates;
+    std::vector<std::vector<uint32_t>> frames;
+    for (size_t i = 0; i < extsCount; i++)
+    {
+        if (exts[i]->type_id != PSA_BINARY_CRT)
+        {
+            continue;
+        }
+
+        SDMBundleCertificate certificate;
+        memset(&certificate, 0, sizeof(certificate));
+        certificate.tlvOffset = (uint32_t)((uint8_t*)exts[i] - chain);
+        certificate.tlvSize = (uint32_t)(exts[i]->length_in_bytes + sizeof(psa_tlv_t));
+        certificate.command = ADAC_AUTH_RESPONSE_CMD;
+        certificate.dataCount = (uint16_t)(certificate.tlvSize / sizeof(uint32_t));
+        certificates.push_back(certificate);
+
+        if (withFrames)
+        {
+            // encode the request exactly as SecureDebugManagerImpl sends it
+            std::vector<uint8_t> request(sizeof(request_packet_t) + certificate.tlvSize, 0);
+            request_packet_t* packet = (request_packet_t*)request.data();
+            packet->command = certificate.command;
+            packet->data_count = certificate.dataCount;
+            memcpy(packet->data, exts[i], certificate.tlvSize);
+
+            size_t size = sizeof(request_packet_t) + sizeof(uint32_t) * packet->data_count;
+            frames.emplace_back();
+            if (ExternalComPortDriver::EComPort_Encode(request.data(), size, frames.back()) != SDMReturnCode_Success)
+            {
+                fprintf(stderr, "Error: failed to encode certificate %zu\n", i);
+                free(chain);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+
+    // lay out the bundle sections
+    SDMBundleHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SDM_BUNDLE_MAGIC;
+    header.version = SDM_BUNDLE_VERSION;
+    header.headerSize = sizeof(SDMBundleHeader);
+    header.flags = withFrames ? SDM_BUNDLE_FLAG_FRAMES : 0;
+    header.keyReferenceType = SDM_BUNDLE_KEY_FILE;
+    header.keyReferenceOffset = (uint32_t)Align(sizeof(SDMBundleHeader));
+    header.keyReferenceSize = (uint32_t)(strlen(keyFile) + 1);
+    header.chainOffset = (uint32_t)Align(header.keyReferenceOffset + header.keyReferenceSize);
+    header.chainSize = (uint32_t)chainSize;
+    header.certificateIndexOffset = (uint32_t)Align(header.chainOffset + header.chainSize);
+    header.certificateCount = (uint32_t)certificates.size();
+    header.frameWordBytes = withFrames ? (uint32_t)ExternalComPortDriver::FRAME_WORD_BYTES : 0;
+
+    size_t offset = Align(header.certificateIndexOffset + certificates.size() * sizeof(SDMBundleCertificate));
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        certificates[i].frameOffset = (uint32_t)offset;
+        certificates[i].frameWordCount = (uint32_t)frames[i].size();
+        offset = Align(offset + frames[i].size() * sizeof(uint32_t));
+    }
+    header.totalSize = (uint32_t)offset;
+
+    std::vector<uint8_t> bundle(header.totalSize, 0);
+    Append(bundle, 0, &header, sizeof(header));
+    Append(bundle, header.keyReferenceOffset, keyFile, header.keyReferenceSize);
+    Append(bundle, header.chainOffset, chain, chainSize);
+    if (!certificates.empty())
+    {
+        Append(bundle, header.certificateIndexOffset, certificates.data(), certificates.size() * sizeof(SDMBundleCertificate));
+    }
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        Append(bundle, certificates[i].frameOffset, frames[i].data(), frames[i].size() * sizeof(uint32_t));
+    }
+    free(chain);
+
+    FILE* output = fopen(bundleFile, "wb");
+    if (output == NULL || fwrite(bundle.data(), 1, bundle.size(), output) != bundle.size())
+    {
+        fprintf(stderr, "Error: failed to write %s\n", bundleFile);
+        if (output != NULL)
+        {
+            fclose(output);
+        }
+        return EXIT_FAILURE;
+    }
+    fclose(output);
+
+    // check the result loads as the library would load it
+    if (!AuthenticationBundle::Open(bundleFile))
+    {
+        fprintf(stderr, "Error: written bundle %s failed validation\n", bundleFile);
+        return EXIT_FAILURE;
+    }
+
+    printf("Wrote %s: %zu certificates, %zu bytes%s\n", bundleFile, certificates.size(), bundle.size(), withFrames ? ", with frames" : "");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+// sdm_key_tool.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Provisions private keys into the Secure Debug Manager persistent key store.
+ *
+ * Sessions then refer to the key by ID (SDMOpenExtensions::privateKeyId, SDM_PRIVATE_KEY_ID
+ * or the private_key_id configuration key) instead of importing the key file on every
+ * authentication. Run from the working directory of the debugger unless the library was
+ * built with SDM_KEY_STORE_DIR.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s provision KEY_FILE KEY_ID\n", binname);
+        fprintf(stderr, "       %s delete KEY_ID\n", binname);
+        fprintf(stderr, "\tprovision : Store the private key in KEY_FILE under KEY_ID.\n");
+        fprintf(stderr, "\tdelete : Remove the key stored under KEY_ID.\n");
+        fprintf(stderr, "\tKEY_ID : From 0x1 to 0x3FFFFFFF, decimal or hexadecimal with a 0x prefix.\n");
+    }
+
+    bool ParseKeyId(const char* text, uint32_t& keyId)
+    {
+        char* end = NULL;
+        unsigned long value = strtoul(text, &end, 0);
+        if (end == text || *end != '\0' || value == 0 || value > 0x3FFFFFFF)
+        {
+            fprintf(stderr, "Error: invalid key ID %s\n", text);
+            return false;
+        }
+
+        keyId = (uint32_t)value;
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t keyId = 0;
+    SDMReturnCode res = SDMReturnCode_InvalidArgument;
+
+    if (argc == 4 && strcmp(argv[1], "provision") == 0)
+    {
+        if (!ParseKeyId(argv[3], keyId))
+        {
+            return EXIT_FAILURE;
+        }
+
+        res = SDMProvisionKey(argv[2], keyId);
+        if (res != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: failed to store %s under key ID 0x%x (%d)\n", argv[2], (unsigned)keyId, (int)res);
+            return EXIT_FAILURE;
+        }
+        printf("Stored %s under key ID 0x%x\n", argv[2], (unsigned)keyId);
+    }
+    else if (argc == 3 && strcmp(argv[1], "delete") == 0)
+    {
+        if (!ParseKeyId(argv[2], keyId))
+        {
+            return EXIT_FAILURE;
+        }
+
+        res = SDMDeleteKey(keyId);
+        if (res != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: failed to delete key ID 0x%x (%d)\n", (unsigned)keyId, (int)res);
+            return EXIT_FAILURE;
+        }
+        printf("Deleted key ID 0x%x\n", (unsigned)keyId);
+    }
+    else
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+// sdm_trace_replay.cpp
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+
+/**
+ * \file
+ *
+ * \brief Replays a recorded register access trace through the Secure Debug Manager.
+ *
+ * Runs SDMOpen, SDMAuthenticate and SDMClose against a trace recorded with
+ * SDM_REGISTER_TRACE_FILE or the register_trace_file configuration key, without a
+ * debug probe or target. See sdm/register_access_trace.h for the trace format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <memory>
+
+#include "secure_debug_manager.h"
+#include "sdm_extensions.h"
+#include "register_access_trace.h"
+
+namespace
+{
+    void PrintUsage(const char* binname)
+    {
+        fprintf(stderr, "Usage: %s [--original-timing] [--check-writes] [--iterations N] TRACE_FILE [KEY_FILE CHAIN_FILE]\n", binname);
+        fprintf(stderr, "\t--original-timing : Answer register accesses no earlier than the recorded session did.\n");
+        fprintf(stderr, "\t--check-writes : Fail on written values that differ from the trace. Signatures differ between\n");
+        fprintf(stderr, "\t                 sessions, so only use this with deterministic credentials.\n");
+        fprintf(stderr, "\t--iterations N : Replay the session N times, reporting the time per session.\n");
+        fprintf(stderr, "\tTRACE_FILE : Path to the register access trace.\n");
+        fprintf(stderr, "\tKEY_FILE, CHAIN_FILE (optional) : Credentials, otherwise resolved from the environment.\n");
+    }
+
+    SDMReturnCode registerAccess(const SDMDeviceDescriptor *device, SDMTransferSize transferSize, const SDMRegisterAccess *accesses, size_t accessCount, size_t *accessesCompleted, void *refcon)
+    {
+        RegisterAccessTraceReplay* replay = (RegisterAccessTraceReplay*)refcon;
+        return replay->Access(accesses, accessCount, accessesCompleted);
+    }
+
+    // resets are not part of the trace, the replayed target is already in its post reset state
+    SDMReturnCode resetStart(SDMResetType resetType, void* refcon)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    SDMReturnCode resetFinish(SDMResetType resetType, void* refcon)
+    {
+        return SDMReturnCode_Success;
+    }
+
+    void updateProgress(const char *progressMessage, uint8_t percentComplete, void *refcon)
+    {
+    }
+
+    void setErrorMessage(const char *errorMessage, const char *errorDetails, void *refcon)
+    {
+        fprintf(stderr, "Error: %s %s\n", errorMessage, errorDetails != NULL ? errorDetails : "");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool originalTiming = false;
+    bool checkWrites = false;
+    unsigned long iterations = 1;
+
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (strcmp(argv[arg], "--original-timing") == 0)
+        {
+            originalTiming = true;
+        }
+        else if (strcmp(argv[arg], "--check-writes") == 0)
+        {
+            checkWrites = true;
+        }
+        else if (strcmp(argv[arg], "--iterations") == 0 && arg + 1 < argc)
+        {
+            iterations = strtoul(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    int positional = argc - arg;
+    if ((positional != 1 && positional != 3) || iterations == 0)
+    {
+        PrintUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<RegisterAccessTraceReplay> replay = RegisterAccessTraceReplay::Open(argv[arg]);
+    if (!replay)
+    {
+        fprintf(stderr, "Error: failed to load trace %s\n", argv[arg]);
+        return EXIT_FAILURE;
+    }
+    replay->SetTiming(originalTiming ? RegisterAccessTraceReplay::TIMING_ORIGINAL : RegisterAccessTraceReplay::TIMING_FULL_SPEED);
+    replay->SetCheckWriteValues(checkWrites);
+
+    SDMOpenExtensions sdmOpenExtensions;
+    memset(&sdmOpenExtensions, 0, sizeof(sdmOpenExtensions));
+    sdmOpenExtensions.size = sizeof(sdmOpenExtensions);
+    if (positional == 3)
+    {
+        sdmOpenExtensions.privateKeyFile = argv[arg + 1];
+        sdmOpenExtensions.trustChainFile = argv[arg + 2];
+    }
+
+    SDMCallbacks sdmCallbacks;
+    memset(&sdmCallbacks, 0, sizeof(sdmCallbacks));
+    sdmCallbacks.updateProgress = updateProgress;
+    sdmCallbacks.setErrorMessage = setErrorMessage;
+    sdmCallbacks.resetStart = resetStart;
+    sdmCallbacks.resetFinish = resetFinish;
+    sdmCallbacks.registerAccess = registerAccess;
+
+    SDMOpenParameters sdmOpenParams;
+    memset(&sdmOpenParams, 0, sizeof(sdmOpenParams));
+    sdmOpenParams.version.major = SDMVersion_CurrentMajor;
+    sdmOpenParams.version.minor = SDMVersion_CurrentMinor;
+    sdmOpenParams.debugArchitecture = replay->DebugArchitecture();
+    sdmOpenParams.callbacks = &sdmCallbacks;
+    sdmOpenParams.refcon = replay.get();
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        replay->Rewind();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        SDMHandle sdmHandle;
+        SDMReturnCode sdmRes = SDMOpenEx(&sdmHandle, &sdmOpenParams, &sdmOpenExtensions);
+        if (sdmRes != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: SDM_Open failed with code: 0x%08x at access %zu of %zu\n", sdmRes, replay->Position(), replay->AccessCount());
+            return EXIT_FAILURE;
+        }
+
+        sdmRes = SDMAuthenticate(sdmHandle, NULL);
+        if (sdmRes != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: SDM_Authenticate failed with code: 0x%08x at access %zu of %zu\n", sdmRes, replay->Position(), replay->AccessCount());
+            SDMClose(sdmHandle);
+            return EXIT_FAILURE;
+        }
+
+        sdmRes = SDMClose(sdmHandle);
+        if (sdmRes != SDMReturnCode_Success)
+        {
+            fprintf(stderr, "Error: SDM_Close failed with code: 0x%08x at access %zu of %zu\n", sdmRes, replay->Position(), replay->AccessCount());
+            return EXIT_FAILURE;
+        }
+
+        double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        printf("Session %lu: %zu of %zu accesses replayed in %.3f ms, %zu written values differ from the trace\n",
+               i + 1, replay->Position(), replay->AccessCount(), elapsedMs, replay->WriteValueMismatches());
+    }
+
+    return EXIT_SUCCESS;
+}